@@ -15,6 +15,7 @@ EXTRA_LDFLAGS ?=
 
 DEBUG_BUILD ?=
 TRACE_BUILD ?=
+BOOT_MARKER_BUILD ?=
 
 LIB_DIR := $(TOPDIR)/Src/Efi/Lib
 # Installation location for SELoader.efi
@@ -47,6 +48,10 @@ ifneq ($(TRACE_BUILD),)
 	CFLAGS += -DTRACE_BUILD
 endif
 
+ifneq ($(BOOT_MARKER_BUILD),)
+	CFLAGS += -DBOOT_MARKER_BUILD
+endif
+
 ifneq ($(EXPERIMENTAL_BUILD),)
 	CFLAGS += -DEXPERIMENTAL_BUILD
 endif
@@ -42,8 +42,35 @@
 /* Threshold used to decide to go entire or parital reverse memcpy. */
 #define THRESHOLD_REVERSE_MEMCPY	(sizeof(long) * 16)
 
+/* Threshold used to decide to use AVX2/NEON copy/compare for large buffers. */
+#define THRESHOLD_VECTOR_COPY		(sizeof(long) * 256)
+#define THRESHOLD_VECTOR_COMPARE	(sizeof(long) * 32)
+
 #define UNALIGNED(p)	(((unsigned long)(p)) % __alignof__ (unsigned long))
 
+/* The word accessed at any address */
+typedef UINTN __attribute__((__may_alias__, __aligned__(1))) UNALIGNED_UINTN;
+
+/* Enhanced REP MOVSB/STOSB */
+#define CPU_FEATURE_ERMS		(1 << 0)
+/* Fast Short REP MOVSB */
+#define CPU_FEATURE_FSRM		(1 << 1)
+/* AVX2 enabled by the firmware in XCR0 */
+#define CPU_FEATURE_AVX2		(1 << 2)
+/* ARMv8 SHA-256 instructions */
+#define CPU_FEATURE_SHA256		(1 << 3)
+/* ARMv8.2 SHA-512 instructions */
+#define CPU_FEATURE_SHA512		(1 << 4)
+
+UINT32
+CpuFeatures(VOID);
+
+BOOLEAN
+CpuVectorAcquire(VOID);
+
+VOID
+CpuVectorRelease(VOID);
+
 VOID *
 MemCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength);
 
@@ -56,6 +83,10 @@ MemSet(VOID *Destination, UINT8 Value, UINTN Length);
 INTN
 MemCmp(CONST VOID *FirstSource, CONST VOID *SecondSource, UINTN MaxLength);
 
+INTN
+MemCmpConstantTime(CONST VOID *FirstSource, CONST VOID *SecondSource,
+		   UINTN Length);
+
 VOID *
 MemDup(CONST VOID *Source, UINTN Length);
 
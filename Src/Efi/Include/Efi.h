@@ -47,11 +47,16 @@
 #include <Edk2/Protocol/Hash2.h>
 #include <Edk2/Protocol/Hash.h>
 #include <Edk2/Protocol/Pkcs7Verify.h>
+#include <Edk2/Protocol/LoadFile2.h>
 #include <Edk2/Library/UefiBootServicesTableLib.h>
 #include <Edk2/Library/UefiRuntimeServicesTableLib.h>
 #include <Edk2/Library/PeCoffLib.h>
 #include <Edk2/Protocol/Security.h>
 #include <Edk2/Protocol/Security2.h>
+#include <Edk2/Pi/PiMultiPhase.h>
+#include <Edk2/Protocol/MpService.h>
+#include <Edk2/Protocol/Rng.h>
+#include <Edk2/Protocol/Tcg2Protocol.h>
 
 #ifdef GNU_EFI_VERSION
 #include <GnuEfi.h>
@@ -57,12 +57,39 @@ EfiLibraryVectorizedBufferLeave(VOID **Buffer, UINTN *BufferSize,
 				VOID *Data, UINTN DataSize,
 				BOOLEAN Duplication);
 
+EFI_STATUS
+EfiInitStateFailure(UINTN Index, CONST CHAR16 **Name, EFI_STATUS *Status,
+		    UINTN *Hits);
+
+VOID
+EfiInitStatePrint(VOID);
+
 EFI_STATUS
 EfiMemoryAllocate(IN UINTN Size, OUT VOID **AllocatedBuffer);
 
+EFI_STATUS
+EfiMemoryAllocatePages(IN UINTN Size, IN UINTN Alignment,
+		       IN EFI_PHYSICAL_ADDRESS Address,
+		       OUT VOID **AllocatedBuffer);
+
 VOID
 EfiMemoryFree(VOID *Buffer);
 
+EFI_STATUS
+EfiMemoryArenaEnter(VOID);
+
+VOID
+EfiMemoryArenaLeave(VOID);
+
+VOID
+EfiMemoryArenaSuspend(VOID);
+
+VOID
+EfiMemoryArenaResume(VOID);
+
+EFI_STATUS
+EfiMemoryArenaEscape(VOID **Buffer, UINTN BufferSize);
+
 EFI_STATUS
 EfiProtocolOpen(EFI_HANDLE Handle, CONST EFI_GUID *Protocol, VOID **Interface);
 
@@ -209,6 +236,15 @@ EfiConsolePrint(EfiConsolePrintLevel Level, CHAR16 *Format, ...);
 UINTN
 EfiConsoleTrace(EfiConsolePrintLevel Level, CHAR16 *Format, ...);
 
+EFI_STATUS
+EfiConsoleSetDeferred(BOOLEAN Deferred);
+
+VOID
+EfiConsoleFlush(VOID);
+
+EFI_STATUS
+EfiConsoleSaveLog(VOID);
+
 #define EfiConsoleTraceDebug(Format, ...)	\
 	do {	\
 		EfiConsoleTrace(CPL_DEBUG, Format, ##__VA_ARGS__);	\
@@ -242,18 +278,76 @@ EfiConsoleVSPrint(CHAR16 *OutputBuffer, UINTN OutputBufferLen,
 EFI_STATUS
 EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize);
 
+EFI_STATUS
+EfiFileLoadAt(CONST CHAR16 *Path, EFI_PHYSICAL_ADDRESS Address, VOID **Data,
+	      UINTN *DataSize);
+
+EFI_STATUS
+EfiFileVerifyBuffer(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize);
+
+typedef struct _EFI_FILE_VERIFY_CONTEXT	EFI_FILE_VERIFY_CONTEXT;
+
+EFI_STATUS
+EfiFileVerifyBegin(CONST CHAR16 *Path, EFI_FILE_VERIFY_CONTEXT **Context);
+
+EFI_STATUS
+EfiFileVerifyUpdate(EFI_FILE_VERIFY_CONTEXT *Context, CONST VOID *Data,
+		    UINTN DataSize);
+
+EFI_STATUS
+EfiFileVerifyFinal(EFI_FILE_VERIFY_CONTEXT *Context);
+
+EFI_STATUS
+EfiFileRead(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize);
+
 EFI_STATUS
 EfiFileSave(CONST CHAR16 *Path, VOID *Data, UINTN DataSize);
 
 EFI_STATUS
 EfiFileDelete(CONST CHAR16 *Path);
 
+BOOLEAN
+EfiFileExists(CONST CHAR16 *Path);
+
 EFI_STATUS
 EfiImageExecute(CONST CHAR16 *Path);
 
 EFI_STATUS
 EfiImageExecuteDriver(CONST CHAR16 *Path);
 
+EFI_STATUS
+EfiImageExecuteWithOptions(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions);
+
+EFI_STATUS
+EfiImageExecuteVerified(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions);
+
+EFI_STATUS
+EfiInitrdAdd(VOID *Data, UINTN DataSize);
+
+EFI_STATUS
+EfiInitrdLoad(CONST CHAR16 *Path);
+
+EFI_STATUS
+EfiInitrdInstall(VOID);
+
+VOID
+EfiInitrdUninstall(VOID);
+
+EFI_STATUS
+EfiPreverifyGrubConfig(CONST CHAR16 *Path);
+
+EFI_STATUS
+EfiVerifyCacheEnable(VOID);
+
+EFI_STATUS
+EfiMeasureEnable(UINT32 PcrIndex);
+
+EFI_STATUS
+EfiVerifiedTableEnable(VOID);
+
+EFI_STATUS
+EfiUkiExecute(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions);
+
 EFI_STATUS
 EfiImageLoad(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize);
 
@@ -293,12 +387,22 @@ EFI_STATUS
 EfiSignatureVerifyAttached(VOID *Signature, UINTN SignatureSize,
 			   VOID **Data, UINTN *DataSize);
 
+EFI_STATUS
+EfiSignatureVerifyAttachedHash(VOID *Signature, UINTN SignatureSize,
+			       EFI_GUID **HashAlgorithm, UINT8 **Hash,
+			       UINTN *HashSize);
+
 typedef struct {
 	EFI_GUID *HashAlgorithm;
 	VOID *Hash;
 	UINTN HashSize;
 	BOOLEAN Extended;
 	UINTN HashedDataSize;
+	/* The instance of the hash service running the hash */
+	BOOLEAN Isolated;
+	EFI_HANDLE Handle;
+	EFI_HASH2_PROTOCOL *Hash2Protocol;
+	EFI_HASH_PROTOCOL *HashProtocol;
 } EFI_HASH_CONTEXT;
 
 EFI_STATUS
@@ -308,6 +412,10 @@ EFI_STATUS
 EfiHashInitialize(CONST EFI_GUID *HashAlgorithm,
 		  EFI_HASH_CONTEXT *Context);
 
+EFI_STATUS
+EfiHashInitializeIsolated(CONST EFI_GUID *HashAlgorithm,
+			  EFI_HASH_CONTEXT *Context);
+
 EFI_STATUS
 EfiHashUpdate(EFI_HASH_CONTEXT *Context, CONST UINT8 *Message,
 	      UINTN MessageSize);
@@ -319,4 +427,68 @@ EFI_STATUS
 EfiHashData(CONST EFI_GUID *HashAlgorithm, CONST UINT8 *Message,
 	    UINTN MessageSize, UINT8 **Hash, UINTN *HashSize);
 
+EFI_HASH2_PROTOCOL *
+EfiHashBuiltinProtocol(VOID);
+
+#define EFI_MULTI_HASH_MAX		4
+
+typedef struct {
+	UINTN NumberOfHashAlgorithms;
+	EFI_HASH_CONTEXT Contexts[EFI_MULTI_HASH_MAX];
+} EFI_MULTI_HASH_CONTEXT;
+
+EFI_STATUS
+EfiMultiHashInitialize(EFI_GUID **HashAlgorithms,
+		       UINTN NumberOfHashAlgorithms,
+		       EFI_MULTI_HASH_CONTEXT *Context);
+
+EFI_STATUS
+EfiMultiHashUpdate(EFI_MULTI_HASH_CONTEXT *Context, CONST UINT8 *Message,
+		   UINTN MessageSize);
+
+EFI_STATUS
+EfiMultiHashFinalize(EFI_MULTI_HASH_CONTEXT *Context, UINT8 **Hashes,
+		     UINTN *HashSizes);
+
+EFI_STATUS
+EfiMultiHashData(EFI_GUID **HashAlgorithms, UINTN NumberOfHashAlgorithms,
+		 CONST UINT8 *Message, UINTN MessageSize, UINT8 **Hashes,
+		 UINTN *HashSizes);
+
+typedef struct {
+	CONST CHAR16 *Section;
+	CONST CHAR16 *Key;
+	CONST CHAR16 *Value;
+} EFI_CONFIG_ENTRY;
+
+typedef struct {
+	CHAR16 *Buffer;
+	EFI_CONFIG_ENTRY *Entries;
+	UINTN NumberOfEntries;
+} EFI_CONFIG;
+
+EFI_STATUS
+EfiProfileSetReportFile(CONST CHAR16 *Path);
+
+EFI_STATUS
+EfiProfileReport(VOID);
+
+UINT64
+EfiProfileTimestamp(VOID);
+
+UINT64
+EfiProfileElapsedMicroseconds(UINT64 Start);
+
+EFI_STATUS
+EfiConfigParse(CONST CHAR8 *Data, UINTN DataSize, EFI_CONFIG *Config);
+
+EFI_STATUS
+EfiConfigLoad(CONST CHAR16 *Path, EFI_CONFIG *Config);
+
+CONST CHAR16 *
+EfiConfigGet(EFI_CONFIG *Config, CONST CHAR16 *Section, CONST CHAR16 *Key);
+
+VOID
+EfiConfigFree(EFI_CONFIG *Config);
+
 #endif	/* EFI_LIBRARY_H */
@@ -50,6 +50,14 @@ VPrint(
 	VA_LIST args
 );
 
+UINTN
+VSPrint(
+	OUT CHAR16 *Str,
+	IN UINTN StrSize,
+	IN CONST CHAR16 *fmt,
+	VA_LIST args
+);
+
 VOID
 Input(
 	IN CHAR16 *Prompt OPTIONAL,
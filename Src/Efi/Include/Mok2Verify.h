@@ -42,6 +42,13 @@
 	{ 0xa1, 0x91, 0xd4, 0xd4, 0x10, 0xfb, 0x8c, 0xb4 }	\
 }
 
+/*
+ * Revision 2 appends VerifyBegin(), VerifyUpdate() and VerifyFinal() for
+ * the file read in pieces, and revision 3 appends VerifyBatch(). The
+ * members of the earlier revisions are unchanged.
+ */
+#define EFI_MOK2_VERIFY_PROTOCOL_REVISION	3
+
 typedef struct _EFI_MOK2_VERIFY_PROTOCOL	EFI_MOK2_VERIFY_PROTOCOL;
 
 typedef
@@ -70,11 +77,63 @@ EFI_STATUS
   IN CONST CHAR16             *Path
   );
 
+typedef
+EFI_STATUS
+(EFIAPI *EFI_MOK2_VERIFY_BEGIN) (
+  IN EFI_MOK2_VERIFY_PROTOCOL *This,
+  IN CONST CHAR16             *Path,
+  OUT VOID                    **Context
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_MOK2_VERIFY_UPDATE) (
+  IN EFI_MOK2_VERIFY_PROTOCOL *This,
+  IN VOID                     *Context,
+  IN CONST VOID               *Data,
+  IN UINTN                    DataSize
+  );
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_MOK2_VERIFY_FINAL) (
+  IN EFI_MOK2_VERIFY_PROTOCOL *This,
+  IN VOID                     *Context
+  );
+
+/*
+ * An item of VerifyBatch(). Data is the content of Path already read by
+ * the caller, or NULL to read it from Path. Status is EFI_NOT_READY until
+ * the item is verified, or EFI_ABORTED if the batch is aborted because the
+ * signature file of another item with Data fails to load.
+ */
+typedef struct {
+  CONST CHAR16                *Path;
+  VOID                        *Data;
+  UINTN                       DataSize;
+  EFI_STATUS                  Status;
+} EFI_MOK2_VERIFY_ITEM;
+
+typedef
+EFI_STATUS
+(EFIAPI *EFI_MOK2_VERIFY_BATCH) (
+  IN EFI_MOK2_VERIFY_PROTOCOL *This,
+  IN OUT EFI_MOK2_VERIFY_ITEM *Items,
+  IN UINTN                    NumberOfItems,
+  IN EFI_EVENT                Event OPTIONAL
+  );
+
 struct _EFI_MOK2_VERIFY_PROTOCOL {
         UINT8 Revision;
         EFI_MOK2_VERIFY_SIGNATURE VerifySignature;
         EFI_MOK2_VERIFY_FILE_BUFFER VerifyFileBuffer;
         EFI_MOK2_VERIFY_FILE VerifyFile;
+        /* Revision 2 */
+        EFI_MOK2_VERIFY_BEGIN VerifyBegin;
+        EFI_MOK2_VERIFY_UPDATE VerifyUpdate;
+        EFI_MOK2_VERIFY_FINAL VerifyFinal;
+        /* Revision 3 */
+        EFI_MOK2_VERIFY_BATCH VerifyBatch;
 };
 
 extern EFI_GUID gEfiMok2VerifyProtocolGuid;
@@ -106,6 +106,103 @@ typedef struct {
 #define SelSignatureTagFileName			11
 #define SelSignatureTagFileSize			12
 
+/*
+ * The boot profile report published in the volatile variable
+ * SELoaderProfile under SELOADER_VENDOR_GUID.
+ */
+#define SelProfileRevision			1
+
+typedef enum {
+	SelProfilePhaseLibraryInitialize,
+	SelProfilePhaseSecurityPolicy,
+	SelProfilePhaseVariableRead,
+	SelProfilePhaseFileLoad,
+	SelProfilePhaseHash,
+	SelProfilePhasePkcs7Verify,
+	SelProfilePhaseLoadImage,
+	SelProfilePhaseStartImage,
+	SelProfilePhaseMax
+} SEL_PROFILE_PHASE;
+
+typedef struct {
+	UINT64 Count;
+	UINT64 Microseconds;
+} SEL_PROFILE_PHASE_RECORD;
+
+#define SelProfilePathLength			64
+
+typedef struct {
+	CHAR16 Path[SelProfilePathLength];	/* Truncated if too long */
+	UINT64 Count;
+	UINT64 Microseconds;
+	UINT64 Size;
+} SEL_PROFILE_FILE_RECORD;
+
+typedef struct {
+	UINT32 Revision;
+	UINT32 HeaderSize;
+	UINT32 NumberOfPhases;
+	UINT32 NumberOfFiles;
+	UINT64 Frequency;		/* The timestamp frequency in Hz */
+	UINT64 Microseconds;		/* Elapsed since SELoader launched */
+	/*
+	 * Followed by SEL_PROFILE_PHASE_RECORD[NumberOfPhases] and
+	 * SEL_PROFILE_FILE_RECORD[NumberOfFiles].
+	 */
+} SEL_PROFILE_REPORT;
+
+/*
+ * The files verified by SELoader with the digests attested by their .p7b
+ * signatures, published in the configuration table SEL_VERIFIED_TABLE_GUID
+ * so the OS can use them instead of hashing the files again. A file
+ * verified more than once is listed once with the latest result.
+ */
+#define SelVerifiedTableRevision		1
+
+/* At least one file is missing because the table is full */
+#define SelVerifiedTableFlagsTruncated		(1 << 0)
+
+#define SelVerifiedPathLength			128
+
+/* The path doesn't fit in the record */
+#define SelVerifiedFileFlagsPathTruncated	(1 << 0)
+/* The signer certificate is not found in the signature */
+#define SelVerifiedFileFlagsSignerUnknown	(1 << 1)
+
+typedef struct {
+	CHAR16 Path[SelVerifiedPathLength];	/* The absolute path on ESP */
+	UINT64 Size;
+	EFI_GUID HashAlgorithm;
+	UINT32 HashSize;
+	UINT32 Flags;
+	UINT8 Hash[64];
+	UINT8 SignerHash[32];		/* SHA-256 of the signer certificate */
+	UINT64 Timestamp;		/* Microseconds since the launch */
+	UINT64 Microseconds;		/* Spent in verifying the file */
+} SEL_VERIFIED_FILE_RECORD;
+
+typedef struct {
+	UINT32 Revision;
+	UINT32 HeaderSize;
+	UINT32 RecordSize;
+	UINT32 NumberOfRecords;
+	UINT32 MaxRecords;
+	UINT32 Flags;
+	/* Followed by SEL_VERIFIED_FILE_RECORD[NumberOfRecords] */
+} SEL_VERIFIED_TABLE;
+
 #pragma pack()
 
+#define SELOADER_VENDOR_GUID	\
+	{ 0x8a4b6f2e, 0x3c71, 0x4d9a, \
+	  { 0x9e, 0x21, 0x5f, 0x6b, 0x0c, 0x8d, 0x47, 0xa3 } }
+
+extern EFI_GUID gSELoaderVendorGuid;
+
+#define SEL_VERIFIED_TABLE_GUID	\
+	{ 0xa1bac994, 0x4f18, 0x4a09, \
+	  { 0xab, 0x23, 0xff, 0x58, 0x02, 0x2e, 0x44, 0x68 } }
+
+extern EFI_GUID gSelVerifiedTableGuid;
+
 #endif	/* SELOADER_H */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#ifndef EFI_SEL_STATISTICS_H
+#define EFI_SEL_STATISTICS_H
+
+#include <Efi.h>
+#include <SELoader.h>
+
+#define EFI_SEL_STATISTICS_PROTOCOL_GUID	\
+{	\
+	0x7252936f, 0xedb3, 0x4f65,	\
+	{ 0xb4, 0xbc, 0x47, 0xac, 0xa8, 0xfc, 0xa8, 0x4b }	\
+}
+
+/* The configuration table holding a copy of SEL_STATISTICS */
+#define SEL_STATISTICS_TABLE_GUID	\
+{	\
+	0x91965ccc, 0xc87a, 0x4c00,	\
+	{ 0xaf, 0xa5, 0x27, 0x0e, 0x60, 0xff, 0x96, 0x42 }	\
+}
+
+#define SEL_STATISTICS_REVISION			1
+
+typedef enum {
+	SelProviderNone,
+	/* EFI Hash2 or PKCS#7 Verify Protocol provided by BIOS */
+	SelProviderFirmware,
+	/* EFI Hash Protocol provided by BIOS */
+	SelProviderFirmwareLegacy,
+	/* Hash2DxeCrypto or Pkcs7VerifyDxe driver loaded by SELoader */
+	SelProviderDriver,
+	/* The implementation built in SELoader */
+	SelProviderBuiltin,
+} SEL_PROVIDER;
+
+/*
+ * Bucket N counts the verifications taking [2^N, 2^(N+1)) microseconds.
+ * The first bucket also counts the ones less than 1 microsecond and the
+ * last bucket counts all the longer ones.
+ */
+#define SEL_STATISTICS_LATENCY_BUCKETS		20
+
+#pragma pack(1)
+
+typedef struct {
+	UINT32 Revision;
+	UINT32 Size;
+	UINT64 FilesVerified;
+	UINT64 FilesFailed;
+	UINT64 BytesHashed;
+	UINT64 CacheHits;
+	UINT32 HashProvider;		/* SEL_PROVIDER */
+	UINT32 Pkcs7Provider;		/* SEL_PROVIDER */
+	/* Indexed by SEL_PROFILE_PHASE, e.g, the hash and PKCS#7 calls */
+	SEL_PROFILE_PHASE_RECORD Phases[SelProfilePhaseMax];
+	UINT64 VerifyLatency[SEL_STATISTICS_LATENCY_BUCKETS];
+} SEL_STATISTICS;
+
+#pragma pack()
+
+typedef struct _EFI_SEL_STATISTICS_PROTOCOL	EFI_SEL_STATISTICS_PROTOCOL;
+
+/*
+ * Copy at most *StatisticsSize bytes of SEL_STATISTICS and return the full
+ * size in *StatisticsSize. The new members are only appended, so a caller
+ * built against an earlier revision gets the ones it knows. Return
+ * EFI_BUFFER_TOO_SMALL without copying if Statistics is NULL or
+ * *StatisticsSize is 0.
+ */
+typedef
+EFI_STATUS
+(EFIAPI *EFI_SEL_STATISTICS_GET) (
+  IN EFI_SEL_STATISTICS_PROTOCOL *This,
+  OUT SEL_STATISTICS             *Statistics,
+  IN OUT UINTN                   *StatisticsSize
+  );
+
+struct _EFI_SEL_STATISTICS_PROTOCOL {
+        UINT8 Revision;
+        EFI_SEL_STATISTICS_GET GetStatistics;
+};
+
+extern EFI_GUID gEfiSelStatisticsProtocolGuid;
+extern EFI_GUID gSelStatisticsTableGuid;
+
+#endif	/* EFI_SEL_STATISTICS_H */
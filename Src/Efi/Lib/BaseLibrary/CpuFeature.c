@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <BaseLibrary.h>
+
+#define CPU_FEATURE_DETECTED		(1 << 31)
+
+STATIC UINT32 Features;
+STATIC BOOLEAN VectorInUse;
+
+#ifdef __x86_64__
+STATIC VOID
+Cpuid(UINT32 Leaf, UINT32 Subleaf, UINT32 *Eax, UINT32 *Ebx, UINT32 *Ecx,
+      UINT32 *Edx)
+{
+	asm volatile("cpuid"
+		     : "=a"(*Eax), "=b"(*Ebx), "=c"(*Ecx), "=d"(*Edx)
+		     : "a"(Leaf), "c"(Subleaf));
+}
+
+STATIC UINT64
+Xgetbv(UINT32 Index)
+{
+	UINT32 Low, High;
+
+	asm volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(Index));
+
+	return ((UINT64)High << 32) | Low;
+}
+
+STATIC UINT32
+DetectFeatures(VOID)
+{
+	UINT32 Eax, Ebx, Ecx, Edx;
+	UINT32 Detected = 0;
+
+	Cpuid(0, 0, &Eax, &Ebx, &Ecx, &Edx);
+	if (Eax < 7)
+		return Detected;
+
+	UINT32 Leaf1Ecx;
+
+	Cpuid(1, 0, &Eax, &Ebx, &Leaf1Ecx, &Edx);
+	Cpuid(7, 0, &Eax, &Ebx, &Ecx, &Edx);
+
+	if (Ebx & (1 << 9))
+		Detected |= CPU_FEATURE_ERMS;
+
+	if (Edx & (1 << 4))
+		Detected |= CPU_FEATURE_FSRM;
+
+	/*
+	 * AVX2 is usable only if the firmware has enabled XSAVE and the
+	 * YMM state in XCR0. The SELoader never touches CR4 and XCR0 by
+	 * itself because the firmware doesn't expect the extended states
+	 * in its context switches.
+	 */
+	if ((Ebx & (1 << 5)) && (Leaf1Ecx & (1 << 27)) &&
+	    (Leaf1Ecx & (1 << 28)) && (Xgetbv(0) & 0x6) == 0x6)
+		Detected |= CPU_FEATURE_AVX2;
+
+	return Detected;
+}
+#elif defined(__aarch64__)
+STATIC UINT32
+DetectFeatures(VOID)
+{
+	UINT64 Isar0;
+	UINT32 Detected = 0;
+
+	/* The ID registers are accessible at EL1 and EL2 */
+	asm volatile("mrs %0, id_aa64isar0_el1" : "=r"(Isar0));
+
+	/* ID_AA64ISAR0_EL1.SHA2: 1 for SHA-256, 2 for SHA-256 and SHA-512 */
+	switch ((Isar0 >> 12) & 0xf) {
+	case 2:
+		Detected |= CPU_FEATURE_SHA512;
+		/* Fall through */
+	case 1:
+		Detected |= CPU_FEATURE_SHA256;
+		break;
+	default:
+		break;
+	}
+
+	return Detected;
+}
+#else
+/* Always take the scalar paths */
+STATIC UINT32
+DetectFeatures(VOID)
+{
+	return 0;
+}
+#endif
+
+UINT32
+CpuFeatures(VOID)
+{
+	if (!(Features & CPU_FEATURE_DETECTED))
+		Features = DetectFeatures() | CPU_FEATURE_DETECTED;
+
+	return Features;
+}
+
+/*
+ * The firmware saves only the legacy FPU/SSE states, if any, in its
+ * interrupt handlers. Acquire the vector unit to prevent the YMM
+ * registers from being clobbered by a nested user, e.g, an event
+ * notification function interrupting a copy. The nested user falls
+ * back to the scalar path.
+ */
+BOOLEAN
+CpuVectorAcquire(VOID)
+{
+	if (!(CpuFeatures() & CPU_FEATURE_AVX2))
+		return FALSE;
+
+	return __atomic_exchange_n(&VectorInUse, TRUE,
+				   __ATOMIC_ACQUIRE) == FALSE;
+}
+
+VOID
+CpuVectorRelease(VOID)
+{
+	__atomic_store_n(&VectorInUse, FALSE, __ATOMIC_RELEASE);
+}
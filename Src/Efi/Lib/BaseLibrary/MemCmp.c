@@ -32,6 +32,66 @@
  */
 
 #include <Efi.h>
+#include <BaseLibrary.h>
+
+#ifdef __x86_64__
+/*
+ * Return the offset of the first 32-byte block which differs, or Length
+ * if all the blocks are identical. Length is the multiple of 32.
+ */
+STATIC UINTN
+CompareBlocksAvx2(CONST UINT8 *First, CONST UINT8 *Second, UINTN Length)
+{
+	UINTN Offset = 0;
+
+	asm volatile(".align 16\n\t"
+		     "1:\n\t"
+		     "vmovdqu (%1,%0), %%ymm0\n\t"
+		     "vpcmpeqb (%2,%0), %%ymm0, %%ymm0\n\t"
+		     "vpmovmskb %%ymm0, %%eax\n\t"
+		     "cmp $0xffffffff, %%eax\n\t"
+		     "jne 2f\n\t"
+		     "add $32, %0\n\t"
+		     "cmp %3, %0\n\t"
+		     "jb 1b\n\t"
+		     "2:\n\t"
+		     "vzeroupper\n\t"
+		     : "+r"(Offset)
+		     : "r"(First), "r"(Second), "r"(Length)
+		     : "rax", "cc", "memory");
+
+	return Offset;
+}
+#elif defined(__aarch64__)
+/*
+ * Return the offset of the first 16-byte block which differs, or Length
+ * if all the blocks are identical. Length is the multiple of 16.
+ */
+STATIC UINTN
+CompareBlocksNeon(CONST UINT8 *First, CONST UINT8 *Second, UINTN Length)
+{
+	UINTN Offset = 0;
+	UINT32 Equal;
+
+	asm volatile(".arch_extension simd\n\t"
+		     "1:\n\t"
+		     "ldr q0, [%2, %0]\n\t"
+		     "ldr q1, [%3, %0]\n\t"
+		     "cmeq v0.16b, v0.16b, v1.16b\n\t"
+		     "uminv b0, v0.16b\n\t"
+		     "umov %w1, v0.b[0]\n\t"
+		     "cbz %w1, 2f\n\t"
+		     "add %0, %0, #16\n\t"
+		     "cmp %0, %4\n\t"
+		     "b.lo 1b\n\t"
+		     "2:\n\t"
+		     : "+r"(Offset), "=&r"(Equal)
+		     : "r"(First), "r"(Second), "r"(Length)
+		     : "cc", "memory");
+
+	return Offset;
+}
+#endif
 
 INTN
 MemCmp(CONST VOID *FirstSource, CONST VOID *SecondSource, UINTN MaxLength)
@@ -39,18 +99,45 @@ MemCmp(CONST VOID *FirstSource, CONST VOID *SecondSource, UINTN MaxLength)
 	if (FirstSource == SecondSource || !MaxLength)
 		return 0;
 
-	UINT8 FirstByte, SecondByte;
+	CONST UINT8 *First = FirstSource;
+	CONST UINT8 *Second = SecondSource;
 
-	while (MaxLength--) {
-		FirstByte = *(UINT8 *)FirstSource;
-		SecondByte = *(UINT8 *)SecondSource;
+#ifdef __x86_64__
+	if (MaxLength >= THRESHOLD_VECTOR_COMPARE &&
+	    CpuVectorAcquire() == TRUE) {
+		UINTN Offset = CompareBlocksAvx2(First, Second,
+						 MaxLength & ~(UINTN)31);
 
-		if (FirstByte != SecondByte)
-			break;
+		CpuVectorRelease();
+
+		First += Offset;
+		Second += Offset;
+		MaxLength -= Offset;
+	}
+#elif defined(__aarch64__)
+	if (MaxLength >= THRESHOLD_VECTOR_COMPARE) {
+		UINTN Offset = CompareBlocksNeon(First, Second,
+						 MaxLength & ~(UINTN)15);
+
+		First += Offset;
+		Second += Offset;
+		MaxLength -= Offset;
+	}
+#endif
+
+	/* Skip the identical words */
+	while (MaxLength >= sizeof(UINTN) &&
+	       *(CONST UNALIGNED_UINTN *)First ==
+	       *(CONST UNALIGNED_UINTN *)Second) {
+		First += sizeof(UINTN);
+		Second += sizeof(UINTN);
+		MaxLength -= sizeof(UINTN);
+	}
 
-		++FirstSource;
-		++SecondSource;
+	for (; MaxLength; --MaxLength, ++First, ++Second) {
+		if (*First != *Second)
+			return *First > *Second ? 1 : -1;
 	}
 
-	return FirstByte > SecondByte ? 1 : FirstByte < SecondByte ? -1 : 0;
+	return 0;
 }
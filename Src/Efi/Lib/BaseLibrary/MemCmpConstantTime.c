@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <BaseLibrary.h>
+
+/*
+ * Compare the buffers in the time depending on the length only, e.g, for
+ * comparing the digests. Return 0 if they are identical, or 1 otherwise.
+ */
+INTN
+MemCmpConstantTime(CONST VOID *FirstSource, CONST VOID *SecondSource,
+		   UINTN Length)
+{
+	CONST UINT8 *First = FirstSource;
+	CONST UINT8 *Second = SecondSource;
+	UINTN Difference = 0;
+
+	for (; Length >= sizeof(UINTN); Length -= sizeof(UINTN)) {
+		Difference |= *(CONST UNALIGNED_UINTN *)First ^
+			      *(CONST UNALIGNED_UINTN *)Second;
+		First += sizeof(UINTN);
+		Second += sizeof(UINTN);
+	}
+
+	while (Length--)
+		Difference |= *First++ ^ *Second++;
+
+	return Difference != 0;
+}
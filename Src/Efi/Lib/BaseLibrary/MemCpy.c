@@ -34,8 +34,102 @@
 #include <Efi.h>
 #include "BaseLibrary.h"
 
+#ifdef __aarch64__
 VOID *
 MemCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
+{
+	UINT8 *d = Destination;
+	CONST UINT8 *s = Source;
+	UINT64 Tmp;
+
+	if (Destination == Source || !MaxLength)
+		return Destination;
+
+	/*
+	 * Copy 64 bytes per iteration with NEON, and then the remaining
+	 * qwords and bytes. Each block is fully loaded before stored so the
+	 * forward overlapping copy is still correct.
+	 */
+	asm volatile(".arch_extension simd\n\t"
+		     "cmp %2, #64\n\t"
+		     "b.lo 2f\n\t"
+		     "1:\n\t"
+		     "ldp q0, q1, [%1], #32\n\t"
+		     "ldp q2, q3, [%1], #32\n\t"
+		     "sub %2, %2, #64\n\t"
+		     "stp q0, q1, [%0], #32\n\t"
+		     "stp q2, q3, [%0], #32\n\t"
+		     "cmp %2, #64\n\t"
+		     "b.hs 1b\n\t"
+		     "2:\n\t"
+		     "cmp %2, #8\n\t"
+		     "b.lo 3f\n\t"
+		     "ldr %3, [%1], #8\n\t"
+		     "sub %2, %2, #8\n\t"
+		     "str %3, [%0], #8\n\t"
+		     "b 2b\n\t"
+		     "3:\n\t"
+		     "cbz %2, 4f\n\t"
+		     "ldrb %w3, [%1], #1\n\t"
+		     "sub %2, %2, #1\n\t"
+		     "strb %w3, [%0], #1\n\t"
+		     "b 3b\n\t"
+		     "4:\n\t"
+		     : "+r"(d), "+r"(s), "+r"(MaxLength), "=&r"(Tmp)
+		     :: "cc", "memory");
+
+	return Destination;
+}
+#else
+#ifdef __x86_64__
+/*
+ * Copy with the aligned 128-byte AVX2 stores. Each block is fully loaded
+ * before stored so the forward overlapping copy is still correct.
+ * MaxLength is at least 128.
+ */
+STATIC VOID
+CopyAvx2(CHAR8 *Destination, CONST CHAR8 *Source, UINTN MaxLength)
+{
+	UINTN UnalignedLen = -(UINTN)Destination & 31;
+
+	MaxLength -= UnalignedLen;
+	asm volatile("cld\n\t"
+		     "rep movsb\n\t"
+		     : "+D"(Destination), "+S"(Source), "+c"(UnalignedLen)
+		     :: "memory");
+
+	asm volatile(".align 16\n\t"
+		     "1:\n\t"
+		     "vmovdqu (%1), %%ymm0\n\t"
+		     "vmovdqu 32(%1), %%ymm1\n\t"
+		     "vmovdqu 64(%1), %%ymm2\n\t"
+		     "vmovdqu 96(%1), %%ymm3\n\t"
+		     "vmovdqa %%ymm0, (%0)\n\t"
+		     "vmovdqa %%ymm1, 32(%0)\n\t"
+		     "vmovdqa %%ymm2, 64(%0)\n\t"
+		     "vmovdqa %%ymm3, 96(%0)\n\t"
+		     "add $128, %1\n\t"
+		     "add $128, %0\n\t"
+		     "sub $128, %2\n\t"
+		     "cmp $128, %2\n\t"
+		     "jae 1b\n\t"
+		     "vzeroupper\n\t"
+		     : "+r"(Destination), "+r"(Source), "+r"(MaxLength)
+		     :: "cc", "memory");
+
+	/* Handle the remaining bytes */
+	asm volatile("rep movsb\n\t"
+		     : "+D"(Destination), "+S"(Source), "+c"(MaxLength)
+		     :: "memory");
+}
+#endif
+
+/*
+ * No function call is allowed between assigning the register variables
+ * and using them in the inline assembly.
+ */
+STATIC VOID *
+CopyScalar(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
 {
 	UINTN UnalignedLen;
 #ifdef __x86_64__
@@ -46,9 +140,6 @@ MemCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
 	register CHAR8 *s asm("esi") = (CHAR8 *)Source;
 #endif
 
-	if (Destination == Source || !MaxLength)
-		return Destination;
-
 	asm volatile("cld");
 
 	/* To ensure there is at least one dword/qword before running the
@@ -95,3 +186,37 @@ MemCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
 
 	return Destination;
 }
+
+VOID *
+MemCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
+{
+	if (Destination == Source || !MaxLength)
+		return Destination;
+
+#ifdef __x86_64__
+	if (MaxLength >= THRESHOLD_VECTOR_COPY &&
+	    CpuVectorAcquire() == TRUE) {
+		CopyAvx2(Destination, Source, MaxLength);
+		CpuVectorRelease();
+		return Destination;
+	}
+
+	/*
+	 * The microcoded byte copy is the fastest if ERMS is available,
+	 * and even for the short copy if FSRM is available.
+	 */
+	if (CpuFeatures() & (CPU_FEATURE_ERMS | CPU_FEATURE_FSRM)) {
+		CHAR8 *d = Destination;
+		CONST CHAR8 *s = Source;
+
+		asm volatile("cld\n\t"
+			     "rep movsb\n\t"
+			     : "+c"(MaxLength), "+S"(s), "+D"(d)
+			     :: "memory");
+		return Destination;
+	}
+#endif
+
+	return CopyScalar(Destination, Source, MaxLength);
+}
+#endif
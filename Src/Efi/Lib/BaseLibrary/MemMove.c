@@ -34,6 +34,35 @@
 #include <Efi.h>
 #include <BaseLibrary.h>
 
+#ifdef __aarch64__
+STATIC VOID *
+MemrCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
+{
+	UINT8 *d = (UINT8 *)Destination + MaxLength;
+	CONST UINT8 *s = (CONST UINT8 *)Source + MaxLength;
+	UINT64 Tmp;
+
+	/* Copy qwords and then bytes backwards */
+	asm volatile("1:\n\t"
+		     "cmp %2, #8\n\t"
+		     "b.lo 2f\n\t"
+		     "ldr %3, [%1, #-8]!\n\t"
+		     "sub %2, %2, #8\n\t"
+		     "str %3, [%0, #-8]!\n\t"
+		     "b 1b\n\t"
+		     "2:\n\t"
+		     "cbz %2, 3f\n\t"
+		     "ldrb %w3, [%1, #-1]!\n\t"
+		     "sub %2, %2, #1\n\t"
+		     "strb %w3, [%0, #-1]!\n\t"
+		     "b 2b\n\t"
+		     "3:\n\t"
+		     : "+r"(d), "+r"(s), "+r"(MaxLength), "=&r"(Tmp)
+		     :: "cc", "memory");
+
+	return Destination;
+}
+#else
 STATIC VOID *
 MemrCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
 {
@@ -94,6 +123,7 @@ MemrCpy(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
 
 	return Destination;
 }
+#endif
 
 VOID *
 MemMove(VOID *Destination, CONST VOID *Source, UINTN MaxLength)
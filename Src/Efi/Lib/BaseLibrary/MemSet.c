@@ -34,8 +34,53 @@
 #include <Efi.h>
 #include <BaseLibrary.h>
 
+#ifdef __aarch64__
 VOID *
 MemSet(VOID *Destination, UINT8 Value, UINTN Length)
+{
+	UINT8 *d = Destination;
+	UINT64 Pattern;
+
+	if (!Length)
+		return Destination;
+
+	/* Set 64 bytes per iteration with NEON, and then qwords and bytes */
+	asm volatile(".arch_extension simd\n\t"
+		     "dup v0.16b, %w3\n\t"
+		     "umov %2, v0.d[0]\n\t"
+		     "cmp %1, #64\n\t"
+		     "b.lo 2f\n\t"
+		     "1:\n\t"
+		     "stp q0, q0, [%0], #32\n\t"
+		     "stp q0, q0, [%0], #32\n\t"
+		     "sub %1, %1, #64\n\t"
+		     "cmp %1, #64\n\t"
+		     "b.hs 1b\n\t"
+		     "2:\n\t"
+		     "cmp %1, #8\n\t"
+		     "b.lo 3f\n\t"
+		     "str %2, [%0], #8\n\t"
+		     "sub %1, %1, #8\n\t"
+		     "b 2b\n\t"
+		     "3:\n\t"
+		     "cbz %1, 4f\n\t"
+		     "strb %w3, [%0], #1\n\t"
+		     "sub %1, %1, #1\n\t"
+		     "b 3b\n\t"
+		     "4:\n\t"
+		     : "+r"(d), "+r"(Length), "=&r"(Pattern)
+		     : "r"((UINT32)Value)
+		     : "cc", "memory");
+
+	return Destination;
+}
+#else
+/*
+ * No function call is allowed between assigning the register variables
+ * and using them in the inline assembly.
+ */
+STATIC VOID *
+SetScalar(VOID *Destination, UINT8 Value, UINTN Length)
 {
 	UINTN UnalignedLen;
 #ifdef __x86_64__
@@ -46,9 +91,6 @@ MemSet(VOID *Destination, UINT8 Value, UINTN Length)
 	register UINTN a asm("eax");
 #endif
 
-	if (!Length)
-		return Destination;
-
 	asm volatile ("cld");
 
 	/* To ensure there is at least one dword/qword before running the
@@ -98,3 +140,27 @@ MemSet(VOID *Destination, UINT8 Value, UINTN Length)
 
 	return Destination;
 }
+
+VOID *
+MemSet(VOID *Destination, UINT8 Value, UINTN Length)
+{
+	if (!Length)
+		return Destination;
+
+#ifdef __x86_64__
+	/* The microcoded byte set is the fastest if ERMS is available */
+	if (CpuFeatures() & CPU_FEATURE_ERMS) {
+		VOID *d = Destination;
+
+		asm volatile("cld\n\t"
+			     "rep stosb\n\t"
+			     : "+c"(Length), "+D"(d)
+			     : "a"(Value)
+			     : "memory");
+		return Destination;
+	}
+#endif
+
+	return SetScalar(Destination, Value, Length);
+}
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+STATIC BOOLEAN
+IsBlank(CHAR16 Char)
+{
+	return Char == L' ' || Char == L'\t' || Char == L'\r';
+}
+
+STATIC CHAR16 *
+Strip(CHAR16 *String)
+{
+	while (IsBlank(*String) == TRUE)
+		++String;
+
+	UINTN Length = StrLen(String);
+
+	while (Length && IsBlank(String[Length - 1]) == TRUE)
+		String[--Length] = L'\0';
+
+	return String;
+}
+
+STATIC EFI_STATUS
+ParseLine(CHAR16 *Line, UINTN LineNumber, CONST CHAR16 **Section,
+	  EFI_CONFIG_ENTRY *Entry)
+{
+	Line = Strip(Line);
+
+	/* Skip the blank line and comment */
+	if (!*Line || *Line == L'#' || *Line == L';')
+		return EFI_NOT_FOUND;
+
+	UINTN Length = StrLen(Line);
+
+	if (*Line == L'[') {
+		if (Line[Length - 1] != L']') {
+			EfiConsolePrintWarning(L"Unterminated section name at "
+					       L"line %d\n", LineNumber);
+			return EFI_INVALID_PARAMETER;
+		}
+
+		Line[Length - 1] = L'\0';
+		*Section = Strip(Line + 1);
+
+		return EFI_NOT_FOUND;
+	}
+
+	CHAR16 *Value = StrChr(Line, L'=');
+
+	if (!Value || Value == Line) {
+		EfiConsolePrintWarning(L"Invalid key-value pair at line %d\n",
+				       LineNumber);
+		return EFI_INVALID_PARAMETER;
+	}
+
+	*Value++ = L'\0';
+
+	if (!*Section) {
+		EfiConsolePrintWarning(L"No section specified for the key "
+				       L"%s at line %d\n", Line, LineNumber);
+		return EFI_INVALID_PARAMETER;
+	}
+
+	Entry->Section = *Section;
+	Entry->Key = Strip(Line);
+	Entry->Value = Strip(Value);
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiConfigParse(CONST CHAR8 *Data, UINTN DataSize, EFI_CONFIG *Config)
+{
+	if (!Data || !Config)
+		return EFI_INVALID_PARAMETER;
+
+	Config->Buffer = NULL;
+	Config->Entries = NULL;
+	Config->NumberOfEntries = 0;
+
+	UINTN NumberOfLines = 1;
+
+	for (UINTN Index = 0; Index < DataSize; ++Index) {
+		if (Data[Index] == '\n')
+			++NumberOfLines;
+	}
+
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate((DataSize + 1) * sizeof(CHAR16),
+				   (VOID **)&Config->Buffer);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = EfiMemoryAllocate(NumberOfLines * sizeof(EFI_CONFIG_ENTRY),
+				   (VOID **)&Config->Entries);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(Config->Buffer);
+		Config->Buffer = NULL;
+		return Status;
+	}
+
+	/* Only ASCII is supported */
+	for (UINTN Index = 0; Index < DataSize; ++Index)
+		Config->Buffer[Index] = (CHAR16)(UINT8)Data[Index];
+	Config->Buffer[DataSize] = L'\0';
+
+	CONST CHAR16 *Section = L"";
+	CHAR16 *Line = Config->Buffer;
+
+	for (UINTN LineNumber = 1; Line; ++LineNumber) {
+		CHAR16 *NextLine = StrChr(Line, L'\n');
+
+		if (NextLine)
+			*NextLine++ = L'\0';
+
+		EFI_CONFIG_ENTRY *Entry;
+
+		Entry = Config->Entries + Config->NumberOfEntries;
+		Status = ParseLine(Line, LineNumber, &Section, Entry);
+		if (!EFI_ERROR(Status))
+			++Config->NumberOfEntries;
+
+		Line = NextLine;
+	}
+
+	EfiConsolePrintDebug(L"%d configuration entries parsed\n",
+			     Config->NumberOfEntries);
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiConfigLoad(CONST CHAR16 *Path, EFI_CONFIG *Config)
+{
+	if (!Path || !Config)
+		return EFI_INVALID_PARAMETER;
+
+	VOID *Data = NULL;
+	UINTN DataSize = 0;
+	EFI_STATUS Status;
+
+	/* The configuration file is verified if Secure Boot is enabled */
+	Status = EfiFileLoad(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = EfiConfigParse(Data, DataSize, Config);
+	EfiMemoryFree(Data);
+
+	return Status;
+}
+
+CONST CHAR16 *
+EfiConfigGet(EFI_CONFIG *Config, CONST CHAR16 *Section, CONST CHAR16 *Key)
+{
+	if (!Config || !Section || !Key)
+		return NULL;
+
+	CONST CHAR16 *Value = NULL;
+
+	/* The last definition wins */
+	for (UINTN Index = 0; Index < Config->NumberOfEntries; ++Index) {
+		EFI_CONFIG_ENTRY *Entry = Config->Entries + Index;
+
+		if (!StrCmp(Entry->Section, Section) &&
+		    !StrCmp(Entry->Key, Key))
+			Value = Entry->Value;
+	}
+
+	return Value;
+}
+
+VOID
+EfiConfigFree(EFI_CONFIG *Config)
+{
+	if (!Config)
+		return;
+
+	if (Config->Entries)
+		EfiMemoryFree(Config->Entries);
+
+	if (Config->Buffer)
+		EfiMemoryFree(Config->Buffer);
+
+	Config->Entries = NULL;
+	Config->Buffer = NULL;
+	Config->NumberOfEntries = 0;
+}
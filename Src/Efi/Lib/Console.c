@@ -33,6 +33,8 @@
 
 #include <Efi.h>
 #include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
 
 #ifndef DEBUG_BUILD
 #  define CURRENT_CPL		CPL_INFO
@@ -42,15 +44,200 @@
 
 STATIC EfiConsolePrintLevel CurrentConsolePrintLevel = CURRENT_CPL;
 
+#define SELOADER_LOG_VARIABLE		L"SELoaderLog"
+
+/* The maximum size of the log saved in variable */
+#define MAX_LOG_VARIABLE_SIZE		(32 * 1024)
+
+#define LOG_RECORD_SIZE			512
+#define LOG_RECORDS			256
+
+/*
+ * The message is formatted when it is logged, so the record doesn't refer
+ * to the arguments which may be gone when it is printed.
+ */
+typedef struct {
+	EfiConsolePrintLevel Level;
+	UINTN Length;
+	CHAR16 Text[0];
+} LOG_RECORD;
+
+#define MAX_LOG_TEXT_SIZE		(LOG_RECORD_SIZE - sizeof(LOG_RECORD))
+
+STATIC UINT8 *LogRing;
+STATIC UINTN LogRingHead;
+STATIC UINTN LogRingRecords;
+STATIC UINTN LogRecordsLost;
+
+STATIC LOG_RECORD *
+LogRecord(UINTN Index)
+{
+	Index = (LogRingHead + Index) % LOG_RECORDS;
+
+	return (LOG_RECORD *)(LogRing + Index * LOG_RECORD_SIZE);
+}
+
+STATIC VOID
+LogRecordAdd(EfiConsolePrintLevel Level, CONST CHAR16 *Format,
+	     VA_LIST Marker)
+{
+	UINTN Index = LogRingRecords;
+
+	/* Overwrite the oldest record if the ring is full */
+	if (LogRingRecords == LOG_RECORDS) {
+		LogRingHead = (LogRingHead + 1) % LOG_RECORDS;
+		++LogRecordsLost;
+		--Index;
+	} else
+		++LogRingRecords;
+
+	LOG_RECORD *Record = LogRecord(Index);
+
+	Record->Level = Level;
+	Record->Length = VSPrint(Record->Text, MAX_LOG_TEXT_SIZE,
+				Format, Marker);
+
+	/* Keep the line break of the truncated message */
+	if (Record->Length == MAX_LOG_TEXT_SIZE / sizeof(CHAR16) - 1)
+		Record->Text[Record->Length - 1] = L'\n';
+}
+
+STATIC UINTN
+PrintLog(CONST CHAR16 *Format, ...)
+{
+	VA_LIST Marker;
+
+	VA_START(Marker, Format);
+	UINTN OutputLength = VPrint(Format, Marker);
+	VA_END(Marker);
+
+	return OutputLength;
+}
+
+STATIC VOID
+LogRingReset(VOID)
+{
+	LogRingHead = 0;
+	LogRingRecords = 0;
+	LogRecordsLost = 0;
+}
+
 STATIC UINTN
 ConsolePrint(EfiConsolePrintLevel Level, CHAR16 *Format, VA_LIST Marker)
 {
 	if (Level < CurrentConsolePrintLevel)
 		return 0;
 
+	if (LogRing) {
+		/* The error is printed along with the messages before it */
+		if (Level < CPL_ERROR) {
+			LogRecordAdd(Level, Format, Marker);
+			return 0;
+		}
+
+		EfiConsoleFlush();
+	}
+
 	return VPrint(Format, Marker);
 }
 
+EFI_STATUS
+EfiConsoleSetDeferred(BOOLEAN Deferred)
+{
+	if (Deferred == FALSE) {
+		if (LogRing) {
+			EfiConsoleFlush();
+			EfiMemoryFree(LogRing);
+			LogRing = NULL;
+		}
+
+		return EFI_SUCCESS;
+	}
+
+	if (LogRing)
+		return EFI_SUCCESS;
+
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(LOG_RECORD_SIZE * LOG_RECORDS,
+				   (VOID **)&LogRing);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	LogRingReset();
+
+	return EFI_SUCCESS;
+}
+
+VOID
+EfiConsoleFlush(VOID)
+{
+	if (!LogRing)
+		return;
+
+	if (LogRecordsLost)
+		PrintLog(L"(%d messages lost)\n", LogRecordsLost);
+
+	for (UINTN Index = 0; Index < LogRingRecords; ++Index)
+		PrintLog(L"%s", LogRecord(Index)->Text);
+
+	LogRingReset();
+}
+
+/*
+ * Save the deferred messages to the volatile variable instead of the slow
+ * console. Only the latest messages are kept if the log is too long.
+ */
+EFI_STATUS
+EfiConsoleSaveLog(VOID)
+{
+	if (!LogRing)
+		return EFI_NOT_READY;
+
+	if (!LogRingRecords)
+		return EFI_SUCCESS;
+
+	UINTN LogSize = 0;
+	UINTN Index;
+
+	/* Skip the oldest records which don't fit in the variable */
+	for (Index = 0; Index < LogRingRecords; ++Index) {
+		LOG_RECORD *Record = LogRecord(LogRingRecords - 1 - Index);
+
+		if (LogSize + Record->Length > MAX_LOG_VARIABLE_SIZE)
+			break;
+
+		LogSize += Record->Length;
+	}
+
+	CHAR8 *Log;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(LogSize, (VOID **)&Log);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	CHAR8 *Line = Log;
+
+	for (UINTN Count = Index; Count; --Count) {
+		LOG_RECORD *Record = LogRecord(LogRingRecords - Count);
+
+		for (UINTN Char = 0; Char < Record->Length; ++Char)
+			*Line++ = (CHAR8)Record->Text[Char];
+	}
+
+	/* The log is only for the boot services, e.g, EFI Shell dmpstore */
+	Status = EfiVariableWrite(SELOADER_LOG_VARIABLE, &gSELoaderVendorGuid,
+				  EFI_VARIABLE_BOOTSERVICE_ACCESS, Log,
+				  LogSize);
+	EfiMemoryFree(Log);
+
+	if (!EFI_ERROR(Status))
+		LogRingReset();
+
+	return Status;
+}
+
 UINTN
 EfiConsolePrint(EfiConsolePrintLevel Level, CHAR16 *Format, ...)
 {
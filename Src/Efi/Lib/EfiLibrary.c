@@ -46,6 +46,9 @@ CHAR16 *gRootPath;
 
 extern CONST CHAR16 *GitCommit;
 
+/* The number of bytes printed per line in hex dump */
+#define HEX_DUMP_LINE_SIZE		32
+
 EFI_STATUS
 EfiLibraryInitialize(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
 {
@@ -60,6 +63,9 @@ EfiLibraryInitialize(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
 	gRT = SystemTable->RuntimeServices;
 	gThisImage = ImageHandle;
 
+	ProfileInitialize();
+
+	UINT64 ProfileTimestamp = ProfileStart();
 	EFI_STATUS Status;
 
 	Status = EfiDeviceLocate(&gThisDevice);
@@ -88,6 +94,9 @@ EfiLibraryInitialize(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
 			EfiSecurityPolicyPrint();
 	}
 
+	ProfileStop(SelProfilePhaseLibraryInitialize, ProfileTimestamp);
+	ProfileMark(L"init", NULL);
+
 	return Status;
 }
 
@@ -97,11 +106,32 @@ EfiLibraryHexDump(CONST CHAR16 *Prompt, UINT8 *Data, UINTN DataSize)
 	if (DataSize && !Data)
 		return;
 
+	EfiConsolePrintLevel Level;
+	EFI_STATUS Status;
+
+	/* Don't bother to format the data which is not printed */
+	Status = EfiConsoleGetVerbosity(&Level);
+	if (EFI_ERROR(Status) || Level != CPL_DEBUG)
+		return;
+
 	if (Prompt)
 		EfiConsolePrintDebug(L"%s (%d-byte): ", Prompt, DataSize);
 
-	for (UINTN Index = 0; Index < DataSize; ++Index)
-		EfiConsolePrintDebug(L"%02x", Data[Index]);
+	/* Print a line of hex string at a time rather than a byte */
+	CHAR16 Line[HEX_DUMP_LINE_SIZE * 2 + 1];
+	STATIC CONST CHAR16 Hex[] = L"0123456789abcdef";
+
+	for (UINTN Index = 0; Index < DataSize;) {
+		UINTN Length = 0;
+
+		do {
+			Line[Length++] = Hex[Data[Index] >> 4];
+			Line[Length++] = Hex[Data[Index] & 0xf];
+		} while (++Index < DataSize && Length < HEX_DUMP_LINE_SIZE * 2);
+
+		Line[Length] = L'\0';
+		EfiConsolePrintDebug(L"%s", Line);
+	}
 
 	EfiConsolePrintDebug(L"\n");
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+#include "Internal.h"
+
+#ifndef EMBEDDED_DRIVER_DIR
+#  error "EMBEDDED_DRIVER_DIR is not defined"
+#endif
+
+/*
+ * The pre-built drivers are placed into a dedicated input section which
+ * is merged into the .data section of SELoader.efi. Therefore, they are
+ * covered by the signature of SELoader itself.
+ */
+#define EMBED_DRIVER(Name)	\
+	asm(".section .data.embedded_driver, \"aw\"\n\t"	\
+	    ".balign 8\n\t"	\
+	    ".global Embedded" #Name "\n\t"	\
+	    ".hidden Embedded" #Name "\n"	\
+	    "Embedded" #Name ":\n\t"	\
+	    ".incbin \"" EMBEDDED_DRIVER_DIR "/" #Name ".efi\"\n\t"	\
+	    ".global Embedded" #Name "End\n\t"	\
+	    ".hidden Embedded" #Name "End\n"	\
+	    "Embedded" #Name "End:\n\t"	\
+	    ".previous\n");	\
+	extern CONST UINT8 Embedded##Name[]	\
+		__attribute__((visibility("hidden")));	\
+	extern CONST UINT8 Embedded##Name##End[]	\
+		__attribute__((visibility("hidden")))
+
+EMBED_DRIVER(Pkcs7VerifyDxe);
+EMBED_DRIVER(Hash2DxeCrypto);
+
+typedef struct {
+	CONST CHAR16 *Name;
+	CONST UINT8 *Image;
+	CONST UINT8 *ImageEnd;
+} EMBEDDED_DRIVER;
+
+STATIC EMBEDDED_DRIVER EmbeddedDrivers[] = {
+	{
+		L"Pkcs7VerifyDxe.efi",
+		EmbeddedPkcs7VerifyDxe,
+		EmbeddedPkcs7VerifyDxeEnd
+	},
+	{
+		L"Hash2DxeCrypto.efi",
+		EmbeddedHash2DxeCrypto,
+		EmbeddedHash2DxeCryptoEnd
+	},
+};
+
+EFI_STATUS
+EmbeddedDriverLocate(CONST CHAR16 *Name, VOID **ImageBuffer,
+		     UINTN *ImageBufferSize)
+{
+	if (!Name || !ImageBuffer || !ImageBufferSize)
+		return EFI_INVALID_PARAMETER;
+
+	for (UINTN Index = 0; Index < sizeof(EmbeddedDrivers) /
+				      sizeof(EmbeddedDrivers[0]); ++Index) {
+		EMBEDDED_DRIVER *Driver = EmbeddedDrivers + Index;
+
+		if (StrCmp(Name, Driver->Name))
+			continue;
+
+		if (Driver->ImageEnd == Driver->Image)
+			break;
+
+		*ImageBuffer = (VOID *)Driver->Image;
+		*ImageBufferSize = Driver->ImageEnd - Driver->Image;
+
+		EfiConsolePrintDebug(L"Found the embedded driver %s "
+				     L"(%d-byte)\n", Name, *ImageBufferSize);
+
+		return EFI_SUCCESS;
+	}
+
+	return EFI_NOT_FOUND;
+}
@@ -35,11 +35,76 @@
 #include <EfiLibrary.h>
 #include <BaseLibrary.h>
 
+#include "Internal.h"
+
 #if GNU_EFI_VERSION <= 303
 EFI_GUID gEfiSimpleFileSystemProtocolGuid =
 	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID;
 #endif
 
+/*
+ * The file buffer larger than this size is allocated with the pages
+ * aligned with 4KB, or 2MB if it is larger than 2MB, e.g, the kernel
+ * and initrd, so it can be handed over or executed in place.
+ */
+#define PAGE_ALLOCATION_THRESHOLD	(64 * 1024)
+
+/* The address to place the file content, specified by EfiFileLoadAt() */
+STATIC EFI_PHYSICAL_ADDRESS FileLoadAddress;
+
+/*
+ * The number of the signature files known to be absent. Remembering them
+ * avoids looking up the same missing .p7a/.p7b again within this boot.
+ */
+#define MAX_MISSING_SIGNATURE_FILES	32
+
+STATIC CHAR16 *MissingSignatureFiles[MAX_MISSING_SIGNATURE_FILES];
+STATIC UINTN MissingSignatureFileIndex;
+
+STATIC BOOLEAN
+SignatureFileMissing(CONST CHAR16 *Path)
+{
+	for (UINTN Index = 0; Index < MAX_MISSING_SIGNATURE_FILES; ++Index) {
+		if (MissingSignatureFiles[Index] &&
+		    !StrCmp(MissingSignatureFiles[Index], Path))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+STATIC VOID
+SignatureFileMissingAdd(CONST CHAR16 *Path)
+{
+	/* The cache outlives the arena scope of loading file */
+	EfiMemoryArenaSuspend();
+	CHAR16 *MissingPath = StrDup(Path);
+	EfiMemoryArenaResume();
+
+	if (!MissingPath)
+		return;
+
+	UINTN Index = MissingSignatureFileIndex++ %
+		      MAX_MISSING_SIGNATURE_FILES;
+
+	if (MissingSignatureFiles[Index])
+		EfiMemoryFree(MissingSignatureFiles[Index]);
+
+	MissingSignatureFiles[Index] = MissingPath;
+}
+
+STATIC VOID
+SignatureFileMissingRemove(CONST CHAR16 *Path)
+{
+	for (UINTN Index = 0; Index < MAX_MISSING_SIGNATURE_FILES; ++Index) {
+		if (MissingSignatureFiles[Index] &&
+		    !StrCmp(MissingSignatureFiles[Index], Path)) {
+			EfiMemoryFree(MissingSignatureFiles[Index]);
+			MissingSignatureFiles[Index] = NULL;
+		}
+	}
+}
+
 STATIC EFI_STATUS
 OpenRootDirectory(EFI_FILE_HANDLE *RootDirectoryHandle)
 {
@@ -102,7 +167,18 @@ OpenFile(CONST CHAR16 *Path, UINT64 OpenMode, EFI_FILE_HANDLE *FileHandle,
 }
 
 STATIC EFI_STATUS
-LoadFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, VOID **Data,
+AllocateFileBuffer(UINTN Size, EFI_PHYSICAL_ADDRESS Address, VOID **Buffer)
+{
+	if (!Address && Size <= PAGE_ALLOCATION_THRESHOLD)
+		return EfiMemoryAllocate(Size, Buffer);
+
+	return EfiMemoryAllocatePages(Size, Size > SIZE_2MB ? SIZE_2MB :
+							      SIZE_4KB,
+				      Address, Buffer);
+}
+
+STATIC EFI_STATUS
+ReadFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, VOID **Data,
 	 UINTN *DataSize)
 {
 	CHAR16 *FilePath;
@@ -118,9 +194,20 @@ LoadFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, VOID **Data,
 	EFI_FILE_HANDLE FileHandle;
 	EFI_STATUS Status;
 
+	if (Suffix && SignatureFileMissing(FilePath) == TRUE) {
+		EfiConsolePrintDebug(L"Hit the cached missing file %s\n",
+				     FilePath);
+		StatisticsCacheHit();
+		Status = EFI_NOT_FOUND;
+		goto ErrOnOpenFile;
+	}
+
 	Status = OpenFile(FilePath, EFI_FILE_MODE_READ, &FileHandle, NULL);
-	if (EFI_ERROR(Status))
+	if (EFI_ERROR(Status)) {
+		if (Suffix && Status == EFI_NOT_FOUND)
+			SignatureFileMissingAdd(FilePath);
 		goto ErrOnOpenFile;
+	}
 
 	/* Open testing */
 	if (!Data && !DataSize)
@@ -154,9 +241,28 @@ LoadFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, VOID **Data,
 			if (*DataSize && *DataSize < FileSize)
 				FileSize = *DataSize;
 
-			Status = EfiMemoryAllocate(FileSize, &FileBuffer);
-			if (EFI_ERROR(Status))
+			EFI_PHYSICAL_ADDRESS Address = 0;
+
+			/*
+			 * The placement is consumed by the content only
+			 * once, rather than the signature file or the
+			 * driver loaded during the verification.
+			 */
+			if (!Suffix) {
+				Address = FileLoadAddress;
+				FileLoadAddress = 0;
+			}
+
+			Status = AllocateFileBuffer(FileSize, Address,
+						    &FileBuffer);
+			if (EFI_ERROR(Status)) {
+				EfiConsolePrintError(L"Failed to allocate "
+						     L"%d-byte for file %s "
+						     L"(err: 0x%x)\n",
+						     FileSize, FilePath,
+						     Status);
 				goto ErrOnAllocFileBuffer;
+			}
 		} else
 			FileBuffer = *Data;
 
@@ -189,6 +295,21 @@ ErrOnOpenFile:
 	return Status;
 }
 
+STATIC EFI_STATUS
+LoadFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, VOID **Data,
+	 UINTN *DataSize)
+{
+	UINT64 ProfileTimestamp = ProfileStart();
+	EFI_STATUS Status;
+
+	Status = ReadFile(Path, Suffix, Data, DataSize);
+
+	ProfileStopFile(Path, Suffix, !EFI_ERROR(Status) && DataSize ?
+			*DataSize : 0, ProfileTimestamp);
+
+	return Status;
+}
+
 STATIC BOOLEAN
 LoadSignatureRequired(CONST CHAR16 *Path)
 {
@@ -210,12 +331,115 @@ LoadSignatureRequired(CONST CHAR16 *Path)
 	return TRUE;
 }
 
+/*
+ * Read the file without the signature verification. The caller is
+ * responsible for verifying the content, e.g, a signed PE image.
+ */
 EFI_STATUS
-EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+EfiFileRead(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
 {
-	if (!Path)
+	if (!Path || !Data || !DataSize)
 		return EFI_INVALID_PARAMETER;
 
+	*Data = NULL;
+	*DataSize = 0;
+
+	return LoadFile(Path, NULL, Data, DataSize);
+}
+
+/*
+ * Verify .p7b for the digest of the signed content. The digest is taken
+ * from the verification cache instead if the same signature of the file
+ * was verified under the same security policy before. The signer is
+ * identified for the verified table.
+ */
+STATIC EFI_STATUS
+VerifySignatureHash(CONST CHAR16 *Path, VOID *Signature,
+		    UINTN SignatureSize, VERIFY_CACHE_TAG *Tag,
+		    VERIFIED_SIGNER *Signer, EFI_GUID **HashAlgorithm,
+		    UINT8 **Hash, UINTN *HashSize)
+{
+	EFI_STATUS Status;
+
+	Status = VerifyCacheLookup(Path, Signature, SignatureSize, Tag,
+				   HashAlgorithm, Hash, HashSize);
+	if (EFI_ERROR(Status))
+		Status = EfiSignatureVerifyAttachedHash(Signature,
+							SignatureSize,
+							HashAlgorithm, Hash,
+							HashSize);
+	if (!EFI_ERROR(Status))
+		VerifiedTableSigner(Signature, SignatureSize, Signer);
+
+	return Status;
+}
+
+/*
+ * Verify the full content with .p7b, record the digest in the
+ * verification cache and the verified table, and measure the content if
+ * Measure is TRUE.
+ */
+STATIC EFI_STATUS
+VerifyAttachedHashed(CONST CHAR16 *Path, VOID *Signature,
+		     UINTN SignatureSize, VOID **Data, UINTN *DataSize,
+		     BOOLEAN Measure, UINT64 ProfileTimestamp)
+{
+	VERIFY_CACHE_TAG Tag;
+	VERIFIED_SIGNER Signer;
+	EFI_GUID *HashAlgorithm;
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_STATUS Status;
+
+	Status = VerifySignatureHash(Path, Signature, SignatureSize, &Tag,
+				     &Signer, &HashAlgorithm, &Hash,
+				     &HashSize);
+	if (Status == EFI_UNSUPPORTED) {
+		/* Content-attached .p7b carries no hash to reuse */
+		Status = EfiSignatureVerifyAttached(Signature, SignatureSize,
+						    Data, DataSize);
+		if (!EFI_ERROR(Status) && Measure == TRUE)
+			MeasureFile(Path, *Data, *DataSize);
+
+		return Status;
+	}
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINT8 *DataHash;
+	UINTN DataHashSize;
+
+	Status = EfiHashData(HashAlgorithm, *Data, *DataSize, &DataHash,
+			     &DataHashSize);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	if (DataHashSize != HashSize ||
+	    MemCmpConstantTime(DataHash, Hash, HashSize)) {
+		EfiConsolePrintError(L"Invalid content for hash "
+				     L"comparison\n");
+		Status = EFI_SECURITY_VIOLATION;
+	} else {
+		VerifyCacheAdd(&Tag, HashAlgorithm, Hash, HashSize);
+		VerifiedTableAdd(Path, *DataSize, HashAlgorithm, Hash,
+				 HashSize, &Signer, ProfileTimestamp);
+
+		if (Measure == TRUE)
+			MeasureFile(Path, *Data, *DataSize);
+	}
+
+	EfiMemoryFree(DataHash);
+
+out:
+	EfiMemoryFree(Hash);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+LoadVerifiedFile(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	UINT64 ProfileTimestamp = ProfileStart();
 	EFI_STATUS Status, RealStatus;
 
 	Status = EfiLibraryVectorizedBufferEnter(Data, DataSize);
@@ -272,6 +496,10 @@ EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
 						    &ExtractedDataSize);
 		EfiMemoryFree(Signature);
 		if (!EFI_ERROR(Status)) {
+			if (CheckSignature == TRUE)
+				MeasureFile(Path, ExtractedData,
+					    ExtractedDataSize);
+
 			/*
 			 * The caller supplies the big enough buffer to store
 			 * the full content.
@@ -323,8 +551,18 @@ EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
 			goto out;
 		}
 
-		Status = EfiSignatureVerifyAttached(Signature, SignatureSize,
-						    &RealData, &RealDataSize);
+		if (VerifyCacheEnabled() == TRUE ||
+		    MeasureEnabled() == TRUE ||
+		    VerifiedTableEnabled() == TRUE)
+			Status = VerifyAttachedHashed(Path, Signature,
+						      SignatureSize, &RealData,
+						      &RealDataSize, TRUE,
+						      ProfileTimestamp);
+		else
+			Status = EfiSignatureVerifyAttached(Signature,
+							    SignatureSize,
+							    &RealData,
+							    &RealDataSize);
 		EfiMemoryFree(Signature);
 		if (!EFI_ERROR(Status)) {
 			Status = EfiLibraryVectorizedBufferLeave(Data,
@@ -366,6 +604,7 @@ EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
 						  RealData, RealDataSize);
 		EfiMemoryFree(Signature);
 		if (!EFI_ERROR(Status)) {
+			MeasureFile(Path, RealData, RealDataSize);
 			Status = EfiLibraryVectorizedBufferLeave(Data,
 								 DataSize,
 								 RealData,
@@ -394,6 +633,586 @@ out:
 	EfiConsoleTraceInfo(L"The file %s loaded with the exit code 0x%x\n",
 			    Path, Status);
 
+	if (CheckSignature == TRUE)
+		StatisticsFileVerified(Status, ProfileTimestamp);
+
+	return Status;
+}
+
+/*
+ * Load the file along with the digest attested by its .p7b, leaving the
+ * comparison to the caller, e.g, hashing the content on an AP. Only .p7b
+ * is supported.
+ */
+EFI_STATUS
+FileLoadSigned(CONST CHAR16 *Path, VERIFY_CACHE_TAG *Tag,
+	       VERIFIED_SIGNER *Signer, EFI_GUID **HashAlgorithm,
+	       UINT8 **Hash, UINTN *HashSize, VOID **Data, UINTN *DataSize)
+{
+	if (LoadSignatureRequired(Path) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	VOID *Signature = NULL;
+	UINTN SignatureSize = 0;
+	EFI_STATUS Status;
+
+	Status = LoadFile(Path, L".p7b", &Signature, &SignatureSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = VerifySignatureHash(Path, Signature, SignatureSize, Tag,
+				     Signer, HashAlgorithm, Hash, HashSize);
+	EfiMemoryFree(Signature);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	*Data = NULL;
+	*DataSize = 0;
+
+	Status = LoadFile(Path, NULL, Data, DataSize);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(*Hash);
+		*Hash = NULL;
+	}
+
+	return Status;
+}
+
+EFI_STATUS
+EfiFileLoad(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	BOOLEAN Allocated = Data && !*Data;
+	EFI_STATUS Status;
+
+	/* The full content is requested so take the pre-verified one */
+	if (Allocated == TRUE && DataSize && !*DataSize &&
+	    PreverifiedFileTake(Path, Data, DataSize) == TRUE)
+		return EFI_SUCCESS;
+
+	/*
+	 * All the transient allocations during loading and verifying the
+	 * file are released in bulk.
+	 */
+	Status = EfiMemoryArenaEnter();
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = LoadVerifiedFile(Path, Data, DataSize);
+	if (!EFI_ERROR(Status) && Allocated == TRUE && *Data) {
+		Status = EfiMemoryArenaEscape(Data, *DataSize);
+		if (EFI_ERROR(Status))
+			*Data = NULL;
+	}
+
+	EfiMemoryArenaLeave();
+
+	return Status;
+}
+
+/*
+ * Load the file as EfiFileLoad() and place the content at Address. The
+ * content extracted from .p7a is copied there.
+ */
+EFI_STATUS
+EfiFileLoadAt(CONST CHAR16 *Path, EFI_PHYSICAL_ADDRESS Address, VOID **Data,
+	      UINTN *DataSize)
+{
+	if (!Path || !Address || !Data || *Data || !DataSize)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status;
+
+	FileLoadAddress = Address;
+	Status = EfiFileLoad(Path, Data, DataSize);
+	FileLoadAddress = 0;
+	if (EFI_ERROR(Status))
+		return Status;
+
+	if (!*Data || (EFI_PHYSICAL_ADDRESS)(UINTN)*Data == Address)
+		return EFI_SUCCESS;
+
+	VOID *Buffer;
+
+	Status = EfiMemoryAllocatePages(*DataSize, EFI_PAGE_SIZE, Address,
+					&Buffer);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to place file %s at 0x%lx "
+				     L"(err: 0x%x)\n", Path, Address,
+				     Status);
+		EfiMemoryFree(*Data);
+		*Data = NULL;
+		return Status;
+	}
+
+	MemCpy(Buffer, *Data, *DataSize);
+	EfiMemoryFree(*Data);
+	*Data = Buffer;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+VerifyFileBuffer(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	UINT64 ProfileTimestamp = ProfileStart();
+	BOOLEAN CheckSignature;
+
+	CheckSignature = LoadSignatureRequired(Path);
+	EfiConsolePrintDebug(L"Signature verification is %srequired\n",
+			     CheckSignature == TRUE ? L"" : L"not ");
+	if (CheckSignature == FALSE)
+		return EFI_SUCCESS;
+
+	if (PreverifiedFileMatch(Path, *Data, *DataSize) == TRUE)
+		return EFI_SUCCESS;
+
+	/*
+	 * The content is already in the caller's buffer so .p7b is
+	 * preferred over .p7a to verify it in place.
+	 */
+	EfiConsolePrintDebug(L"Attempting to load the attached signature "
+			     L"file %s.p7b for the file buffer ...\n", Path);
+
+	VOID *Signature = NULL;
+	UINTN SignatureSize = 0;
+	EFI_STATUS Status, RealStatus;
+
+	Status = LoadFile(Path, L".p7b", &Signature, &SignatureSize);
+	RealStatus = Status;
+	if (!EFI_ERROR(Status)) {
+		/* The caller, e.g, grub, measures the buffer itself */
+		if (VerifyCacheEnabled() == TRUE ||
+		    VerifiedTableEnabled() == TRUE)
+			Status = VerifyAttachedHashed(Path, Signature,
+						      SignatureSize, Data,
+						      DataSize, FALSE,
+						      ProfileTimestamp);
+		else
+			Status = EfiSignatureVerifyAttached(Signature,
+							    SignatureSize,
+							    Data, DataSize);
+		EfiMemoryFree(Signature);
+		goto out;
+	}
+
+	EfiConsolePrintDebug(L"Attempting to load the content-attached "
+			     L"signature file %s.p7a for the file buffer "
+			     L"...\n", Path);
+
+	Status = LoadFile(Path, L".p7a", &Signature, &SignatureSize);
+	if (!EFI_ERROR(Status)) {
+		VOID *ExtractedData = NULL;
+		UINTN ExtractedDataSize = 0;
+
+		Status = EfiSignatureVerifyAttached(Signature, SignatureSize,
+						    &ExtractedData,
+						    &ExtractedDataSize);
+		EfiMemoryFree(Signature);
+		if (EFI_ERROR(Status))
+			goto out;
+
+		/*
+		 * The extracted content supersedes the caller's buffer
+		 * which has to be big enough to hold it.
+		 */
+		if (*DataSize < ExtractedDataSize) {
+			EfiConsolePrintError(L"The file buffer is too small "
+					     L"for the content extracted from "
+					     L"%s.p7a\n", Path);
+			*DataSize = ExtractedDataSize;
+			Status = EFI_BUFFER_TOO_SMALL;
+		} else {
+			*DataSize = ExtractedDataSize;
+			MemCpy(*Data, ExtractedData, ExtractedDataSize);
+		}
+
+		EfiMemoryFree(ExtractedData);
+
+		goto out;
+	} else {
+		if (Status == EFI_NOT_FOUND)
+			Status = RealStatus;
+		else
+			RealStatus = Status;
+	}
+
+#ifdef EXPERIMENTAL_BUILD
+	EfiConsolePrintDebug(L"Attempting to load the detached signature "
+			     L"file %s.p7s for the file buffer ...\n", Path);
+
+	Status = LoadFile(Path, L".p7s", &Signature, &SignatureSize);
+	if (!EFI_ERROR(Status)) {
+		Status = EfiSignatureVerifyBuffer(Signature, SignatureSize,
+						  *Data, *DataSize);
+		EfiMemoryFree(Signature);
+	} else {
+		if (Status == EFI_NOT_FOUND)
+			Status = RealStatus;
+
+		EfiConsolePrintDebug(L"Failed to load the signature file "
+				     L"%s.p7b|.p7a|.p7s\n", Path);
+	}
+#else
+	EfiConsolePrintDebug(L"Failed to load the signature file "
+			     L"%s.p7b|.p7a\n", Path);
+#endif
+
+out:
+	EfiConsoleTraceInfo(L"The file buffer %s verified with the exit "
+			    L"code 0x%x\n", Path, Status);
+
+	StatisticsFileVerified(Status, ProfileTimestamp);
+
+	return Status;
+}
+
+/*
+ * Verify the content of Path which the caller has already read into
+ * *Data. Only the signature file is loaded so the file is not read twice.
+ * If .p7a is used, the extracted content is copied to *Data and *DataSize
+ * is updated. If *Data is NULL, the file is loaded as EfiFileLoad().
+ */
+EFI_STATUS
+EfiFileVerifyBuffer(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	if (!Path || !Data || !DataSize)
+		return EFI_INVALID_PARAMETER;
+
+	if (!*Data)
+		return EfiFileLoad(Path, Data, DataSize);
+
+	if (!*DataSize)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status;
+
+	Status = EfiMemoryArenaEnter();
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = VerifyFileBuffer(Path, Data, DataSize);
+
+	EfiMemoryArenaLeave();
+
+	return Status;
+}
+
+/*
+ * The context of the file streamed by the caller. Only one of the signed
+ * hash from .p7b, the content extracted from .p7a and the detached
+ * signature from .p7s is present.
+ */
+struct _EFI_FILE_VERIFY_CONTEXT {
+	CHAR16 *Path;
+	BOOLEAN CheckSignature;
+	UINT64 ProfileTimestamp;
+	/* The first failure which is sticky until EfiFileVerifyFinal() */
+	EFI_STATUS Status;
+	BOOLEAN Hashing;
+	EFI_HASH_CONTEXT HashContext;
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_GUID *HashAlgorithm;
+	VERIFY_CACHE_TAG CacheTag;
+	VERIFIED_SIGNER Signer;
+	UINT8 *Content;
+	UINTN ContentSize;
+	UINTN ContentOffset;
+#ifdef EXPERIMENTAL_BUILD
+	VOID *Signature;
+	UINTN SignatureSize;
+#endif
+};
+
+STATIC EFI_STATUS
+BeginVerifyFile(EFI_FILE_VERIFY_CONTEXT *Context)
+{
+	CONST CHAR16 *Path = Context->Path;
+
+	/* The streamed data is compared with the pre-verified content */
+	if (PreverifiedFileTake(Path, (VOID **)&Context->Content,
+				&Context->ContentSize) == TRUE)
+		return EFI_SUCCESS;
+
+	EfiConsolePrintDebug(L"Attempting to load the attached signature "
+			     L"file %s.p7b for the file stream ...\n", Path);
+
+	VOID *Signature = NULL;
+	UINTN SignatureSize = 0;
+	EFI_STATUS Status, RealStatus;
+
+	Status = LoadFile(Path, L".p7b", &Signature, &SignatureSize);
+	RealStatus = Status;
+	if (!EFI_ERROR(Status)) {
+		Status = VerifySignatureHash(Path, Signature, SignatureSize,
+					     &Context->CacheTag,
+					     &Context->Signer,
+					     &Context->HashAlgorithm,
+					     &Context->Hash,
+					     &Context->HashSize);
+		EfiMemoryFree(Signature);
+		if (EFI_ERROR(Status))
+			return Status;
+
+		Status = EfiHashInitializeIsolated(Context->HashAlgorithm,
+						   &Context->HashContext);
+		if (EFI_ERROR(Status)) {
+			EfiMemoryFree(Context->Hash);
+			Context->Hash = NULL;
+			return Status;
+		}
+
+		Context->Hashing = TRUE;
+
+		return EFI_SUCCESS;
+	}
+
+	EfiConsolePrintDebug(L"Attempting to load the content-attached "
+			     L"signature file %s.p7a for the file stream "
+			     L"...\n", Path);
+
+	Status = LoadFile(Path, L".p7a", &Signature, &SignatureSize);
+	if (!EFI_ERROR(Status)) {
+		/* The streamed data is compared with the extracted content */
+		Status = EfiSignatureVerifyAttached(Signature, SignatureSize,
+						    (VOID **)&Context->Content,
+						    &Context->ContentSize);
+		EfiMemoryFree(Signature);
+
+		return Status;
+	} else {
+		if (Status == EFI_NOT_FOUND)
+			Status = RealStatus;
+		else
+			RealStatus = Status;
+	}
+
+#ifdef EXPERIMENTAL_BUILD
+	EfiConsolePrintDebug(L"Attempting to load the detached signature "
+			     L"file %s.p7s for the file stream ...\n", Path);
+
+	Status = LoadFile(Path, L".p7s", &Signature, &SignatureSize);
+	if (!EFI_ERROR(Status)) {
+		Status = EfiHashInitializeIsolated(&gEfiHashAlgorithmSha256Guid,
+						   &Context->HashContext);
+		if (EFI_ERROR(Status)) {
+			EfiMemoryFree(Signature);
+			return Status;
+		}
+
+		Context->Signature = Signature;
+		Context->SignatureSize = SignatureSize;
+		Context->Hashing = TRUE;
+
+		return EFI_SUCCESS;
+	}
+
+	if (Status == EFI_NOT_FOUND)
+		Status = RealStatus;
+
+	EfiConsolePrintDebug(L"Failed to load the signature file "
+			     L"%s.p7b|.p7a|.p7s\n", Path);
+#else
+	EfiConsolePrintDebug(L"Failed to load the signature file "
+			     L"%s.p7b|.p7a\n", Path);
+#endif
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+FinishVerifyFile(EFI_FILE_VERIFY_CONTEXT *Context)
+{
+	if (Context->Hashing == FALSE) {
+		if (Context->ContentOffset != Context->ContentSize) {
+			EfiConsolePrintError(L"The file %s is shorter than "
+					     L"the content attached in "
+					     L"%s.p7a\n", Context->Path,
+					     Context->Path);
+			return EFI_SECURITY_VIOLATION;
+		}
+
+		return EFI_SUCCESS;
+	}
+
+	Context->Hashing = FALSE;
+
+	if (!Context->HashContext.HashedDataSize) {
+		EfiHashFinalize(&Context->HashContext, NULL, NULL);
+		EfiConsolePrintError(L"Invalid data size to be verified for "
+				     L"hash calculation\n");
+		return EFI_UNSUPPORTED;
+	}
+
+	UINT8 *Hash;
+	UINTN HashSize;
+	UINTN DataSize = Context->HashContext.HashedDataSize;
+	EFI_STATUS Status;
+
+	Status = EfiHashFinalize(&Context->HashContext, &Hash, &HashSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+#ifdef EXPERIMENTAL_BUILD
+	if (Context->Signature) {
+		Status = Pkcs7VerifyDetachedSignature(Hash, HashSize,
+						      Context->Signature,
+						      Context->SignatureSize);
+		EfiMemoryFree(Hash);
+		return Status;
+	}
+#endif
+
+	if (HashSize != Context->HashSize ||
+	    MemCmpConstantTime(Hash, Context->Hash, HashSize)) {
+		EfiConsolePrintError(L"Invalid content for hash "
+				     L"comparison\n");
+		Status = EFI_SECURITY_VIOLATION;
+	} else {
+		VerifyCacheAdd(&Context->CacheTag, Context->HashAlgorithm,
+			       Context->Hash, Context->HashSize);
+		VerifiedTableAdd(Context->Path, DataSize,
+				 Context->HashAlgorithm, Context->Hash,
+				 Context->HashSize, &Context->Signer,
+				 Context->ProfileTimestamp);
+	}
+
+	EfiMemoryFree(Hash);
+
+	return Status;
+}
+
+/*
+ * Start verifying the content of Path which the caller reads in pieces
+ * and passes to EfiFileVerifyUpdate(), so it is neither read again nor
+ * staged in full. Only the signature file is loaded here.
+ */
+EFI_STATUS
+EfiFileVerifyBegin(CONST CHAR16 *Path, EFI_FILE_VERIFY_CONTEXT **Context)
+{
+	if (!Path || !Context)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_FILE_VERIFY_CONTEXT *VerifyContext;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(sizeof(*VerifyContext),
+				   (VOID **)&VerifyContext);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemSet(VerifyContext, 0, sizeof(*VerifyContext));
+	VerifyContext->ProfileTimestamp = ProfileStart();
+
+	VerifyContext->Path = StrDup(Path);
+	if (!VerifyContext->Path) {
+		EfiMemoryFree(VerifyContext);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	VerifyContext->CheckSignature = LoadSignatureRequired(Path);
+	EfiConsolePrintDebug(L"Signature verification is %srequired\n",
+			     VerifyContext->CheckSignature == TRUE ? L"" :
+								     L"not ");
+	if (VerifyContext->CheckSignature == TRUE) {
+		Status = BeginVerifyFile(VerifyContext);
+		if (EFI_ERROR(Status)) {
+			EfiConsoleTraceInfo(L"The file stream %s failed to "
+					    L"begin (err: 0x%x)\n", Path,
+					    Status);
+			StatisticsFileVerified(Status,
+					       VerifyContext->ProfileTimestamp);
+			EfiMemoryFree(VerifyContext->Path);
+			EfiMemoryFree(VerifyContext);
+			return Status;
+		}
+	}
+
+	*Context = VerifyContext;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiFileVerifyUpdate(EFI_FILE_VERIFY_CONTEXT *Context, CONST VOID *Data,
+		    UINTN DataSize)
+{
+	if (!Context || (DataSize && !Data))
+		return EFI_INVALID_PARAMETER;
+
+	if (EFI_ERROR(Context->Status))
+		return Context->Status;
+
+	if (Context->CheckSignature == FALSE || !DataSize)
+		return EFI_SUCCESS;
+
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	if (Context->Hashing == TRUE)
+		Status = EfiHashUpdate(&Context->HashContext, Data, DataSize);
+	else if (DataSize > Context->ContentSize - Context->ContentOffset ||
+		 MemCmp(Context->Content + Context->ContentOffset, Data,
+			DataSize)) {
+		EfiConsolePrintError(L"The file %s doesn't match the "
+				     L"content attached in %s.p7a\n",
+				     Context->Path, Context->Path);
+		Status = EFI_SECURITY_VIOLATION;
+	} else
+		Context->ContentOffset += DataSize;
+
+	Context->Status = Status;
+
+	return Status;
+}
+
+/* Fail the verification with EFI_ABORTED before the final */
+VOID
+FileVerifyAbort(EFI_FILE_VERIFY_CONTEXT *Context)
+{
+	if (!EFI_ERROR(Context->Status))
+		Context->Status = EFI_ABORTED;
+}
+
+/*
+ * Finish the verification and release the context, even if the file
+ * is not streamed to the end.
+ */
+EFI_STATUS
+EfiFileVerifyFinal(EFI_FILE_VERIFY_CONTEXT *Context)
+{
+	if (!Context)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status = Context->Status;
+
+	if (Context->CheckSignature == TRUE) {
+		if (!EFI_ERROR(Status))
+			Status = FinishVerifyFile(Context);
+
+		if (Context->Hashing == TRUE)
+			EfiHashFinalize(&Context->HashContext, NULL, NULL);
+
+		EfiConsoleTraceInfo(L"The file stream %s verified with the "
+				    L"exit code 0x%x\n", Context->Path,
+				    Status);
+
+		StatisticsFileVerified(Status, Context->ProfileTimestamp);
+	}
+
+#ifdef EXPERIMENTAL_BUILD
+	if (Context->Signature)
+		EfiMemoryFree(Context->Signature);
+#endif
+	if (Context->Content)
+		EfiMemoryFree(Context->Content);
+	if (Context->Hash)
+		EfiMemoryFree(Context->Hash);
+	EfiMemoryFree(Context->Path);
+	EfiMemoryFree(Context);
+
 	return Status;
 }
 
@@ -403,6 +1222,8 @@ EfiFileSave(CONST CHAR16 *Path, VOID *Data, UINTN DataSize)
 	EFI_FILE_HANDLE FileHandle;
 	EFI_STATUS Status;
 
+	SignatureFileMissingRemove(Path);
+
 	Status = OpenFile(Path, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE |
 			  EFI_FILE_MODE_CREATE, &FileHandle, NULL);
 	if (EFI_ERROR(Status))
@@ -440,3 +1261,18 @@ EfiFileDelete(CONST CHAR16 *Path)
 
 	return Status;
 }
+
+BOOLEAN
+EfiFileExists(CONST CHAR16 *Path)
+{
+	EFI_FILE_HANDLE FileHandle;
+	EFI_STATUS Status;
+
+	Status = OpenFile(Path, EFI_FILE_MODE_READ, &FileHandle, NULL);
+	if (EFI_ERROR(Status))
+		return FALSE;
+
+	FileHandle->Close(FileHandle);
+
+	return TRUE;
+}
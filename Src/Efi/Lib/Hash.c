@@ -35,6 +35,8 @@
 #include <EfiLibrary.h>
 #include <BaseLibrary.h>
 
+#include "Internal.h"
+
 EFI_GUID gEfiHash2ServiceBindingProtocolGuid =
 	EFI_HASH2_SERVICE_BINDING_PROTOCOL_GUID;	
 EFI_GUID gEfiHashServiceBindingProtocolGuid =
@@ -49,7 +51,6 @@ EFI_GUID gEfiHashAlgorithmSha256Guid = EFI_HASH_ALGORITHM_SHA256_GUID;
 EFI_GUID gEfiHashAlgorithmSha384Guid = EFI_HASH_ALGORITHM_SHA384_GUID;
 EFI_GUID gEfiHashAlgorithmSha512Guid = EFI_HASH_ALGORITHM_SHA512_GUID;
 
-STATIC BOOLEAN HashServiceInitialized = FALSE;
 STATIC EFI_SERVICE_BINDING_PROTOCOL *HashServiceBindingProtocol;
 STATIC BOOLEAN Hash2ServiceBindingProtocolUsed = TRUE;
 /* TODO: call DestroyChild() via notifier */
@@ -98,6 +99,14 @@ InitializeHashService(VOID)
 	EfiConsolePrintDebug(L"Initializing EFI Hash Protocol "
 			     L"infrastructure ...\n");
 
+	if (Sha2Accelerated() == TRUE) {
+		Hash2Protocol = Sha2ProtocolGet();
+		StatisticsHashProviderSet(SelProviderBuiltin);
+		EfiConsolePrintDebug(L"Using the built-in SHA-2 engine "
+				     L"accelerated by CPU\n");
+		return EFI_SUCCESS;
+	}
+
 	EFI_STATUS Status;
 
 	Status = EfiProtocolLocate(&gEfiHash2ServiceBindingProtocolGuid,
@@ -120,9 +129,14 @@ InitializeHashService(VOID)
 			Status = LoadHash2DxeCrypto();
 			if (EFI_ERROR(Status))
 				return Status;
-		} else
+
+			StatisticsHashProviderSet(SelProviderDriver);
+		} else {
 			Hash2ServiceBindingProtocolUsed = FALSE;
-	}
+			StatisticsHashProviderSet(SelProviderFirmwareLegacy);
+		}
+	} else
+		StatisticsHashProviderSet(SelProviderFirmware);
 
 	Status = HashServiceBindingProtocol->CreateChild(HashServiceBindingProtocol,
 							 &HashHandle);
@@ -149,8 +163,6 @@ InitializeHashService(VOID)
 		return Status;
 	}
 
-	HashServiceInitialized = TRUE;
-
 	EfiConsoleTraceDebug(L"Hash service initialized\n");
 
 	return EFI_SUCCESS;
@@ -164,11 +176,9 @@ EfiHashSize(CONST EFI_GUID *HashAlgorithm, UINTN *HashSize)
 
 	EFI_STATUS Status;
 
-	if (HashServiceInitialized == FALSE) {
-		Status = InitializeHashService();
-		if (EFI_ERROR(Status))
-			return Status;
-	}
+	Status = InitStateRun(InitObjectHashService, InitializeHashService);
+	if (EFI_ERROR(Status))
+		return Status;
 
 	if (Hash2ServiceBindingProtocolUsed == TRUE)
 		return Hash2Protocol->GetHashSize(Hash2Protocol, HashAlgorithm,
@@ -178,37 +188,84 @@ EfiHashSize(CONST EFI_GUID *HashAlgorithm, UINTN *HashSize)
 						 HashSize);
 }
 
-EFI_STATUS
-EfiHashInitialize(CONST EFI_GUID *HashAlgorithm,
-		  EFI_HASH_CONTEXT *Context)
+STATIC EFI_STATUS
+CreateHashInstance(EFI_HASH_CONTEXT *Context)
 {
-	if (!Context)
-		return EFI_INVALID_PARAMETER;
-
 	EFI_STATUS Status;
 
-	if (HashServiceInitialized == FALSE) {
-		Status = InitializeHashService();
-		if (EFI_ERROR(Status))
-			return Status;
+	/* The built-in engine is used without the service binding */
+	if (!HashServiceBindingProtocol)
+		return Sha2ProtocolCreate(&Context->Hash2Protocol);
+
+	Status = HashServiceBindingProtocol->CreateChild(HashServiceBindingProtocol,
+							 &Context->Handle);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to create hash handle "
+				     L"(err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	if (Hash2ServiceBindingProtocolUsed == TRUE)
+		Status = EfiProtocolOpen(Context->Handle,
+					 &gEfiHash2ProtocolGuid,
+					 (VOID **)&Context->Hash2Protocol);
+	else
+		Status = EfiProtocolOpen(Context->Handle,
+					 &gEfiHashProtocolGuid,
+					 (VOID **)&Context->HashProtocol);
+	if (EFI_ERROR(Status)) {
+		HashServiceBindingProtocol->DestroyChild(HashServiceBindingProtocol,
+							 Context->Handle);
+		Context->Handle = NULL;
+		EfiConsolePrintError(L"Unable to open EFI Hash%s Protocol "
+				     L"(err: 0x%x)\n",
+				     Hash2ServiceBindingProtocolUsed ? L"2" :
+								       L"",
+				     Status);
 	}
 
+	return Status;
+}
+
+STATIC VOID
+DestroyHashInstance(EFI_HASH_CONTEXT *Context)
+{
+	if (Context->Isolated == FALSE)
+		return;
+
+	if (Context->Handle)
+		HashServiceBindingProtocol->DestroyChild(HashServiceBindingProtocol,
+							 Context->Handle);
+	else
+		Sha2ProtocolDestroy(Context->Hash2Protocol);
+
+	Context->Handle = NULL;
+	Context->Hash2Protocol = NULL;
+	Context->HashProtocol = NULL;
+	Context->Isolated = FALSE;
+}
+
+STATIC EFI_STATUS
+InitializeHashContext(CONST EFI_GUID *HashAlgorithm,
+		      EFI_HASH_CONTEXT *Context)
+{
+	EFI_STATUS Status;
 	UINTN HashSize;
 
 	if (Hash2ServiceBindingProtocolUsed == TRUE)
-		Status = Hash2Protocol->GetHashSize(Hash2Protocol,
-						    HashAlgorithm,
-					 	    &HashSize);
+		Status = Context->Hash2Protocol->GetHashSize(Context->Hash2Protocol,
+							     HashAlgorithm,
+							     &HashSize);
 	else
-		Status = HashProtocol->GetHashSize(HashProtocol,
-						   HashAlgorithm,
-					 	   &HashSize);
+		Status = Context->HashProtocol->GetHashSize(Context->HashProtocol,
+							    HashAlgorithm,
+							    &HashSize);
 	if (EFI_ERROR(Status))
 		return Status;
 
 	if (Hash2ServiceBindingProtocolUsed == TRUE) {
-		Status = Hash2Protocol->HashInit(Hash2Protocol,
-						 HashAlgorithm);
+		Status = Context->Hash2Protocol->HashInit(Context->Hash2Protocol,
+							  HashAlgorithm);
 		if (EFI_ERROR(Status))
 			return Status;
 	}
@@ -236,6 +293,64 @@ ErrOnAllocateHashAlgorithm:
 	return Status;
 }
 
+EFI_STATUS
+EfiHashInitialize(CONST EFI_GUID *HashAlgorithm,
+		  EFI_HASH_CONTEXT *Context)
+{
+	if (!Context)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status;
+
+	Status = InitStateRun(InitObjectHashService, InitializeHashService);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Context->Handle = NULL;
+	Context->Hash2Protocol = Hash2Protocol;
+	Context->HashProtocol = HashProtocol;
+	Context->Isolated = FALSE;
+
+	return InitializeHashContext(HashAlgorithm, Context);
+}
+
+/*
+ * Initialize the hash context on a private instance of the hash service.
+ * It is required if the multi-part hash lasts across the calls from the
+ * caller of SELoader, e.g, the file streamed via MOK2 Verify Protocol,
+ * because the shared instance is able to run only one at a time.
+ */
+EFI_STATUS
+EfiHashInitializeIsolated(CONST EFI_GUID *HashAlgorithm,
+			  EFI_HASH_CONTEXT *Context)
+{
+	if (!Context)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status;
+
+	Status = InitStateRun(InitObjectHashService, InitializeHashService);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Context->Handle = NULL;
+	Context->Hash2Protocol = NULL;
+	Context->HashProtocol = NULL;
+	Context->Isolated = TRUE;
+
+	Status = CreateHashInstance(Context);
+	if (EFI_ERROR(Status)) {
+		Context->Isolated = FALSE;
+		return Status;
+	}
+
+	Status = InitializeHashContext(HashAlgorithm, Context);
+	if (EFI_ERROR(Status))
+		DestroyHashInstance(Context);
+
+	return Status;
+}
+
 EFI_STATUS
 EfiHashUpdate(EFI_HASH_CONTEXT *Context, CONST UINT8 *Message,
 	      UINTN MessageSize)
@@ -243,24 +358,30 @@ EfiHashUpdate(EFI_HASH_CONTEXT *Context, CONST UINT8 *Message,
 	if (!Context)
 		return EFI_INVALID_PARAMETER;
 
-	if (HashServiceInitialized == FALSE)
+	if (InitStateReady(InitObjectHashService) == FALSE)
 		return EFI_UNSUPPORTED;
 
+	UINT64 ProfileTimestamp = ProfileStart();
 	EFI_STATUS Status;
 
 	if (Hash2ServiceBindingProtocolUsed == TRUE)
-		Status = Hash2Protocol->HashUpdate(Hash2Protocol, Message,
-						   MessageSize);
+		Status = Context->Hash2Protocol->HashUpdate(Context->Hash2Protocol,
+							    Message,
+							    MessageSize);
 	else {
 		EFI_HASH_OUTPUT HashOutput;
 
 		*(VOID **)&HashOutput = Context->Hash;
-		Status = HashProtocol->Hash(HashProtocol,
-					    Context->HashAlgorithm,
-					    Context->Extended, Message,
-					    MessageSize, &HashOutput);
+		Status = Context->HashProtocol->Hash(Context->HashProtocol,
+						     Context->HashAlgorithm,
+						     Context->Extended,
+						     Message, MessageSize,
+						     &HashOutput);
 	}
 
+	ProfileStop(SelProfilePhaseHash, ProfileTimestamp);
+	StatisticsHashed(MessageSize);
+
 	if (!EFI_ERROR(Status))
 		Context->Extended = TRUE;
 
@@ -276,6 +397,7 @@ FreeHashContext(EFI_HASH_CONTEXT *Context)
 	EfiMemoryFree(Context->Hash);
 	Context->HashAlgorithm = NULL;
 	Context->Hash = NULL;
+	DestroyHashInstance(Context);
 }
 
 EFI_STATUS
@@ -292,8 +414,8 @@ EfiHashFinalize(EFI_HASH_CONTEXT *Context, UINT8 **Hash, UINTN *HashSize)
 			return Status;
 
 		if (Hash2ServiceBindingProtocolUsed == TRUE) {
-			Status = Hash2Protocol->HashFinal(Hash2Protocol,
-							  (EFI_HASH2_OUTPUT *)*Hash);
+			Status = Context->Hash2Protocol->HashFinal(Context->Hash2Protocol,
+								   (EFI_HASH2_OUTPUT *)*Hash);
 			if (EFI_ERROR(Status)) {
 				EfiMemoryFree(*Hash);
 				goto ErrOnHashFinal;
@@ -349,9 +471,15 @@ EfiHashData(CONST EFI_GUID *HashAlgorithm, CONST UINT8 *Message,
 		if (EFI_ERROR(Status))
 			return Status;
 
+		UINT64 ProfileTimestamp = ProfileStart();
+
 		Status = Hash2Protocol->Hash(Hash2Protocol, HashAlgorithm,
 					     Message, MessageSize,
 					     (EFI_HASH2_OUTPUT *)*Hash);
+
+		ProfileStop(SelProfilePhaseHash, ProfileTimestamp);
+		StatisticsHashed(MessageSize);
+
 		if (EFI_ERROR(Status)) {
 			EfiMemoryFree(*Hash);
 			*Hash = NULL;
@@ -363,3 +491,146 @@ EfiHashData(CONST EFI_GUID *HashAlgorithm, CONST UINT8 *Message,
 
 	return Status;
 }
+
+/*
+ * Hash the same message with several algorithms in a single pass, e.g,
+ * the digest for the signature and the ones for the PCR banks. Each
+ * algorithm runs on a private instance of the hash service, and the
+ * message is fed in strides small enough to stay in the data cache until
+ * all the algorithms consume it, so it is loaded from memory only once.
+ */
+#define MULTI_HASH_STRIDE		(8 * 1024)
+
+EFI_STATUS
+EfiMultiHashInitialize(EFI_GUID **HashAlgorithms,
+		       UINTN NumberOfHashAlgorithms,
+		       EFI_MULTI_HASH_CONTEXT *Context)
+{
+	if (!HashAlgorithms || !NumberOfHashAlgorithms ||
+	    NumberOfHashAlgorithms > EFI_MULTI_HASH_MAX || !Context)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status = EFI_SUCCESS;
+	UINTN Index;
+
+	for (Index = 0; Index < NumberOfHashAlgorithms; ++Index) {
+		Status = EfiHashInitializeIsolated(HashAlgorithms[Index],
+						   &Context->Contexts[Index]);
+		if (EFI_ERROR(Status))
+			break;
+	}
+
+	if (EFI_ERROR(Status)) {
+		while (Index--)
+			FreeHashContext(&Context->Contexts[Index]);
+
+		return Status;
+	}
+
+	Context->NumberOfHashAlgorithms = NumberOfHashAlgorithms;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiMultiHashUpdate(EFI_MULTI_HASH_CONTEXT *Context, CONST UINT8 *Message,
+		   UINTN MessageSize)
+{
+	if (!Context)
+		return EFI_INVALID_PARAMETER;
+
+	while (MessageSize) {
+		UINTN Size = MIN(MessageSize, MULTI_HASH_STRIDE);
+
+		for (UINTN Index = 0; Index < Context->NumberOfHashAlgorithms;
+		     ++Index) {
+			EFI_STATUS Status;
+
+			Status = EfiHashUpdate(&Context->Contexts[Index],
+					       Message, Size);
+			if (EFI_ERROR(Status))
+				return Status;
+		}
+
+		Message += Size;
+		MessageSize -= Size;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * The digests are returned in the order of the algorithms. Pass NULL
+ * Hashes to abort.
+ */
+EFI_STATUS
+EfiMultiHashFinalize(EFI_MULTI_HASH_CONTEXT *Context, UINT8 **Hashes,
+		     UINTN *HashSizes)
+{
+	if (!Context || (Hashes && !HashSizes))
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status = EFI_SUCCESS;
+	UINTN Finalized = 0;
+
+	for (UINTN Index = 0; Index < Context->NumberOfHashAlgorithms;
+	     ++Index) {
+		EFI_HASH_CONTEXT *HashContext = &Context->Contexts[Index];
+
+		if (!Hashes || EFI_ERROR(Status)) {
+			FreeHashContext(HashContext);
+			continue;
+		}
+
+		Status = EfiHashFinalize(HashContext, &Hashes[Index],
+					 &HashSizes[Index]);
+		if (!EFI_ERROR(Status))
+			++Finalized;
+	}
+
+	if (EFI_ERROR(Status)) {
+		while (Finalized--) {
+			EfiMemoryFree(Hashes[Finalized]);
+			Hashes[Finalized] = NULL;
+		}
+	}
+
+	Context->NumberOfHashAlgorithms = 0;
+
+	return Status;
+}
+
+EFI_STATUS
+EfiMultiHashData(EFI_GUID **HashAlgorithms, UINTN NumberOfHashAlgorithms,
+		 CONST UINT8 *Message, UINTN MessageSize, UINT8 **Hashes,
+		 UINTN *HashSizes)
+{
+	if (!Hashes || !HashSizes)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_MULTI_HASH_CONTEXT Context;
+	EFI_STATUS Status;
+
+	Status = EfiMultiHashInitialize(HashAlgorithms, NumberOfHashAlgorithms,
+					&Context);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = EfiMultiHashUpdate(&Context, Message, MessageSize);
+	if (EFI_ERROR(Status)) {
+		EfiMultiHashFinalize(&Context, NULL, NULL);
+		return Status;
+	}
+
+	return EfiMultiHashFinalize(&Context, Hashes, HashSizes);
+}
+
+/*
+ * The built-in SHA-2 engine, regardless of whether it is used by the hash
+ * service, e.g, to compare with the firmware.
+ */
+EFI_HASH2_PROTOCOL *
+EfiHashBuiltinProtocol(VOID)
+{
+	return Sha2ProtocolGet();
+}
@@ -41,9 +41,9 @@
 EFI_GUID gEfiLoadedImageProtocolGuid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
 #endif
 
+/* The device path of the file on the device SELoader is loaded from */
 STATIC EFI_STATUS
-LoadImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
-	  EFI_HANDLE *ImageHandle)
+CreateDevicePath(CONST CHAR16 *Path, EFI_DEVICE_PATH **DevicePath)
 {
 	EFI_LOADED_IMAGE *LoadedImage;
 	EFI_STATUS Status;
@@ -62,14 +62,27 @@ LoadImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
 		return Status;
 	}
 
-	EFI_DEVICE_PATH *DevicePath = FileDevicePath(LoadedImage->DeviceHandle,
-						     FilePath);
+	*DevicePath = FileDevicePath(LoadedImage->DeviceHandle, FilePath);
 	EfiMemoryFree(FilePath);
-	if (!DevicePath) {
+	if (!*DevicePath) {
 		EfiConsolePrintError(L"Failed to create the device path for "
-				     L"%s (err: 0x%x)\n", Path, Status);
+				     L"%s\n", Path);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+LoadImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
+	  BOOLEAN Trusted, EFI_HANDLE *ImageHandle)
+{
+	EFI_DEVICE_PATH *DevicePath;
+	EFI_STATUS Status;
+
+	Status = CreateDevicePath(Path, &DevicePath);
+	if (EFI_ERROR(Status))
 		return Status;
-	}	
 
 	/*
 	 * shim may re-install the Sap/Sap2 hooks. If so, we hook them
@@ -82,11 +95,37 @@ LoadImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
 		Sap2Hook();
 	}
 
+	/*
+	 * The trusted image buffer is covered by the signature of SELoader
+	 * so the hook doesn't need to verify it again. Without the hook,
+	 * BIOS would verify it against db, e.g, the unsigned .linux of UKI,
+	 * so refuse to load it rather than relying on that.
+	 */
+	if (Trusted == TRUE) {
+		if (EfiSecurityPolicySecureBootEnabled() == TRUE &&
+		    Sap2Hooked() == FALSE) {
+			EfiConsolePrintError(L"Unable to load the trusted "
+					     L"image %s without hooking EFI "
+					     L"Security2 Architectural "
+					     L"Protocol\n", Path);
+			EfiMemoryFree(DevicePath);
+			return EFI_SECURITY_VIOLATION;
+		}
+
+		Sap2TrustedImageSet(ImageBuffer, ImageBufferSize);
+	}
+
 	EFI_HANDLE LoadedImageHandle;
+	UINT64 ProfileTimestamp = ProfileStart();
 
         Status = gBS->LoadImage(FALSE, gThisImage, DevicePath, ImageBuffer,
 				ImageBufferSize, &LoadedImageHandle);
+	ProfileStop(SelProfilePhaseLoadImage, ProfileTimestamp);
 	EfiMemoryFree(DevicePath);
+
+	if (Trusted == TRUE)
+		Sap2TrustedImageSet(NULL, 0);
+
 	if (EFI_ERROR(Status)) {
 		EfiConsolePrintError(L"Failed to load the image "
 				     L"%s (err: 0x%x)\n", Path, Status);
@@ -103,7 +142,7 @@ LoadImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
 
 STATIC EFI_STATUS
 ExecuteImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
-	     BOOLEAN Unload)
+	     CONST CHAR16 *LoadOptions, BOOLEAN Trusted, BOOLEAN Unload)
 {
 	EfiConsolePrintDebug(L"Preparing to start the image %s ...\n",
 			     Path);
@@ -111,11 +150,52 @@ ExecuteImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
 	EFI_HANDLE ImageHandle;
 	EFI_STATUS Status;
 
-	Status = LoadImage(Path, ImageBuffer, ImageBufferSize, &ImageHandle);
+	/* Only the boot target is marked */
+	if (Unload == TRUE)
+		ProfileMark(L"load", Path);
+
+	Status = LoadImage(Path, ImageBuffer, ImageBufferSize, Trusted,
+			   &ImageHandle);
 	if (EFI_ERROR(Status))
 		return Status;
 
+	if (LoadOptions) {
+		EFI_LOADED_IMAGE *LoadedImage;
+
+		Status = EfiProtocolOpen(ImageHandle,
+					 &gEfiLoadedImageProtocolGuid,
+					 (VOID **)&LoadedImage);
+		if (EFI_ERROR(Status)) {
+			gBS->UnloadImage(ImageHandle);
+			return Status;
+		}
+
+		/* The load options must be alive until the image exits */
+		LoadedImage->LoadOptions = (VOID *)LoadOptions;
+		LoadedImage->LoadOptionsSize = (StrLen(LoadOptions) + 1) *
+					       sizeof(CHAR16);
+
+		EfiConsolePrintDebug(L"Load options for the image %s: %s\n",
+				     Path, LoadOptions);
+	}
+
+	/*
+	 * The boot target, e.g, grub or kernel, may never return so the
+	 * profile report and the deferred log have to be published, and the
+	 * verification cache saved, before starting it.
+	 */
+	if (Unload == TRUE) {
+		VerifyCacheFlush();
+		EfiProfileReport();
+		StatisticsPublish();
+		EfiConsoleSaveLog();
+		ProfileMark(L"start", Path);
+	}
+
+	UINT64 ProfileTimestamp = ProfileStart();
+
 	Status = gBS->StartImage(ImageHandle, NULL, NULL);
+	ProfileStop(SelProfilePhaseStartImage, ProfileTimestamp);
 	if (!EFI_ERROR(Status))
 		EfiConsolePrintDebug(L"The image %s exited\n", Path);
 	else
@@ -128,13 +208,65 @@ ExecuteImage(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize,
 	return Status;
 }
 
+/*
+ * Authenticate the PE image in the buffer against db and dbx with BIOS
+ * without loading it.
+ */
+EFI_STATUS
+ImageVerify(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize)
+{
+	if (!Path || !ImageBuffer || !ImageBufferSize)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_DEVICE_PATH *DevicePath;
+	EFI_STATUS Status;
+
+	Status = CreateDevicePath(Path, &DevicePath);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = Sap2VerifyImage(DevicePath, ImageBuffer, ImageBufferSize);
+	EfiMemoryFree(DevicePath);
+
+	return Status;
+}
+
+EFI_STATUS
+ImageExecuteTrusted(CONST CHAR16 *Path, VOID *ImageBuffer,
+		    UINTN ImageBufferSize, CONST CHAR16 *LoadOptions)
+{
+	if (!Path || !ImageBuffer || !ImageBufferSize)
+		return EFI_INVALID_PARAMETER;
+
+	return ExecuteImage(Path, ImageBuffer, ImageBufferSize, LoadOptions,
+			    TRUE, TRUE);
+}
+
 EFI_STATUS
 EfiImageExecuteDriver(CONST CHAR16 *Path)
 {
 	if (!Path)
 		return EFI_INVALID_PARAMETER;
 
-	return ExecuteImage(Path, NULL, 0, FALSE);
+#ifdef EMBEDDED_DRIVER_BUILD
+	VOID *ImageBuffer;
+	UINTN ImageBufferSize;
+	EFI_STATUS Status;
+
+	Status = EmbeddedDriverLocate(Path, &ImageBuffer, &ImageBufferSize);
+	if (!EFI_ERROR(Status)) {
+		Status = ExecuteImage(Path, ImageBuffer, ImageBufferSize,
+				      NULL, TRUE, FALSE);
+		/* Refused without the hook, so try the copy on ESP */
+		if (Status != EFI_SECURITY_VIOLATION)
+			return Status;
+
+		EfiConsolePrintInfo(L"Falling back to the driver %s on "
+				    L"ESP\n", Path);
+	}
+#endif
+
+	return ExecuteImage(Path, NULL, 0, NULL, FALSE, FALSE);
 }
 
 EFI_STATUS
@@ -143,7 +275,46 @@ EfiImageExecute(CONST CHAR16 *Path)
 	if (!Path)
 		return EFI_INVALID_PARAMETER;
 
-	return ExecuteImage(Path, NULL, 0, TRUE);
+	return ExecuteImage(Path, NULL, 0, NULL, FALSE, TRUE);
+}
+
+EFI_STATUS
+EfiImageExecuteWithOptions(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	return ExecuteImage(Path, NULL, 0, LoadOptions, FALSE, TRUE);
+}
+
+/*
+ * Load the image with EfiFileLoad() so it is verified with its signature
+ * file along with the verification cache, measurement and verified table,
+ * and then start it from the verified buffer.
+ */
+EFI_STATUS
+EfiImageExecuteVerified(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	VOID *ImageBuffer = NULL;
+	UINTN ImageBufferSize = 0;
+	EFI_STATUS Status;
+
+	Status = EfiFileLoad(Path, &ImageBuffer, &ImageBufferSize);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to load the image %s (err: "
+				     L"0x%x)\n", Path, Status);
+		return Status;
+	}
+
+	Status = ExecuteImage(Path, ImageBuffer, ImageBufferSize, LoadOptions,
+			      TRUE, TRUE);
+
+	EfiMemoryFree(ImageBuffer);
+
+	return Status;
 }
 
 EFI_STATUS
@@ -152,5 +323,5 @@ EfiImageLoad(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize)
 	if (!Path)
 		return EFI_INVALID_PARAMETER;
 
-	return LoadImage(Path, ImageBuffer, ImageBufferSize, NULL);
+	return LoadImage(Path, ImageBuffer, ImageBufferSize, FALSE, NULL);
 }
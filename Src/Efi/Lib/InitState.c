@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+
+#include "Internal.h"
+
+typedef enum {
+	InitStateNone,
+	InitStateInProgress,
+	InitStateDone,
+	InitStateFailed,
+} INIT_STATE;
+
+typedef struct {
+	CONST CHAR16 *Name;
+	INIT_STATE State;
+	EFI_STATUS Status;
+	UINTN Hits;
+} INIT_OBJECT_STATE;
+
+STATIC INIT_OBJECT_STATE InitObjectStates[InitObjectMax] = {
+	[InitObjectPkcs7] = {
+		L"PKCS#7 Verify Protocol", InitStateNone, EFI_SUCCESS, 0
+	},
+	[InitObjectHashService] = {
+		L"EFI Hash Protocol", InitStateNone, EFI_SUCCESS, 0
+	},
+};
+
+/*
+ * A transient failure allows to retry the initialization next time.
+ * Anything else, e.g, a missing driver, is not going to be fixed
+ * within this boot.
+ */
+STATIC BOOLEAN
+TerminalFailure(EFI_STATUS Status)
+{
+	return Status != EFI_OUT_OF_RESOURCES;
+}
+
+EFI_STATUS
+InitStateRun(INIT_OBJECT Object, EFI_STATUS (*Initialize)(VOID))
+{
+	if (Object >= InitObjectMax || !Initialize)
+		return EFI_INVALID_PARAMETER;
+
+	INIT_OBJECT_STATE *ObjectState = InitObjectStates + Object;
+
+	switch (ObjectState->State) {
+	case InitStateDone:
+		return EFI_SUCCESS;
+	case InitStateFailed:
+		++ObjectState->Hits;
+		StatisticsCacheHit();
+		EfiConsolePrintDebug(L"Hit the cached failure of initializing "
+				     L"%s (err: 0x%x)\n", ObjectState->Name,
+				     ObjectState->Status);
+		return ObjectState->Status;
+	case InitStateInProgress:
+		/* Recursively called during the initialization */
+		return EFI_NOT_READY;
+	default:
+		break;
+	}
+
+	ObjectState->State = InitStateInProgress;
+
+	/* The initialized objects live until the end */
+	EfiMemoryArenaSuspend();
+	EFI_STATUS Status = Initialize();
+	EfiMemoryArenaResume();
+
+	if (!EFI_ERROR(Status))
+		ObjectState->State = InitStateDone;
+	else if (TerminalFailure(Status) == TRUE) {
+		ObjectState->State = InitStateFailed;
+		ObjectState->Status = Status;
+	} else
+		ObjectState->State = InitStateNone;
+
+	return Status;
+}
+
+BOOLEAN
+InitStateReady(INIT_OBJECT Object)
+{
+	if (Object >= InitObjectMax)
+		return FALSE;
+
+	return InitObjectStates[Object].State == InitStateDone;
+}
+
+EFI_STATUS
+EfiInitStateFailure(UINTN Index, CONST CHAR16 **Name, EFI_STATUS *Status,
+		    UINTN *Hits)
+{
+	for (UINTN Object = 0; Object < InitObjectMax; ++Object) {
+		INIT_OBJECT_STATE *ObjectState = InitObjectStates + Object;
+
+		if (ObjectState->State != InitStateFailed || Index--)
+			continue;
+
+		if (Name)
+			*Name = ObjectState->Name;
+
+		if (Status)
+			*Status = ObjectState->Status;
+
+		if (Hits)
+			*Hits = ObjectState->Hits;
+
+		return EFI_SUCCESS;
+	}
+
+	return EFI_NOT_FOUND;
+}
+
+VOID
+EfiInitStatePrint(VOID)
+{
+	for (UINTN Object = 0; Object < InitObjectMax; ++Object) {
+		INIT_OBJECT_STATE *ObjectState = InitObjectStates + Object;
+
+		if (ObjectState->State != InitStateFailed)
+			continue;
+
+		EfiConsolePrintInfo(L"Failed to initialize %s (err: 0x%x, "
+				    L"%d retries skipped)\n",
+				    ObjectState->Name, ObjectState->Status,
+				    ObjectState->Hits);
+	}
+}
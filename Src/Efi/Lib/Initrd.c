@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/*
+ * The EFI-stub kernel since v5.8 locates the handle with this vendor media
+ * device path and loads the initrd with EFI Load File2 Protocol, without
+ * the need of the initrd= command line option or the boot params.
+ */
+#define LINUX_EFI_INITRD_MEDIA_GUID	\
+	{ 0x5568e427, 0x68fc, 0x4f3d, \
+	  { 0xac, 0x74, 0xca, 0x55, 0x52, 0x31, 0xcc, 0x68 } }
+
+#if GNU_EFI_VERSION <= 304
+EFI_GUID gEfiDevicePathProtocolGuid = EFI_DEVICE_PATH_PROTOCOL_GUID;
+#endif
+
+/* Not all gnu-efi versions define this GUID */
+STATIC EFI_GUID LoadFile2ProtocolGuid = EFI_LOAD_FILE2_PROTOCOL_GUID;
+
+typedef struct {
+	VENDOR_DEVICE_PATH Vendor;
+	EFI_DEVICE_PATH_PROTOCOL End;
+} __attribute__((packed)) INITRD_DEVICE_PATH;
+
+STATIC INITRD_DEVICE_PATH InitrdDevicePath = {
+	{
+		{
+			MEDIA_DEVICE_PATH,
+			MEDIA_VENDOR_DP,
+			{ sizeof(VENDOR_DEVICE_PATH), 0 }
+		},
+		LINUX_EFI_INITRD_MEDIA_GUID
+	},
+	{
+		END_DEVICE_PATH_TYPE,
+		END_ENTIRE_DEVICE_PATH_SUBTYPE,
+		{ sizeof(EFI_DEVICE_PATH_PROTOCOL), 0 }
+	}
+};
+
+/*
+ * The maximum number of initrds concatenated, e.g, the early microcode
+ * cpio and the main initramfs.
+ */
+#define MAX_INITRD_SEGMENTS		8
+
+/*
+ * Each initrd starts at 4-byte boundary as grub and systemd-stub lay them
+ * out, otherwise the cpio unpacker of kernel fails with "broken padding".
+ */
+#define INITRD_SEGMENT_ALIGNMENT	4
+
+typedef struct {
+	VOID *Data;
+	UINTN DataSize;
+	BOOLEAN Allocated;
+} INITRD_SEGMENT;
+
+STATIC INITRD_SEGMENT InitrdSegments[MAX_INITRD_SEGMENTS];
+STATIC UINTN NumberOfInitrdSegments;
+STATIC UINTN InitrdSize;
+STATIC EFI_HANDLE InitrdHandle;
+
+STATIC EFI_STATUS EFIAPI
+InitrdLoadFile(IN EFI_LOAD_FILE2_PROTOCOL *This,
+	       IN EFI_DEVICE_PATH_PROTOCOL *FilePath,
+	       IN BOOLEAN BootPolicy, IN OUT UINTN *BufferSize,
+	       IN VOID *Buffer OPTIONAL)
+{
+	if (!This || !FilePath || !BufferSize)
+		return EFI_INVALID_PARAMETER;
+
+	/* LoadFile2 doesn't support the boot policy */
+	if (BootPolicy == TRUE)
+		return EFI_UNSUPPORTED;
+
+	if (!InitrdSize)
+		return EFI_NOT_FOUND;
+
+	if (!Buffer || *BufferSize < InitrdSize) {
+		*BufferSize = InitrdSize;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	/*
+	 * Copy the verified initrds to the buffer allocated by the kernel
+	 * one by one, zero-padded in between. No combined buffer is ever
+	 * built.
+	 */
+	UINTN Offset = 0;
+
+	for (UINTN Index = 0; Index < NumberOfInitrdSegments; ++Index) {
+		INITRD_SEGMENT *Segment = InitrdSegments + Index;
+		UINTN Padding;
+
+		Padding = ALIGN_VALUE(Offset, INITRD_SEGMENT_ALIGNMENT) -
+			  Offset;
+		MemSet((UINT8 *)Buffer + Offset, 0, Padding);
+		Offset += Padding;
+
+		MemCpy((UINT8 *)Buffer + Offset, Segment->Data,
+		       Segment->DataSize);
+		Offset += Segment->DataSize;
+	}
+
+	*BufferSize = InitrdSize;
+
+	EfiConsolePrintDebug(L"%d bytes of initrd loaded\n", InitrdSize);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_LOAD_FILE2_PROTOCOL InitrdLoadFile2Protocol = {
+	InitrdLoadFile
+};
+
+EFI_STATUS
+EfiInitrdAdd(VOID *Data, UINTN DataSize)
+{
+	if (!Data || !DataSize)
+		return EFI_INVALID_PARAMETER;
+
+	if (NumberOfInitrdSegments == MAX_INITRD_SEGMENTS) {
+		EfiConsolePrintError(L"Too many initrds\n");
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	INITRD_SEGMENT *Segment = InitrdSegments + NumberOfInitrdSegments++;
+
+	Segment->Data = Data;
+	Segment->DataSize = DataSize;
+	Segment->Allocated = FALSE;
+
+	/* The padding of the previous initrd is counted in */
+	InitrdSize = ALIGN_VALUE(InitrdSize, INITRD_SEGMENT_ALIGNMENT) +
+		     DataSize;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiInitrdLoad(CONST CHAR16 *Path)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	VOID *Data = NULL;
+	UINTN DataSize = 0;
+	EFI_STATUS Status;
+
+	/* The initrd is verified if Secure Boot is enabled */
+	Status = EfiFileLoad(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to load the initrd %s "
+				     L"(err: 0x%x)\n", Path, Status);
+		return Status;
+	}
+
+	Status = EfiInitrdAdd(Data, DataSize);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(Data);
+		return Status;
+	}
+
+	InitrdSegments[NumberOfInitrdSegments - 1].Allocated = TRUE;
+
+	EfiConsolePrintDebug(L"The initrd %s (%d-byte) added\n", Path,
+			     DataSize);
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiInitrdInstall(VOID)
+{
+	if (!InitrdSize)
+		return EFI_NOT_FOUND;
+
+	if (InitrdHandle)
+		return EFI_ALREADY_STARTED;
+
+	EFI_DEVICE_PATH_PROTOCOL *DevicePath;
+	EFI_HANDLE Handle;
+	EFI_STATUS Status;
+
+	/* Someone else, e.g, BIOS, already provides the initrd */
+	DevicePath = (EFI_DEVICE_PATH_PROTOCOL *)&InitrdDevicePath;
+	Status = gBS->LocateDevicePath(&LoadFile2ProtocolGuid, &DevicePath,
+				       &Handle);
+	if (!EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"The initrd media device path is "
+				     L"already installed\n");
+		return EFI_ALREADY_STARTED;
+	}
+
+	Status = gBS->InstallMultipleProtocolInterfaces(&InitrdHandle,
+							&gEfiDevicePathProtocolGuid,
+							&InitrdDevicePath,
+							&LoadFile2ProtocolGuid,
+							&InitrdLoadFile2Protocol,
+							NULL);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to install the initrd media "
+				     L"device path (err: 0x%x)\n", Status);
+		InitrdHandle = NULL;
+		return Status;
+	}
+
+	return EFI_SUCCESS;
+}
+
+VOID
+EfiInitrdUninstall(VOID)
+{
+	if (InitrdHandle) {
+		gBS->UninstallMultipleProtocolInterfaces(InitrdHandle,
+							 &gEfiDevicePathProtocolGuid,
+							 &InitrdDevicePath,
+							 &LoadFile2ProtocolGuid,
+							 &InitrdLoadFile2Protocol,
+							 NULL);
+		InitrdHandle = NULL;
+	}
+
+	for (UINTN Index = 0; Index < NumberOfInitrdSegments; ++Index) {
+		INITRD_SEGMENT *Segment = InitrdSegments + Index;
+
+		if (Segment->Allocated == TRUE)
+			EfiMemoryFree(Segment->Data);
+	}
+
+	NumberOfInitrdSegments = 0;
+	InitrdSize = 0;
+}
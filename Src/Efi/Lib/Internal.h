@@ -34,6 +34,21 @@
 #ifndef __LIB_INTERNAL_H__
 #define __LIB_INTERNAL_H__
 
+#include <SELoader.h>
+#include <SelStatistics.h>
+
+typedef enum {
+	InitObjectPkcs7,
+	InitObjectHashService,
+	InitObjectMax
+} INIT_OBJECT;
+
+EFI_STATUS
+InitStateRun(INIT_OBJECT Object, EFI_STATUS (*Initialize)(VOID));
+
+BOOLEAN
+InitStateReady(INIT_OBJECT Object);
+
 EFI_STATUS
 UefiSecureBootDeployedMode(UINT8 *DeployedMode);
 
@@ -54,6 +69,10 @@ EFI_STATUS
 Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
 			     VOID *Signature, UINTN SignatureSize);
 
+EFI_STATUS
+Pkcs7SignerCertificate(CONST VOID *Signature, UINTN SignatureSize,
+		       CONST UINT8 **Certificate, UINTN *CertificateSize);
+
 EFI_STATUS
 MokSecureBootState(UINT8 *MokSBState);
 
@@ -77,7 +96,157 @@ SapHook(VOID);
 EFI_STATUS
 Sap2Hook(VOID);
 
+VOID
+Sap2TrustedImageSet(CONST VOID *ImageBuffer, UINTN ImageBufferSize);
+
+BOOLEAN
+Sap2Hooked(VOID);
+
+EFI_STATUS
+Sap2VerifyImage(CONST EFI_DEVICE_PATH *DevicePath, VOID *ImageBuffer,
+		UINTN ImageBufferSize);
+
+#ifdef EMBEDDED_DRIVER_BUILD
+EFI_STATUS
+EmbeddedDriverLocate(CONST CHAR16 *Name, VOID **ImageBuffer,
+		     UINTN *ImageBufferSize);
+#endif
+
 VOID
 SecurityPolicyInitialize(VOID);
 
+VOID
+ProfileInitialize(VOID);
+
+UINT64
+ProfileStart(VOID);
+
+VOID
+ProfileStop(SEL_PROFILE_PHASE Phase, UINT64 Start);
+
+VOID
+ProfileStopFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, UINTN Size,
+		UINT64 Start);
+
+UINT64
+ProfileElapsedMicroseconds(UINT64 Start);
+
+UINT64
+ProfileLaunchElapsedMicroseconds(VOID);
+
+VOID
+ProfileMark(CONST CHAR16 *Event, CONST CHAR16 *Path);
+
+VOID
+ProfilePhaseQuery(SEL_PROFILE_PHASE Phase, UINT64 *Count,
+		  UINT64 *Microseconds);
+
+EFI_STATUS
+StatisticsInitialize(VOID);
+
+VOID
+StatisticsPublish(VOID);
+
+VOID
+StatisticsFileVerified(EFI_STATUS Status, UINT64 Start);
+
+VOID
+StatisticsHashed(UINTN Size);
+
+VOID
+StatisticsCacheHit(VOID);
+
+VOID
+StatisticsHashProviderSet(SEL_PROVIDER Provider);
+
+VOID
+StatisticsPkcs7ProviderSet(SEL_PROVIDER Provider);
+
+#define VERIFY_CACHE_DIGEST_SIZE	32
+
+typedef struct {
+	BOOLEAN Valid;
+	UINT8 Tag[VERIFY_CACHE_DIGEST_SIZE];
+} VERIFY_CACHE_TAG;
+
+BOOLEAN
+VerifyCacheEnabled(VOID);
+
+EFI_STATUS
+VerifyCacheLookup(CONST CHAR16 *Path, CONST VOID *Signature,
+		  UINTN SignatureSize, VERIFY_CACHE_TAG *Tag,
+		  EFI_GUID **HashAlgorithm, UINT8 **Hash, UINTN *HashSize);
+
+VOID
+VerifyCacheAdd(CONST VERIFY_CACHE_TAG *Tag, CONST EFI_GUID *HashAlgorithm,
+	       CONST UINT8 *Hash, UINTN HashSize);
+
+VOID
+VerifyCacheFlush(VOID);
+
+BOOLEAN
+MeasureEnabled(VOID);
+
+VOID
+MeasureSuspend(VOID);
+
+VOID
+MeasureResume(VOID);
+
+VOID
+MeasureFile(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize);
+
+#define VERIFIED_SIGNER_HASH_SIZE	32
+
+typedef struct {
+	BOOLEAN Valid;
+	UINT8 Hash[VERIFIED_SIGNER_HASH_SIZE];
+} VERIFIED_SIGNER;
+
+BOOLEAN
+VerifiedTableEnabled(VOID);
+
+VOID
+VerifiedTableSigner(CONST VOID *Signature, UINTN SignatureSize,
+		    VERIFIED_SIGNER *Signer);
+
+VOID
+VerifiedTableAdd(CONST CHAR16 *Path, UINTN DataSize,
+		 CONST EFI_GUID *HashAlgorithm, CONST UINT8 *Hash,
+		 UINTN HashSize, CONST VERIFIED_SIGNER *Signer,
+		 UINT64 ProfileTimestamp);
+
+EFI_STATUS
+FileLoadSigned(CONST CHAR16 *Path, VERIFY_CACHE_TAG *Tag,
+	       VERIFIED_SIGNER *Signer, EFI_GUID **HashAlgorithm,
+	       UINT8 **Hash, UINTN *HashSize, VOID **Data, UINTN *DataSize);
+
+VOID
+FileVerifyAbort(EFI_FILE_VERIFY_CONTEXT *Context);
+
+BOOLEAN
+PreverifiedFileTake(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize);
+
+BOOLEAN
+PreverifiedFileMatch(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize);
+
+EFI_STATUS
+ImageExecuteTrusted(CONST CHAR16 *Path, VOID *ImageBuffer,
+		    UINTN ImageBufferSize, CONST CHAR16 *LoadOptions);
+
+EFI_STATUS
+ImageVerify(CONST CHAR16 *Path, VOID *ImageBuffer, UINTN ImageBufferSize);
+
+BOOLEAN
+Sha2Accelerated(VOID);
+
+EFI_HASH2_PROTOCOL *
+Sha2ProtocolGet(VOID);
+
+EFI_STATUS
+Sha2ProtocolCreate(EFI_HASH2_PROTOCOL **Protocol);
+
+VOID
+Sha2ProtocolDestroy(EFI_HASH2_PROTOCOL *Protocol);
+
 #endif	/* __LIB_INTERNAL_H__ */
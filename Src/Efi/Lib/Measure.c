@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+
+#include "Internal.h"
+
+/*
+ * Measure the files verified by EfiFileLoad() into the TPM with
+ * HashLogExtendEvent() of EFI TCG2 Protocol, as grub measures the files
+ * it loads into PCR 9. The firmware hashes the content for every active
+ * bank, extends the PCR and logs the event, so the event digests are the
+ * ones of the file content and the firmware event log replays as usual.
+ *
+ * The digest computed for the signature is not reused, and each file is
+ * extended on its own as the protocol takes a single event per call.
+ */
+
+#ifndef EV_IPL
+#  define EV_IPL			((TCG_EVENTTYPE)0x0000000D)
+#endif
+
+#define MAX_MEASURE_PCR_INDEX		23
+
+EFI_GUID gEfiTcg2ProtocolGuid = EFI_TCG2_PROTOCOL_GUID;
+
+STATIC EFI_TCG2_PROTOCOL *Tcg2Protocol;
+STATIC UINT32 MeasurePcrIndex;
+STATIC UINTN MeasureSuspended;
+
+/* The event data is the absolute path in ASCII */
+STATIC EFI_STATUS
+CreateEventData(CONST CHAR16 *Path, CHAR8 **EventData,
+		UINT32 *EventDataSize)
+{
+	CHAR16 *FilePath;
+	EFI_STATUS Status;
+
+	Status = EfiDevicePathCreate(Path, &FilePath);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINTN Length = StrLen(FilePath);
+
+	Status = EfiMemoryAllocate(Length + 1, (VOID **)EventData);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(FilePath);
+		return Status;
+	}
+
+	for (UINTN Index = 0; Index <= Length; ++Index) {
+		CHAR16 Char = FilePath[Index];
+
+		if (Char == L'/')
+			Char = L'\\';
+		else if (Char > 0x7f)
+			Char = L'?';
+
+		(*EventData)[Index] = (CHAR8)Char;
+	}
+
+	*EventDataSize = (UINT32)(Length + 1);
+	EfiMemoryFree(FilePath);
+
+	return EFI_SUCCESS;
+}
+
+/* Let the firmware hash, extend and log the file */
+STATIC EFI_STATUS
+HashLogExtend(CONST VOID *Data, UINTN DataSize, CONST CHAR8 *EventData,
+	      UINT32 EventDataSize)
+{
+	EFI_TCG2_EVENT *Event;
+	UINT32 EventSize = OFFSET_OF(EFI_TCG2_EVENT, Event) + EventDataSize;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(EventSize, (VOID **)&Event);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Event->Size = EventSize;
+	Event->Header.HeaderSize = sizeof(Event->Header);
+	Event->Header.HeaderVersion = EFI_TCG2_EVENT_HEADER_VERSION;
+	Event->Header.PCRIndex = MeasurePcrIndex;
+	Event->Header.EventType = EV_IPL;
+	MemCpy(Event->Event, EventData, EventDataSize);
+
+	Status = Tcg2Protocol->HashLogExtendEvent(Tcg2Protocol, 0,
+						  (EFI_PHYSICAL_ADDRESS)
+						  (UINTN)Data, DataSize,
+						  Event);
+	EfiMemoryFree(Event);
+
+	return Status;
+}
+
+BOOLEAN
+MeasureEnabled(VOID)
+{
+	return Tcg2Protocol && !MeasureSuspended;
+}
+
+/*
+ * The files loaded speculatively, e.g, by the pre-verification, are not
+ * measured until requested.
+ */
+VOID
+MeasureSuspend(VOID)
+{
+	++MeasureSuspended;
+}
+
+VOID
+MeasureResume(VOID)
+{
+	if (MeasureSuspended)
+		--MeasureSuspended;
+}
+
+/*
+ * Measure the verified content of Path. A failure is reported but doesn't
+ * fail the loading.
+ */
+VOID
+MeasureFile(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize)
+{
+	if (MeasureEnabled() == FALSE)
+		return;
+
+	CHAR8 *EventData;
+	UINT32 EventDataSize;
+	EFI_STATUS Status;
+
+	Status = CreateEventData(Path, &EventData, &EventDataSize);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	Status = HashLogExtend(Data, DataSize, EventData, EventDataSize);
+	EfiMemoryFree(EventData);
+	if (!EFI_ERROR(Status))
+		EfiConsolePrintDebug(L"Measured the file %s into PCR %d\n",
+				     Path, MeasurePcrIndex);
+
+out:
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to measure the file %s "
+				     L"(err: 0x%x)\n", Path, Status);
+}
+
+EFI_STATUS
+EfiMeasureEnable(UINT32 PcrIndex)
+{
+	if (PcrIndex > MAX_MEASURE_PCR_INDEX)
+		return EFI_INVALID_PARAMETER;
+
+	if (Tcg2Protocol) {
+		MeasurePcrIndex = PcrIndex;
+		return EFI_SUCCESS;
+	}
+
+	EFI_TCG2_PROTOCOL *Tcg2;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&gEfiTcg2ProtocolGuid, (VOID **)&Tcg2);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to open EFI TCG2 Protocol "
+				     L"(err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	EFI_TCG2_BOOT_SERVICE_CAPABILITY Capability;
+
+	Capability.Size = sizeof(Capability);
+	Status = Tcg2->GetCapability(Tcg2, &Capability);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to get the TPM capability "
+				     L"(err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	if (Capability.TPMPresentFlag == FALSE) {
+		EfiConsolePrintError(L"TPM not present\n");
+		return EFI_NOT_FOUND;
+	}
+
+	Tcg2Protocol = Tcg2;
+	MeasurePcrIndex = PcrIndex;
+
+	EfiConsolePrintDebug(L"Measuring the verified files into PCR %d "
+			     L"(banks: 0x%x)\n", PcrIndex,
+			     Capability.ActivePcrBanks);
+
+	return EFI_SUCCESS;
+}
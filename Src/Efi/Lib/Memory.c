@@ -33,15 +33,406 @@
 
 #include <Efi.h>
 #include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/*
+ * The arena serves the transient allocations, e.g, the path strings and
+ * hash outputs, during a scope such as verifying a file. They are
+ * bump-allocated from the page-backed chunks and released in bulk when
+ * leaving the scope. EfiMemoryFree() ignores them.
+ */
+#define ARENA_CHUNK_SIZE		(64 * 1024)
+#define ARENA_ALIGNMENT			sizeof(UINT64)
+#define MAX_ARENA_DEPTH			8
+
+/* The larger allocations get their own pages */
+#define LARGE_ALLOCATION_SIZE		(16 * 1024)
+#define PAGE_TABLE_CAPACITY		64
+
+typedef struct _ARENA_CHUNK {
+	struct _ARENA_CHUNK *Next;
+	UINTN Size;
+	UINTN Used;
+} ARENA_CHUNK;
+
+typedef struct {
+	ARENA_CHUNK *Chunk;
+	UINTN Used;
+} ARENA_MARK;
+
+typedef struct {
+	EFI_PHYSICAL_ADDRESS Address;
+	UINTN Pages;
+	/* The arena depth owning the pages */
+	UINTN Depth;
+} PAGE_ALLOCATION;
+
+/* The table grows on demand and never shrinks */
+typedef struct {
+	PAGE_ALLOCATION *Allocations;
+	UINTN NumberOfAllocations;
+	UINTN Capacity;
+} PAGE_TABLE;
+
+STATIC ARENA_CHUNK *ArenaChunks;
+STATIC ARENA_MARK ArenaMarks[MAX_ARENA_DEPTH];
+STATIC UINTN ArenaDepth;
+STATIC UINTN ArenaSuspended;
+/* The pages released when leaving the arena scope owning them */
+STATIC PAGE_TABLE ArenaPages;
+/* The pages out of arena, e.g, escaped, released by EfiMemoryFree() */
+STATIC PAGE_TABLE PageAllocations;
+
+STATIC BOOLEAN
+ArenaActive(VOID)
+{
+	return ArenaDepth && !ArenaSuspended;
+}
+
+STATIC ARENA_CHUNK *
+ArenaChunkLookup(CONST VOID *Buffer)
+{
+	for (ARENA_CHUNK *Chunk = ArenaChunks; Chunk; Chunk = Chunk->Next) {
+		if ((UINT8 *)Buffer > (UINT8 *)Chunk &&
+		    (UINT8 *)Buffer < (UINT8 *)Chunk + Chunk->Size)
+			return Chunk;
+	}
+
+	return NULL;
+}
+
+STATIC PAGE_ALLOCATION *
+PageTableLookup(PAGE_TABLE *Table, CONST VOID *Buffer)
+{
+	for (UINTN Index = 0; Index < Table->NumberOfAllocations; ++Index) {
+		PAGE_ALLOCATION *Allocation = Table->Allocations + Index;
+
+		if (Allocation->Address == (EFI_PHYSICAL_ADDRESS)(UINTN)Buffer)
+			return Allocation;
+	}
+
+	return NULL;
+}
+
+/*
+ * Make room for one more allocation, so adding it afterwards never
+ * fails. The table is not allocated in the arena.
+ */
+STATIC EFI_STATUS
+PageTableReserve(PAGE_TABLE *Table)
+{
+	if (Table->NumberOfAllocations < Table->Capacity)
+		return EFI_SUCCESS;
+
+	UINTN Capacity = Table->Capacity ? Table->Capacity * 2 :
+					   PAGE_TABLE_CAPACITY;
+	PAGE_ALLOCATION *Allocations;
+	EFI_STATUS Status;
+
+	Status = gBS->AllocatePool(EfiLoaderData,
+				   Capacity * sizeof(*Allocations),
+				   (VOID **)&Allocations);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	if (Table->Allocations) {
+		MemCpy(Allocations, Table->Allocations,
+		       Table->NumberOfAllocations * sizeof(*Allocations));
+		gBS->FreePool(Table->Allocations);
+	}
+
+	Table->Allocations = Allocations;
+	Table->Capacity = Capacity;
+
+	return EFI_SUCCESS;
+}
+
+STATIC VOID
+PageTableAdd(PAGE_TABLE *Table, CONST PAGE_ALLOCATION *Allocation)
+{
+	Table->Allocations[Table->NumberOfAllocations++] = *Allocation;
+}
+
+/* The last allocation takes the place of the removed one */
+STATIC VOID
+PageTableRemove(PAGE_TABLE *Table, PAGE_ALLOCATION *Allocation)
+{
+	*Allocation = Table->Allocations[--Table->NumberOfAllocations];
+}
+
+/*
+ * The alignment larger than a page is satisfied by over-allocating the
+ * pages and then trimming the unaligned head and the unused tail.
+ */
+STATIC EFI_STATUS
+AllocateAlignedPages(UINTN Pages, UINTN Alignment,
+		     EFI_PHYSICAL_ADDRESS *Address)
+{
+	if (Alignment <= EFI_PAGE_SIZE)
+		return gBS->AllocatePages(AllocateAnyPages, EfiLoaderData,
+					  Pages, Address);
+
+	UINTN AlignmentPages = EFI_SIZE_TO_PAGES(Alignment);
+	EFI_PHYSICAL_ADDRESS Allocated;
+	EFI_STATUS Status;
+
+	Status = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData,
+				    Pages + AlignmentPages, &Allocated);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	EFI_PHYSICAL_ADDRESS Aligned = ALIGN_VALUE(Allocated, Alignment);
+	UINTN HeadPages = EFI_SIZE_TO_PAGES((UINTN)(Aligned - Allocated));
+	UINTN TailPages = AlignmentPages - HeadPages;
+
+	if (HeadPages)
+		gBS->FreePages(Allocated, HeadPages);
+
+	if (TailPages)
+		gBS->FreePages(Aligned + EFI_PAGES_TO_SIZE(Pages), TailPages);
+
+	*Address = Aligned;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * The pages are owned by the arena scope at Depth, or out of arena if
+ * Depth is 0. The pool is never used instead, which would lose the
+ * alignment and the ownership of the arena.
+ */
+STATIC EFI_STATUS
+AllocatePages(UINTN Size, UINTN Alignment, EFI_PHYSICAL_ADDRESS Address,
+	      UINTN Depth, VOID **AllocatedBuffer)
+{
+	PAGE_TABLE *Table = Depth ? &ArenaPages : &PageAllocations;
+	EFI_STATUS Status;
+
+	Status = PageTableReserve(Table);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to track the page allocation "
+				     L"(%d-byte)\n", Size);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	PAGE_ALLOCATION Allocation;
+
+	Allocation.Pages = EFI_SIZE_TO_PAGES(Size);
+	Allocation.Depth = Depth;
+
+	if (Address)
+		Status = gBS->AllocatePages(AllocateAddress, EfiLoaderData,
+					    Allocation.Pages, &Address);
+	else
+		Status = AllocateAlignedPages(Allocation.Pages, Alignment,
+					      &Address);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Allocation.Address = Address;
+	PageTableAdd(Table, &Allocation);
+
+	*AllocatedBuffer = (VOID *)(UINTN)Address;
+
+	return EFI_SUCCESS;
+}
+
+STATIC VOID
+FreePages(PAGE_TABLE *Table, PAGE_ALLOCATION *Allocation)
+{
+	gBS->FreePages(Allocation->Address, Allocation->Pages);
+	PageTableRemove(Table, Allocation);
+}
+
+STATIC EFI_STATUS
+ArenaAllocate(UINTN Size, VOID **AllocatedBuffer)
+{
+	if (Size > LARGE_ALLOCATION_SIZE)
+		return AllocatePages(Size, EFI_PAGE_SIZE, 0, ArenaDepth,
+				     AllocatedBuffer);
+
+	Size = ALIGN_VALUE(Size, ARENA_ALIGNMENT);
+
+	ARENA_CHUNK *Chunk = ArenaChunks;
+
+	if (!Chunk || Chunk->Size - Chunk->Used < Size) {
+		EFI_PHYSICAL_ADDRESS Address;
+		EFI_STATUS Status;
+
+		Status = gBS->AllocatePages(AllocateAnyPages, EfiLoaderData,
+					    EFI_SIZE_TO_PAGES(ARENA_CHUNK_SIZE),
+					    &Address);
+		if (EFI_ERROR(Status))
+			return Status;
+
+		Chunk = (ARENA_CHUNK *)(UINTN)Address;
+		Chunk->Next = ArenaChunks;
+		Chunk->Size = ARENA_CHUNK_SIZE;
+		Chunk->Used = ALIGN_VALUE(sizeof(*Chunk), ARENA_ALIGNMENT);
+		ArenaChunks = Chunk;
+	}
+
+	*AllocatedBuffer = (UINT8 *)Chunk + Chunk->Used;
+	Chunk->Used += Size;
+
+	return EFI_SUCCESS;
+}
 
 EFI_STATUS
 EfiMemoryAllocate(IN UINTN Size, OUT VOID **AllocatedBuffer)
 {
+	if (ArenaActive() == TRUE)
+		return ArenaAllocate(Size, AllocatedBuffer);
+
 	return gBS->AllocatePool(EfiLoaderData, Size, AllocatedBuffer);
 }
 
+/*
+ * Allocate the pages aligned with Alignment, or at Address if not 0.
+ * The buffer is freed with EfiMemoryFree().
+ */
+EFI_STATUS
+EfiMemoryAllocatePages(IN UINTN Size, IN UINTN Alignment,
+		       IN EFI_PHYSICAL_ADDRESS Address,
+		       OUT VOID **AllocatedBuffer)
+{
+	if (!Size || !AllocatedBuffer)
+		return EFI_INVALID_PARAMETER;
+
+	if (Alignment & (Alignment - 1))
+		return EFI_INVALID_PARAMETER;
+
+	if (Address & EFI_PAGE_MASK)
+		return EFI_INVALID_PARAMETER;
+
+	return AllocatePages(Size, Alignment, Address,
+			     ArenaActive() == TRUE ? ArenaDepth : 0,
+			     AllocatedBuffer);
+}
+
 VOID
 EfiMemoryFree(VOID *Buffer)
 {
+	/* Released when leaving the arena scope */
+	if (ArenaChunkLookup(Buffer))
+		return;
+
+	PAGE_ALLOCATION *Allocation = PageTableLookup(&PageAllocations, Buffer);
+
+	if (Allocation) {
+		FreePages(&PageAllocations, Allocation);
+		return;
+	}
+
+	if (PageTableLookup(&ArenaPages, Buffer))
+		return;
+
 	gBS->FreePool(Buffer);
 }
+
+EFI_STATUS
+EfiMemoryArenaEnter(VOID)
+{
+	if (ArenaDepth == MAX_ARENA_DEPTH)
+		return EFI_OUT_OF_RESOURCES;
+
+	ArenaMarks[ArenaDepth].Chunk = ArenaChunks;
+	ArenaMarks[ArenaDepth].Used = ArenaChunks ? ArenaChunks->Used : 0;
+	++ArenaDepth;
+
+	return EFI_SUCCESS;
+}
+
+VOID
+EfiMemoryArenaLeave(VOID)
+{
+	if (!ArenaDepth)
+		return;
+
+	/* The removal moves the last allocation to the current index */
+	for (UINTN Index = ArenaPages.NumberOfAllocations; Index--;) {
+		PAGE_ALLOCATION *Allocation = ArenaPages.Allocations + Index;
+
+		if (Allocation->Depth == ArenaDepth)
+			FreePages(&ArenaPages, Allocation);
+	}
+
+	ARENA_MARK *Mark = ArenaMarks + --ArenaDepth;
+
+	if (!ArenaChunks)
+		return;
+
+	/* Keep the oldest chunk for reuse */
+	while (ArenaChunks != Mark->Chunk && ArenaChunks->Next) {
+		ARENA_CHUNK *Chunk = ArenaChunks;
+
+		ArenaChunks = Chunk->Next;
+		gBS->FreePages((EFI_PHYSICAL_ADDRESS)(UINTN)Chunk,
+			       EFI_SIZE_TO_PAGES(Chunk->Size));
+	}
+
+	if (ArenaChunks == Mark->Chunk)
+		ArenaChunks->Used = Mark->Used;
+	else
+		ArenaChunks->Used = ALIGN_VALUE(sizeof(*ArenaChunks),
+						ARENA_ALIGNMENT);
+}
+
+/*
+ * Allocate the memory out of the arena for the objects outliving the
+ * current scope, e.g, the cached states.
+ */
+VOID
+EfiMemoryArenaSuspend(VOID)
+{
+	++ArenaSuspended;
+}
+
+VOID
+EfiMemoryArenaResume(VOID)
+{
+	if (ArenaSuspended)
+		--ArenaSuspended;
+}
+
+/*
+ * Move the buffer allocated in the current scope out of the arena so it
+ * is still available after leaving the scope. The large buffer is not
+ * copied.
+ */
+EFI_STATUS
+EfiMemoryArenaEscape(VOID **Buffer, UINTN BufferSize)
+{
+	if (!Buffer || !*Buffer)
+		return EFI_INVALID_PARAMETER;
+
+	PAGE_ALLOCATION *Allocation = PageTableLookup(&ArenaPages, *Buffer);
+
+	if (Allocation) {
+		EFI_STATUS Status = PageTableReserve(&PageAllocations);
+
+		if (EFI_ERROR(Status))
+			return Status;
+
+		Allocation->Depth = 0;
+		PageTableAdd(&PageAllocations, Allocation);
+		PageTableRemove(&ArenaPages, Allocation);
+
+		return EFI_SUCCESS;
+	}
+
+	if (!ArenaChunkLookup(*Buffer))
+		return EFI_SUCCESS;
+
+	VOID *Escaped;
+	EFI_STATUS Status;
+
+	Status = gBS->AllocatePool(EfiLoaderData, BufferSize, &Escaped);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemCpy(Escaped, *Buffer, BufferSize);
+	*Buffer = Escaped;
+
+	return EFI_SUCCESS;
+}
@@ -33,6 +33,7 @@
 
 #include <Efi.h>
 #include <EfiLibrary.h>
+#include <BaseLibrary.h>
 #include <MokVerify.h>
 #include <Mok2Verify.h>
 
@@ -42,6 +43,32 @@ EFI_GUID gEfiMok2VerifyProtocolGuid = EFI_MOK2_VERIFY_PROTOCOL_GUID;
 
 STATIC EFI_HANDLE Mok2VerifyHandle;
 
+/*
+ * The calls touching the file and hash state don't nest, e.g, from a
+ * notification function. The TPL is not raised instead because they read
+ * the files.
+ */
+STATIC BOOLEAN Mok2VerifyBusy;
+
+STATIC BOOLEAN
+Mok2VerifyAcquire(VOID)
+{
+	if (Mok2VerifyBusy == TRUE) {
+		EfiConsolePrintDebug(L"MOK2 Verify Protocol is busy\n");
+		return FALSE;
+	}
+
+	Mok2VerifyBusy = TRUE;
+
+	return TRUE;
+}
+
+STATIC VOID
+Mok2VerifyRelease(VOID)
+{
+	Mok2VerifyBusy = FALSE;
+}
+
 STATIC EFI_STATUS EFIAPI
 Mok2VerifySignature(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN VOID *Signature,
 		    IN UINTN SignatureSize, IN VOID *Data, IN UINTN DataSize)
@@ -85,7 +112,21 @@ Mok2VerifyFileBuffer(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN OUT VOID **Data,
 	EfiConsoleTraceDebug(L"Attempting to verify file buffer %s by MOK2 "
 			     L"Verify Protocol ...\n", Path);
 
-	return EFI_UNSUPPORTED;
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
+	EFI_STATUS Status;
+
+	Status = EfiFileVerifyBuffer(Path, Data, DataSize);
+	Mok2VerifyRelease();
+	if (!EFI_ERROR(Status))
+		EfiConsoleTraceDebug(L"Succeeded to verify file buffer %s by "
+				     L"MOK2 Verify Protocol\n", Path);
+	else
+		EfiConsoleTraceDebug(L"Failed to verify file buffer %s by "
+				     L"MOK2 Verify Protocol\n", Path);
+
+	return Status;
 }
 
 STATIC EFI_STATUS EFIAPI
@@ -97,11 +138,17 @@ Mok2VerifyFile(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN CONST CHAR16 *Path)
 	EfiConsoleTraceDebug(L"Attempting to verify file %s by MOK2 Verify "
 			     L"Protocol ...\n", Path);
 
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
 	VOID *Data = NULL;
 	UINTN DataSize = 0;
 	EFI_STATUS Status;
 
 	Status = EfiFileLoad(Path, &Data, &DataSize);
+	if (!EFI_ERROR(Status))
+		EfiMemoryFree(Data);
+	Mok2VerifyRelease();
 	if (!EFI_ERROR(Status))
 		EfiConsoleTraceDebug(L"Succeeded to verify file %s by MOK2 "
 				     L"Verify Protocol\n", Path);
@@ -112,11 +159,205 @@ Mok2VerifyFile(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN CONST CHAR16 *Path)
 	return Status;
 }
 
+/*
+ * The caller reads the file in pieces, e.g, a large initrd, and passes
+ * each of them to VerifyUpdate() so the file is hashed while reading.
+ * VerifyFinal() must be called to release the context.
+ */
+STATIC EFI_STATUS EFIAPI
+Mok2VerifyBegin(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN CONST CHAR16 *Path,
+		OUT VOID **Context)
+{
+	if (!This || !Path || !Context)
+		return EFI_INVALID_PARAMETER;
+
+	EfiConsoleTraceDebug(L"Attempting to verify file stream %s by MOK2 "
+			     L"Verify Protocol ...\n", Path);
+
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
+	EFI_STATUS Status;
+
+	Status = EfiFileVerifyBegin(Path, (EFI_FILE_VERIFY_CONTEXT **)Context);
+	Mok2VerifyRelease();
+
+	return Status;
+}
+
+STATIC EFI_STATUS EFIAPI
+Mok2VerifyUpdate(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN VOID *Context,
+		 IN CONST VOID *Data, IN UINTN DataSize)
+{
+	if (!This || !Context)
+		return EFI_INVALID_PARAMETER;
+
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
+	EFI_STATUS Status;
+
+	Status = EfiFileVerifyUpdate(Context, Data, DataSize);
+	Mok2VerifyRelease();
+
+	return Status;
+}
+
+STATIC EFI_STATUS EFIAPI
+Mok2VerifyFinal(IN EFI_MOK2_VERIFY_PROTOCOL *This, IN VOID *Context)
+{
+	if (!This || !Context)
+		return EFI_INVALID_PARAMETER;
+
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
+	EFI_STATUS Status;
+
+	Status = EfiFileVerifyFinal(Context);
+	Mok2VerifyRelease();
+	if (!EFI_ERROR(Status))
+		EfiConsoleTraceDebug(L"Succeeded to verify file stream by "
+				     L"MOK2 Verify Protocol\n");
+	else
+		EfiConsoleTraceDebug(L"Failed to verify file stream by MOK2 "
+				     L"Verify Protocol\n");
+
+	return Status;
+}
+
+/*
+ * VerifyBatch() is a synchronous convenience wrapper and nothing is
+ * overlapped. The signature files of the items with the data supplied are
+ * loaded first, and if any of them fails, the batch is aborted before any
+ * content is hashed or read. The items are then verified one by one in
+ * order, i.e, the supplied data is hashed, and the rest are loaded and
+ * verified as VerifyFile() does.
+ */
+STATIC VOID
+RunBatch(EFI_MOK2_VERIFY_ITEM *Items, UINTN NumberOfItems,
+	 EFI_FILE_VERIFY_CONTEXT **Contexts)
+{
+	BOOLEAN Aborted = FALSE;
+
+	for (UINTN Index = 0; Index < NumberOfItems; ++Index) {
+		if (!Items[Index].Data)
+			continue;
+
+		Items[Index].Status = EfiFileVerifyBegin(Items[Index].Path,
+							 Contexts + Index);
+		if (EFI_ERROR(Items[Index].Status)) {
+			Contexts[Index] = NULL;
+			Aborted = TRUE;
+		}
+	}
+
+	for (UINTN Index = 0; Index < NumberOfItems; ++Index) {
+		EFI_MOK2_VERIFY_ITEM *Item = Items + Index;
+
+		if (Aborted == TRUE) {
+			/* The context is always released by the final */
+			if (Contexts[Index]) {
+				FileVerifyAbort(Contexts[Index]);
+				EfiFileVerifyFinal(Contexts[Index]);
+			}
+
+			if (!Item->Data || Contexts[Index])
+				Item->Status = EFI_ABORTED;
+		} else if (!Item->Data) {
+			VOID *Data = NULL;
+			UINTN DataSize = 0;
+
+			Item->Status = EfiFileLoad(Item->Path, &Data,
+						   &DataSize);
+			if (!EFI_ERROR(Item->Status))
+				EfiMemoryFree(Data);
+		} else {
+			EFI_STATUS Status;
+
+			Item->Status = EfiFileVerifyUpdate(Contexts[Index],
+							   Item->Data,
+							   Item->DataSize);
+			Status = EfiFileVerifyFinal(Contexts[Index]);
+			if (!EFI_ERROR(Item->Status))
+				Item->Status = Status;
+		}
+
+		if (!EFI_ERROR(Item->Status))
+			EfiConsoleTraceDebug(L"Succeeded to verify the batch "
+					     L"item %s\n", Item->Path);
+		else
+			EfiConsoleTraceDebug(L"Failed to verify the batch "
+					     L"item %s (err: 0x%x)\n",
+					     Item->Path, Item->Status);
+	}
+}
+
+/*
+ * Verify a set of files, e.g, the kernel, initrd and modules, at once.
+ * All the items are verified on return, and Event, if passed, is signalled
+ * before returning.
+ */
+STATIC EFI_STATUS EFIAPI
+Mok2VerifyBatch(IN EFI_MOK2_VERIFY_PROTOCOL *This,
+		IN OUT EFI_MOK2_VERIFY_ITEM *Items, IN UINTN NumberOfItems,
+		IN EFI_EVENT Event OPTIONAL)
+{
+	if (!This || !Items || !NumberOfItems)
+		return EFI_INVALID_PARAMETER;
+
+	for (UINTN Index = 0; Index < NumberOfItems; ++Index) {
+		if (!Items[Index].Path ||
+		    (Items[Index].Data && !Items[Index].DataSize))
+			return EFI_INVALID_PARAMETER;
+
+		Items[Index].Status = EFI_NOT_READY;
+	}
+
+	EfiConsoleTraceDebug(L"Attempting to verify %d files in batch by "
+			     L"MOK2 Verify Protocol ...\n", NumberOfItems);
+
+	if (Mok2VerifyAcquire() == FALSE)
+		return EFI_ALREADY_STARTED;
+
+	EFI_FILE_VERIFY_CONTEXT **Contexts;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(NumberOfItems * sizeof(*Contexts),
+				   (VOID **)&Contexts);
+	if (EFI_ERROR(Status)) {
+		Mok2VerifyRelease();
+		return Status;
+	}
+
+	MemSet(Contexts, 0, NumberOfItems * sizeof(*Contexts));
+	RunBatch(Items, NumberOfItems, Contexts);
+	EfiMemoryFree(Contexts);
+	Mok2VerifyRelease();
+
+	Status = EFI_SUCCESS;
+	for (UINTN Index = 0; Index < NumberOfItems; ++Index) {
+		if (EFI_ERROR(Items[Index].Status)) {
+			Status = Items[Index].Status;
+			break;
+		}
+	}
+
+	if (Event)
+		gBS->SignalEvent(Event);
+
+	return Status;
+}
+
 STATIC EFI_MOK2_VERIFY_PROTOCOL Mok2VerifyProtocol = {
-	1,
+	EFI_MOK2_VERIFY_PROTOCOL_REVISION,
 	Mok2VerifySignature,
 	Mok2VerifyFileBuffer,
-	Mok2VerifyFile
+	Mok2VerifyFile,
+	Mok2VerifyBegin,
+	Mok2VerifyUpdate,
+	Mok2VerifyFinal,
+	Mok2VerifyBatch
 };
 
 EFI_STATUS
@@ -135,5 +376,8 @@ Mok2VerifyInitialize(VOID)
 
 	EfiConsoleTraceDebug(L"MOK2 Verify Protocol installed\n");
 
+	/* The statistics are optional */
+	StatisticsInitialize();
+
         return EFI_SUCCESS;
 }
@@ -35,9 +35,10 @@
 #include <EfiLibrary.h>
 #include <BaseLibrary.h>
 
+#include "Internal.h"
+
 EFI_GUID gEfiPkcs7VerifyProtocolGuid = EFI_PKCS7_VERIFY_PROTOCOL_GUID;
 
-STATIC BOOLEAN Pkcs7Initialized = FALSE;
 STATIC EFI_PKCS7_VERIFY_PROTOCOL *Pkcs7VerifyProtocol;
 STATIC EFI_SIGNATURE_LIST **AllowedDb;
 STATIC EFI_SIGNATURE_LIST **RevokedDb;
@@ -108,6 +109,7 @@ InitializePkcs7(VOID)
 	if (!EFI_ERROR(Status)) {
 		EfiConsolePrintInfo(L"PKCS#7 Verify Protocol installed "
 				    L"by BIOS\n");
+		StatisticsPkcs7ProviderSet(SelProviderFirmware);
 	} else {
 
 		EfiConsolePrintDebug(L"PKCS#7 Verify Protocol not supported by BIOS.\n"
@@ -128,6 +130,8 @@ InitializePkcs7(VOID)
 					     L"Protocol (err: 0x%x)\n", Status);
 			return Status;
 		}
+
+		StatisticsPkcs7ProviderSet(SelProviderDriver);
 	}
 
 	EFI_SIGNATURE_LIST *Db = NULL;
@@ -174,8 +178,6 @@ InitializePkcs7(VOID)
 		goto ErrorMergeRevokedDb;
 	}	
 
-	Pkcs7Initialized = TRUE;
-
 	EfiConsoleTraceInfo(L"PKCS#7 Verify Protocol loaded\n");
 
 	return EFI_SUCCESS;
@@ -207,11 +209,11 @@ Pkcs7VerifyDetachedSignature(VOID *Hash, UINTN HashSize,
 
 	EFI_STATUS Status;
 
-	if (Pkcs7Initialized == FALSE) {
-		Status = InitializePkcs7();
-		if (EFI_ERROR(Status))
-			return Status;
-	}
+	Status = InitStateRun(InitObjectPkcs7, InitializePkcs7);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINT64 ProfileTimestamp = ProfileStart();
 
 #ifdef EXPERIMENTAL_BUILD
 	/*
@@ -232,6 +234,8 @@ Pkcs7VerifyDetachedSignature(VOID *Hash, UINTN HashSize,
 			Hash, HashSize, AllowedDb, RevokedDb, TimeStampDb,
 			NULL, NULL);
 #endif
+
+	ProfileStop(SelProfilePhasePkcs7Verify, ProfileTimestamp);
 	if (!EFI_ERROR(Status))
 		EfiConsolePrintDebug(L"Succeeded to verify detached PKCS#7 "
 				     L"signature\n");
@@ -261,16 +265,15 @@ Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
 
 	EFI_STATUS Status;
 
-	if (Pkcs7Initialized == FALSE) {
-		Status = InitializePkcs7();
-		if (EFI_ERROR(Status))
-			return Status;
-	}
+	Status = InitStateRun(InitObjectPkcs7, InitializePkcs7);
+	if (EFI_ERROR(Status))
+		return Status;
 
 	EFI_PKCS7_VERIFY_BUFFER Verify = Pkcs7VerifyProtocol->VerifyBuffer;
 	UINT8 FixedContent[MIN_CONTENT_SIZE];
 	UINTN ExtractedContentSize = sizeof(FixedContent);
 	UINT8 *ExtractedContent = FixedContent;
+	UINT64 ProfileTimestamp = ProfileStart();
 
 	Status = Verify(Pkcs7VerifyProtocol, Signature, SignatureSize,
 			NULL, 0, AllowedDb, RevokedDb, TimeStampDb,
@@ -285,6 +288,9 @@ Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
 					ExtractedContent,
 					&ExtractedContentSize);
 		else {
+			ProfileStop(SelProfilePhasePkcs7Verify,
+				    ProfileTimestamp);
+
 			EfiConsolePrintError(L"Unable to retrieve the signed "
 					     L"content in PKCS#7 attached "
 					     L"signature\n");
@@ -292,6 +298,8 @@ Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
 		}
 	}
 
+	ProfileStop(SelProfilePhasePkcs7Verify, ProfileTimestamp);
+
 	if (EFI_ERROR(Status)) {
 		if (ExtractedContent != FixedContent)
 			EfiMemoryFree(ExtractedContent);
@@ -340,3 +348,200 @@ Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
 
 	return Status;
 }
+
+/* The tags of DER used in the PKCS#7 SignedData */
+#define DER_INTEGER			0x02
+#define DER_OBJECT_IDENTIFIER		0x06
+#define DER_SEQUENCE			0x30
+#define DER_SET				0x31
+#define DER_CONTEXT_0			0xa0
+#define DER_CONTEXT_1			0xa1
+
+typedef struct {
+	UINT8 Tag;
+	CONST UINT8 *Content;
+	UINTN ContentSize;
+	/* The whole element including the tag and length */
+	CONST UINT8 *Element;
+	UINTN ElementSize;
+} DER_ELEMENT;
+
+/* Only the definite length is supported, i.e, DER rather than BER */
+STATIC BOOLEAN
+DerNext(CONST UINT8 **Pointer, CONST UINT8 *End, DER_ELEMENT *Element)
+{
+	CONST UINT8 *Current = *Pointer;
+
+	if (End - Current < 2)
+		return FALSE;
+
+	Element->Element = Current;
+	Element->Tag = *Current++;
+
+	UINTN Length = *Current++;
+
+	if (Length & 0x80) {
+		UINTN LengthSize = Length & 0x7f;
+
+		if (!LengthSize || LengthSize > sizeof(UINT32) ||
+		    (UINTN)(End - Current) < LengthSize)
+			return FALSE;
+
+		for (Length = 0; LengthSize--; )
+			Length = (Length << 8) | *Current++;
+	}
+
+	if ((UINTN)(End - Current) < Length)
+		return FALSE;
+
+	Element->Content = Current;
+	Element->ContentSize = Length;
+	Element->ElementSize = Current + Length - Element->Element;
+	*Pointer = Current + Length;
+
+	return TRUE;
+}
+
+STATIC BOOLEAN
+DerExpect(CONST UINT8 **Pointer, CONST UINT8 *End, UINT8 Tag,
+	  DER_ELEMENT *Element)
+{
+	return DerNext(Pointer, End, Element) == TRUE && Element->Tag == Tag;
+}
+
+STATIC BOOLEAN
+DerEqual(CONST DER_ELEMENT *Element1, CONST DER_ELEMENT *Element2)
+{
+	return Element1->ElementSize == Element2->ElementSize &&
+	       !MemCmp(Element1->Element, Element2->Element,
+		       Element1->ElementSize);
+}
+
+/*
+ * Check whether the certificate is issued by Issuer with SerialNumber,
+ * i.e, the sid of SignerInfo.
+ */
+STATIC BOOLEAN
+CertificateMatch(CONST DER_ELEMENT *Certificate, CONST DER_ELEMENT *Issuer,
+		 CONST DER_ELEMENT *SerialNumber)
+{
+	CONST UINT8 *Pointer = Certificate->Content;
+	CONST UINT8 *End = Pointer + Certificate->ContentSize;
+	DER_ELEMENT TbsCertificate, Element;
+
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &TbsCertificate) == FALSE)
+		return FALSE;
+
+	Pointer = TbsCertificate.Content;
+	End = Pointer + TbsCertificate.ContentSize;
+
+	/* Skip the optional version */
+	if (DerNext(&Pointer, End, &Element) == FALSE)
+		return FALSE;
+
+	if (Element.Tag == DER_CONTEXT_0 &&
+	    DerNext(&Pointer, End, &Element) == FALSE)
+		return FALSE;
+
+	if (Element.Tag != DER_INTEGER ||
+	    DerEqual(&Element, SerialNumber) == FALSE)
+		return FALSE;
+
+	/* Skip the signature algorithm */
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &Element) == FALSE ||
+	    DerExpect(&Pointer, End, DER_SEQUENCE, &Element) == FALSE)
+		return FALSE;
+
+	return DerEqual(&Element, Issuer);
+}
+
+/*
+ * Locate the DER of the certificate of the first signer in the PKCS#7
+ * SignedData. Only the signer identified by the issuer and serial number
+ * is supported. The certificate is not verified here.
+ */
+EFI_STATUS
+Pkcs7SignerCertificate(CONST VOID *Signature, UINTN SignatureSize,
+		       CONST UINT8 **Certificate, UINTN *CertificateSize)
+{
+	if (!Signature || !SignatureSize || !Certificate || !CertificateSize)
+		return EFI_INVALID_PARAMETER;
+
+	CONST UINT8 *Pointer = Signature;
+	CONST UINT8 *End = Pointer + SignatureSize;
+	DER_ELEMENT ContentInfo, SignedData, Element;
+	DER_ELEMENT Certificates = { 0 };
+
+	/* ContentInfo of the content type and [0] SignedData */
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &ContentInfo) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	Pointer = ContentInfo.Content;
+	End = Pointer + ContentInfo.ContentSize;
+	if (DerExpect(&Pointer, End, DER_OBJECT_IDENTIFIER,
+		      &Element) == FALSE ||
+	    DerExpect(&Pointer, End, DER_CONTEXT_0, &Element) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	Pointer = Element.Content;
+	End = Pointer + Element.ContentSize;
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &SignedData) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	/* The version, digestAlgorithms and encapContentInfo */
+	Pointer = SignedData.Content;
+	End = Pointer + SignedData.ContentSize;
+	if (DerExpect(&Pointer, End, DER_INTEGER, &Element) == FALSE ||
+	    DerExpect(&Pointer, End, DER_SET, &Element) == FALSE ||
+	    DerExpect(&Pointer, End, DER_SEQUENCE, &Element) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	/* Followed by the optional [0] certificates and [1] crls */
+	do {
+		if (DerNext(&Pointer, End, &Element) == FALSE)
+			return EFI_UNSUPPORTED;
+
+		if (Element.Tag == DER_CONTEXT_0)
+			Certificates = Element;
+	} while (Element.Tag == DER_CONTEXT_0 ||
+		 Element.Tag == DER_CONTEXT_1);
+
+	if (Element.Tag != DER_SET || !Certificates.Content)
+		return EFI_NOT_FOUND;
+
+	/* The sid of the first SignerInfo */
+	DER_ELEMENT SignerInfo, Issuer, SerialNumber;
+
+	Pointer = Element.Content;
+	End = Pointer + Element.ContentSize;
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &SignerInfo) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	Pointer = SignerInfo.Content;
+	End = Pointer + SignerInfo.ContentSize;
+	if (DerExpect(&Pointer, End, DER_INTEGER, &Element) == FALSE ||
+	    DerExpect(&Pointer, End, DER_SEQUENCE, &Element) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	Pointer = Element.Content;
+	End = Pointer + Element.ContentSize;
+	if (DerExpect(&Pointer, End, DER_SEQUENCE, &Issuer) == FALSE ||
+	    DerExpect(&Pointer, End, DER_INTEGER, &SerialNumber) == FALSE)
+		return EFI_UNSUPPORTED;
+
+	Pointer = Certificates.Content;
+	End = Pointer + Certificates.ContentSize;
+	while (Pointer < End) {
+		if (DerExpect(&Pointer, End, DER_SEQUENCE, &Element) == FALSE)
+			return EFI_UNSUPPORTED;
+
+		if (CertificateMatch(&Element, &Issuer,
+				     &SerialNumber) == TRUE) {
+			*Certificate = Element.Element;
+			*CertificateSize = Element.ElementSize;
+			return EFI_SUCCESS;
+		}
+	}
+
+	return EFI_NOT_FOUND;
+}
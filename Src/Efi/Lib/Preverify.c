@@ -0,0 +1,951 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+#include "Internal.h"
+
+/*
+ * Speculatively verify the files the default entry of grub.cfg is going
+ * to ask for before chainloading grub. The verified content is cached and
+ * handed over to the first request for the same file through
+ * EfiFileLoad(), EfiFileVerifyBuffer() and EfiFileVerifyBegin(), i.e,
+ * MOK2 Verify Protocol.
+ *
+ * If EFI MP Services Protocol is available, the files signed with .p7b
+ * are only read and checked against the PKCS#7 signature here, and the
+ * content is hashed by the APs with the built-in SHA-2 engine while grub
+ * runs. The first request for such a file waits for its digest, or hashes
+ * it on BSP if no AP has picked it up yet.
+ */
+
+#define MAX_PREVERIFIED_FILES		32
+/* The total size of the cached content */
+#define MAX_PREVERIFIED_SIZE		(256 * 1024 * 1024)
+/* The nesting of source and configfile followed */
+#define MAX_PREVERIFY_DEPTH		4
+#define MAX_GRUB_ARGUMENTS		16
+
+#if defined(CONFIG_x86_64)
+#  define GRUB_PLATFORM			L"x86_64-efi"
+#elif defined(CONFIG_i386)
+#  define GRUB_PLATFORM			L"i386-efi"
+#else
+#  define GRUB_PLATFORM			L"arm64-efi"
+#endif
+
+/* The maximum pause instructions between the idle passes of an AP */
+#define MAX_AP_BACKOFF			1024
+
+typedef enum {
+	PreverifyJobNone,
+	PreverifyJobQueued,
+	PreverifyJobRunning,
+	PreverifyJobDone
+} PREVERIFY_JOB_STATE;
+
+typedef struct {
+	CHAR16 *Path;
+	VOID *Data;
+	UINTN DataSize;
+	/* The content is not verified yet unless PreverifyJobNone */
+	UINT32 JobState;
+	EFI_GUID *HashAlgorithm;
+	/* The digest attested by the signature */
+	UINT8 *Hash;
+	UINTN HashSize;
+	VERIFY_CACHE_TAG CacheTag;
+	VERIFIED_SIGNER Signer;
+	/* Written by the AP */
+	EFI_HASH2_OUTPUT Digest;
+	EFI_STATUS HashStatus;
+	UINT64 ProfileTimestamp;
+} PREVERIFIED_FILE;
+
+typedef struct {
+	/* The value of "set default=" */
+	CONST CHAR16 *DefaultEntry;
+	UINTN Depth;
+	UINTN NumberOfEntries;
+	/* The depth of the body of the default entry, or 0 if outside */
+	UINTN SelectedDepth;
+} GRUB_CONFIG_STATE;
+
+EFI_GUID gEfiMpServiceProtocolGuid = EFI_MP_SERVICES_PROTOCOL_GUID;
+
+STATIC PREVERIFIED_FILE PreverifiedFiles[MAX_PREVERIFIED_FILES];
+STATIC UINTN NumberOfPreverifiedFiles;
+STATIC UINTN PreverifiedSize;
+/* Set if the APs are hashing the queued files */
+STATIC BOOLEAN JobQueueEnabled;
+/* No more file is queued once set */
+STATIC BOOLEAN JobQueueSealed;
+/* The APs started but not yet returned from HashFiles() */
+STATIC UINTN NumberOfHashingAps;
+STATIC EFI_HASH2_PROTOCOL *Sha2Protocol;
+STATIC EFI_EVENT ApWaitEvent;
+STATIC EFI_EVENT ExitBootServicesEvent;
+
+STATIC CHAR16 *
+CreateFilePath(CONST CHAR16 *Path)
+{
+	CHAR16 *FilePath;
+	EFI_STATUS Status;
+
+	Status = EfiDevicePathCreate(Path, &FilePath);
+	if (EFI_ERROR(Status))
+		return NULL;
+
+	for (CHAR16 *Char = FilePath; *Char; ++Char) {
+		if (*Char == L'/')
+			*Char = L'\\';
+	}
+
+	return FilePath;
+}
+
+STATIC PREVERIFIED_FILE *
+LookupFile(CONST CHAR16 *Path)
+{
+	if (!NumberOfPreverifiedFiles)
+		return NULL;
+
+	CHAR16 *FilePath = CreateFilePath(Path);
+	if (!FilePath)
+		return NULL;
+
+	PREVERIFIED_FILE *File = NULL;
+
+	/* FAT is case-insensitive */
+	for (UINTN Index = 0; Index < MAX_PREVERIFIED_FILES; ++Index) {
+		if (PreverifiedFiles[Index].Path &&
+		    !StrCaseCmp(PreverifiedFiles[Index].Path, FilePath,
+				StrLen(FilePath) + 1)) {
+			File = PreverifiedFiles + Index;
+			break;
+		}
+	}
+
+	EfiMemoryFree(FilePath);
+
+	return File;
+}
+
+STATIC VOID
+RemoveFile(PREVERIFIED_FILE *File, BOOLEAN FreeData)
+{
+	if (FreeData == TRUE)
+		EfiMemoryFree(File->Data);
+	EfiMemoryFree(File->Path);
+	if (File->Hash)
+		EfiMemoryFree(File->Hash);
+
+	PreverifiedSize -= File->DataSize;
+	--NumberOfPreverifiedFiles;
+	MemSet(File, 0, sizeof(*File));
+}
+
+/* Let the sibling thread and the memory bus go while spinning */
+STATIC VOID
+CpuRelax(UINTN Count)
+{
+	for (UINTN Index = 0; Index < Count; ++Index) {
+#if defined(__x86_64__) || defined(__i386__)
+		__asm__ __volatile__ ("pause" ::: "memory");
+#elif defined(__aarch64__)
+		asm volatile("yield" ::: "memory");
+#endif
+	}
+}
+
+/*
+ * Run on an AP or BSP, whichever claims the job first. No boot service
+ * is allowed here. The built-in engine copies at most a block at a time
+ * so the vector unit which may be disabled on the APs is not used.
+ * Return TRUE if the job is claimed.
+ */
+STATIC BOOLEAN
+HashFile(PREVERIFIED_FILE *File)
+{
+	UINT32 State = PreverifyJobQueued;
+
+	/* Read first so the idle pass doesn't steal the cache line */
+	if (__atomic_load_n(&File->JobState, __ATOMIC_RELAXED) != State)
+		return FALSE;
+
+	if (!__atomic_compare_exchange_n(&File->JobState, &State,
+					 PreverifyJobRunning, FALSE,
+					 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return FALSE;
+
+	File->HashStatus = Sha2Protocol->Hash(Sha2Protocol,
+					      File->HashAlgorithm,
+					      File->Data, File->DataSize,
+					      &File->Digest);
+
+	__atomic_store_n(&File->JobState, PreverifyJobDone, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+/*
+ * EFI_AP_PROCEDURE running on all the APs until the queue is sealed. The
+ * AP backs off exponentially while no file is queued.
+ */
+STATIC VOID EFIAPI
+HashFiles(IN OUT VOID *Buffer)
+{
+	UINTN Backoff = 1;
+	BOOLEAN Sealed;
+
+	do {
+		BOOLEAN Claimed = FALSE;
+
+		Sealed = __atomic_load_n(&JobQueueSealed, __ATOMIC_ACQUIRE);
+
+		for (UINTN Index = 0; Index < MAX_PREVERIFIED_FILES; ++Index) {
+			if (HashFile(PreverifiedFiles + Index) == TRUE)
+				Claimed = TRUE;
+		}
+
+		if (Claimed == TRUE)
+			Backoff = 1;
+		else if (Sealed == FALSE) {
+			CpuRelax(Backoff);
+			if (Backoff < MAX_AP_BACKOFF)
+				Backoff <<= 1;
+		}
+	} while (Sealed == FALSE);
+
+	__atomic_sub_fetch(&NumberOfHashingAps, 1, __ATOMIC_RELEASE);
+}
+
+STATIC VOID
+WaitForFile(PREVERIFIED_FILE *File)
+{
+	/* Don't wait for the APs busy with other files */
+	HashFile(File);
+
+	while (__atomic_load_n(&File->JobState, __ATOMIC_ACQUIRE) !=
+	       PreverifyJobDone)
+		EfiStallMicroseconds(1);
+}
+
+/*
+ * Compare the digest calculated by the AP with the one attested by the
+ * signature. The file is dropped from the cache if not verified.
+ */
+STATIC BOOLEAN
+CompleteFile(PREVERIFIED_FILE *File)
+{
+	if (__atomic_load_n(&File->JobState, __ATOMIC_ACQUIRE) ==
+	    PreverifyJobNone)
+		return TRUE;
+
+	WaitForFile(File);
+
+	EFI_STATUS Status = File->HashStatus;
+
+	if (!EFI_ERROR(Status)) {
+		StatisticsHashed(File->DataSize);
+
+		if (MemCmpConstantTime(&File->Digest, File->Hash,
+				       File->HashSize)) {
+			EfiConsolePrintError(L"Invalid content for hash "
+					     L"comparison\n");
+			Status = EFI_SECURITY_VIOLATION;
+		} else {
+			VerifyCacheAdd(&File->CacheTag, File->HashAlgorithm,
+				       File->Hash, File->HashSize);
+			VerifiedTableAdd(File->Path, File->DataSize,
+					 File->HashAlgorithm, File->Hash,
+					 File->HashSize, &File->Signer,
+					 File->ProfileTimestamp);
+		}
+	}
+
+	EfiConsoleTraceInfo(L"The pre-verified file %s hashed with the exit "
+			    L"code 0x%x\n", File->Path, Status);
+
+	StatisticsFileVerified(Status, File->ProfileTimestamp);
+
+	if (EFI_ERROR(Status)) {
+		RemoveFile(File, TRUE);
+		return FALSE;
+	}
+
+	EfiMemoryFree(File->Hash);
+	File->Hash = NULL;
+	File->JobState = PreverifyJobNone;
+
+	return TRUE;
+}
+
+/*
+ * No AP may touch the content or run SELoader after ExitBootServices().
+ * The queued files are not requested by the boot target so they are just
+ * dropped, and the APs are waited for to return from HashFiles().
+ */
+STATIC VOID EFIAPI
+OnExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+	__atomic_store_n(&JobQueueSealed, TRUE, __ATOMIC_RELEASE);
+
+	for (UINTN Index = 0; Index < MAX_PREVERIFIED_FILES; ++Index) {
+		PREVERIFIED_FILE *File = PreverifiedFiles + Index;
+		UINT32 State = PreverifyJobQueued;
+
+		if (__atomic_compare_exchange_n(&File->JobState, &State,
+						PreverifyJobDone, FALSE,
+						__ATOMIC_ACQUIRE,
+						__ATOMIC_RELAXED))
+			continue;
+
+		while (__atomic_load_n(&File->JobState, __ATOMIC_ACQUIRE) ==
+		       PreverifyJobRunning)
+			EfiStallMicroseconds(1);
+	}
+
+	while (__atomic_load_n(&NumberOfHashingAps, __ATOMIC_ACQUIRE))
+		EfiStallMicroseconds(1);
+}
+
+/*
+ * Start the APs in non-blocking mode. They keep picking the queued files
+ * until the queue is sealed.
+ */
+STATIC EFI_STATUS
+StartApplicationProcessors(VOID)
+{
+	EFI_MP_SERVICES_PROTOCOL *MpServices;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&gEfiMpServiceProtocolGuid,
+				   (VOID **)&MpServices);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINTN NumberOfProcessors, NumberOfEnabledProcessors;
+
+	Status = MpServices->GetNumberOfProcessors(MpServices,
+						   &NumberOfProcessors,
+						   &NumberOfEnabledProcessors);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	if (NumberOfEnabledProcessors < 2)
+		return EFI_UNSUPPORTED;
+
+	Sha2Protocol = Sha2ProtocolGet();
+
+	/* Required by the non-blocking mode but never waited for */
+	Status = gBS->CreateEvent(0, 0, NULL, NULL, &ApWaitEvent);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+				  OnExitBootServices, NULL,
+				  &ExitBootServicesEvent);
+	if (EFI_ERROR(Status))
+		goto ErrOnCreateEvent;
+
+	/* Counted before any AP may return */
+	__atomic_store_n(&NumberOfHashingAps, NumberOfEnabledProcessors - 1,
+			 __ATOMIC_RELEASE);
+
+	Status = MpServices->StartupAllAPs(MpServices, HashFiles, FALSE,
+					   ApWaitEvent, 0, NULL, NULL);
+	if (EFI_ERROR(Status)) {
+		__atomic_store_n(&NumberOfHashingAps, 0, __ATOMIC_RELEASE);
+		goto ErrOnStartup;
+	}
+
+	EfiConsolePrintDebug(L"%d APs started for hashing the pre-verified "
+			     L"files\n", NumberOfEnabledProcessors - 1);
+
+	JobQueueEnabled = TRUE;
+
+	return EFI_SUCCESS;
+
+ErrOnStartup:
+	gBS->CloseEvent(ExitBootServicesEvent);
+	ExitBootServicesEvent = NULL;
+
+ErrOnCreateEvent:
+	gBS->CloseEvent(ApWaitEvent);
+	ApWaitEvent = NULL;
+
+	return Status;
+}
+
+/*
+ * Hand over the cached content of Path to the caller who is responsible
+ * for freeing it.
+ */
+BOOLEAN
+PreverifiedFileTake(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	PREVERIFIED_FILE *File = LookupFile(Path);
+
+	if (!File || CompleteFile(File) == FALSE)
+		return FALSE;
+
+	MeasureFile(Path, File->Data, File->DataSize);
+
+	*Data = File->Data;
+	*DataSize = File->DataSize;
+	RemoveFile(File, FALSE);
+
+	EfiConsolePrintDebug(L"Served the pre-verified file %s\n", Path);
+	StatisticsCacheHit();
+
+	return TRUE;
+}
+
+/*
+ * Check whether the content read by the caller is identical to the
+ * cached one. The cached content is released if so.
+ */
+BOOLEAN
+PreverifiedFileMatch(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize)
+{
+	PREVERIFIED_FILE *File = LookupFile(Path);
+
+	if (!File || CompleteFile(File) == FALSE)
+		return FALSE;
+
+	if (File->DataSize != DataSize || MemCmp(File->Data, Data, DataSize)) {
+		EfiConsolePrintDebug(L"The pre-verified file %s doesn't match "
+				     L"the file buffer\n", Path);
+		return FALSE;
+	}
+
+	RemoveFile(File, TRUE);
+
+	EfiConsolePrintDebug(L"Matched the pre-verified file %s\n", Path);
+	StatisticsCacheHit();
+
+	return TRUE;
+}
+
+/*
+ * The algorithm not supported by the built-in engine, e.g, SHA-1, is
+ * hashed on BSP right away instead. The digest is still compared when the
+ * file is requested.
+ */
+STATIC VOID
+HashFileOnBsp(PREVERIFIED_FILE *File)
+{
+	UINT8 *Digest;
+	UINTN DigestSize;
+
+	File->HashStatus = EfiHashData(File->HashAlgorithm, File->Data,
+				       File->DataSize, &Digest, &DigestSize);
+	if (EFI_ERROR(File->HashStatus))
+		goto out;
+
+	if (DigestSize == File->HashSize &&
+	    DigestSize <= sizeof(File->Digest))
+		MemCpy(&File->Digest, Digest, DigestSize);
+	else
+		File->HashStatus = EFI_UNSUPPORTED;
+
+	EfiMemoryFree(Digest);
+
+out:
+	File->JobState = PreverifyJobDone;
+}
+
+/*
+ * Read the file and verify its signature, leaving the content to be
+ * hashed by the APs.
+ */
+STATIC EFI_STATUS
+LoadQueuedFile(PREVERIFIED_FILE *File, CONST CHAR16 *Path)
+{
+	UINT64 ProfileTimestamp = ProfileStart();
+	EFI_STATUS Status;
+
+	Status = FileLoadSigned(Path, &File->CacheTag, &File->Signer,
+				&File->HashAlgorithm, &File->Hash,
+				&File->HashSize, &File->Data, &File->DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	File->ProfileTimestamp = ProfileTimestamp;
+
+	UINTN HashSize;
+
+	Status = Sha2Protocol->GetHashSize(Sha2Protocol, File->HashAlgorithm,
+					   &HashSize);
+	if (EFI_ERROR(Status) || HashSize != File->HashSize)
+		HashFileOnBsp(File);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+PreverifyFile(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	if (LookupFile(Path))
+		return EFI_ALREADY_STARTED;
+
+	if (NumberOfPreverifiedFiles == MAX_PREVERIFIED_FILES)
+		return EFI_OUT_OF_RESOURCES;
+
+	/* Don't count the missing files, e.g, the built-in modules */
+	if (EfiFileExists(Path) == FALSE) {
+		EfiConsolePrintDebug(L"Skip pre-verifying the missing file "
+				     L"%s\n", Path);
+		return EFI_NOT_FOUND;
+	}
+
+	PREVERIFIED_FILE *File = NULL;
+
+	for (UINTN Index = 0; Index < MAX_PREVERIFIED_FILES; ++Index) {
+		if (!PreverifiedFiles[Index].Path) {
+			File = PreverifiedFiles + Index;
+			break;
+		}
+	}
+
+	EFI_STATUS Status = EFI_UNSUPPORTED;
+
+	/* The content is needed at once if requested */
+	if (!Data && JobQueueEnabled == TRUE)
+		Status = LoadQueuedFile(File, Path);
+
+	if (EFI_ERROR(Status))
+		Status = EfiFileLoad(Path, &File->Data, &File->DataSize);
+
+	if (EFI_ERROR(Status)) {
+		MemSet(File, 0, sizeof(*File));
+		return Status;
+	}
+
+	if (File->DataSize > MAX_PREVERIFIED_SIZE - PreverifiedSize) {
+		EfiConsolePrintDebug(L"No room to cache the pre-verified "
+				     L"file %s\n", Path);
+		Status = EFI_OUT_OF_RESOURCES;
+	} else {
+		/* Added to the cache once loaded */
+		File->Path = CreateFilePath(Path);
+		if (!File->Path)
+			Status = EFI_OUT_OF_RESOURCES;
+	}
+
+	if (EFI_ERROR(Status)) {
+		if (File->Hash)
+			EfiMemoryFree(File->Hash);
+		EfiMemoryFree(File->Data);
+		MemSet(File, 0, sizeof(*File));
+		return Status;
+	}
+
+	++NumberOfPreverifiedFiles;
+	PreverifiedSize += File->DataSize;
+
+	/* Published to the APs once added to the cache */
+	if (File->Hash && File->JobState == PreverifyJobNone) {
+		__atomic_store_n(&File->JobState, PreverifyJobQueued,
+				 __ATOMIC_RELEASE);
+		EfiConsolePrintDebug(L"Queued the file %s (%d-byte) for "
+				     L"hashing\n", Path, File->DataSize);
+	} else
+		EfiConsolePrintDebug(L"Pre-verified the file %s (%d-byte)\n",
+				     Path, File->DataSize);
+
+	if (Data) {
+		*Data = File->Data;
+		*DataSize = File->DataSize;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Convert the grub path, e.g, (hd0,gpt1)/EFI/BOOT/bzImage or
+ * ${prefix}/custom.cfg, to the path on ESP. $prefix is assumed to be the
+ * directory of grub, i.e, the one of the SELoader. The path referring to
+ * other variables is unknown.
+ */
+STATIC CHAR16 *
+ConvertGrubPath(CONST CHAR16 *GrubPath)
+{
+	if (*GrubPath == L'(') {
+		GrubPath = StrChr(GrubPath, L')');
+		if (!GrubPath)
+			return NULL;
+
+		++GrubPath;
+	}
+
+	if (!StrCaseCmp(GrubPath, L"$prefix/", 8))
+		GrubPath += 8;
+	else if (!StrCaseCmp(GrubPath, L"${prefix}/", 10))
+		GrubPath += 10;
+	else if (StrChr(GrubPath, L'$'))
+		return NULL;
+
+	if (!*GrubPath)
+		return NULL;
+
+	CHAR16 *Path = StrDup(GrubPath);
+	if (!Path)
+		return NULL;
+
+	for (CHAR16 *Char = Path; *Char; ++Char) {
+		if (*Char == L'/')
+			*Char = L'\\';
+	}
+
+	return Path;
+}
+
+STATIC VOID
+PreverifyGrubPath(CONST CHAR16 *GrubPath)
+{
+	CHAR16 *Path = ConvertGrubPath(GrubPath);
+
+	if (!Path) {
+		EfiConsolePrintDebug(L"Skip pre-verifying the unknown path "
+				     L"%s\n", GrubPath);
+		return;
+	}
+
+	PreverifyFile(Path, NULL, NULL);
+	EfiMemoryFree(Path);
+}
+
+STATIC VOID
+PreverifyModule(CONST CHAR16 *Module)
+{
+	if (StrChr(Module, L'/') || StrEndsWith(Module, L".mod") == TRUE) {
+		PreverifyGrubPath(Module);
+		return;
+	}
+
+	CHAR16 *Path = StrAppend(GRUB_PLATFORM L"\\", Module);
+	if (!Path)
+		return;
+
+	CHAR16 *ModulePath = StrAppend(Path, L".mod");
+
+	EfiMemoryFree(Path);
+	if (!ModulePath)
+		return;
+
+	PreverifyFile(ModulePath, NULL, NULL);
+	EfiMemoryFree(ModulePath);
+}
+
+STATIC BOOLEAN
+IsBlank(CHAR16 Char)
+{
+	return Char == L' ' || Char == L'\t' || Char == L'\r';
+}
+
+/*
+ * Split the line into the arguments separated by blanks in place. The
+ * quotes are removed, e.g, default="1" becomes default=1. Return the
+ * number of the arguments.
+ */
+STATIC UINTN
+SplitArguments(CHAR16 *Line, CHAR16 **Arguments)
+{
+	UINTN NumberOfArguments = 0;
+
+	while (NumberOfArguments < MAX_GRUB_ARGUMENTS) {
+		while (IsBlank(*Line) == TRUE)
+			++Line;
+
+		if (!*Line || *Line == L'#')
+			break;
+
+		CHAR16 *Argument = Line;
+		CHAR16 Quote = L'\0';
+
+		Arguments[NumberOfArguments++] = Argument;
+
+		for (; *Line; ++Line) {
+			if (Quote) {
+				if (*Line == Quote) {
+					Quote = L'\0';
+					continue;
+				}
+			} else if (*Line == L'\'' || *Line == L'"') {
+				Quote = *Line;
+				continue;
+			} else if (IsBlank(*Line) == TRUE)
+				break;
+
+			*Argument++ = *Line;
+		}
+
+		BOOLEAN End = !*Line;
+
+		*Argument = L'\0';
+		if (End == TRUE)
+			break;
+
+		++Line;
+	}
+
+	return NumberOfArguments;
+}
+
+STATIC BOOLEAN
+IsDefaultEntry(GRUB_CONFIG_STATE *State, CHAR16 **Arguments,
+	       UINTN NumberOfArguments)
+{
+	CONST CHAR16 *Default = State->DefaultEntry;
+
+	/* The unknown default, e.g, ${saved_entry}, falls back to 0 */
+	if (!Default || !*Default || StrChr(Default, L'$'))
+		return State->NumberOfEntries == 0;
+
+	if (*Default >= L'0' && *Default <= L'9') {
+		UINTN Index = 0;
+
+		for (; *Default >= L'0' && *Default <= L'9'; ++Default)
+			Index = Index * 10 + *Default - L'0';
+
+		if (!*Default)
+			return State->NumberOfEntries == Index;
+
+		Default = State->DefaultEntry;
+	}
+
+	/* Match the title or --id */
+	for (UINTN Index = 1; Index < NumberOfArguments; ++Index) {
+		if (!StrCmp(Arguments[Index], Default))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+STATIC VOID ScanGrubConfig(CONST CHAR16 *Path, UINTN Depth);
+
+STATIC VOID
+ParseGrubLine(CHAR16 *Line, GRUB_CONFIG_STATE *State, UINTN Depth,
+	      BOOLEAN DefaultOnly)
+{
+	CHAR16 *Arguments[MAX_GRUB_ARGUMENTS];
+	UINTN NumberOfArguments;
+
+	NumberOfArguments = SplitArguments(Line, Arguments);
+	if (!NumberOfArguments)
+		return;
+
+	CONST CHAR16 *Command = Arguments[0];
+
+	if (DefaultOnly == TRUE) {
+		if (!StrCmp(Command, L"set") && NumberOfArguments > 1 &&
+		    !StrCaseCmp(Arguments[1], L"default=", 8))
+			State->DefaultEntry = Arguments[1] + 8;
+		return;
+	}
+
+	if (!StrCmp(Command, L"}")) {
+		if (State->Depth)
+			--State->Depth;
+
+		if (State->Depth < State->SelectedDepth)
+			State->SelectedDepth = 0;
+
+		return;
+	}
+
+	BOOLEAN Block = !StrCmp(Arguments[NumberOfArguments - 1], L"{");
+
+	if (!StrCmp(Command, L"menuentry") || !StrCmp(Command, L"submenu")) {
+		BOOLEAN Selected = FALSE;
+
+		if (!State->Depth) {
+			Selected = !StrCmp(Command, L"menuentry") &&
+				   IsDefaultEntry(State, Arguments,
+						  NumberOfArguments);
+			++State->NumberOfEntries;
+		}
+
+		if (Block == TRUE) {
+			++State->Depth;
+			if (Selected == TRUE)
+				State->SelectedDepth = State->Depth;
+		}
+
+		return;
+	}
+
+	/* Skip the other entries and the function definitions */
+	if (State->Depth &&
+	    (!State->SelectedDepth || State->Depth < State->SelectedDepth)) {
+		if (Block == TRUE)
+			++State->Depth;
+		return;
+	}
+
+	if (Block == TRUE)
+		++State->Depth;
+
+	if (NumberOfArguments < 2)
+		return;
+
+	if (!StrCmp(Command, L"linux") || !StrCmp(Command, L"linuxefi") ||
+	    !StrCmp(Command, L"linux16"))
+		PreverifyGrubPath(Arguments[1]);
+	else if (!StrCmp(Command, L"initrd") ||
+		 !StrCmp(Command, L"initrdefi") ||
+		 !StrCmp(Command, L"initrd16")) {
+		for (UINTN Index = 1; Index < NumberOfArguments; ++Index)
+			PreverifyGrubPath(Arguments[Index]);
+	} else if (!StrCmp(Command, L"insmod"))
+		PreverifyModule(Arguments[1]);
+	else if (!StrCmp(Command, L"source") ||
+		 !StrCmp(Command, L"configfile")) {
+		CHAR16 *Path = ConvertGrubPath(Arguments[1]);
+
+		if (Path) {
+			ScanGrubConfig(Path, Depth + 1);
+			EfiMemoryFree(Path);
+		}
+	}
+}
+
+STATIC VOID
+ParseGrubConfig(CONST CHAR8 *Data, UINTN DataSize, GRUB_CONFIG_STATE *State,
+		UINTN Depth, BOOLEAN DefaultOnly, CHAR16 *Buffer)
+{
+	/* Only ASCII is supported */
+	for (UINTN Index = 0; Index < DataSize; ++Index)
+		Buffer[Index] = (CHAR16)(UINT8)Data[Index];
+	Buffer[DataSize] = L'\0';
+
+	CHAR16 *Line = Buffer;
+
+	while (Line) {
+		CHAR16 *NextLine = StrChr(Line, L'\n');
+
+		if (NextLine)
+			*NextLine++ = L'\0';
+
+		ParseGrubLine(Line, State, Depth, DefaultOnly);
+
+		Line = NextLine;
+	}
+}
+
+/*
+ * Verify the configuration file and the files referred by the commands
+ * outside any menu entry and in the default entry.
+ */
+STATIC VOID
+ScanGrubConfig(CONST CHAR16 *Path, UINTN Depth)
+{
+	if (Depth > MAX_PREVERIFY_DEPTH)
+		return;
+
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	Status = PreverifyFile(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return;
+
+	CHAR16 *DefaultBuffer, *Buffer;
+
+	Status = EfiMemoryAllocate((DataSize + 1) * sizeof(CHAR16),
+				   (VOID **)&DefaultBuffer);
+	if (EFI_ERROR(Status))
+		return;
+
+	Status = EfiMemoryAllocate((DataSize + 1) * sizeof(CHAR16),
+				   (VOID **)&Buffer);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(DefaultBuffer);
+		return;
+	}
+
+	GRUB_CONFIG_STATE State;
+
+	MemSet(&State, 0, sizeof(State));
+
+	/* The default entry may be set after the first menu entry */
+	ParseGrubConfig(Data, DataSize, &State, Depth, TRUE, DefaultBuffer);
+	ParseGrubConfig(Data, DataSize, &State, Depth, FALSE, Buffer);
+
+	EfiMemoryFree(Buffer);
+	EfiMemoryFree(DefaultBuffer);
+}
+
+EFI_STATUS
+EfiPreverifyGrubConfig(CONST CHAR16 *Path)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	EfiConsoleTraceDebug(L"Pre-verifying the default boot entry in %s "
+			     L"...\n", Path);
+
+	UINT64 ProfileTimestamp = ProfileStart();
+
+	/* The APs are started only once and the files are verified on BSP */
+	if (!ApWaitEvent) {
+		EFI_STATUS Status = StartApplicationProcessors();
+
+		if (EFI_ERROR(Status))
+			EfiConsolePrintDebug(L"Unable to hash the pre-verified "
+					     L"files on APs (err: 0x%x)\n",
+					     Status);
+	}
+
+	/* The files are measured once requested by grub */
+	MeasureSuspend();
+	ScanGrubConfig(Path, 0);
+	MeasureResume();
+
+	if (JobQueueEnabled == TRUE) {
+		JobQueueEnabled = FALSE;
+		__atomic_store_n(&JobQueueSealed, TRUE, __ATOMIC_RELEASE);
+	}
+
+	EfiConsolePrintInfo(L"%d files pre-verified (%d-byte) in %ld us\n",
+			    NumberOfPreverifiedFiles, PreverifiedSize,
+			    ProfileElapsedMicroseconds(ProfileTimestamp));
+
+	return LookupFile(Path) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
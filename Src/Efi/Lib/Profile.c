@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+#include <Edk2/Protocol/Timestamp.h>
+
+#include "Internal.h"
+
+EFI_GUID gSELoaderVendorGuid = SELOADER_VENDOR_GUID;
+
+/* Not all gnu-efi versions define this GUID */
+STATIC EFI_GUID TimestampProtocolGuid = EFI_TIMESTAMP_PROTOCOL_GUID;
+
+#define SELOADER_PROFILE_VARIABLE	L"SELoaderProfile"
+
+/* The time used to calibrate TSC */
+#define CALIBRATION_MICROSECONDS	1000
+
+#define MAX_PROFILE_FILES		64
+
+typedef struct {
+	UINT64 Count;
+	UINT64 Ticks;
+} PROFILE_PHASE_STATE;
+
+typedef struct {
+	CHAR16 Path[SelProfilePathLength];
+	UINT64 Count;
+	UINT64 Ticks;
+	UINT64 Size;
+} PROFILE_FILE_STATE;
+
+/* Zero means no available timestamp source */
+STATIC UINT64 Frequency;
+STATIC UINT64 LaunchTimestamp;
+STATIC EFI_TIMESTAMP_PROTOCOL *TimestampProtocol;
+STATIC PROFILE_PHASE_STATE PhaseStates[SelProfilePhaseMax];
+STATIC PROFILE_FILE_STATE FileStates[MAX_PROFILE_FILES];
+STATIC UINTN NumberOfFiles;
+STATIC CHAR16 *ReportFile;
+
+STATIC UINT64
+ReadTimestamp(VOID)
+{
+	if (TimestampProtocol)
+		return TimestampProtocol->GetTimestamp();
+
+#if defined(__x86_64__) || defined(__i386__)
+	UINT32 Low, High;
+
+	__asm__ __volatile__ ("rdtsc" : "=a"(Low), "=d"(High));
+
+	return ((UINT64)High << 32) | Low;
+#elif defined(__aarch64__)
+	UINT64 Count;
+
+	asm volatile("isb\n\t"
+		     "mrs %0, cntvct_el0"
+		     : "=r"(Count));
+
+	return Count;
+#else
+	return 0;
+#endif
+}
+
+STATIC UINT64
+TicksToMicroseconds(UINT64 Ticks)
+{
+	if (!Frequency)
+		return 0;
+
+	return Ticks * 1000000 / Frequency;
+}
+
+#ifdef BOOT_MARKER_BUILD
+/* The debugcon port used by OVMF */
+#define DEBUGCON_PORT			0x402
+
+#define MARKER_PREFIX			"SELoader: marker "
+
+STATIC VOID
+MarkerWrite(CHAR8 Char)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__ ("outb %b0, %w1"
+			      : : "a"(Char), "Nd"(DEBUGCON_PORT));
+#else
+	CHAR16 String[2] = { Char, L'\0' };
+
+	gST->ConOut->OutputString(gST->ConOut, String);
+#endif
+}
+
+STATIC VOID
+MarkerWriteString(CONST CHAR16 *String)
+{
+	while (*String)
+		MarkerWrite((CHAR8)*String++);
+}
+
+STATIC VOID
+MarkerWriteNumber(UINT64 Number)
+{
+	CHAR8 Digits[20];
+	UINTN Length = 0;
+
+	do {
+		Digits[Length++] = '0' + Number % 10;
+		Number /= 10;
+	} while (Number);
+
+	while (Length)
+		MarkerWrite(Digits[--Length]);
+}
+#endif
+
+/*
+ * Emit a boot marker, e.g, to track the boot latency under QEMU, in the
+ * format below:
+ *
+ * SELoader: marker <event> <microseconds since launch> [path]
+ *
+ * The markers are written to the debugcon port on x86, otherwise to the
+ * console.
+ */
+VOID
+ProfileMark(CONST CHAR16 *Event, CONST CHAR16 *Path)
+{
+#ifdef BOOT_MARKER_BUILD
+	CONST CHAR8 *Prefix = MARKER_PREFIX;
+
+	while (*Prefix)
+		MarkerWrite(*Prefix++);
+
+	MarkerWriteString(Event);
+	MarkerWrite(' ');
+	MarkerWriteNumber(TicksToMicroseconds(ReadTimestamp() -
+					      LaunchTimestamp));
+
+	if (Path) {
+		MarkerWrite(' ');
+		MarkerWriteString(Path);
+	}
+
+	MarkerWrite('\n');
+#endif
+}
+
+/*
+ * EFI Timestamp Protocol is preferred because its frequency is already
+ * known. Otherwise, TSC is calibrated with gBS->Stall() only once, or
+ * the generic timer is used on AArch64.
+ */
+VOID
+ProfileInitialize(VOID)
+{
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&TimestampProtocolGuid,
+				   (VOID **)&TimestampProtocol);
+	if (!EFI_ERROR(Status)) {
+		EFI_TIMESTAMP_PROPERTIES Properties;
+
+		Status = TimestampProtocol->GetProperties(&Properties);
+		if (!EFI_ERROR(Status) && Properties.Frequency)
+			Frequency = Properties.Frequency;
+		else
+			TimestampProtocol = NULL;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	if (!TimestampProtocol) {
+		UINT64 Start = ReadTimestamp();
+
+		gBS->Stall(CALIBRATION_MICROSECONDS);
+		Frequency = (ReadTimestamp() - Start) *
+			    (1000000 / CALIBRATION_MICROSECONDS);
+	}
+#elif defined(__aarch64__)
+	/* The generic timer reports its frequency */
+	if (!TimestampProtocol)
+		asm volatile("mrs %0, cntfrq_el0" : "=r"(Frequency));
+#endif
+
+	LaunchTimestamp = ReadTimestamp();
+}
+
+UINT64
+ProfileStart(VOID)
+{
+	return ReadTimestamp();
+}
+
+VOID
+ProfileStop(SEL_PROFILE_PHASE Phase, UINT64 Start)
+{
+	if (Phase >= SelProfilePhaseMax)
+		return;
+
+	PhaseStates[Phase].Ticks += ReadTimestamp() - Start;
+	++PhaseStates[Phase].Count;
+}
+
+VOID
+ProfileStopFile(CONST CHAR16 *Path, CONST CHAR16 *Suffix, UINTN Size,
+		UINT64 Start)
+{
+	UINT64 Ticks = ReadTimestamp() - Start;
+
+	PhaseStates[SelProfilePhaseFileLoad].Ticks += Ticks;
+	++PhaseStates[SelProfilePhaseFileLoad].Count;
+
+	CHAR16 FilePath[SelProfilePathLength];
+	UINTN Length = StrLen(Path);
+
+	if (Length > SelProfilePathLength - 1)
+		Length = SelProfilePathLength - 1;
+	MemCpy(FilePath, Path, Length * sizeof(CHAR16));
+
+	while (Suffix && *Suffix && Length < SelProfilePathLength - 1)
+		FilePath[Length++] = *Suffix++;
+	FilePath[Length] = L'\0';
+
+	PROFILE_FILE_STATE *FileState = NULL;
+
+	for (UINTN Index = 0; Index < NumberOfFiles; ++Index) {
+		if (!StrCmp(FileStates[Index].Path, FilePath)) {
+			FileState = FileStates + Index;
+			break;
+		}
+	}
+
+	if (!FileState) {
+		/* Only the phase total is counted if the table is full */
+		if (NumberOfFiles == MAX_PROFILE_FILES)
+			return;
+
+		FileState = FileStates + NumberOfFiles++;
+		StrCpy(FileState->Path, FilePath);
+	}
+
+	FileState->Ticks += Ticks;
+	FileState->Size += Size;
+	++FileState->Count;
+}
+
+UINT64
+ProfileElapsedMicroseconds(UINT64 Start)
+{
+	return TicksToMicroseconds(ReadTimestamp() - Start);
+}
+
+UINT64
+ProfileLaunchElapsedMicroseconds(VOID)
+{
+	return TicksToMicroseconds(ReadTimestamp() - LaunchTimestamp);
+}
+
+VOID
+ProfilePhaseQuery(SEL_PROFILE_PHASE Phase, UINT64 *Count,
+		  UINT64 *Microseconds)
+{
+	if (Phase >= SelProfilePhaseMax)
+		return;
+
+	*Count = PhaseStates[Phase].Count;
+	*Microseconds = TicksToMicroseconds(PhaseStates[Phase].Ticks);
+}
+
+EFI_STATUS
+EfiProfileSetReportFile(CONST CHAR16 *Path)
+{
+	if (ReportFile) {
+		EfiMemoryFree(ReportFile);
+		ReportFile = NULL;
+	}
+
+	if (!Path)
+		return EFI_SUCCESS;
+
+	ReportFile = StrDup(Path);
+	if (!ReportFile)
+		return EFI_OUT_OF_RESOURCES;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiProfileReport(VOID)
+{
+	if (!Frequency)
+		return EFI_UNSUPPORTED;
+
+	UINTN ReportSize = sizeof(SEL_PROFILE_REPORT) +
+			   sizeof(SEL_PROFILE_PHASE_RECORD) *
+			   SelProfilePhaseMax +
+			   sizeof(SEL_PROFILE_FILE_RECORD) * NumberOfFiles;
+	SEL_PROFILE_REPORT *Report;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(ReportSize, (VOID **)&Report);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Report->Revision = SelProfileRevision;
+	Report->HeaderSize = sizeof(*Report);
+	Report->NumberOfPhases = SelProfilePhaseMax;
+	Report->NumberOfFiles = NumberOfFiles;
+	Report->Frequency = Frequency;
+	Report->Microseconds = TicksToMicroseconds(ReadTimestamp() -
+						   LaunchTimestamp);
+
+	SEL_PROFILE_PHASE_RECORD *PhaseRecord;
+
+	PhaseRecord = (SEL_PROFILE_PHASE_RECORD *)(Report + 1);
+	for (UINTN Index = 0; Index < SelProfilePhaseMax; ++Index) {
+		PhaseRecord[Index].Count = PhaseStates[Index].Count;
+		PhaseRecord[Index].Microseconds =
+			TicksToMicroseconds(PhaseStates[Index].Ticks);
+
+		EfiConsolePrintDebug(L"Profile phase %d: %d calls, %d us\n",
+				     Index, (UINTN)PhaseRecord[Index].Count,
+				     (UINTN)PhaseRecord[Index].Microseconds);
+	}
+
+	SEL_PROFILE_FILE_RECORD *FileRecord;
+
+	FileRecord = (SEL_PROFILE_FILE_RECORD *)(PhaseRecord +
+						 SelProfilePhaseMax);
+	for (UINTN Index = 0; Index < NumberOfFiles; ++Index) {
+		MemCpy(FileRecord[Index].Path, FileStates[Index].Path,
+		       sizeof(FileRecord[Index].Path));
+		FileRecord[Index].Count = FileStates[Index].Count;
+		FileRecord[Index].Microseconds =
+			TicksToMicroseconds(FileStates[Index].Ticks);
+		FileRecord[Index].Size = FileStates[Index].Size;
+	}
+
+	Status = EfiVariableWrite(SELOADER_PROFILE_VARIABLE,
+				  &gSELoaderVendorGuid,
+				  EFI_VARIABLE_BOOTSERVICE_ACCESS |
+				  EFI_VARIABLE_RUNTIME_ACCESS,
+				  Report, ReportSize);
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to write the profile report "
+				     L"variable (err: 0x%x)\n", Status);
+
+	if (ReportFile) {
+		/* Don't leave the stale content of a longer report */
+		EfiFileDelete(ReportFile);
+
+		Status = EfiFileSave(ReportFile, Report, ReportSize);
+	}
+
+	EfiMemoryFree(Report);
+
+	return Status;
+}
+
+UINT64
+EfiProfileTimestamp(VOID)
+{
+	return ProfileStart();
+}
+
+/* Zero is returned if no timestamp source is available */
+UINT64
+EfiProfileElapsedMicroseconds(UINT64 Start)
+{
+	return ProfileElapsedMicroseconds(Start);
+}
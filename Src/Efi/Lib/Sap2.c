@@ -39,6 +39,9 @@
 EFI_GUID gEfiSecurity2ArchProtocolGuid = EFI_SECURITY2_ARCH_PROTOCOL_GUID;
 
 STATIC EFI_SECURITY2_FILE_AUTHENTICATION OriginalFileAuthentication;
+/* The image buffer already covered by the signature of SELoader */
+STATIC CONST VOID *TrustedImageBuffer;
+STATIC UINTN TrustedImageBufferSize;
 
 EFI_STATUS EFIAPI
 ReplacedFileAuthentication(IN CONST EFI_SECURITY2_ARCH_PROTOCOL *This,
@@ -55,17 +58,25 @@ ReplacedFileAuthentication(IN CONST EFI_SECURITY2_ARCH_PROTOCOL *This,
 	EfiConsoleTraceDebug(L"The FileAuthentication() hook called for "
 			     L"authenticating %s\n", FilePath);
 
+	EFI_STATUS Status = EFI_SUCCESS;
+
 	if (EfiSecurityPolicySecureBootEnabled() == FALSE) {
 		EfiConsoleTraceDebug(L"Ignore to verify signature\n");
-		return EFI_SUCCESS;
+		goto out;
+	}
+
+	if (TrustedImageBuffer && FileBuffer == TrustedImageBuffer &&
+	    FileSize == TrustedImageBufferSize) {
+		EfiConsoleTraceDebug(L"Skip verifying the trusted image "
+				     L"%s\n", FilePath);
+		goto out;
 	}
 
 	BOOLEAN Installed;
-	EFI_STATUS Status;
 
 	Status = MokVerifyProtocolInstalled(&Installed);
 	if (EFI_ERROR(Status))
-		return Status;
+		goto out;
 
 	if (Installed == TRUE) {
 		Status = MokVerifyPeImage(FileBuffer, FileSize);
@@ -73,7 +84,7 @@ ReplacedFileAuthentication(IN CONST EFI_SECURITY2_ARCH_PROTOCOL *This,
 			EfiConsoleTraceDebug(L"Succeeded to verify PE image "
 					     L"by the FileAuthentication() "
 					     L"hook\n");
-			return EFI_SUCCESS;
+			goto out;
 		}
 	}
 
@@ -83,17 +94,19 @@ ReplacedFileAuthentication(IN CONST EFI_SECURITY2_ARCH_PROTOCOL *This,
 	/* Chain original security policy */
 	Status = OriginalFileAuthentication(This, DevicePath, FileBuffer,
 					    FileSize, BootPolicy);
-	if (EFI_ERROR(Status)) {
+	if (EFI_ERROR(Status))
 		EfiConsoleTraceError(L"Failed to verify PE image %s by the "
 				     L"original FileAuthentication()\n",
 				     FilePath);
-		return Status;
-	}
+	else
+		EfiConsoleTraceDebug(L"Succeeded to verify PE image %s by the "
+				     L"original FileAuthentication()\n",
+				     FilePath);
 
-	EfiConsoleTraceDebug(L"Succeeded to verify PE image %s by the "
-			     L"original FileAuthentication()\n", FilePath);
+out:
+	EfiMemoryFree(FilePath);
 
-	return EFI_SUCCESS;
+	return Status;
 }
 
 EFI_STATUS
@@ -110,6 +123,10 @@ Sap2Hook(VOID)
 		return Status;
 	}
 
+	/* Don't chain the hook to itself if already hooked */
+	if (Sap2->FileAuthentication == ReplacedFileAuthentication)
+		return EFI_SUCCESS;
+
 	OriginalFileAuthentication = Sap2->FileAuthentication;
 	Sap2->FileAuthentication = ReplacedFileAuthentication;
 
@@ -125,3 +142,57 @@ Sap2Hook(VOID)
 
 	return EFI_SUCCESS;
 }
+
+/*
+ * Check whether the hook is still in place, e.g, not replaced by the one
+ * re-installed by shim.
+ */
+BOOLEAN
+Sap2Hooked(VOID)
+{
+	EFI_SECURITY2_ARCH_PROTOCOL *Sap2;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&gEfiSecurity2ArchProtocolGuid,
+				   (VOID **)&Sap2);
+	if (EFI_ERROR(Status))
+		return FALSE;
+
+	return Sap2->FileAuthentication == ReplacedFileAuthentication;
+}
+
+/*
+ * Authenticate the PE image with the FileAuthentication() of BIOS, i.e,
+ * against db and dbx, bypassing the hook.
+ */
+EFI_STATUS
+Sap2VerifyImage(CONST EFI_DEVICE_PATH *DevicePath, VOID *ImageBuffer,
+		UINTN ImageBufferSize)
+{
+	EFI_SECURITY2_ARCH_PROTOCOL *Sap2;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&gEfiSecurity2ArchProtocolGuid,
+				   (VOID **)&Sap2);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to open EFI Security2 "
+				     L"Architectural Protocol\n");
+		return Status;
+	}
+
+	EFI_SECURITY2_FILE_AUTHENTICATION FileAuthentication;
+
+	FileAuthentication = Sap2->FileAuthentication;
+	if (FileAuthentication == ReplacedFileAuthentication)
+		FileAuthentication = OriginalFileAuthentication;
+
+	return FileAuthentication(Sap2, DevicePath, ImageBuffer,
+				  ImageBufferSize, FALSE);
+}
+
+VOID
+Sap2TrustedImageSet(CONST VOID *ImageBuffer, UINTN ImageBufferSize)
+{
+	TrustedImageBuffer = ImageBuffer;
+	TrustedImageBufferSize = ImageBufferSize;
+}
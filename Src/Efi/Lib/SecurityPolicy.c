@@ -296,5 +296,9 @@ EfiSecurityPolicyMokVerifyProtocolInstalled(VOID)
 VOID
 SecurityPolicyInitialize(VOID)
 {
+	UINT64 ProfileTimestamp = ProfileStart();
+
 	InitializeSecurityPolicy();
+
+	ProfileStop(SelProfilePhaseSecurityPolicy, ProfileTimestamp);
 }
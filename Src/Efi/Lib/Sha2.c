@@ -0,0 +1,777 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+#include "Internal.h"
+
+/*
+ * The built-in SHA-2 engine published as EFI Hash2 Protocol. The block
+ * functions use ARMv8 crypto extensions if available. The portable ones
+ * are used otherwise.
+ */
+
+#define SHA256_BLOCK_SIZE		64
+#define SHA512_BLOCK_SIZE		128
+
+typedef VOID (*SHA2_BLOCK_FUNCTION)(VOID *State, CONST UINT8 *Data,
+				    UINTN NumberOfBlocks);
+
+typedef struct {
+	CONST EFI_GUID *HashAlgorithm;
+	UINTN HashSize;
+	UINTN BlockSize;
+	/* The size of a state word, i.e, 4 for SHA-256 and 8 for SHA-512 */
+	UINTN WordSize;
+	CONST VOID *InitialState;
+	SHA2_BLOCK_FUNCTION *Blocks;
+} SHA2_ALGORITHM;
+
+typedef struct {
+	CONST SHA2_ALGORITHM *Algorithm;
+	UINT64 State[8];
+	UINT64 Length;
+	UINT8 Buffer[SHA512_BLOCK_SIZE];
+	UINTN BufferSize;
+} SHA2_CONTEXT;
+
+/* Each instance of the protocol carries its own multi-part hash */
+typedef struct {
+	EFI_HASH2_PROTOCOL Protocol;
+	SHA2_CONTEXT Context;
+} SHA2_INSTANCE;
+
+STATIC CONST UINT32 K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+STATIC CONST UINT64 K512[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+	0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+	0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+	0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+	0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+	0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+	0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+	0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+	0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+	0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+	0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+	0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+	0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+	0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+STATIC CONST UINT32 InitialState224[8] = {
+	0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939,
+	0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4
+};
+
+STATIC CONST UINT32 InitialState256[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+STATIC CONST UINT64 InitialState384[8] = {
+	0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+	0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+	0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+	0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+};
+
+STATIC CONST UINT64 InitialState512[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+#define ROR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+STATIC UINT32
+ReadBe32(CONST UINT8 *Data)
+{
+	return (UINT32)Data[0] << 24 | (UINT32)Data[1] << 16 |
+	       (UINT32)Data[2] << 8 | Data[3];
+}
+
+STATIC UINT64
+ReadBe64(CONST UINT8 *Data)
+{
+	return (UINT64)ReadBe32(Data) << 32 | ReadBe32(Data + 4);
+}
+
+STATIC VOID
+WriteBe64(UINT8 *Data, UINT64 Value)
+{
+	for (UINTN Index = 0; Index < sizeof(Value); ++Index)
+		Data[Index] = (UINT8)(Value >> (56 - Index * 8));
+}
+
+STATIC VOID
+Sha256BlocksGeneric(VOID *State, CONST UINT8 *Data, UINTN NumberOfBlocks)
+{
+	UINT32 *H = State;
+
+	while (NumberOfBlocks--) {
+		UINT32 W[64];
+		UINT32 a = H[0], b = H[1], c = H[2], d = H[3];
+		UINT32 e = H[4], f = H[5], g = H[6], h = H[7];
+
+		for (UINTN t = 0; t < 16; ++t)
+			W[t] = ReadBe32(Data + t * 4);
+
+		for (UINTN t = 16; t < 64; ++t) {
+			UINT32 s0 = ROR32(W[t - 15], 7) ^
+				    ROR32(W[t - 15], 18) ^ (W[t - 15] >> 3);
+			UINT32 s1 = ROR32(W[t - 2], 17) ^
+				    ROR32(W[t - 2], 19) ^ (W[t - 2] >> 10);
+
+			W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+		}
+
+		for (UINTN t = 0; t < 64; ++t) {
+			UINT32 T1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^
+					 ROR32(e, 25)) +
+				    ((e & f) ^ (~e & g)) + K256[t] + W[t];
+			UINT32 T2 = (ROR32(a, 2) ^ ROR32(a, 13) ^
+				     ROR32(a, 22)) +
+				    ((a & b) ^ (a & c) ^ (b & c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+		}
+
+		H[0] += a;
+		H[1] += b;
+		H[2] += c;
+		H[3] += d;
+		H[4] += e;
+		H[5] += f;
+		H[6] += g;
+		H[7] += h;
+
+		Data += SHA256_BLOCK_SIZE;
+	}
+}
+
+STATIC VOID
+Sha512BlocksGeneric(VOID *State, CONST UINT8 *Data, UINTN NumberOfBlocks)
+{
+	UINT64 *H = State;
+
+	while (NumberOfBlocks--) {
+		UINT64 W[80];
+		UINT64 a = H[0], b = H[1], c = H[2], d = H[3];
+		UINT64 e = H[4], f = H[5], g = H[6], h = H[7];
+
+		for (UINTN t = 0; t < 16; ++t)
+			W[t] = ReadBe64(Data + t * 8);
+
+		for (UINTN t = 16; t < 80; ++t) {
+			UINT64 s0 = ROR64(W[t - 15], 1) ^
+				    ROR64(W[t - 15], 8) ^ (W[t - 15] >> 7);
+			UINT64 s1 = ROR64(W[t - 2], 19) ^
+				    ROR64(W[t - 2], 61) ^ (W[t - 2] >> 6);
+
+			W[t] = W[t - 16] + s0 + W[t - 7] + s1;
+		}
+
+		for (UINTN t = 0; t < 80; ++t) {
+			UINT64 T1 = h + (ROR64(e, 14) ^ ROR64(e, 18) ^
+					 ROR64(e, 41)) +
+				    ((e & f) ^ (~e & g)) + K512[t] + W[t];
+			UINT64 T2 = (ROR64(a, 28) ^ ROR64(a, 34) ^
+				     ROR64(a, 39)) +
+				    ((a & b) ^ (a & c) ^ (b & c));
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + T1;
+			d = c;
+			c = b;
+			b = a;
+			a = T1 + T2;
+		}
+
+		H[0] += a;
+		H[1] += b;
+		H[2] += c;
+		H[3] += d;
+		H[4] += e;
+		H[5] += f;
+		H[6] += g;
+		H[7] += h;
+
+		Data += SHA512_BLOCK_SIZE;
+	}
+}
+
+#ifdef __aarch64__
+/* 4 rounds with the message words in M0, and schedule the next ones */
+#define SHA256_ROUNDS(M0)						\
+	"ld1 {v18.4s}, [%[K]], #16\n\t"					\
+	"add v16.4s, " M0 ".4s, v18.4s\n\t"				\
+	"mov v17.16b, v0.16b\n\t"					\
+	"sha256h q0, q1, v16.4s\n\t"					\
+	"sha256h2 q1, q17, v16.4s\n\t"
+
+#define SHA256_SCHEDULE(M0, M1, M2, M3)					\
+	"sha256su0 " M0 ".4s, " M1 ".4s\n\t"				\
+	"sha256su1 " M0 ".4s, " M2 ".4s, " M3 ".4s\n\t"
+
+#define SHA256_ROUNDS_SCHEDULE(M0, M1, M2, M3)				\
+	SHA256_ROUNDS(M0)						\
+	SHA256_SCHEDULE(M0, M1, M2, M3)
+
+STATIC VOID
+Sha256BlocksCe(VOID *State, CONST UINT8 *Data, UINTN NumberOfBlocks)
+{
+	CONST UINT32 *K;
+
+	/*
+	 * v0/v1: ABCD/EFGH, v2/v3: the state of the previous block,
+	 * v4-v7: the message schedule.
+	 */
+	asm volatile(".arch_extension simd\n\t"
+		     ".arch_extension sha2\n\t"
+		     "ld1 {v0.4s, v1.4s}, [%[State]]\n\t"
+		     "1:\n\t"
+		     "ld1 {v4.16b-v7.16b}, [%[Data]], #64\n\t"
+		     "rev32 v4.16b, v4.16b\n\t"
+		     "rev32 v5.16b, v5.16b\n\t"
+		     "rev32 v6.16b, v6.16b\n\t"
+		     "rev32 v7.16b, v7.16b\n\t"
+		     "mov v2.16b, v0.16b\n\t"
+		     "mov v3.16b, v1.16b\n\t"
+		     "mov %[K], %[K256]\n\t"
+		     SHA256_ROUNDS_SCHEDULE("v4", "v5", "v6", "v7")
+		     SHA256_ROUNDS_SCHEDULE("v5", "v6", "v7", "v4")
+		     SHA256_ROUNDS_SCHEDULE("v6", "v7", "v4", "v5")
+		     SHA256_ROUNDS_SCHEDULE("v7", "v4", "v5", "v6")
+		     SHA256_ROUNDS_SCHEDULE("v4", "v5", "v6", "v7")
+		     SHA256_ROUNDS_SCHEDULE("v5", "v6", "v7", "v4")
+		     SHA256_ROUNDS_SCHEDULE("v6", "v7", "v4", "v5")
+		     SHA256_ROUNDS_SCHEDULE("v7", "v4", "v5", "v6")
+		     SHA256_ROUNDS_SCHEDULE("v4", "v5", "v6", "v7")
+		     SHA256_ROUNDS_SCHEDULE("v5", "v6", "v7", "v4")
+		     SHA256_ROUNDS_SCHEDULE("v6", "v7", "v4", "v5")
+		     SHA256_ROUNDS_SCHEDULE("v7", "v4", "v5", "v6")
+		     SHA256_ROUNDS("v4")
+		     SHA256_ROUNDS("v5")
+		     SHA256_ROUNDS("v6")
+		     SHA256_ROUNDS("v7")
+		     "add v0.4s, v0.4s, v2.4s\n\t"
+		     "add v1.4s, v1.4s, v3.4s\n\t"
+		     "subs %[NumberOfBlocks], %[NumberOfBlocks], #1\n\t"
+		     "b.ne 1b\n\t"
+		     "st1 {v0.4s, v1.4s}, [%[State]]\n\t"
+		     : [Data] "+r"(Data), [NumberOfBlocks] "+r"(NumberOfBlocks),
+		       [K] "=&r"(K)
+		     : [State] "r"(State), [K256] "r"(K256)
+		     : "cc", "memory");
+}
+
+/*
+ * 2 rounds with the round constants loaded from K and the message words
+ * in I0, where the state rotates among v0-v4.
+ */
+#define SHA512_ROUNDS_BEGIN(S1, S2, S3, I0)				\
+	"ld1 {v24.2d}, [%[K]], #16\n\t"					\
+	"add v5.2d, v24.2d, " I0 ".2d\n\t"				\
+	"ext v6.16b, v" S2 ".16b, v" S3 ".16b, #8\n\t"			\
+	"ext v5.16b, v5.16b, v5.16b, #8\n\t"				\
+	"ext v7.16b, v" S1 ".16b, v" S2 ".16b, #8\n\t"			\
+	"add v" S3 ".2d, v" S3 ".2d, v5.2d\n\t"
+
+#define SHA512_ROUNDS_END(S0, S1, S3, S4)				\
+	"add v" S4 ".2d, v" S1 ".2d, v" S3 ".2d\n\t"			\
+	"sha512h2 q" S3 ", q" S1 ", v" S0 ".2d\n\t"
+
+#define SHA512_ROUNDS(S0, S1, S2, S3, S4, I0)				\
+	SHA512_ROUNDS_BEGIN(S1, S2, S3, I0)				\
+	"sha512h q" S3 ", q6, v7.2d\n\t"				\
+	SHA512_ROUNDS_END(S0, S1, S3, S4)
+
+/* Also schedule the next message words in I0 */
+#define SHA512_ROUNDS_SCHEDULE(S0, S1, S2, S3, S4, I0, I1, I2, I3, I4)	\
+	SHA512_ROUNDS_BEGIN(S1, S2, S3, I0)				\
+	"ext v5.16b, " I3 ".16b, " I4 ".16b, #8\n\t"			\
+	"sha512su0 " I0 ".2d, " I1 ".2d\n\t"				\
+	"sha512h q" S3 ", q6, v7.2d\n\t"				\
+	"sha512su1 " I0 ".2d, " I2 ".2d, v5.2d\n\t"			\
+	SHA512_ROUNDS_END(S0, S1, S3, S4)
+
+STATIC VOID
+Sha512BlocksCe(VOID *State, CONST UINT8 *Data, UINTN NumberOfBlocks)
+{
+	CONST UINT64 *K;
+
+	/*
+	 * v0-v4: the rotating state, v5-v7 and v24: the temporaries,
+	 * v16-v23: the message schedule, v25-v28: the state of the
+	 * previous block. v8-v15 are not used since they are callee-saved.
+	 */
+	asm volatile(".arch_extension simd\n\t"
+		     ".arch_extension sha3\n\t"
+		     "ld1 {v25.2d-v28.2d}, [%[State]]\n\t"
+		     "1:\n\t"
+		     "ld1 {v16.2d-v19.2d}, [%[Data]], #64\n\t"
+		     "ld1 {v20.2d-v23.2d}, [%[Data]], #64\n\t"
+		     "rev64 v16.16b, v16.16b\n\t"
+		     "rev64 v17.16b, v17.16b\n\t"
+		     "rev64 v18.16b, v18.16b\n\t"
+		     "rev64 v19.16b, v19.16b\n\t"
+		     "rev64 v20.16b, v20.16b\n\t"
+		     "rev64 v21.16b, v21.16b\n\t"
+		     "rev64 v22.16b, v22.16b\n\t"
+		     "rev64 v23.16b, v23.16b\n\t"
+		     "mov %[K], %[K512]\n\t"
+		     "mov v0.16b, v25.16b\n\t"
+		     "mov v1.16b, v26.16b\n\t"
+		     "mov v2.16b, v27.16b\n\t"
+		     "mov v3.16b, v28.16b\n\t"
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v16", "v17", "v23", "v20", "v21")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v17", "v18", "v16", "v21", "v22")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v18", "v19", "v17", "v22", "v23")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v19", "v20", "v18", "v23", "v16")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v20", "v21", "v19", "v16", "v17")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v21", "v22", "v20", "v17", "v18")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v22", "v23", "v21", "v18", "v19")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v23", "v16", "v22", "v19", "v20")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v16", "v17", "v23", "v20", "v21")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v17", "v18", "v16", "v21", "v22")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v18", "v19", "v17", "v22", "v23")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v19", "v20", "v18", "v23", "v16")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v20", "v21", "v19", "v16", "v17")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v21", "v22", "v20", "v17", "v18")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v22", "v23", "v21", "v18", "v19")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v23", "v16", "v22", "v19", "v20")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v16", "v17", "v23", "v20", "v21")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v17", "v18", "v16", "v21", "v22")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v18", "v19", "v17", "v22", "v23")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v19", "v20", "v18", "v23", "v16")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v20", "v21", "v19", "v16", "v17")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v21", "v22", "v20", "v17", "v18")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v22", "v23", "v21", "v18", "v19")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v23", "v16", "v22", "v19", "v20")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v16", "v17", "v23", "v20", "v21")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v17", "v18", "v16", "v21", "v22")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v18", "v19", "v17", "v22", "v23")
+		     SHA512_ROUNDS_SCHEDULE("2", "3", "1", "4", "0",
+					    "v19", "v20", "v18", "v23", "v16")
+		     SHA512_ROUNDS_SCHEDULE("4", "2", "0", "1", "3",
+					    "v20", "v21", "v19", "v16", "v17")
+		     SHA512_ROUNDS_SCHEDULE("1", "4", "3", "0", "2",
+					    "v21", "v22", "v20", "v17", "v18")
+		     SHA512_ROUNDS_SCHEDULE("0", "1", "2", "3", "4",
+					    "v22", "v23", "v21", "v18", "v19")
+		     SHA512_ROUNDS_SCHEDULE("3", "0", "4", "2", "1",
+					    "v23", "v16", "v22", "v19", "v20")
+		     SHA512_ROUNDS("2", "3", "1", "4", "0", "v16")
+		     SHA512_ROUNDS("4", "2", "0", "1", "3", "v17")
+		     SHA512_ROUNDS("1", "4", "3", "0", "2", "v18")
+		     SHA512_ROUNDS("0", "1", "2", "3", "4", "v19")
+		     SHA512_ROUNDS("3", "0", "4", "2", "1", "v20")
+		     SHA512_ROUNDS("2", "3", "1", "4", "0", "v21")
+		     SHA512_ROUNDS("4", "2", "0", "1", "3", "v22")
+		     SHA512_ROUNDS("1", "4", "3", "0", "2", "v23")
+		     "add v25.2d, v25.2d, v0.2d\n\t"
+		     "add v26.2d, v26.2d, v1.2d\n\t"
+		     "add v27.2d, v27.2d, v2.2d\n\t"
+		     "add v28.2d, v28.2d, v3.2d\n\t"
+		     "subs %[NumberOfBlocks], %[NumberOfBlocks], #1\n\t"
+		     "b.ne 1b\n\t"
+		     "st1 {v25.2d-v28.2d}, [%[State]]\n\t"
+		     : [Data] "+r"(Data), [NumberOfBlocks] "+r"(NumberOfBlocks),
+		       [K] "=&r"(K)
+		     : [State] "r"(State), [K512] "r"(K512)
+		     : "cc", "memory");
+}
+#endif
+
+STATIC SHA2_BLOCK_FUNCTION Sha256Blocks = Sha256BlocksGeneric;
+STATIC SHA2_BLOCK_FUNCTION Sha512Blocks = Sha512BlocksGeneric;
+
+STATIC CONST SHA2_ALGORITHM Algorithms[] = {
+	{
+		&gEfiHashAlgorithmSha224Guid, 28, SHA256_BLOCK_SIZE,
+		sizeof(UINT32), InitialState224, &Sha256Blocks
+	},
+	{
+		&gEfiHashAlgorithmSha256Guid, 32, SHA256_BLOCK_SIZE,
+		sizeof(UINT32), InitialState256, &Sha256Blocks
+	},
+	{
+		&gEfiHashAlgorithmSha384Guid, 48, SHA512_BLOCK_SIZE,
+		sizeof(UINT64), InitialState384, &Sha512Blocks
+	},
+	{
+		&gEfiHashAlgorithmSha512Guid, 64, SHA512_BLOCK_SIZE,
+		sizeof(UINT64), InitialState512, &Sha512Blocks
+	},
+};
+
+STATIC CONST SHA2_ALGORITHM *
+LookupAlgorithm(CONST EFI_GUID *HashAlgorithm)
+{
+	if (!HashAlgorithm)
+		return NULL;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Algorithms); ++Index) {
+		if (!MemCmp(Algorithms[Index].HashAlgorithm, HashAlgorithm,
+			    sizeof(*HashAlgorithm)))
+			return Algorithms + Index;
+	}
+
+	return NULL;
+}
+
+STATIC VOID
+Sha2Init(SHA2_CONTEXT *Context, CONST SHA2_ALGORITHM *Algorithm)
+{
+	Context->Algorithm = Algorithm;
+	MemCpy(Context->State, Algorithm->InitialState,
+	       Algorithm->WordSize * 8);
+	Context->Length = 0;
+	Context->BufferSize = 0;
+}
+
+STATIC VOID
+Sha2Update(SHA2_CONTEXT *Context, CONST UINT8 *Message, UINTN MessageSize)
+{
+	CONST SHA2_ALGORITHM *Algorithm = Context->Algorithm;
+	UINTN BlockSize = Algorithm->BlockSize;
+
+	Context->Length += MessageSize;
+
+	if (Context->BufferSize) {
+		UINTN Size = MIN(BlockSize - Context->BufferSize,
+				 MessageSize);
+
+		MemCpy(Context->Buffer + Context->BufferSize, Message, Size);
+		Context->BufferSize += Size;
+		Message += Size;
+		MessageSize -= Size;
+
+		if (Context->BufferSize < BlockSize)
+			return;
+
+		(*Algorithm->Blocks)(Context->State, Context->Buffer, 1);
+		Context->BufferSize = 0;
+	}
+
+	if (MessageSize >= BlockSize) {
+		UINTN NumberOfBlocks = MessageSize / BlockSize;
+
+		(*Algorithm->Blocks)(Context->State, Message, NumberOfBlocks);
+		Message += NumberOfBlocks * BlockSize;
+		MessageSize -= NumberOfBlocks * BlockSize;
+	}
+
+	MemCpy(Context->Buffer, Message, MessageSize);
+	Context->BufferSize = MessageSize;
+}
+
+STATIC VOID
+Sha2Final(SHA2_CONTEXT *Context, UINT8 *Hash)
+{
+	CONST SHA2_ALGORITHM *Algorithm = Context->Algorithm;
+	UINTN BlockSize = Algorithm->BlockSize;
+	/* The message length is encoded in 64 or 128 bits */
+	UINTN LengthSize = Algorithm->WordSize * 2;
+
+	Context->Buffer[Context->BufferSize++] = 0x80;
+
+	if (Context->BufferSize > BlockSize - LengthSize) {
+		MemSet(Context->Buffer + Context->BufferSize, 0,
+		       BlockSize - Context->BufferSize);
+		(*Algorithm->Blocks)(Context->State, Context->Buffer, 1);
+		Context->BufferSize = 0;
+	}
+
+	MemSet(Context->Buffer + Context->BufferSize, 0,
+	       BlockSize - Context->BufferSize);
+	/* The length in bits never exceeds 2^67 */
+	if (LengthSize > sizeof(UINT64))
+		Context->Buffer[BlockSize - 9] = (UINT8)(Context->Length >>
+							 61);
+	WriteBe64(Context->Buffer + BlockSize - 8, Context->Length << 3);
+	(*Algorithm->Blocks)(Context->State, Context->Buffer, 1);
+
+	for (UINTN Index = 0; Index < Algorithm->HashSize; ++Index) {
+		UINTN Word = Index / Algorithm->WordSize;
+		UINTN Shift = (Algorithm->WordSize - 1 -
+			       Index % Algorithm->WordSize) * 8;
+
+		if (Algorithm->WordSize == sizeof(UINT32))
+			Hash[Index] = (UINT8)(((UINT32 *)Context->State)[Word] >>
+					      Shift);
+		else
+			Hash[Index] = (UINT8)(Context->State[Word] >> Shift);
+	}
+
+	Context->Algorithm = NULL;
+}
+
+STATIC EFI_STATUS EFIAPI
+Sha2GetHashSize(IN CONST EFI_HASH2_PROTOCOL *This,
+		IN CONST EFI_GUID *HashAlgorithm, OUT UINTN *HashSize)
+{
+	if (!HashSize)
+		return EFI_INVALID_PARAMETER;
+
+	CONST SHA2_ALGORITHM *Algorithm = LookupAlgorithm(HashAlgorithm);
+
+	if (!Algorithm)
+		return EFI_UNSUPPORTED;
+
+	*HashSize = Algorithm->HashSize;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+Sha2HashInit(IN CONST EFI_HASH2_PROTOCOL *This,
+	     IN CONST EFI_GUID *HashAlgorithm)
+{
+	CONST SHA2_ALGORITHM *Algorithm = LookupAlgorithm(HashAlgorithm);
+
+	if (!Algorithm)
+		return EFI_UNSUPPORTED;
+
+	SHA2_CONTEXT *Context = &((SHA2_INSTANCE *)This)->Context;
+
+	if (Context->Algorithm)
+		return EFI_ALREADY_STARTED;
+
+	Sha2Init(Context, Algorithm);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+Sha2HashUpdate(IN CONST EFI_HASH2_PROTOCOL *This, IN CONST UINT8 *Message,
+	       IN UINTN MessageSize)
+{
+	SHA2_CONTEXT *Context = &((SHA2_INSTANCE *)This)->Context;
+
+	if (!Context->Algorithm)
+		return EFI_NOT_READY;
+
+	Sha2Update(Context, Message, MessageSize);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+Sha2HashFinal(IN CONST EFI_HASH2_PROTOCOL *This, IN OUT EFI_HASH2_OUTPUT *Hash)
+{
+	if (!Hash)
+		return EFI_INVALID_PARAMETER;
+
+	SHA2_CONTEXT *Context = &((SHA2_INSTANCE *)This)->Context;
+
+	if (!Context->Algorithm)
+		return EFI_NOT_READY;
+
+	Sha2Final(Context, (UINT8 *)Hash);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+Sha2Hash(IN CONST EFI_HASH2_PROTOCOL *This, IN CONST EFI_GUID *HashAlgorithm,
+	 IN CONST UINT8 *Message, IN UINTN MessageSize,
+	 IN OUT EFI_HASH2_OUTPUT *Hash)
+{
+	if (!Hash)
+		return EFI_INVALID_PARAMETER;
+
+	CONST SHA2_ALGORITHM *Algorithm = LookupAlgorithm(HashAlgorithm);
+
+	if (!Algorithm)
+		return EFI_UNSUPPORTED;
+
+	/* Don't disturb the ongoing multi-part hash */
+	SHA2_CONTEXT Context;
+
+	Sha2Init(&Context, Algorithm);
+	Sha2Update(&Context, Message, MessageSize);
+	Sha2Final(&Context, (UINT8 *)Hash);
+
+	return EFI_SUCCESS;
+}
+
+STATIC SHA2_INSTANCE Sha2Instance = {
+	{
+		Sha2GetHashSize,
+		Sha2Hash,
+		Sha2HashInit,
+		Sha2HashUpdate,
+		Sha2HashFinal
+	}
+};
+
+/*
+ * The built-in engine is preferred to the firmware only if the CPU
+ * accelerates SHA-256, because the firmware usually hashes in C.
+ */
+BOOLEAN
+Sha2Accelerated(VOID)
+{
+	return !!(CpuFeatures() & CPU_FEATURE_SHA256);
+}
+
+EFI_HASH2_PROTOCOL *
+Sha2ProtocolGet(VOID)
+{
+#ifdef __aarch64__
+	UINT32 Features = CpuFeatures();
+
+	if (Features & CPU_FEATURE_SHA256)
+		Sha256Blocks = Sha256BlocksCe;
+
+	if (Features & CPU_FEATURE_SHA512)
+		Sha512Blocks = Sha512BlocksCe;
+#endif
+
+	return &Sha2Instance.Protocol;
+}
+
+/*
+ * Create a private instance of the built-in engine for a multi-part hash
+ * which may be interleaved with the ones on the shared instance.
+ */
+EFI_STATUS
+Sha2ProtocolCreate(EFI_HASH2_PROTOCOL **Protocol)
+{
+	SHA2_INSTANCE *Instance;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(sizeof(*Instance), (VOID **)&Instance);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemCpy(&Instance->Protocol, Sha2ProtocolGet(),
+	       sizeof(Instance->Protocol));
+	MemSet(&Instance->Context, 0, sizeof(Instance->Context));
+	*Protocol = &Instance->Protocol;
+
+	return EFI_SUCCESS;
+}
+
+VOID
+Sha2ProtocolDestroy(EFI_HASH2_PROTOCOL *Protocol)
+{
+	if (Protocol != &Sha2Instance.Protocol)
+		EfiMemoryFree(Protocol);
+}
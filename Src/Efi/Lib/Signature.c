@@ -252,7 +252,7 @@ VerifySelSignature(SEL_SIGNATURE_CONTEXT *Context, VOID **Data,
 		if (EFI_ERROR(Status))
 			return Status;
 
-		if (MemCmp(Hash, Context->Content, HashSize)) {
+		if (MemCmpConstantTime(Hash, Context->Content, HashSize)) {
 			EfiConsolePrintError(L"Invalid content for hash "
 					     L"comparison\n");
 			EfiMemoryFree(Hash);
@@ -355,6 +355,71 @@ EfiSignatureVerifyAttached(VOID *Signature, UINTN SignatureSize,
 	return EFI_SUCCESS;
 }
 
+/*
+ * Verify the attached signature and return the signed hash instead of
+ * comparing it with the data, so the data can be hashed in pieces.
+ */
+EFI_STATUS
+EfiSignatureVerifyAttachedHash(VOID *Signature, UINTN SignatureSize,
+			       EFI_GUID **HashAlgorithm, UINT8 **Hash,
+			       UINTN *HashSize)
+{
+	if (!Signature || !SignatureSize || !HashAlgorithm || !Hash ||
+	    !HashSize)
+		return EFI_INVALID_PARAMETER;
+
+	VOID *SelSignature = NULL;
+	UINTN SelSignatureSize = 0;
+	EFI_STATUS Status;
+
+	Status = Pkcs7VerifyAttachedSignature(&SelSignature, &SelSignatureSize,
+					      Signature, SignatureSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	SEL_SIGNATURE_CONTEXT SignatureContext;
+
+	Status = ParseSelSignature(SelSignature, SelSignatureSize,
+				   &SignatureContext);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	if (!SignatureContext.HashAlgorithm || !SignatureContext.Content) {
+		EfiConsolePrintError(L"No hash in SELoader signature\n");
+		Status = EFI_UNSUPPORTED;
+		goto out;
+	}
+
+	UINTN Size;
+
+	Status = EfiHashSize(SignatureContext.HashAlgorithm, &Size);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	if (SignatureContext.ContentSize != Size) {
+		EfiConsolePrintError(L"Invalid content size\n");
+		Status = EFI_UNSUPPORTED;
+		goto out;
+	}
+
+	*Hash = MemDup(SignatureContext.Content, Size);
+	if (!*Hash) {
+		Status = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
+
+	*HashAlgorithm = SignatureContext.HashAlgorithm;
+	*HashSize = Size;
+
+	EfiConsolePrintDebug(L"Succeeded to verify the attached signature "
+			     L"for the hash\n");
+
+out:
+	EfiMemoryFree(SelSignature);
+
+	return Status;
+}
+
 EFI_STATUS
 EfiSignatureVerifyBuffer(VOID *Signature, UINTN SignatureSize,
 			 VOID *Data, UINTN DataSize)
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SelStatistics.h>
+
+#include "Internal.h"
+
+EFI_GUID gEfiSelStatisticsProtocolGuid = EFI_SEL_STATISTICS_PROTOCOL_GUID;
+EFI_GUID gSelStatisticsTableGuid = SEL_STATISTICS_TABLE_GUID;
+
+STATIC SEL_STATISTICS Statistics = {
+	.Revision = SEL_STATISTICS_REVISION,
+	.Size = sizeof(SEL_STATISTICS),
+};
+
+STATIC EFI_HANDLE StatisticsHandle;
+STATIC SEL_STATISTICS *StatisticsTable;
+STATIC EFI_EVENT ExitBootServicesEvent;
+
+STATIC VOID
+UpdateStatistics(SEL_STATISTICS *Destination)
+{
+	for (UINTN Phase = 0; Phase < SelProfilePhaseMax; ++Phase)
+		ProfilePhaseQuery(Phase, &Statistics.Phases[Phase].Count,
+				  &Statistics.Phases[Phase].Microseconds);
+
+	if (Destination)
+		MemCpy(Destination, &Statistics, sizeof(Statistics));
+}
+
+VOID
+StatisticsFileVerified(EFI_STATUS Status, UINT64 Start)
+{
+	if (EFI_ERROR(Status)) {
+		++Statistics.FilesFailed;
+		return;
+	}
+
+	++Statistics.FilesVerified;
+
+	UINT64 Microseconds = ProfileElapsedMicroseconds(Start);
+	UINTN Bucket = 0;
+
+	while (Microseconds >>= 1)
+		++Bucket;
+
+	if (Bucket >= SEL_STATISTICS_LATENCY_BUCKETS)
+		Bucket = SEL_STATISTICS_LATENCY_BUCKETS - 1;
+
+	++Statistics.VerifyLatency[Bucket];
+}
+
+VOID
+StatisticsHashed(UINTN Size)
+{
+	Statistics.BytesHashed += Size;
+}
+
+VOID
+StatisticsCacheHit(VOID)
+{
+	++Statistics.CacheHits;
+}
+
+VOID
+StatisticsHashProviderSet(SEL_PROVIDER Provider)
+{
+	Statistics.HashProvider = Provider;
+}
+
+VOID
+StatisticsPkcs7ProviderSet(SEL_PROVIDER Provider)
+{
+	Statistics.Pkcs7Provider = Provider;
+}
+
+/*
+ * Refresh the configuration table so the latest statistics are visible
+ * to the OS.
+ */
+VOID
+StatisticsPublish(VOID)
+{
+	if (StatisticsTable)
+		UpdateStatistics(StatisticsTable);
+}
+
+STATIC EFI_STATUS EFIAPI
+GetStatistics(IN EFI_SEL_STATISTICS_PROTOCOL *This,
+	      OUT SEL_STATISTICS *Destination, IN OUT UINTN *DestinationSize)
+{
+	if (!This || !DestinationSize)
+		return EFI_INVALID_PARAMETER;
+
+	if (!Destination || !*DestinationSize) {
+		*DestinationSize = sizeof(Statistics);
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	/*
+	 * The caller built against an earlier revision gets the members it
+	 * knows, as the new ones are only appended.
+	 */
+	UpdateStatistics(NULL);
+	MemCpy(Destination, &Statistics,
+	       MIN(*DestinationSize, sizeof(Statistics)));
+	*DestinationSize = sizeof(Statistics);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_SEL_STATISTICS_PROTOCOL SelStatisticsProtocol = {
+	1,
+	GetStatistics
+};
+
+STATIC VOID EFIAPI
+OnExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+	/* No boot service is called */
+	StatisticsPublish();
+}
+
+STATIC EFI_STATUS
+InstallStatisticsTable(VOID)
+{
+	EFI_STATUS Status;
+
+	/* The table must survive ExitBootServices() */
+	Status = gBS->AllocatePool(EfiRuntimeServicesData,
+				   sizeof(*StatisticsTable),
+				   (VOID **)&StatisticsTable);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UpdateStatistics(StatisticsTable);
+
+	Status = gBS->InstallConfigurationTable(&gSelStatisticsTableGuid,
+						StatisticsTable);
+	if (EFI_ERROR(Status))
+		goto ErrOnInstallTable;
+
+	Status = gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+				  OnExitBootServices, NULL,
+				  &ExitBootServicesEvent);
+	if (EFI_ERROR(Status))
+		goto ErrOnCreateEvent;
+
+	return EFI_SUCCESS;
+
+ErrOnCreateEvent:
+	gBS->InstallConfigurationTable(&gSelStatisticsTableGuid, NULL);
+
+ErrOnInstallTable:
+	gBS->FreePool(StatisticsTable);
+	StatisticsTable = NULL;
+
+	return Status;
+}
+
+EFI_STATUS
+StatisticsInitialize(VOID)
+{
+	EFI_STATUS Status;
+
+	Status = EfiProtocolInstall(&StatisticsHandle,
+				    &gEfiSelStatisticsProtocolGuid,
+				    (VOID *)&SelStatisticsProtocol);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to install SELoader Statistics "
+				     L"Protocol (err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	Status = InstallStatisticsTable();
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to install SELoader statistics "
+				     L"table (err: 0x%x)\n", Status);
+
+	EfiConsoleTraceDebug(L"SELoader Statistics Protocol installed\n");
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+#include "Internal.h"
+
+/*
+ * The sections of Unified Kernel Image (UKI) created by systemd-stub or
+ * ukify.
+ */
+typedef enum {
+	UkiSectionLinux,
+	UkiSectionInitrd,
+	UkiSectionCmdline,
+	UkiSectionOsrel,
+	UkiSectionMax
+} UKI_SECTION;
+
+STATIC CONST CHAR8 *UkiSectionNames[UkiSectionMax] = {
+	[UkiSectionLinux] = ".linux",
+	[UkiSectionInitrd] = ".initrd",
+	[UkiSectionCmdline] = ".cmdline",
+	[UkiSectionOsrel] = ".osrel",
+};
+
+typedef struct {
+	VOID *Data;
+	UINTN DataSize;
+} UKI_SECTION_DATA;
+
+STATIC BOOLEAN
+SectionNameMatch(CONST UINT8 *SectionName, CONST CHAR8 *Name)
+{
+	UINTN Index;
+
+	for (Index = 0; Index < EFI_IMAGE_SIZEOF_SHORT_NAME && Name[Index];
+	     ++Index) {
+		if (SectionName[Index] != (UINT8)Name[Index])
+			return FALSE;
+	}
+
+	return Index == EFI_IMAGE_SIZEOF_SHORT_NAME || !SectionName[Index];
+}
+
+/*
+ * Locate the UKI sections in the file buffer. All the sections refer to
+ * the file buffer so nothing is copied.
+ */
+STATIC EFI_STATUS
+ParseSections(VOID *Data, UINTN DataSize, UKI_SECTION_DATA *Sections)
+{
+	EFI_IMAGE_DOS_HEADER *DosHeader = Data;
+
+	if (DataSize < sizeof(*DosHeader) ||
+	    DosHeader->e_magic != EFI_IMAGE_DOS_SIGNATURE)
+		return EFI_UNSUPPORTED;
+
+	UINTN Offset = DosHeader->e_lfanew;
+
+	if (Offset > DataSize ||
+	    DataSize - Offset < sizeof(EFI_IMAGE_NT_HEADERS32))
+		return EFI_UNSUPPORTED;
+
+	EFI_IMAGE_NT_HEADERS32 *NtHeader;
+
+	NtHeader = (EFI_IMAGE_NT_HEADERS32 *)((UINT8 *)Data + Offset);
+	if (NtHeader->Signature != EFI_IMAGE_NT_SIGNATURE)
+		return EFI_UNSUPPORTED;
+
+	/* The file header is shared by PE32 and PE32+ */
+	UINTN NumberOfSections = NtHeader->FileHeader.NumberOfSections;
+
+	Offset += OFFSET_OF(EFI_IMAGE_NT_HEADERS32, OptionalHeader) +
+		  NtHeader->FileHeader.SizeOfOptionalHeader;
+	if (Offset > DataSize || (DataSize - Offset) /
+	    sizeof(EFI_IMAGE_SECTION_HEADER) < NumberOfSections)
+		return EFI_UNSUPPORTED;
+
+	EFI_IMAGE_SECTION_HEADER *SectionHeader;
+
+	SectionHeader = (EFI_IMAGE_SECTION_HEADER *)((UINT8 *)Data + Offset);
+
+	for (UINTN Index = 0; Index < NumberOfSections; ++Index,
+	     ++SectionHeader) {
+		UINTN Section;
+
+		for (Section = 0; Section < UkiSectionMax; ++Section) {
+			if (SectionNameMatch(SectionHeader->Name,
+					     UkiSectionNames[Section]) == TRUE)
+				break;
+		}
+
+		if (Section == UkiSectionMax)
+			continue;
+
+		/* The raw data is padded to the file alignment */
+		UINTN SectionSize = SectionHeader->Misc.VirtualSize;
+
+		if (SectionSize > SectionHeader->SizeOfRawData)
+			SectionSize = SectionHeader->SizeOfRawData;
+
+		if (SectionHeader->PointerToRawData > DataSize ||
+		    DataSize - SectionHeader->PointerToRawData < SectionSize) {
+			EfiConsolePrintError(L"Invalid UKI section %d\n",
+					     Index);
+			return EFI_UNSUPPORTED;
+		}
+
+		Sections[Section].Data = (UINT8 *)Data +
+					 SectionHeader->PointerToRawData;
+		Sections[Section].DataSize = SectionSize;
+
+		EfiConsolePrintDebug(L"UKI section %d found (%d-byte)\n",
+				     Section, SectionSize);
+	}
+
+	if (!Sections[UkiSectionLinux].DataSize) {
+		EfiConsolePrintError(L"No .linux section found in UKI\n");
+		return EFI_UNSUPPORTED;
+	}
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * The whole UKI is verified only once. Verifying it implies verifying
+ * all the embedded sections.
+ */
+STATIC EFI_STATUS
+VerifyImage(CONST CHAR16 *Path, VOID *Data, UINTN DataSize)
+{
+	if (EfiSecurityPolicySecureBootEnabled() == FALSE) {
+		EfiConsolePrintDebug(L"Ignore to verify UKI %s due to Secure "
+				     L"Boot disabled\n", Path);
+		return EFI_SUCCESS;
+	}
+
+	EFI_STATUS Status;
+
+	Status = MokVerifyPeImage(Data, DataSize);
+	if (EFI_ERROR(Status))
+		Status = ImageVerify(Path, Data, DataSize);
+
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to verify UKI %s (err: 0x%x)\n",
+				     Path, Status);
+	else
+		EfiConsolePrintDebug(L"Succeeded to verify UKI %s\n", Path);
+
+	return Status;
+}
+
+STATIC CHAR16 *
+ConvertCmdline(CONST CHAR8 *Cmdline, UINTN CmdlineSize)
+{
+	CHAR16 *LoadOptions;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate((CmdlineSize + 1) * sizeof(CHAR16),
+				   (VOID **)&LoadOptions);
+	if (EFI_ERROR(Status))
+		return NULL;
+
+	UINTN Index;
+
+	for (Index = 0; Index < CmdlineSize && Cmdline[Index]; ++Index) {
+		if (Cmdline[Index] == '\n' || Cmdline[Index] == '\r')
+			LoadOptions[Index] = L' ';
+		else
+			LoadOptions[Index] = (CHAR16)(UINT8)Cmdline[Index];
+	}
+	LoadOptions[Index] = L'\0';
+
+	return LoadOptions;
+}
+
+EFI_STATUS
+EfiUkiExecute(CONST CHAR16 *Path, CONST CHAR16 *LoadOptions)
+{
+	if (!Path)
+		return EFI_INVALID_PARAMETER;
+
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	Status = EfiFileRead(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to read UKI %s (err: 0x%x)\n",
+				     Path, Status);
+		return Status;
+	}
+
+	UKI_SECTION_DATA Sections[UkiSectionMax];
+
+	MemSet(Sections, 0, sizeof(Sections));
+
+	Status = ParseSections(Data, DataSize, Sections);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to parse UKI %s (err: 0x%x)\n",
+				     Path, Status);
+		goto ErrOnParseSections;
+	}
+
+	Status = VerifyImage(Path, Data, DataSize);
+	if (EFI_ERROR(Status))
+		goto ErrOnVerifyImage;
+
+	/* The embedded command line is covered by the signature of UKI */
+	CHAR16 *Cmdline = NULL;
+
+	if (Sections[UkiSectionCmdline].DataSize) {
+		Cmdline = ConvertCmdline(Sections[UkiSectionCmdline].Data,
+					 Sections[UkiSectionCmdline].DataSize);
+		if (!Cmdline) {
+			Status = EFI_OUT_OF_RESOURCES;
+			goto ErrOnConvertCmdline;
+		}
+
+		LoadOptions = Cmdline;
+	}
+
+	if (Sections[UkiSectionInitrd].DataSize) {
+		Status = EfiInitrdAdd(Sections[UkiSectionInitrd].Data,
+				      Sections[UkiSectionInitrd].DataSize);
+		if (!EFI_ERROR(Status))
+			Status = EfiInitrdInstall();
+
+		if (EFI_ERROR(Status))
+			goto ErrOnInstallInitrd;
+	}
+
+	/*
+	 * Start the kernel from .linux in place. It is trusted because the
+	 * UKI is already verified.
+	 */
+	Status = ImageExecuteTrusted(Path, Sections[UkiSectionLinux].Data,
+				     Sections[UkiSectionLinux].DataSize,
+				     LoadOptions);
+
+ErrOnInstallInitrd:
+	if (Sections[UkiSectionInitrd].DataSize)
+		EfiInitrdUninstall();
+
+	if (Cmdline)
+		EfiMemoryFree(Cmdline);
+
+ErrOnConvertCmdline:
+ErrOnVerifyImage:
+ErrOnParseSections:
+	EfiMemoryFree(Data);
+
+	return Status;
+}
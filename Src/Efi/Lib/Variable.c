@@ -35,6 +35,8 @@
 #include <EfiLibrary.h>
 #include <BaseLibrary.h>
 
+#include "Internal.h"
+
 #if GNU_EFI_VERSION <= 303
 EFI_GUID gEfiGlobalVariableGuid = EFI_GLOBAL_VARIABLE;
 #endif
@@ -46,9 +48,9 @@ EFI_GUID gEfiGlobalVariableGuid = EFI_GLOBAL_VARIABLE;
  * DataSize == NULL: Ignore the size of variable
  * *Data == NULL: Return the buffer of variable
  */
-EFI_STATUS
-EfiVariableRead(CONST CHAR16 *VariableName, CONST EFI_GUID *VendorGuid,
-		UINT32 *Attributes, VOID **Data, UINTN *DataSize)
+STATIC EFI_STATUS
+ReadVariable(CONST CHAR16 *VariableName, CONST EFI_GUID *VendorGuid,
+	     UINT32 *Attributes, VOID **Data, UINTN *DataSize)
 {
 	UINTN BufferSize;
 	EFI_STATUS Status;
@@ -97,6 +99,21 @@ EfiVariableRead(CONST CHAR16 *VariableName, CONST EFI_GUID *VendorGuid,
         return Status;
 }
 
+EFI_STATUS
+EfiVariableRead(CONST CHAR16 *VariableName, CONST EFI_GUID *VendorGuid,
+		UINT32 *Attributes, VOID **Data, UINTN *DataSize)
+{
+	UINT64 ProfileTimestamp = ProfileStart();
+	EFI_STATUS Status;
+
+	Status = ReadVariable(VariableName, VendorGuid, Attributes, Data,
+			      DataSize);
+
+	ProfileStop(SelProfilePhaseVariableRead, ProfileTimestamp);
+
+	return Status;
+}
+
 EFI_STATUS
 EfiVariableWrite(CONST CHAR16 *VariableName, CONST EFI_GUID *VendorGuid,
 		 UINT32 Attributes, VOID *Data, UINTN DataSize)
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+
+#include "Internal.h"
+
+/*
+ * The verified table lists the files whose content SELoader has compared
+ * with the digest attested by their .p7b signatures, along with the hash
+ * of the signer certificate. It is published as a configuration table in
+ * the runtime memory, so the OS, e.g, IMA or an attestation agent, can
+ * take the digests instead of hashing the kernel and initrd again.
+ *
+ * The content verified with .p7a or .p7s is not listed because no digest
+ * is attested for it.
+ */
+
+#define MAX_VERIFIED_RECORDS		64
+
+EFI_GUID gSelVerifiedTableGuid = SEL_VERIFIED_TABLE_GUID;
+
+STATIC SEL_VERIFIED_TABLE *VerifiedTable;
+
+STATIC SEL_VERIFIED_FILE_RECORD *
+VerifiedRecords(VOID)
+{
+	return (SEL_VERIFIED_FILE_RECORD *)(VerifiedTable + 1);
+}
+
+/* The absolute path on ESP with the backslash separators */
+STATIC EFI_STATUS
+CreateRecordPath(CONST CHAR16 *Path, CHAR16 *RecordPath, UINT32 *Flags)
+{
+	CHAR16 *FilePath;
+	EFI_STATUS Status;
+
+	Status = EfiDevicePathCreate(Path, &FilePath);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINTN Length = StrLen(FilePath);
+
+	if (Length >= SelVerifiedPathLength) {
+		Length = SelVerifiedPathLength - 1;
+		*Flags |= SelVerifiedFileFlagsPathTruncated;
+	}
+
+	for (UINTN Index = 0; Index < Length; ++Index)
+		RecordPath[Index] = FilePath[Index] == L'/' ? L'\\' :
+							       FilePath[Index];
+	RecordPath[Length] = 0;
+
+	EfiMemoryFree(FilePath);
+
+	return EFI_SUCCESS;
+}
+
+/* The latest result replaces the record of the same file */
+STATIC SEL_VERIFIED_FILE_RECORD *
+LookupRecord(CONST CHAR16 *RecordPath)
+{
+	SEL_VERIFIED_FILE_RECORD *Records = VerifiedRecords();
+
+	for (UINTN Index = 0; Index < VerifiedTable->NumberOfRecords;
+	     ++Index) {
+		if (!StrCaseCmp(Records[Index].Path, RecordPath,
+				SelVerifiedPathLength))
+			return Records + Index;
+	}
+
+	if (VerifiedTable->NumberOfRecords == VerifiedTable->MaxRecords)
+		return NULL;
+
+	return Records + VerifiedTable->NumberOfRecords++;
+}
+
+BOOLEAN
+VerifiedTableEnabled(VOID)
+{
+	return VerifiedTable ? TRUE : FALSE;
+}
+
+/*
+ * Identify the signer with the SHA-256 of its certificate carried in the
+ * signature. The certificate must have been verified by the caller.
+ */
+VOID
+VerifiedTableSigner(CONST VOID *Signature, UINTN SignatureSize,
+		    VERIFIED_SIGNER *Signer)
+{
+	Signer->Valid = FALSE;
+
+	if (VerifiedTableEnabled() == FALSE)
+		return;
+
+	CONST UINT8 *Certificate;
+	UINTN CertificateSize;
+	EFI_STATUS Status;
+
+	Status = Pkcs7SignerCertificate(Signature, SignatureSize,
+					&Certificate, &CertificateSize);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintDebug(L"Unable to locate the signer "
+				     L"certificate (err: 0x%x)\n", Status);
+		return;
+	}
+
+	UINT8 *Hash;
+	UINTN HashSize;
+
+	Status = EfiHashData(&gEfiHashAlgorithmSha256Guid, Certificate,
+			     CertificateSize, &Hash, &HashSize);
+	if (EFI_ERROR(Status))
+		return;
+
+	if (HashSize == sizeof(Signer->Hash)) {
+		MemCpy(Signer->Hash, Hash, HashSize);
+		Signer->Valid = TRUE;
+	}
+
+	EfiMemoryFree(Hash);
+}
+
+/*
+ * Record the file whose content is verified with the digest Hash. The
+ * verification started at ProfileTimestamp.
+ */
+VOID
+VerifiedTableAdd(CONST CHAR16 *Path, UINTN DataSize,
+		 CONST EFI_GUID *HashAlgorithm, CONST UINT8 *Hash,
+		 UINTN HashSize, CONST VERIFIED_SIGNER *Signer,
+		 UINT64 ProfileTimestamp)
+{
+	if (VerifiedTableEnabled() == FALSE)
+		return;
+
+	SEL_VERIFIED_FILE_RECORD Record;
+
+	if (HashSize > sizeof(Record.Hash))
+		return;
+
+	MemSet(&Record, 0, sizeof(Record));
+
+	EFI_STATUS Status;
+
+	Status = CreateRecordPath(Path, Record.Path, &Record.Flags);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to record the verified file "
+				     L"%s (err: 0x%x)\n", Path, Status);
+		return;
+	}
+
+	Record.Size = DataSize;
+	Record.HashAlgorithm = *HashAlgorithm;
+	Record.HashSize = (UINT32)HashSize;
+	MemCpy(Record.Hash, Hash, HashSize);
+
+	if (Signer && Signer->Valid == TRUE)
+		MemCpy(Record.SignerHash, Signer->Hash,
+		       sizeof(Record.SignerHash));
+	else
+		Record.Flags |= SelVerifiedFileFlagsSignerUnknown;
+
+	Record.Timestamp = ProfileLaunchElapsedMicroseconds();
+	Record.Microseconds = ProfileElapsedMicroseconds(ProfileTimestamp);
+
+	SEL_VERIFIED_FILE_RECORD *Slot = LookupRecord(Record.Path);
+
+	if (!Slot) {
+		EfiConsolePrintDebug(L"No room to record the verified file "
+				     L"%s\n", Path);
+		VerifiedTable->Flags |= SelVerifiedTableFlagsTruncated;
+		return;
+	}
+
+	MemCpy(Slot, &Record, sizeof(Record));
+}
+
+EFI_STATUS
+EfiVerifiedTableEnable(VOID)
+{
+	if (VerifiedTable)
+		return EFI_SUCCESS;
+
+	SEL_VERIFIED_TABLE *Table;
+	EFI_STATUS Status;
+
+	/* The table must survive ExitBootServices() */
+	Status = gBS->AllocatePool(EfiRuntimeServicesData,
+				   sizeof(*Table) + MAX_VERIFIED_RECORDS *
+				   sizeof(SEL_VERIFIED_FILE_RECORD),
+				   (VOID **)&Table);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to allocate the verified table "
+				     L"(err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	MemSet(Table, 0, sizeof(*Table));
+	Table->Revision = SelVerifiedTableRevision;
+	Table->HeaderSize = sizeof(*Table);
+	Table->RecordSize = sizeof(SEL_VERIFIED_FILE_RECORD);
+	Table->MaxRecords = MAX_VERIFIED_RECORDS;
+
+	Status = gBS->InstallConfigurationTable(&gSelVerifiedTableGuid, Table);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to install the verified table "
+				     L"(err: 0x%x)\n", Status);
+		gBS->FreePool(Table);
+		return Status;
+	}
+
+	VerifiedTable = Table;
+
+	EfiConsolePrintDebug(L"Verified table enabled\n");
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,677 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+
+#include "Internal.h"
+
+/*
+ * The verification cache remembers the digests attested by the .p7b
+ * signatures verified in the previous boots, so the next boot only has
+ * to compare the hash of the content.
+ *
+ * The cache is kept in a non-volatile variable only accessible in boot
+ * services, authenticated with a HMAC-SHA256 keyed by another one. The
+ * key is wiped from the memory at ExitBootServices() so the OS can
+ * neither read nor forge the cache. The whole cache is dropped as soon
+ * as the fingerprint of the security policy (db, dbx, MokList and
+ * MokListXRT) changes.
+ *
+ * The new entries are written at most once per boot, before starting the
+ * boot target or at the beginning of ExitBootServices(), to limit the
+ * wear of the flash. The least recently used entry is evicted if full.
+ */
+
+EFI_GUID gEfiRngProtocolGuid = EFI_RNG_PROTOCOL_GUID;
+
+/* EFI_EVENT_GROUP_BEFORE_EXIT_BOOT_SERVICES defined in UEFI 2.8 */
+STATIC EFI_GUID BeforeExitBootServicesGuid = {
+	0x8be0e274, 0x3970, 0x4b44,
+	{ 0x80, 0xc5, 0x1a, 0xb9, 0x50, 0x2f, 0x3b, 0xfc }
+};
+
+#define VERIFY_CACHE_VARIABLE		L"SELoaderVerifyCache"
+#define VERIFY_CACHE_KEY_VARIABLE	L"SELoaderVerifyCacheKey"
+#define VERIFY_CACHE_ATTRIBUTES		(EFI_VARIABLE_NON_VOLATILE | \
+					 EFI_VARIABLE_BOOTSERVICE_ACCESS)
+#define VERIFY_CACHE_MAGIC		0x43565353	/* SSVC */
+#define VERIFY_CACHE_REVISION		2
+/* Below 8KB, the default maximum variable size of EDK2 */
+#define MAX_VERIFY_CACHE_ENTRIES	64
+#define VERIFY_CACHE_KEY_SIZE		32
+#define HMAC_SHA256_BLOCK_SIZE		64
+
+typedef struct {
+	UINT8 Tag[VERIFY_CACHE_DIGEST_SIZE];
+	UINT8 HashAlgorithm;
+	UINT8 HashSize;
+	UINT8 Reserved[6];
+	EFI_SHA512_HASH2 Hash;
+} VERIFY_CACHE_ENTRY;
+
+typedef struct {
+	UINT32 Magic;
+	UINT32 Revision;
+	UINT32 NumberOfEntries;
+	UINT32 Reserved;
+	UINT8 PolicyFingerprint[VERIFY_CACHE_DIGEST_SIZE];
+	VERIFY_CACHE_ENTRY Entries[MAX_VERIFY_CACHE_ENTRIES];
+	UINT8 Mac[VERIFY_CACHE_DIGEST_SIZE];
+} VERIFY_CACHE;
+
+STATIC EFI_GUID *HashAlgorithms[] = {
+	&gEfiHashAlgorithmSha1Guid,
+	&gEfiHashAlgorithmSha224Guid,
+	&gEfiHashAlgorithmSha256Guid,
+	&gEfiHashAlgorithmSha384Guid,
+	&gEfiHashAlgorithmSha512Guid,
+};
+
+STATIC BOOLEAN VerifyCacheRequested;
+STATIC BOOLEAN VerifyCacheLoaded;
+STATIC UINT8 Key[VERIFY_CACHE_KEY_SIZE];
+STATIC VERIFY_CACHE Cache;
+/* Set if the entries are changed since loaded */
+STATIC BOOLEAN CacheDirty;
+STATIC EFI_EVENT ExitBootServicesEvent;
+STATIC EFI_EVENT BeforeExitBootServicesEvent;
+
+STATIC EFI_STATUS
+Sha256Finalize(EFI_HASH_CONTEXT *Context, UINT8 *Digest)
+{
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_STATUS Status;
+
+	Status = EfiHashFinalize(Context, &Hash, &HashSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemCpy(Digest, Hash, VERIFY_CACHE_DIGEST_SIZE);
+	EfiMemoryFree(Hash);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+Sha256Data(CONST VOID *Data, UINTN DataSize, UINT8 *Digest)
+{
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_STATUS Status;
+
+	Status = EfiHashData(&gEfiHashAlgorithmSha256Guid, Data, DataSize,
+			     &Hash, &HashSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemCpy(Digest, Hash, VERIFY_CACHE_DIGEST_SIZE);
+	EfiMemoryFree(Hash);
+
+	return EFI_SUCCESS;
+}
+
+/* HMAC-SHA256 as defined in RFC 2104 */
+STATIC EFI_STATUS
+ComputeMac(CONST VOID *Data, UINTN DataSize, UINT8 *Mac)
+{
+	UINT8 Pad[HMAC_SHA256_BLOCK_SIZE];
+	UINT8 InnerDigest[VERIFY_CACHE_DIGEST_SIZE];
+	EFI_HASH_CONTEXT Context;
+	EFI_STATUS Status;
+
+	MemSet(Pad, 0x36, sizeof(Pad));
+	for (UINTN Index = 0; Index < sizeof(Key); ++Index)
+		Pad[Index] ^= Key[Index];
+
+	Status = EfiHashInitializeIsolated(&gEfiHashAlgorithmSha256Guid,
+					   &Context);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	Status = EfiHashUpdate(&Context, Pad, sizeof(Pad));
+	if (!EFI_ERROR(Status))
+		Status = EfiHashUpdate(&Context, Data, DataSize);
+	if (EFI_ERROR(Status)) {
+		EfiHashFinalize(&Context, NULL, NULL);
+		goto out;
+	}
+
+	Status = Sha256Finalize(&Context, InnerDigest);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	MemSet(Pad, 0x5c, sizeof(Pad));
+	for (UINTN Index = 0; Index < sizeof(Key); ++Index)
+		Pad[Index] ^= Key[Index];
+
+	Status = EfiHashInitializeIsolated(&gEfiHashAlgorithmSha256Guid,
+					   &Context);
+	if (EFI_ERROR(Status))
+		goto out;
+
+	Status = EfiHashUpdate(&Context, Pad, sizeof(Pad));
+	if (!EFI_ERROR(Status))
+		Status = EfiHashUpdate(&Context, InnerDigest,
+				       sizeof(InnerDigest));
+	if (EFI_ERROR(Status)) {
+		EfiHashFinalize(&Context, NULL, NULL);
+		goto out;
+	}
+
+	Status = Sha256Finalize(&Context, Mac);
+
+out:
+	MemSet(Pad, 0, sizeof(Pad));
+
+	return Status;
+}
+
+/*
+ * Any change to the objects consulted by the PKCS#7 verification
+ * results in a different fingerprint.
+ */
+STATIC EFI_STATUS
+ComputePolicyFingerprint(UINT8 *Fingerprint)
+{
+	STATIC CONST CHAR16 *PolicyObjects[] = {
+		EFI_IMAGE_SECURITY_DATABASE,
+		EFI_IMAGE_SECURITY_DATABASE1,
+		L"MokList",
+		L"MokListXRT",
+	};
+	EFI_HASH_CONTEXT Context;
+	EFI_STATUS Status;
+
+	Status = EfiHashInitializeIsolated(&gEfiHashAlgorithmSha256Guid,
+					   &Context);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	BOOLEAN State[2] = {
+		EfiSecurityPolicySecureBootEnabled(),
+		EfiSecurityPolicyMokVerifyProtocolInstalled(),
+	};
+
+	Status = EfiHashUpdate(&Context, (UINT8 *)State, sizeof(State));
+	if (EFI_ERROR(Status))
+		goto out;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(PolicyObjects); ++Index) {
+		EFI_SIGNATURE_LIST *List = NULL;
+		UINTN ListSize = 0;
+
+		Status = EfiSecurityPolicyLoad(PolicyObjects[Index], &List,
+					       &ListSize);
+		if (EFI_ERROR(Status) && Status != EFI_NOT_FOUND)
+			goto out;
+
+		UINT64 Size = ListSize;
+
+		Status = EfiHashUpdate(&Context, (UINT8 *)PolicyObjects[Index],
+				       (StrLen(PolicyObjects[Index]) + 1) *
+				       sizeof(CHAR16));
+		if (!EFI_ERROR(Status))
+			Status = EfiHashUpdate(&Context, (UINT8 *)&Size,
+					       sizeof(Size));
+		if (!EFI_ERROR(Status) && ListSize)
+			Status = EfiHashUpdate(&Context, (UINT8 *)List,
+					       ListSize);
+		if (List)
+			EfiSecurityPolicyFree(&List);
+		if (EFI_ERROR(Status))
+			goto out;
+	}
+
+	return Sha256Finalize(&Context, Fingerprint);
+
+out:
+	EfiHashFinalize(&Context, NULL, NULL);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+CreateKey(VOID)
+{
+	EFI_RNG_PROTOCOL *Rng;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(&gEfiRngProtocolGuid, (VOID **)&Rng);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to find RNG protocol for "
+				     L"the verification cache key (err: "
+				     L"0x%x)\n", Status);
+		return Status;
+	}
+
+	Status = Rng->GetRNG(Rng, NULL, sizeof(Key), Key);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to generate the verification "
+				     L"cache key (err: 0x%x)\n", Status);
+		return Status;
+	}
+
+	/* A key with the wrong attributes cannot be overwritten in place */
+	EfiVariableDelete(VERIFY_CACHE_KEY_VARIABLE, &gSELoaderVendorGuid);
+
+	Status = EfiVariableWrite(VERIFY_CACHE_KEY_VARIABLE,
+				  &gSELoaderVendorGuid,
+				  VERIFY_CACHE_ATTRIBUTES, Key, sizeof(Key));
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to save the verification "
+				     L"cache key (err: 0x%x)\n", Status);
+
+	return Status;
+}
+
+/*
+ * The key is only trusted if the variable cannot be written at runtime,
+ * otherwise a new one is generated and the cache signed with the old
+ * one becomes invalid.
+ */
+STATIC EFI_STATUS
+LoadKey(VOID)
+{
+	UINT32 Attributes;
+	VOID *Data = NULL;
+	UINTN DataSize = 0;
+	EFI_STATUS Status;
+
+	Status = EfiVariableRead(VERIFY_CACHE_KEY_VARIABLE,
+				 &gSELoaderVendorGuid, &Attributes, &Data,
+				 &DataSize);
+	if (EFI_ERROR(Status))
+		return CreateKey();
+
+	if (Attributes != VERIFY_CACHE_ATTRIBUTES ||
+	    DataSize != sizeof(Key)) {
+		EfiConsolePrintDebug(L"Discarding the invalid verification "
+				     L"cache key\n");
+		MemSet(Data, 0, DataSize);
+		EfiMemoryFree(Data);
+		return CreateKey();
+	}
+
+	MemCpy(Key, Data, sizeof(Key));
+	MemSet(Data, 0, DataSize);
+	EfiMemoryFree(Data);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+LoadEntries(CONST UINT8 *PolicyFingerprint)
+{
+	UINT32 Attributes;
+	VOID *Data = NULL;
+	UINTN DataSize = 0;
+	EFI_STATUS Status;
+
+	Status = EfiVariableRead(VERIFY_CACHE_VARIABLE, &gSELoaderVendorGuid,
+				 &Attributes, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	VERIFY_CACHE *Saved = Data;
+	UINT8 Mac[VERIFY_CACHE_DIGEST_SIZE];
+
+	Status = EFI_COMPROMISED_DATA;
+
+	if (Attributes != VERIFY_CACHE_ATTRIBUTES ||
+	    DataSize != sizeof(*Saved) ||
+	    Saved->Magic != VERIFY_CACHE_MAGIC ||
+	    Saved->Revision != VERIFY_CACHE_REVISION ||
+	    Saved->NumberOfEntries > MAX_VERIFY_CACHE_ENTRIES)
+		goto out;
+
+	if (EFI_ERROR(ComputeMac(Saved, OFFSET_OF(VERIFY_CACHE, Mac), Mac)) ||
+	    MemCmpConstantTime(Mac, Saved->Mac, sizeof(Mac))) {
+		EfiConsolePrintError(L"The verification cache is not "
+				     L"authentic\n");
+		goto out;
+	}
+
+	if (MemCmp(Saved->PolicyFingerprint, PolicyFingerprint,
+		   VERIFY_CACHE_DIGEST_SIZE)) {
+		EfiConsolePrintInfo(L"Security policy changed, dropping the "
+				    L"verification cache\n");
+		Status = EFI_NOT_FOUND;
+		goto out;
+	}
+
+	MemCpy(&Cache, Saved, sizeof(Cache));
+	Status = EFI_SUCCESS;
+
+out:
+	EfiMemoryFree(Data);
+
+	return Status;
+}
+
+STATIC VOID
+SaveEntries(VOID)
+{
+	EFI_STATUS Status;
+
+	Status = ComputeMac(&Cache, OFFSET_OF(VERIFY_CACHE, Mac), Cache.Mac);
+	if (!EFI_ERROR(Status))
+		Status = EfiVariableWrite(VERIFY_CACHE_VARIABLE,
+					  &gSELoaderVendorGuid,
+					  VERIFY_CACHE_ATTRIBUTES, &Cache,
+					  sizeof(Cache));
+	if (EFI_ERROR(Status))
+		EfiConsolePrintError(L"Failed to save the verification "
+				     L"cache (err: 0x%x)\n", Status);
+}
+
+STATIC VOID
+WipeCache(VOID)
+{
+	MemSet(Key, 0, sizeof(Key));
+	MemSet(&Cache, 0, sizeof(Cache));
+	CacheDirty = FALSE;
+	VerifyCacheRequested = FALSE;
+}
+
+STATIC VOID EFIAPI
+OnExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+	/* No boot service is called */
+	WipeCache();
+}
+
+/* The variable is still writable before ExitBootServices() proceeds */
+STATIC VOID EFIAPI
+OnBeforeExitBootServices(IN EFI_EVENT Event, IN VOID *Context)
+{
+	VerifyCacheFlush();
+}
+
+/*
+ * Load the cache upon the first use because computing the policy
+ * fingerprint reads all the security policy objects.
+ */
+STATIC EFI_STATUS
+LoadCache(VOID)
+{
+	if (VerifyCacheLoaded == TRUE)
+		return EFI_SUCCESS;
+
+	UINT8 PolicyFingerprint[VERIFY_CACHE_DIGEST_SIZE];
+	EFI_STATUS Status;
+
+	Status = LoadKey();
+	if (EFI_ERROR(Status))
+		goto err;
+
+	Status = ComputePolicyFingerprint(PolicyFingerprint);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Failed to compute the security "
+				     L"policy fingerprint (err: 0x%x)\n",
+				     Status);
+		goto err;
+	}
+
+	Status = LoadEntries(PolicyFingerprint);
+	if (EFI_ERROR(Status)) {
+		MemSet(&Cache, 0, sizeof(Cache));
+		Cache.Magic = VERIFY_CACHE_MAGIC;
+		Cache.Revision = VERIFY_CACHE_REVISION;
+		MemCpy(Cache.PolicyFingerprint, PolicyFingerprint,
+		       sizeof(PolicyFingerprint));
+	}
+
+	EfiConsolePrintDebug(L"Verification cache loaded with %d "
+			     L"entries\n", Cache.NumberOfEntries);
+
+	VerifyCacheLoaded = TRUE;
+
+	return EFI_SUCCESS;
+
+err:
+	WipeCache();
+
+	return Status;
+}
+
+/* The most recently used entry is kept at the end */
+STATIC VOID
+TouchEntry(VERIFY_CACHE_ENTRY *Entry)
+{
+	VERIFY_CACHE_ENTRY Used = *Entry;
+	UINTN Index = Entry - Cache.Entries;
+
+	MemMove(Entry, Entry + 1,
+		(Cache.NumberOfEntries - 1 - Index) * sizeof(*Entry));
+	Cache.Entries[Cache.NumberOfEntries - 1] = Used;
+}
+
+STATIC VERIFY_CACHE_ENTRY *
+LookupEntry(CONST UINT8 *Tag)
+{
+	for (UINTN Index = 0; Index < Cache.NumberOfEntries; ++Index) {
+		if (!MemCmp(Cache.Entries[Index].Tag, Tag,
+			    VERIFY_CACHE_DIGEST_SIZE))
+			return &Cache.Entries[Index];
+	}
+
+	return NULL;
+}
+
+BOOLEAN
+VerifyCacheEnabled(VOID)
+{
+	return VerifyCacheRequested;
+}
+
+/*
+ * The tag binds the entry to both the file path and the exact signature
+ * verified, so updating a file along with its signature simply misses
+ * the cache.
+ */
+EFI_STATUS
+VerifyCacheLookup(CONST CHAR16 *Path, CONST VOID *Signature,
+		  UINTN SignatureSize, VERIFY_CACHE_TAG *Tag,
+		  EFI_GUID **HashAlgorithm, UINT8 **Hash, UINTN *HashSize)
+{
+	Tag->Valid = FALSE;
+
+	if (VerifyCacheRequested == FALSE)
+		return EFI_UNSUPPORTED;
+
+	EFI_STATUS Status;
+
+	Status = LoadCache();
+	if (EFI_ERROR(Status))
+		return Status;
+
+	CHAR16 *FilePath;
+
+	Status = EfiDevicePathCreate(Path, &FilePath);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	/* The file system is case-insensitive */
+	for (CHAR16 *Char = FilePath; *Char; ++Char) {
+		if (*Char >= L'a' && *Char <= L'z')
+			*Char -= L'a' - L'A';
+		else if (*Char == L'/')
+			*Char = L'\\';
+	}
+
+	UINT8 Digest[VERIFY_CACHE_DIGEST_SIZE * 2];
+	UINTN FilePathSize = (StrLen(FilePath) + 1) * sizeof(CHAR16);
+
+	Status = Sha256Data(FilePath, FilePathSize, Digest);
+	EfiMemoryFree(FilePath);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = Sha256Data(Signature, SignatureSize,
+			    Digest + VERIFY_CACHE_DIGEST_SIZE);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = Sha256Data(Digest, sizeof(Digest), Tag->Tag);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Tag->Valid = TRUE;
+
+	VERIFY_CACHE_ENTRY *Entry = LookupEntry(Tag->Tag);
+	if (!Entry)
+		return EFI_NOT_FOUND;
+
+	if (Entry->HashAlgorithm >= ARRAY_SIZE(HashAlgorithms) ||
+	    Entry->HashSize > sizeof(Entry->Hash)) {
+		EfiConsolePrintError(L"Invalid verification cache entry for "
+				     L"%s\n", Path);
+		return EFI_COMPROMISED_DATA;
+	}
+
+	*Hash = MemDup(Entry->Hash, Entry->HashSize);
+	if (!*Hash)
+		return EFI_OUT_OF_RESOURCES;
+
+	*HashAlgorithm = HashAlgorithms[Entry->HashAlgorithm];
+	*HashSize = Entry->HashSize;
+
+	/* The order is only saved along with the new entries */
+	TouchEntry(Entry);
+
+	/* Nothing to record again */
+	Tag->Valid = FALSE;
+
+	StatisticsCacheHit();
+
+	EfiConsolePrintDebug(L"Verification cache hit for %s\n", Path);
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Record the digest attested by the signature once the content is proven
+ * to match it. The least recently used entry is evicted if the cache is
+ * full.
+ */
+VOID
+VerifyCacheAdd(CONST VERIFY_CACHE_TAG *Tag, CONST EFI_GUID *HashAlgorithm,
+	       CONST UINT8 *Hash, UINTN HashSize)
+{
+	if (VerifyCacheRequested == FALSE || VerifyCacheLoaded == FALSE ||
+	    Tag->Valid == FALSE || HashSize > sizeof(EFI_SHA512_HASH2))
+		return;
+
+	UINTN Algorithm;
+
+	for (Algorithm = 0; Algorithm < ARRAY_SIZE(HashAlgorithms);
+	     ++Algorithm) {
+		if (HashAlgorithms[Algorithm] == HashAlgorithm)
+			break;
+	}
+
+	if (Algorithm == ARRAY_SIZE(HashAlgorithms) ||
+	    LookupEntry(Tag->Tag))
+		return;
+
+	if (Cache.NumberOfEntries == MAX_VERIFY_CACHE_ENTRIES) {
+		MemMove(Cache.Entries, Cache.Entries + 1,
+			sizeof(Cache.Entries[0]) *
+			(MAX_VERIFY_CACHE_ENTRIES - 1));
+		--Cache.NumberOfEntries;
+	}
+
+	VERIFY_CACHE_ENTRY *Entry = &Cache.Entries[Cache.NumberOfEntries++];
+
+	MemSet(Entry, 0, sizeof(*Entry));
+	MemCpy(Entry->Tag, Tag->Tag, sizeof(Entry->Tag));
+	Entry->HashAlgorithm = (UINT8)Algorithm;
+	Entry->HashSize = (UINT8)HashSize;
+	MemCpy(Entry->Hash, Hash, HashSize);
+
+	CacheDirty = TRUE;
+}
+
+/* Save the cache if changed in this boot */
+VOID
+VerifyCacheFlush(VOID)
+{
+	if (VerifyCacheRequested == FALSE || CacheDirty == FALSE)
+		return;
+
+	SaveEntries();
+	CacheDirty = FALSE;
+}
+
+EFI_STATUS
+EfiVerifyCacheEnable(VOID)
+{
+	if (VerifyCacheRequested == TRUE)
+		return EFI_SUCCESS;
+
+	EFI_STATUS Status;
+
+	if (!ExitBootServicesEvent) {
+		Status = gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES,
+					  TPL_NOTIFY, OnExitBootServices,
+					  NULL, &ExitBootServicesEvent);
+		if (EFI_ERROR(Status)) {
+			EfiConsolePrintError(L"Failed to create the event "
+					     L"for the verification cache "
+					     L"(err: 0x%x)\n", Status);
+			return Status;
+		}
+	}
+
+	/* Unknown to the firmware before UEFI 2.8 and never signalled */
+	if (!BeforeExitBootServicesEvent) {
+		Status = gBS->CreateEventEx(EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+					    OnBeforeExitBootServices, NULL,
+					    &BeforeExitBootServicesGuid,
+					    &BeforeExitBootServicesEvent);
+		if (EFI_ERROR(Status))
+			EfiConsolePrintDebug(L"The verification cache is only "
+					     L"saved before starting the boot "
+					     L"target (err: 0x%x)\n", Status);
+	}
+
+	VerifyCacheRequested = TRUE;
+
+	EfiConsolePrintDebug(L"Verification cache enabled\n");
+
+	return EFI_SUCCESS;
+}
@@ -33,6 +33,7 @@
 
 #include <Efi.h>
 #include <EfiLibrary.h>
+#include <BaseLibrary.h>
 #include <SELoader.h>
 
 #define SELOADER_CONFIGURATION			L"SELoader.conf"
@@ -41,43 +42,216 @@
 #  define SELOADER_CHAINLOADER			L"grub" EFI_ARCH L".efi"
 #endif
 
-#ifdef EXPERIMENTAL_BUILD
+STATIC EFI_CONFIG Config;
+
+STATIC VOID
+ApplyConsoleConfig(VOID)
+{
+	STATIC CONST CHAR16 *Levels[CPL_MAX] = {
+		[CPL_DEBUG] = L"debug",
+		[CPL_INFO] = L"info",
+		[CPL_WARNING] = L"warning",
+		[CPL_ERROR] = L"error",
+		[CPL_FAULT] = L"fault",
+	};
+	CONST CHAR16 *Value;
+
+	Value = EfiConfigGet(&Config, L"global", L"verbosity");
+	if (Value) {
+		for (UINTN Level = CPL_DEBUG; Level < CPL_MAX; ++Level) {
+			if (!StrCmp(Value, Levels[Level])) {
+				EfiConsoleSetVerbosity(Level);
+				break;
+			}
+		}
+	}
+
+	/*
+	 * Record the messages in memory and render them on error or before
+	 * starting the boot target.
+	 */
+	Value = EfiConfigGet(&Config, L"global", L"deferred_log");
+	if (Value && !StrCmp(Value, L"yes"))
+		EfiConsoleSetDeferred(TRUE);
+}
+
+/*
+ * Measure the files verified by SELoader into PCR 9 as grub does, or the
+ * one specified by measure_pcr.
+ */
+STATIC VOID
+ApplyMeasureConfig(VOID)
+{
+	CONST CHAR16 *Value;
+
+	Value = EfiConfigGet(&Config, L"global", L"measure");
+	if (!Value || StrCmp(Value, L"yes"))
+		return;
+
+	UINT32 PcrIndex = 9;
+
+	Value = EfiConfigGet(&Config, L"global", L"measure_pcr");
+	if (Value && *Value) {
+		PcrIndex = 0;
+		for (; *Value >= L'0' && *Value <= L'9' && PcrIndex < 100;
+		     ++Value)
+			PcrIndex = PcrIndex * 10 + *Value - L'0';
+
+		if (*Value) {
+			EfiConsolePrintError(L"Invalid measure_pcr\n");
+			return;
+		}
+	}
+
+	EfiMeasureEnable(PcrIndex);
+}
+
 STATIC EFI_STATUS
 LoadConfig(VOID)
 {
 	EfiConsoleTraceDebug(L"Attempting to load SELoader configuration "
 			     SELOADER_CONFIGURATION L" ...\n");
 
-	BOOLEAN ParseContent = FALSE;
 	EFI_STATUS Status;
 
-	if (ParseContent == FALSE)
-		Status = EfiFileLoad(SELOADER_CONFIGURATION, NULL, 0);
-	else {
-		VOID *Config = NULL;
-		UINTN ConfigSize = 0;
+	Status = EfiConfigLoad(SELOADER_CONFIGURATION, &Config);
+
+	EfiConsoleTraceDebug(SELOADER_CONFIGURATION L" parsed (err: 0x%x)\n",
+			     Status);
+
+	return Status;
+}
+
+/*
+ * Serve the initrds separated by space to the kernel as a single
+ * concatenated initrd.
+ */
+STATIC EFI_STATUS
+LoadInitrd(CONST CHAR16 *InitrdList)
+{
+	CHAR16 *List = StrDup(InitrdList);
+	if (!List)
+		return EFI_OUT_OF_RESOURCES;
+
+	CHAR16 *Path = List;
+	EFI_STATUS Status = EFI_SUCCESS;
 
-		Status = EfiFileLoad(SELOADER_CONFIGURATION, &Config,
-				     &ConfigSize);
+	while (*Path) {
+		CHAR16 *Next = StrChr(Path, L' ');
+
+		if (Next)
+			*Next++ = L'\0';
+		else
+			Next = Path + StrLen(Path);
+
+		if (*Path) {
+			Status = EfiInitrdLoad(Path);
+			if (EFI_ERROR(Status))
+				break;
+		}
+
+		Path = Next;
 	}
 
-	/*
-	 * TODO: parse the configuration to allow to customize the
-	 * behavior of SELoader.
-	 */
+	EfiMemoryFree(List);
 
-	EfiConsoleTraceDebug(SELOADER_CONFIGURATION L" parsed (err: 0x%x)\n",
-			     Status);
+	if (!EFI_ERROR(Status))
+		Status = EfiInitrdInstall();
+
+	if (EFI_ERROR(Status))
+		EfiInitrdUninstall();
 
 	return Status;
 }
-#else
+
+/*
+ * Start the EFI-stub kernel directly without the help of grub. The
+ * kernel is verified with its signature file as grub asks for it, and
+ * started from the verified buffer.
+ */
 STATIC EFI_STATUS
-LoadConfig(VOID)
+LaunchKernel(CONST CHAR16 *Entry, CONST CHAR16 *Kernel)
+{
+	CONST CHAR16 *Options = EfiConfigGet(&Config, Entry, L"option");
+	CONST CHAR16 *Initrd = EfiConfigGet(&Config, Entry, L"initrd");
+	EFI_STATUS Status;
+
+	if (Initrd) {
+		Status = LoadInitrd(Initrd);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	EfiConsoleTraceInfo(L"Preparing to load the kernel %s ...\n",
+			    Kernel);
+
+	Status = EfiImageExecuteVerified(Kernel, Options);
+
+	if (Initrd)
+		EfiInitrdUninstall();
+
+	if (EFI_ERROR(Status))
+		EfiConsoleTraceError(L"The kernel %s exited with 0x%x\n",
+				     Kernel, Status);
+
+	return Status;
+}
+
+/*
+ * The UKI is verified as a whole, and then the embedded kernel, initrd
+ * and command line are used in place.
+ */
+STATIC EFI_STATUS
+LaunchUki(CONST CHAR16 *Entry, CONST CHAR16 *Uki)
 {
-	return EFI_UNSUPPORTED;
+	CONST CHAR16 *Options = EfiConfigGet(&Config, Entry, L"option");
+
+	EfiConsoleTraceInfo(L"Preparing to load the UKI %s ...\n", Uki);
+
+	EFI_STATUS Status;
+
+	Status = EfiUkiExecute(Uki, Options);
+
+	if (EFI_ERROR(Status))
+		EfiConsoleTraceError(L"The UKI %s exited with 0x%x\n", Uki,
+				     Status);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+LaunchEntry(CONST CHAR16 *Entry)
+{
+	EfiConsoleTraceDebug(L"Launching the boot entry %s ...\n", Entry);
+
+	CONST CHAR16 *Path;
+
+	Path = EfiConfigGet(&Config, Entry, L"uki");
+	if (Path)
+		return LaunchUki(Entry, Path);
+
+	Path = EfiConfigGet(&Config, Entry, L"kernel");
+	if (Path)
+		return LaunchKernel(Entry, Path);
+
+	Path = EfiConfigGet(&Config, Entry, L"image");
+	if (Path) {
+		EFI_STATUS Status;
+
+		Status = EfiImageExecute(Path);
+
+		if (EFI_ERROR(Status))
+			EfiConsoleTraceError(L"%s exited with 0x%x\n", Path,
+					     Status);
+
+		return Status;
+	}
+
+	EfiConsolePrintError(L"No UKI, kernel or image specified for the boot "
+			     L"entry %s\n", Entry);
+
+	return EFI_NOT_FOUND;
 }
-#endif
 
 STATIC EFI_STATUS
 LaunchLoader(VOID)
@@ -87,8 +261,18 @@ LaunchLoader(VOID)
 
 	EFI_STATUS Status;
 
+	/*
+	 * Verify the files the default grub entry will ask for ahead so
+	 * grub gets them from the cache through MOK2 Verify Protocol.
+	 */
+	CONST CHAR16 *Value = EfiConfigGet(&Config, L"global", L"preverify");
+	if (Value && !StrCmp(Value, L"yes"))
+		EfiPreverifyGrubConfig(L"grub.cfg");
+
 	Status = EfiImageExecute(SELOADER_CHAINLOADER);
 
+	EfiInitStatePrint();
+
 	EfiConsoleTraceFault(SELOADER_CHAINLOADER L" exited with 0x%x\n",
 			     Status);
 
@@ -104,7 +288,44 @@ efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
 	if (EFI_ERROR(Status))
 		return Status;
 
-	LoadConfig();
+	Status = LoadConfig();
+	if (!EFI_ERROR(Status)) {
+		ApplyConsoleConfig();
+
+		CONST CHAR16 *Report;
+
+		Report = EfiConfigGet(&Config, L"global", L"profile_report");
+		if (Report)
+			EfiProfileSetReportFile(Report);
+
+		/*
+		 * Skip the PKCS#7 verification of the files verified in the
+		 * previous boots under the same security policy.
+		 */
+		CONST CHAR16 *VerifyCache;
+
+		VerifyCache = EfiConfigGet(&Config, L"global", L"verify_cache");
+		if (VerifyCache && !StrCmp(VerifyCache, L"yes"))
+			EfiVerifyCacheEnable();
+
+		ApplyMeasureConfig();
+
+		/* Publish the digests of the verified files to the OS */
+		CONST CHAR16 *VerifiedTable;
+
+		VerifiedTable = EfiConfigGet(&Config, L"global",
+					     L"verified_table");
+		if (VerifiedTable && !StrCmp(VerifiedTable, L"yes"))
+			EfiVerifiedTableEnable();
+
+		CONST CHAR16 *Entry;
+
+		Entry = EfiConfigGet(&Config, L"global", L"default_boot");
+		if (Entry)
+			LaunchEntry(Entry);
+
+		/* Fall back to the chainloader if the boot entry fails */
+	}
 
 	return LaunchLoader();
 }
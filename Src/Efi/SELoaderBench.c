@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The on-target benchmark of the hash providers, PKCS#7 verification, file
+ * loading and the policy variable reads. The results are printed to the
+ * console and saved to SELoaderBench.csv along with SELoaderBench.efi.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+#define BENCH_CSV_FILE			L"SELoaderBench.csv"
+#define BENCH_DATA_FILE			L"SELoaderBench.dat"
+
+/* Each measurement runs until the time or the iteration limit expires */
+#define BENCH_MICROSECONDS		200000
+#define BENCH_MAX_ITERATIONS		(1024 * 1024)
+
+#define BENCH_CSV_SIZE			(16 * 1024)
+#define BENCH_LINE_LENGTH		160
+
+#define HASH_MAX_SIZE			(16 * 1024 * 1024)
+#define FILE_MAX_SIZE			(16 * 1024 * 1024)
+
+#ifndef BENCH_SAMPLE_DIR
+#  error "BENCH_SAMPLE_DIR is not defined"
+#endif
+
+#ifndef BENCH_SAMPLE_SIZE
+#  error "BENCH_SAMPLE_SIZE is not defined"
+#endif
+
+/*
+ * The samples are generated from the sample DB key during the build. The
+ * signed content is BENCH_SAMPLE_SIZE zero bytes. The attached signature
+ * embeds the content and the detached signature signs its SHA-256 digest.
+ */
+#define EMBED_SAMPLE(Name, File)	\
+	asm(".section .data.bench_sample, \"aw\"\n\t"	\
+	    ".balign 8\n\t"	\
+	    ".global Sample" #Name "\n\t"	\
+	    ".hidden Sample" #Name "\n"	\
+	    "Sample" #Name ":\n\t"	\
+	    ".incbin \"" BENCH_SAMPLE_DIR "/" File "\"\n\t"	\
+	    ".global Sample" #Name "End\n\t"	\
+	    ".hidden Sample" #Name "End\n"	\
+	    "Sample" #Name "End:\n\t"	\
+	    ".previous\n");	\
+	extern CONST UINT8 Sample##Name[]	\
+		__attribute__((visibility("hidden")));	\
+	extern CONST UINT8 Sample##Name##End[]	\
+		__attribute__((visibility("hidden")))
+
+EMBED_SAMPLE(Certificate, "BenchSample.der");
+EMBED_SAMPLE(Attached, "BenchSample.p7b");
+EMBED_SAMPLE(Detached, "BenchSample.p7s");
+
+typedef EFI_STATUS (*BENCH_FUNCTION)(VOID *Context);
+
+typedef struct {
+	EFI_HASH_PROTOCOL *HashProtocol;
+	EFI_HASH2_PROTOCOL *Hash2Protocol;
+	EFI_GUID *HashAlgorithm;
+	UINT8 *Buffer;
+	UINTN Size;
+} HASH_BENCH;
+
+typedef struct {
+	EFI_PKCS7_VERIFY_PROTOCOL *Pkcs7VerifyProtocol;
+	VOID *Signature;
+	UINTN SignatureSize;
+	/* The digest signed by the detached signature */
+	VOID *InData;
+	UINTN InDataSize;
+	EFI_SIGNATURE_LIST **AllowedDb;
+	UINT8 Content[BENCH_SAMPLE_SIZE];
+} PKCS7_BENCH;
+
+typedef struct {
+	CONST CHAR16 *Name;
+	CONST EFI_GUID *Guid;
+} VARIABLE_BENCH;
+
+STATIC CONST UINTN HashSizes[] = {
+	64, 1024, 16 * 1024, 1024 * 1024, HASH_MAX_SIZE
+};
+
+STATIC struct {
+	CONST CHAR16 *Name;
+	EFI_GUID *Guid;
+} HashAlgorithms[] = {
+	{ L"SHA-256", &gEfiHashAlgorithmSha256Guid },
+	{ L"SHA-384", &gEfiHashAlgorithmSha384Guid },
+	{ L"SHA-512", &gEfiHashAlgorithmSha512Guid },
+};
+
+STATIC CONST UINTN FileSizes[] = {
+	4 * 1024, 64 * 1024, 1024 * 1024, FILE_MAX_SIZE
+};
+
+/* The variables read by the security policy */
+STATIC VARIABLE_BENCH PolicyVariables[] = {
+	{ L"SecureBoot", &gEfiGlobalVariableGuid },
+	{ L"SetupMode", &gEfiGlobalVariableGuid },
+	{ L"PK", &gEfiGlobalVariableGuid },
+	{ L"KEK", &gEfiGlobalVariableGuid },
+	{ L"db", &gEfiImageSecurityDatabaseGuid },
+	{ L"dbx", &gEfiImageSecurityDatabaseGuid },
+	{ L"MokSBState", &gEfiMokVerifyProtocolGuid },
+	{ L"MokList", &gEfiMokVerifyProtocolGuid },
+	{ L"MokListX", &gEfiMokVerifyProtocolGuid },
+	{ L"MokListXRT", &gEfiMokVerifyProtocolGuid },
+};
+
+/* Not all gnu-efi versions define this GUID */
+STATIC EFI_GUID CertX509Guid = EFI_CERT_X509_GUID;
+
+STATIC CHAR8 *Csv;
+STATIC UINTN CsvSize;
+
+STATIC VOID
+FormatName(CHAR16 *Name, UINTN NameSize, CONST CHAR16 *Format, ...)
+{
+	VA_LIST Marker;
+
+	VA_START(Marker, Format);
+	VSPrint(Name, NameSize, Format, Marker);
+	VA_END(Marker);
+}
+
+/*
+ * Print a line to the console and append it to the CSV. The content is
+ * ASCII so the characters are simply narrowed.
+ */
+STATIC VOID
+Report(CONST CHAR16 *Format, ...)
+{
+	CHAR16 Line[BENCH_LINE_LENGTH];
+	VA_LIST Marker;
+	UINTN Length;
+
+	VA_START(Marker, Format);
+	Length = VSPrint(Line, sizeof(Line), Format, Marker);
+	VA_END(Marker);
+
+	EfiConsolePrintInfo(L"%s", Line);
+
+	for (UINTN Index = 0; Index < Length; ++Index) {
+		if (CsvSize == BENCH_CSV_SIZE)
+			break;
+
+		Csv[CsvSize++] = (CHAR8)Line[Index];
+	}
+}
+
+/*
+ * Run the function repeatedly within BENCH_MICROSECONDS. The first failure
+ * stops the measurement.
+ */
+STATIC EFI_STATUS
+Measure(BENCH_FUNCTION Function, VOID *Context, UINTN *Iterations,
+	UINT64 *Microseconds)
+{
+	UINT64 Start = EfiProfileTimestamp();
+	EFI_STATUS Status;
+
+	*Iterations = 0;
+	*Microseconds = 0;
+
+	do {
+		Status = Function(Context);
+		if (EFI_ERROR(Status))
+			return Status;
+
+		++*Iterations;
+		*Microseconds = EfiProfileElapsedMicroseconds(Start);
+	} while (*Microseconds < BENCH_MICROSECONDS &&
+		 *Iterations < BENCH_MAX_ITERATIONS);
+
+	return EFI_SUCCESS;
+}
+
+STATIC VOID
+ReportResult(CONST CHAR16 *Group, CONST CHAR16 *Name, UINTN Size,
+	     UINTN Iterations, UINT64 Microseconds, EFI_STATUS Status)
+{
+	UINT64 Nanoseconds = 0;
+	UINT64 Throughput = 0;
+
+	if (!EFI_ERROR(Status) && Iterations) {
+		if (!Microseconds)
+			Microseconds = 1;
+
+		Nanoseconds = Microseconds * 1000 / Iterations;
+		/* Bytes per microsecond equals to MB/s */
+		Throughput = (UINT64)Size * Iterations / Microseconds;
+	} else
+		Iterations = 0;
+
+	Report(L"%s,%s,%d,%d,%ld,%ld,0x%x\n", Group, Name, Size, Iterations,
+	       Nanoseconds, Throughput, Status);
+}
+
+STATIC EFI_STATUS
+HashOnce(VOID *Context)
+{
+	HASH_BENCH *Bench = Context;
+
+	if (Bench->Hash2Protocol) {
+		EFI_HASH2_OUTPUT Hash;
+
+		return Bench->Hash2Protocol->Hash(Bench->Hash2Protocol,
+						  Bench->HashAlgorithm,
+						  Bench->Buffer, Bench->Size,
+						  &Hash);
+	}
+
+	UINT8 Digest[sizeof(EFI_HASH2_OUTPUT)];
+	EFI_HASH_OUTPUT Hash;
+
+	*(VOID **)&Hash = Digest;
+
+	return Bench->HashProtocol->Hash(Bench->HashProtocol,
+					 Bench->HashAlgorithm, FALSE,
+					 Bench->Buffer, Bench->Size, &Hash);
+}
+
+STATIC VOID
+BenchHashProvider(CONST CHAR16 *Provider, HASH_BENCH *Bench)
+{
+	for (UINTN Algorithm = 0; Algorithm < sizeof(HashAlgorithms) /
+				  sizeof(HashAlgorithms[0]); ++Algorithm) {
+		CHAR16 Name[BENCH_LINE_LENGTH];
+		UINTN HashSize;
+		EFI_STATUS Status;
+
+		Bench->HashAlgorithm = HashAlgorithms[Algorithm].Guid;
+
+		if (Bench->Hash2Protocol)
+			Status = Bench->Hash2Protocol->GetHashSize(Bench->Hash2Protocol,
+								   Bench->HashAlgorithm,
+								   &HashSize);
+		else
+			Status = Bench->HashProtocol->GetHashSize(Bench->HashProtocol,
+								  Bench->HashAlgorithm,
+								  &HashSize);
+		if (EFI_ERROR(Status)) {
+			EfiConsolePrintInfo(L"%s doesn't support %s "
+					    L"(err: 0x%x)\n", Provider,
+					    HashAlgorithms[Algorithm].Name,
+					    Status);
+			continue;
+		}
+
+		FormatName(Name, sizeof(Name), L"%s/%s", Provider,
+			   HashAlgorithms[Algorithm].Name);
+
+		for (UINTN Index = 0; Index < sizeof(HashSizes) /
+					      sizeof(HashSizes[0]); ++Index) {
+			UINTN Iterations;
+			UINT64 Microseconds;
+
+			Bench->Size = HashSizes[Index];
+			Status = Measure(HashOnce, Bench, &Iterations,
+					 &Microseconds);
+			ReportResult(L"hash", Name, Bench->Size, Iterations,
+				     Microseconds, Status);
+		}
+	}
+}
+
+STATIC EFI_STATUS
+HashSeparateOnce(VOID *Context)
+{
+	HASH_BENCH *Bench = Context;
+
+	for (UINTN Algorithm = 0; Algorithm < sizeof(HashAlgorithms) /
+				  sizeof(HashAlgorithms[0]); ++Algorithm) {
+		UINT8 *Hash;
+		UINTN HashSize;
+		EFI_STATUS Status;
+
+		Status = EfiHashData(HashAlgorithms[Algorithm].Guid,
+				     Bench->Buffer, Bench->Size, &Hash,
+				     &HashSize);
+		if (EFI_ERROR(Status))
+			return Status;
+
+		EfiMemoryFree(Hash);
+	}
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+HashMultiOnce(VOID *Context)
+{
+	HASH_BENCH *Bench = Context;
+	EFI_GUID *Guids[sizeof(HashAlgorithms) / sizeof(HashAlgorithms[0])];
+	UINT8 *Hashes[sizeof(Guids) / sizeof(Guids[0])];
+	UINTN HashSizes[sizeof(Guids) / sizeof(Guids[0])];
+	EFI_STATUS Status;
+
+	for (UINTN Algorithm = 0; Algorithm < sizeof(Guids) /
+				  sizeof(Guids[0]); ++Algorithm)
+		Guids[Algorithm] = HashAlgorithms[Algorithm].Guid;
+
+	Status = EfiMultiHashData(Guids, sizeof(Guids) / sizeof(Guids[0]),
+				  Bench->Buffer, Bench->Size, Hashes,
+				  HashSizes);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	for (UINTN Algorithm = 0; Algorithm < sizeof(Guids) /
+				  sizeof(Guids[0]); ++Algorithm)
+		EfiMemoryFree(Hashes[Algorithm]);
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * All the algorithms through the hash service of the library, either one
+ * message pass per algorithm or a single pass with the multi-digest
+ * context.
+ */
+STATIC VOID
+BenchMultiHash(HASH_BENCH *Bench)
+{
+	for (UINTN Index = 0; Index < sizeof(HashSizes) /
+				      sizeof(HashSizes[0]); ++Index) {
+		UINTN Iterations;
+		UINT64 Microseconds;
+		EFI_STATUS Status;
+
+		Bench->Size = HashSizes[Index];
+
+		Status = Measure(HashSeparateOnce, Bench, &Iterations,
+				 &Microseconds);
+		ReportResult(L"hash", L"Library/separate", Bench->Size,
+			     Iterations, Microseconds, Status);
+
+		Status = Measure(HashMultiOnce, Bench, &Iterations,
+				 &Microseconds);
+		ReportResult(L"hash", L"Library/multi", Bench->Size,
+			     Iterations, Microseconds, Status);
+	}
+}
+
+/*
+ * The firmware services are used through the service binding directly
+ * without involving the hash service of the library, which may load
+ * Hash2DxeCrypto.efi.
+ */
+STATIC VOID
+BenchFirmwareHash(CONST CHAR16 *Provider, EFI_GUID *ServiceBindingGuid,
+		  EFI_GUID *ProtocolGuid, HASH_BENCH *Bench)
+{
+	EFI_SERVICE_BINDING_PROTOCOL *ServiceBinding;
+	EFI_STATUS Status;
+
+	Status = EfiProtocolLocate(ServiceBindingGuid,
+				   (VOID **)&ServiceBinding);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintInfo(L"EFI %s Protocol is not provided by "
+				    L"BIOS (err: 0x%x)\n", Provider, Status);
+		return;
+	}
+
+	EFI_HANDLE Handle = NULL;
+
+	Status = ServiceBinding->CreateChild(ServiceBinding, &Handle);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to create %s handle "
+				     L"(err: 0x%x)\n", Provider, Status);
+		return;
+	}
+
+	VOID *Interface;
+
+	Status = EfiProtocolOpen(Handle, ProtocolGuid, &Interface);
+	if (!EFI_ERROR(Status)) {
+		if (ProtocolGuid == &gEfiHash2ProtocolGuid)
+			Bench->Hash2Protocol = Interface;
+		else
+			Bench->HashProtocol = Interface;
+
+		BenchHashProvider(Provider, Bench);
+
+		Bench->Hash2Protocol = NULL;
+		Bench->HashProtocol = NULL;
+	} else
+		EfiConsolePrintError(L"Unable to open EFI %s Protocol "
+				     L"(err: 0x%x)\n", Provider, Status);
+
+	ServiceBinding->DestroyChild(ServiceBinding, Handle);
+}
+
+STATIC VOID
+BenchHash(VOID)
+{
+	HASH_BENCH Bench;
+	EFI_STATUS Status;
+
+	MemSet(&Bench, 0, sizeof(Bench));
+
+	Status = EfiMemoryAllocatePages(HASH_MAX_SIZE, EFI_PAGE_SIZE, 0,
+					(VOID **)&Bench.Buffer);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to allocate the hash buffer "
+				     L"(err: 0x%x)\n", Status);
+		return;
+	}
+
+	for (UINTN Index = 0; Index < HASH_MAX_SIZE; ++Index)
+		Bench.Buffer[Index] = (UINT8)Index;
+
+	BenchFirmwareHash(L"Hash", &gEfiHashServiceBindingProtocolGuid,
+			  &gEfiHashProtocolGuid, &Bench);
+	BenchFirmwareHash(L"Hash2", &gEfiHash2ServiceBindingProtocolGuid,
+			  &gEfiHash2ProtocolGuid, &Bench);
+
+	Bench.Hash2Protocol = EfiHashBuiltinProtocol();
+	BenchHashProvider(L"Builtin", &Bench);
+
+	BenchMultiHash(&Bench);
+
+	EfiMemoryFree(Bench.Buffer);
+}
+
+STATIC EFI_STATUS
+Pkcs7VerifyOnce(VOID *Context)
+{
+	PKCS7_BENCH *Bench = Context;
+	EFI_PKCS7_VERIFY_PROTOCOL *Protocol = Bench->Pkcs7VerifyProtocol;
+	EFI_SIGNATURE_LIST *RevokedDb[1] = { NULL };
+	EFI_SIGNATURE_LIST *TimeStampDb[1] = { NULL };
+
+	if (Bench->InData)
+		return Protocol->VerifyBuffer(Protocol, Bench->Signature,
+					      Bench->SignatureSize,
+					      Bench->InData,
+					      Bench->InDataSize,
+					      Bench->AllowedDb, RevokedDb,
+					      TimeStampDb, NULL, NULL);
+
+	UINTN ContentSize = sizeof(Bench->Content);
+
+	return Protocol->VerifyBuffer(Protocol, Bench->Signature,
+				      Bench->SignatureSize, NULL, 0,
+				      Bench->AllowedDb, RevokedDb,
+				      TimeStampDb, Bench->Content,
+				      &ContentSize);
+}
+
+/*
+ * The allowed database only contains the sample certificate so the
+ * result doesn't depend on the provisioned db.
+ */
+STATIC EFI_STATUS
+CreateAllowedDb(EFI_SIGNATURE_LIST ***AllowedDb)
+{
+	UINTN CertificateSize = SampleCertificateEnd - SampleCertificate;
+	UINTN SignatureSize = sizeof(EFI_SIGNATURE_DATA) - 1 +
+			      CertificateSize;
+	UINTN ListSize = sizeof(EFI_SIGNATURE_LIST) + SignatureSize;
+	EFI_SIGNATURE_LIST **Db;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(sizeof(*Db) * 2 + ListSize, (VOID **)&Db);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	EFI_SIGNATURE_LIST *List = (EFI_SIGNATURE_LIST *)(Db + 2);
+
+	List->SignatureType = CertX509Guid;
+	List->SignatureListSize = ListSize;
+	List->SignatureHeaderSize = 0;
+	List->SignatureSize = SignatureSize;
+
+	EFI_SIGNATURE_DATA *Data = (EFI_SIGNATURE_DATA *)(List + 1);
+
+	MemSet(&Data->SignatureOwner, 0, sizeof(Data->SignatureOwner));
+	MemCpy(Data->SignatureData, SampleCertificate, CertificateSize);
+
+	Db[0] = List;
+	Db[1] = NULL;
+	*AllowedDb = Db;
+
+	return EFI_SUCCESS;
+}
+
+STATIC VOID
+BenchPkcs7(VOID)
+{
+	PKCS7_BENCH *Bench;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(sizeof(*Bench), (VOID **)&Bench);
+	if (EFI_ERROR(Status))
+		return;
+
+	MemSet(Bench, 0, sizeof(*Bench));
+
+	Status = EfiProtocolLocate(&gEfiPkcs7VerifyProtocolGuid,
+				   (VOID **)&Bench->Pkcs7VerifyProtocol);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintInfo(L"PKCS#7 Verify Protocol not supported "
+				    L"by BIOS. Attempting to load "
+				    L"Pkcs7VerifyDxe driver ...\n");
+
+		Status = EfiImageExecuteDriver(L"Pkcs7VerifyDxe.efi");
+		if (!EFI_ERROR(Status))
+			Status = EfiProtocolLocate(&gEfiPkcs7VerifyProtocolGuid,
+						   (VOID **)&Bench->Pkcs7VerifyProtocol);
+		if (EFI_ERROR(Status)) {
+			EfiConsolePrintError(L"Unable to find PKCS#7 Verify "
+					     L"Protocol (err: 0x%x)\n", Status);
+			goto Out;
+		}
+	}
+
+	Status = CreateAllowedDb(&Bench->AllowedDb);
+	if (EFI_ERROR(Status))
+		goto Out;
+
+	UINTN Iterations;
+	UINT64 Microseconds;
+
+	Bench->Signature = (VOID *)SampleAttached;
+	Bench->SignatureSize = SampleAttachedEnd - SampleAttached;
+	Status = Measure(Pkcs7VerifyOnce, Bench, &Iterations, &Microseconds);
+	ReportResult(L"pkcs7", L"attached", Bench->SignatureSize, Iterations,
+		     Microseconds, Status);
+
+	EFI_HASH2_PROTOCOL *Sha2 = EfiHashBuiltinProtocol();
+	EFI_HASH2_OUTPUT Digest;
+
+	MemSet(Bench->Content, 0, sizeof(Bench->Content));
+	Status = Sha2->Hash(Sha2, &gEfiHashAlgorithmSha256Guid,
+			    Bench->Content, sizeof(Bench->Content), &Digest);
+	if (!EFI_ERROR(Status)) {
+		Bench->Signature = (VOID *)SampleDetached;
+		Bench->SignatureSize = SampleDetachedEnd - SampleDetached;
+		Bench->InData = &Digest;
+		Bench->InDataSize = sizeof(Digest.Sha256Hash);
+		Status = Measure(Pkcs7VerifyOnce, Bench, &Iterations,
+				 &Microseconds);
+	}
+	ReportResult(L"pkcs7", L"detached", Bench->SignatureSize, Iterations,
+		     Microseconds, Status);
+
+	EfiMemoryFree(Bench->AllowedDb);
+
+Out:
+	EfiMemoryFree(Bench);
+}
+
+STATIC EFI_STATUS
+FileReadOnce(VOID *Context)
+{
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	Status = EfiFileRead(BENCH_DATA_FILE, &Data, &DataSize);
+	if (!EFI_ERROR(Status))
+		EfiMemoryFree(Data);
+
+	return Status;
+}
+
+/*
+ * The file is written to ESP for each size and deleted afterward. The
+ * signature verification is not involved.
+ */
+STATIC VOID
+BenchFile(VOID)
+{
+	UINT8 *Buffer;
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocatePages(FILE_MAX_SIZE, EFI_PAGE_SIZE, 0,
+					(VOID **)&Buffer);
+	if (EFI_ERROR(Status)) {
+		EfiConsolePrintError(L"Unable to allocate the file buffer "
+				     L"(err: 0x%x)\n", Status);
+		return;
+	}
+
+	for (UINTN Index = 0; Index < FILE_MAX_SIZE; ++Index)
+		Buffer[Index] = (UINT8)Index;
+
+	for (UINTN Index = 0; Index < sizeof(FileSizes) /
+				      sizeof(FileSizes[0]); ++Index) {
+		UINTN Iterations = 0;
+		UINT64 Microseconds = 0;
+
+		/* Don't leave the stale content of a larger file */
+		EfiFileDelete(BENCH_DATA_FILE);
+
+		Status = EfiFileSave(BENCH_DATA_FILE, Buffer,
+				     FileSizes[Index]);
+		if (!EFI_ERROR(Status))
+			Status = Measure(FileReadOnce, NULL, &Iterations,
+					 &Microseconds);
+
+		ReportResult(L"file", L"load", FileSizes[Index], Iterations,
+			     Microseconds, Status);
+	}
+
+	EfiFileDelete(BENCH_DATA_FILE);
+	EfiMemoryFree(Buffer);
+}
+
+STATIC EFI_STATUS
+VariableReadOnce(VOID *Context)
+{
+	VARIABLE_BENCH *Bench = Context;
+	VOID *Data = NULL;
+	UINTN DataSize = 0;
+	EFI_STATUS Status;
+
+	Status = EfiVariableRead(Bench->Name, Bench->Guid, NULL, &Data,
+				 &DataSize);
+	if (!EFI_ERROR(Status))
+		EfiMemoryFree(Data);
+
+	return Status;
+}
+
+STATIC VOID
+BenchVariable(VOID)
+{
+	for (UINTN Index = 0; Index < sizeof(PolicyVariables) /
+				      sizeof(PolicyVariables[0]); ++Index) {
+		VARIABLE_BENCH *Bench = PolicyVariables + Index;
+		VOID *Data = NULL;
+		UINTN DataSize = 0;
+		UINTN Iterations = 0;
+		UINT64 Microseconds = 0;
+		EFI_STATUS Status;
+
+		/* An absent variable is reported with its status */
+		Status = EfiVariableRead(Bench->Name, Bench->Guid, NULL, &Data,
+					 &DataSize);
+		if (!EFI_ERROR(Status)) {
+			EfiMemoryFree(Data);
+			Status = Measure(VariableReadOnce, Bench, &Iterations,
+					 &Microseconds);
+		}
+
+		ReportResult(L"variable", Bench->Name, DataSize, Iterations,
+			     Microseconds, Status);
+	}
+}
+
+EFI_STATUS
+efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable)
+{
+	EFI_STATUS Status;
+
+	Status = EfiLibraryInitialize(ImageHandle, SystemTable);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINT64 Start = EfiProfileTimestamp();
+
+	gBS->Stall(1000);
+	if (!EfiProfileElapsedMicroseconds(Start)) {
+		EfiConsolePrintError(L"No timestamp source available\n");
+		return EFI_UNSUPPORTED;
+	}
+
+	Status = EfiMemoryAllocate(BENCH_CSV_SIZE, (VOID **)&Csv);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Report(L"group,name,size,iterations,ns_per_op,mb_per_s,status\n");
+
+	BenchHash();
+	BenchPkcs7();
+	BenchFile();
+	BenchVariable();
+
+	/* Don't leave the stale content of a longer report */
+	EfiFileDelete(BENCH_CSV_FILE);
+
+	Status = EfiFileSave(BENCH_CSV_FILE, Csv, CsvSize);
+	if (!EFI_ERROR(Status))
+		EfiConsolePrintInfo(L"Benchmark results written to "
+				    BENCH_CSV_FILE L"\n");
+
+	EfiMemoryFree(Csv);
+
+	return Status;
+}
@@ -0,0 +1,848 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The simulated EFI Boot Services. The handle database, the events and
+ * the configuration tables are kept in the fixed tables, which are more
+ * than enough for a single loader.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "Internal.h"
+#include "HostEfi.h"
+
+#define MAX_HANDLES			64
+#define MAX_HANDLE_PROTOCOLS		8
+#define MAX_EVENTS			32
+#define MAX_CONFIGURATION_TABLES	16
+
+typedef struct {
+	EFI_GUID Protocol;
+	VOID *Interface;
+} HOST_PROTOCOL;
+
+typedef struct {
+	BOOLEAN Used;
+	HOST_PROTOCOL Protocols[MAX_HANDLE_PROTOCOLS];
+	UINTN NumberOfProtocols;
+} HOST_HANDLE;
+
+typedef struct {
+	BOOLEAN Used;
+	UINT32 Type;
+	EFI_TPL NotifyTpl;
+	EFI_EVENT_NOTIFY NotifyFunction;
+	VOID *NotifyContext;
+	BOOLEAN Signaled;
+	/* The event group, or zero if not in a group */
+	EFI_GUID EventGroup;
+} HOST_EVENT;
+
+STATIC HOST_HANDLE Handles[MAX_HANDLES];
+STATIC HOST_EVENT Events[MAX_EVENTS];
+STATIC EFI_CONFIGURATION_TABLE ConfigurationTables[MAX_CONFIGURATION_TABLES];
+STATIC EFI_SYSTEM_TABLE *HostSystemTable;
+STATIC EFI_TPL CurrentTpl = TPL_APPLICATION;
+
+STATIC BOOLEAN
+GuidEqual(CONST EFI_GUID *Guid1, CONST EFI_GUID *Guid2)
+{
+	return !MemCmp(Guid1, Guid2, sizeof(EFI_GUID));
+}
+
+STATIC HOST_HANDLE *
+HandleGet(EFI_HANDLE Handle)
+{
+	HOST_HANDLE *HostHandle = (HOST_HANDLE *)Handle;
+
+	if (HostHandle < Handles || HostHandle >= Handles + MAX_HANDLES ||
+	    HostHandle->Used == FALSE)
+		return NULL;
+
+	return HostHandle;
+}
+
+STATIC HOST_PROTOCOL *
+ProtocolGet(HOST_HANDLE *HostHandle, CONST EFI_GUID *Protocol)
+{
+	for (UINTN Index = 0; Index < HostHandle->NumberOfProtocols; ++Index) {
+		if (GuidEqual(&HostHandle->Protocols[Index].Protocol,
+			      Protocol) == TRUE)
+			return HostHandle->Protocols + Index;
+	}
+
+	return NULL;
+}
+
+STATIC EFI_STATUS
+HandleCreate(EFI_HANDLE *Handle)
+{
+	for (UINTN Index = 0; Index < MAX_HANDLES; ++Index) {
+		if (Handles[Index].Used == TRUE)
+			continue;
+
+		Handles[Index].Used = TRUE;
+		Handles[Index].NumberOfProtocols = 0;
+		*Handle = (EFI_HANDLE)(Handles + Index);
+
+		return EFI_SUCCESS;
+	}
+
+	return EFI_OUT_OF_RESOURCES;
+}
+
+EFI_STATUS
+HostProtocolInstall(EFI_HANDLE *Handle, EFI_GUID *Protocol, VOID *Interface)
+{
+	if (!Handle || !Protocol)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status;
+
+	if (!*Handle) {
+		Status = HandleCreate(Handle);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	HOST_HANDLE *HostHandle = HandleGet(*Handle);
+	if (!HostHandle)
+		return EFI_INVALID_PARAMETER;
+
+	if (ProtocolGet(HostHandle, Protocol))
+		return EFI_INVALID_PARAMETER;
+
+	if (HostHandle->NumberOfProtocols == MAX_HANDLE_PROTOCOLS)
+		return EFI_OUT_OF_RESOURCES;
+
+	HOST_PROTOCOL *HostProtocol;
+
+	HostProtocol = HostHandle->Protocols + HostHandle->NumberOfProtocols++;
+	HostProtocol->Protocol = *Protocol;
+	HostProtocol->Interface = Interface;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+ProtocolUninstall(EFI_HANDLE Handle, EFI_GUID *Protocol, VOID *Interface)
+{
+	HOST_HANDLE *HostHandle = HandleGet(Handle);
+	if (!HostHandle)
+		return EFI_INVALID_PARAMETER;
+
+	HOST_PROTOCOL *HostProtocol = ProtocolGet(HostHandle, Protocol);
+	if (!HostProtocol || HostProtocol->Interface != Interface)
+		return EFI_NOT_FOUND;
+
+	*HostProtocol = HostHandle->Protocols[--HostHandle->NumberOfProtocols];
+
+	/* The handle is gone along with the last protocol */
+	if (!HostHandle->NumberOfProtocols)
+		HostHandle->Used = FALSE;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostAllocatePool(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size,
+		 OUT VOID **Buffer)
+{
+	*Buffer = malloc(Size ? Size : 1);
+
+	return *Buffer ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFreePool(IN VOID *Buffer)
+{
+	free(Buffer);
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * The pages are mapped anonymously so that the head and tail trimmed by
+ * the aligned allocation can be unmapped separately.
+ */
+STATIC EFI_STATUS EFIAPI
+HostAllocatePages(IN EFI_ALLOCATE_TYPE Type, IN EFI_MEMORY_TYPE MemoryType,
+		  IN UINTN Pages, IN OUT EFI_PHYSICAL_ADDRESS *Memory)
+{
+	if (Type != AllocateAnyPages)
+		return EFI_NOT_FOUND;
+
+	VOID *Buffer = mmap(NULL, EFI_PAGES_TO_SIZE(Pages),
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Buffer == MAP_FAILED)
+		return EFI_OUT_OF_RESOURCES;
+
+	*Memory = (EFI_PHYSICAL_ADDRESS)(UINTN)Buffer;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFreePages(IN EFI_PHYSICAL_ADDRESS Memory, IN UINTN Pages)
+{
+	if (munmap((VOID *)(UINTN)Memory, EFI_PAGES_TO_SIZE(Pages)))
+		return EFI_NOT_FOUND;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_TPL EFIAPI
+HostRaiseTpl(IN EFI_TPL NewTpl)
+{
+	EFI_TPL OldTpl = CurrentTpl;
+
+	CurrentTpl = NewTpl;
+
+	return OldTpl;
+}
+
+STATIC VOID EFIAPI
+HostRestoreTpl(IN EFI_TPL OldTpl)
+{
+	CurrentTpl = OldTpl;
+}
+
+STATIC HOST_EVENT *
+EventGet(EFI_EVENT Event)
+{
+	HOST_EVENT *HostEvent = (HOST_EVENT *)Event;
+
+	if (HostEvent < Events || HostEvent >= Events + MAX_EVENTS ||
+	    HostEvent->Used == FALSE)
+		return NULL;
+
+	return HostEvent;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostCreateEvent(IN UINT32 Type, IN EFI_TPL NotifyTpl,
+		IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL,
+		IN VOID *NotifyContext OPTIONAL, OUT EFI_EVENT *Event)
+{
+	if (!Event)
+		return EFI_INVALID_PARAMETER;
+
+	if ((Type & (EVT_NOTIFY_SIGNAL | EVT_NOTIFY_WAIT)) && !NotifyFunction)
+		return EFI_INVALID_PARAMETER;
+
+	/* Timers are never fired by the simulated firmware */
+	if (Type & EVT_TIMER)
+		return EFI_UNSUPPORTED;
+
+	for (UINTN Index = 0; Index < MAX_EVENTS; ++Index) {
+		HOST_EVENT *HostEvent = Events + Index;
+
+		if (HostEvent->Used == TRUE)
+			continue;
+
+		HostEvent->Used = TRUE;
+		HostEvent->Type = Type;
+		HostEvent->NotifyTpl = NotifyTpl;
+		HostEvent->NotifyFunction = NotifyFunction;
+		HostEvent->NotifyContext = NotifyContext;
+		HostEvent->Signaled = FALSE;
+		MemSet(&HostEvent->EventGroup, 0,
+		       sizeof(HostEvent->EventGroup));
+		*Event = (EFI_EVENT)HostEvent;
+
+		return EFI_SUCCESS;
+	}
+
+	return EFI_OUT_OF_RESOURCES;
+}
+
+/* Only the group signalled by HostExitBootServices() is ever signalled */
+STATIC EFI_STATUS EFIAPI
+HostCreateEventEx(IN UINT32 Type, IN EFI_TPL NotifyTpl,
+		  IN EFI_EVENT_NOTIFY NotifyFunction OPTIONAL,
+		  IN CONST VOID *NotifyContext OPTIONAL,
+		  IN CONST EFI_GUID *EventGroup OPTIONAL,
+		  OUT EFI_EVENT *Event)
+{
+	EFI_STATUS Status;
+
+	Status = HostCreateEvent(Type, NotifyTpl, NotifyFunction,
+				 (VOID *)NotifyContext, Event);
+	if (!EFI_ERROR(Status) && EventGroup)
+		((HOST_EVENT *)*Event)->EventGroup = *EventGroup;
+
+	return Status;
+}
+
+/*
+ * There is no preemption in the simulated firmware, so the notification
+ * function is called right away at its TPL.
+ */
+STATIC EFI_STATUS EFIAPI
+HostSignalEvent(IN EFI_EVENT Event)
+{
+	HOST_EVENT *HostEvent = EventGet(Event);
+	if (!HostEvent)
+		return EFI_INVALID_PARAMETER;
+
+	HostEvent->Signaled = TRUE;
+
+	if (HostEvent->Type & EVT_NOTIFY_SIGNAL) {
+		EFI_TPL OldTpl = HostRaiseTpl(HostEvent->NotifyTpl);
+
+		HostEvent->Signaled = FALSE;
+		HostEvent->NotifyFunction(Event, HostEvent->NotifyContext);
+		HostRestoreTpl(OldTpl);
+	}
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostCheckEvent(IN EFI_EVENT Event)
+{
+	HOST_EVENT *HostEvent = EventGet(Event);
+	if (!HostEvent || (HostEvent->Type & EVT_NOTIFY_SIGNAL))
+		return EFI_INVALID_PARAMETER;
+
+	if (HostEvent->Signaled == FALSE && HostEvent->NotifyFunction)
+		HostEvent->NotifyFunction(Event, HostEvent->NotifyContext);
+
+	if (HostEvent->Signaled == FALSE)
+		return EFI_NOT_READY;
+
+	HostEvent->Signaled = FALSE;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostCloseEvent(IN EFI_EVENT Event)
+{
+	HOST_EVENT *HostEvent = EventGet(Event);
+	if (!HostEvent)
+		return EFI_INVALID_PARAMETER;
+
+	HostEvent->Used = FALSE;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * EFI_EVENT_GROUP_BEFORE_EXIT_BOOT_SERVICES of UEFI 2.8 is signalled
+ * before any EVT_SIGNAL_EXIT_BOOT_SERVICES event.
+ */
+VOID
+HostExitBootServices(VOID)
+{
+	STATIC CONST EFI_GUID BeforeExitBootServicesGuid = {
+		0x8be0e274, 0x3970, 0x4b44,
+		{ 0x80, 0xc5, 0x1a, 0xb9, 0x50, 0x2f, 0x3b, 0xfc }
+	};
+
+	for (UINTN Index = 0; Index < MAX_EVENTS; ++Index) {
+		HOST_EVENT *HostEvent = Events + Index;
+
+		if (HostEvent->Used == TRUE &&
+		    GuidEqual(&HostEvent->EventGroup,
+			      &BeforeExitBootServicesGuid) == TRUE)
+			HostSignalEvent((EFI_EVENT)HostEvent);
+	}
+
+	for (UINTN Index = 0; Index < MAX_EVENTS; ++Index) {
+		HOST_EVENT *HostEvent = Events + Index;
+
+		if (HostEvent->Used == TRUE &&
+		    HostEvent->Type == EVT_SIGNAL_EXIT_BOOT_SERVICES)
+			HostSignalEvent((EFI_EVENT)HostEvent);
+	}
+}
+
+STATIC EFI_STATUS EFIAPI
+HostInstallProtocolInterface(IN OUT EFI_HANDLE *Handle,
+			     IN EFI_GUID *Protocol,
+			     IN EFI_INTERFACE_TYPE InterfaceType,
+			     IN VOID *Interface)
+{
+	if (InterfaceType != EFI_NATIVE_INTERFACE)
+		return EFI_INVALID_PARAMETER;
+
+	return HostProtocolInstall(Handle, Protocol, Interface);
+}
+
+STATIC EFI_STATUS EFIAPI
+HostUninstallProtocolInterface(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol,
+			       IN VOID *Interface)
+{
+	return ProtocolUninstall(Handle, Protocol, Interface);
+}
+
+STATIC EFI_STATUS EFIAPI
+HostHandleProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol,
+		   OUT VOID **Interface)
+{
+	if (!Protocol || !Interface)
+		return EFI_INVALID_PARAMETER;
+
+	HOST_HANDLE *HostHandle = HandleGet(Handle);
+	if (!HostHandle)
+		return EFI_INVALID_PARAMETER;
+
+	HOST_PROTOCOL *HostProtocol = ProtocolGet(HostHandle, Protocol);
+	if (!HostProtocol)
+		return EFI_UNSUPPORTED;
+
+	*Interface = HostProtocol->Interface;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostLocateDevicePath(IN EFI_GUID *Protocol,
+		     IN OUT EFI_DEVICE_PATH_PROTOCOL **DevicePath,
+		     OUT EFI_HANDLE *Device)
+{
+	return EFI_NOT_FOUND;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostInstallConfigurationTable(IN EFI_GUID *Guid, IN VOID *Table)
+{
+	if (!Guid)
+		return EFI_INVALID_PARAMETER;
+
+	UINTN Entries = HostSystemTable->NumberOfTableEntries;
+	UINTN Index;
+
+	for (Index = 0; Index < Entries; ++Index) {
+		if (GuidEqual(&ConfigurationTables[Index].VendorGuid,
+			      Guid) == TRUE)
+			break;
+	}
+
+	if (!Table) {
+		if (Index == Entries)
+			return EFI_NOT_FOUND;
+
+		ConfigurationTables[Index] = ConfigurationTables[Entries - 1];
+		--HostSystemTable->NumberOfTableEntries;
+
+		return EFI_SUCCESS;
+	}
+
+	if (Index == Entries) {
+		if (Entries == MAX_CONFIGURATION_TABLES)
+			return EFI_OUT_OF_RESOURCES;
+
+		ConfigurationTables[Index].VendorGuid = *Guid;
+		++HostSystemTable->NumberOfTableEntries;
+	}
+
+	ConfigurationTables[Index].VendorTable = Table;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * The PE images are not executed. An image in the buffer is authenticated
+ * with EFI Security2 Architectural Protocol as the firmware does, and
+ * starting it only counts it. Loading from the file path, e.g, grub or the
+ * drivers, is not modeled.
+ */
+STATIC EFI_STATUS EFIAPI
+HostLocateProtocol(IN EFI_GUID *Protocol, IN VOID *Registration OPTIONAL,
+		   OUT VOID **Interface);
+
+STATIC EFI_STATUS EFIAPI
+HostLoadImage(IN BOOLEAN BootPolicy, IN EFI_HANDLE ParentImageHandle,
+	      IN EFI_DEVICE_PATH_PROTOCOL *DevicePath,
+	      IN VOID *SourceBuffer OPTIONAL, IN UINTN SourceSize,
+	      OUT EFI_HANDLE *ImageHandle)
+{
+	if (!SourceBuffer || !SourceSize || !ImageHandle)
+		return EFI_UNSUPPORTED;
+
+	/* Sap2.c defining the GUID is not linked into SelBench */
+	STATIC EFI_GUID Security2Guid = EFI_SECURITY2_ARCH_PROTOCOL_GUID;
+	EFI_SECURITY2_ARCH_PROTOCOL *Sap2;
+	EFI_STATUS Status;
+
+	Status = HostLocateProtocol(&Security2Guid, NULL, (VOID **)&Sap2);
+	if (!EFI_ERROR(Status)) {
+		Status = Sap2->FileAuthentication(Sap2, DevicePath,
+						  SourceBuffer, SourceSize,
+						  BootPolicy);
+		if (EFI_ERROR(Status))
+			return EFI_SECURITY_VIOLATION;
+	}
+
+	EFI_LOADED_IMAGE *LoadedImage = calloc(1, sizeof(*LoadedImage));
+	if (!LoadedImage)
+		return EFI_OUT_OF_RESOURCES;
+
+	LoadedImage->Revision = EFI_LOADED_IMAGE_PROTOCOL_REVISION;
+	LoadedImage->ParentHandle = ParentImageHandle;
+	LoadedImage->SystemTable = HostSystemTable;
+	LoadedImage->ImageBase = SourceBuffer;
+	LoadedImage->ImageSize = SourceSize;
+
+	*ImageHandle = NULL;
+
+	Status = HostProtocolInstall(ImageHandle, &gEfiLoadedImageProtocolGuid,
+				     LoadedImage);
+	if (EFI_ERROR(Status))
+		free(LoadedImage);
+
+	return Status;
+}
+
+STATIC UINTN NumberOfStartedImages;
+
+STATIC EFI_STATUS EFIAPI
+HostStartImage(IN EFI_HANDLE ImageHandle, OUT UINTN *ExitDataSize,
+	       OUT CHAR16 **ExitData OPTIONAL)
+{
+	EFI_LOADED_IMAGE *LoadedImage;
+	EFI_STATUS Status;
+
+	Status = HostHandleProtocol(ImageHandle, &gEfiLoadedImageProtocolGuid,
+				    (VOID **)&LoadedImage);
+	if (EFI_ERROR(Status) || !LoadedImage->ImageBase)
+		return EFI_INVALID_PARAMETER;
+
+	++NumberOfStartedImages;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostUnloadImage(IN EFI_HANDLE ImageHandle)
+{
+	EFI_LOADED_IMAGE *LoadedImage;
+	EFI_STATUS Status;
+
+	Status = HostHandleProtocol(ImageHandle, &gEfiLoadedImageProtocolGuid,
+				    (VOID **)&LoadedImage);
+	if (EFI_ERROR(Status) || !LoadedImage->ImageBase)
+		return EFI_INVALID_PARAMETER;
+
+	ProtocolUninstall(ImageHandle, &gEfiLoadedImageProtocolGuid,
+			  LoadedImage);
+	free(LoadedImage);
+
+	return EFI_SUCCESS;
+}
+
+/* The number of the images started so far */
+UINTN
+HostImageStartCount(VOID)
+{
+	return NumberOfStartedImages;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostStall(IN UINTN Microseconds)
+{
+	struct timespec Time = {
+		.tv_sec = Microseconds / 1000000,
+		.tv_nsec = (Microseconds % 1000000) * 1000,
+	};
+
+	while (nanosleep(&Time, &Time))
+		;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostLocateHandleBuffer(IN EFI_LOCATE_SEARCH_TYPE SearchType,
+		       IN EFI_GUID *Protocol OPTIONAL,
+		       IN VOID *SearchKey OPTIONAL,
+		       IN OUT UINTN *NoHandles, OUT EFI_HANDLE **Buffer)
+{
+	if (!NoHandles || !Buffer)
+		return EFI_INVALID_PARAMETER;
+
+	if (SearchType != AllHandles && SearchType != ByProtocol)
+		return EFI_UNSUPPORTED;
+
+	if (SearchType == ByProtocol && !Protocol)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_HANDLE *HandleBuffer = malloc(sizeof(EFI_HANDLE) * MAX_HANDLES);
+	if (!HandleBuffer)
+		return EFI_OUT_OF_RESOURCES;
+
+	UINTN Number = 0;
+
+	for (UINTN Index = 0; Index < MAX_HANDLES; ++Index) {
+		if (Handles[Index].Used == FALSE)
+			continue;
+
+		if (SearchType == ByProtocol &&
+		    !ProtocolGet(Handles + Index, Protocol))
+			continue;
+
+		HandleBuffer[Number++] = (EFI_HANDLE)(Handles + Index);
+	}
+
+	if (!Number) {
+		free(HandleBuffer);
+		return EFI_NOT_FOUND;
+	}
+
+	*NoHandles = Number;
+	*Buffer = HandleBuffer;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostLocateProtocol(IN EFI_GUID *Protocol, IN VOID *Registration OPTIONAL,
+		   OUT VOID **Interface)
+{
+	if (!Protocol || !Interface)
+		return EFI_INVALID_PARAMETER;
+
+	for (UINTN Index = 0; Index < MAX_HANDLES; ++Index) {
+		if (Handles[Index].Used == FALSE)
+			continue;
+
+		HOST_PROTOCOL *HostProtocol = ProtocolGet(Handles + Index,
+							  Protocol);
+		if (HostProtocol) {
+			*Interface = HostProtocol->Interface;
+			return EFI_SUCCESS;
+		}
+	}
+
+	*Interface = NULL;
+
+	return EFI_NOT_FOUND;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostInstallMultipleProtocolInterfaces(IN OUT EFI_HANDLE *Handle, ...)
+{
+	VA_LIST Marker;
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	VA_START(Marker, Handle);
+
+	for (EFI_GUID *Protocol = VA_ARG(Marker, EFI_GUID *); Protocol;
+	     Protocol = VA_ARG(Marker, EFI_GUID *)) {
+		Status = HostProtocolInstall(Handle, Protocol,
+					     VA_ARG(Marker, VOID *));
+		if (EFI_ERROR(Status))
+			break;
+	}
+
+	VA_END(Marker);
+
+	return Status;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostUninstallMultipleProtocolInterfaces(IN EFI_HANDLE Handle, ...)
+{
+	VA_LIST Marker;
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	VA_START(Marker, Handle);
+
+	for (EFI_GUID *Protocol = VA_ARG(Marker, EFI_GUID *); Protocol;
+	     Protocol = VA_ARG(Marker, EFI_GUID *)) {
+		Status = ProtocolUninstall(Handle, Protocol,
+					   VA_ARG(Marker, VOID *));
+		if (EFI_ERROR(Status))
+			break;
+	}
+
+	VA_END(Marker);
+
+	return Status;
+}
+
+/*
+ * The built-in SHA-2 engine plays the firmware EFI Hash2 Protocol so
+ * that Hash.c runs through the same service binding path as on BIOS.
+ * Each child carries its own multi-part hash as the firmware does.
+ */
+STATIC EFI_STATUS EFIAPI
+HostHash2CreateChild(IN EFI_SERVICE_BINDING_PROTOCOL *This,
+		     IN OUT EFI_HANDLE *ChildHandle)
+{
+	if (!ChildHandle)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_HASH2_PROTOCOL *Hash2;
+	EFI_STATUS Status;
+
+	Status = Sha2ProtocolCreate(&Hash2);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = HostProtocolInstall(ChildHandle, &gEfiHash2ProtocolGuid,
+				     Hash2);
+	if (EFI_ERROR(Status))
+		Sha2ProtocolDestroy(Hash2);
+
+	return Status;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostHash2DestroyChild(IN EFI_SERVICE_BINDING_PROTOCOL *This,
+		      IN EFI_HANDLE ChildHandle)
+{
+	EFI_HASH2_PROTOCOL *Hash2;
+	EFI_STATUS Status;
+
+	Status = HostHandleProtocol(ChildHandle, &gEfiHash2ProtocolGuid,
+				    (VOID **)&Hash2);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = ProtocolUninstall(ChildHandle, &gEfiHash2ProtocolGuid,
+				   Hash2);
+	if (!EFI_ERROR(Status))
+		Sha2ProtocolDestroy(Hash2);
+
+	return Status;
+}
+
+STATIC EFI_SERVICE_BINDING_PROTOCOL HostHash2ServiceBinding = {
+	HostHash2CreateChild,
+	HostHash2DestroyChild
+};
+
+STATIC EFI_BOOT_SERVICES HostBootServices = {
+	.Hdr = {
+		.Signature = EFI_BOOT_SERVICES_SIGNATURE,
+		.Revision = EFI_BOOT_SERVICES_REVISION,
+		.HeaderSize = sizeof(EFI_BOOT_SERVICES),
+	},
+	.RaiseTPL = HostRaiseTpl,
+	.RestoreTPL = HostRestoreTpl,
+	.AllocatePages = HostAllocatePages,
+	.FreePages = HostFreePages,
+	.AllocatePool = HostAllocatePool,
+	.FreePool = HostFreePool,
+	.CreateEvent = HostCreateEvent,
+	.SignalEvent = HostSignalEvent,
+	.CloseEvent = HostCloseEvent,
+	.CheckEvent = HostCheckEvent,
+	.CreateEventEx = HostCreateEventEx,
+	.InstallProtocolInterface = HostInstallProtocolInterface,
+	.UninstallProtocolInterface = HostUninstallProtocolInterface,
+	.HandleProtocol = HostHandleProtocol,
+	.LocateDevicePath = HostLocateDevicePath,
+	.InstallConfigurationTable = HostInstallConfigurationTable,
+	.LoadImage = HostLoadImage,
+	.StartImage = HostStartImage,
+	.UnloadImage = HostUnloadImage,
+	.Stall = HostStall,
+	.LocateHandleBuffer = HostLocateHandleBuffer,
+	.LocateProtocol = HostLocateProtocol,
+	.InstallMultipleProtocolInterfaces =
+		HostInstallMultipleProtocolInterfaces,
+	.UninstallMultipleProtocolInterfaces =
+		HostUninstallMultipleProtocolInterfaces,
+};
+
+EFI_STATUS
+HostBootServicesInitialize(EFI_SYSTEM_TABLE *SystemTable)
+{
+	HostSystemTable = SystemTable;
+	SystemTable->BootServices = &HostBootServices;
+	SystemTable->ConfigurationTable = ConfigurationTables;
+	SystemTable->NumberOfTableEntries = 0;
+
+	EFI_HANDLE Handle = NULL;
+
+	return HostProtocolInstall(&Handle,
+				   &gEfiHash2ServiceBindingProtocolGuid,
+				   &HostHash2ServiceBinding);
+}
+
+/*
+ * Install the loaded image along with the device it is loaded from, as
+ * the boot manager does for the boot option.
+ */
+EFI_STATUS
+HostImageInstall(CONST CHAR16 *Path,
+		 EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem,
+		 EFI_HANDLE *ImageHandle)
+{
+	STATIC EFI_DEVICE_PATH_PROTOCOL DeviceEnd = {
+		END_DEVICE_PATH_TYPE, END_ENTIRE_DEVICE_PATH_SUBTYPE,
+		{ sizeof(EFI_DEVICE_PATH_PROTOCOL), 0 }
+	};
+	STATIC EFI_LOADED_IMAGE LoadedImage = {
+		.Revision = EFI_LOADED_IMAGE_PROTOCOL_REVISION,
+		.ImageCodeType = EfiLoaderCode,
+		.ImageDataType = EfiLoaderData,
+	};
+	EFI_HANDLE DeviceHandle = NULL;
+	EFI_STATUS Status;
+
+	Status = HostProtocolInstall(&DeviceHandle,
+				     &gEfiSimpleFileSystemProtocolGuid,
+				     FileSystem);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = HostProtocolInstall(&DeviceHandle, &gEfiDevicePathProtocolGuid,
+				     &DeviceEnd);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	LoadedImage.SystemTable = HostSystemTable;
+	LoadedImage.DeviceHandle = DeviceHandle;
+	LoadedImage.FilePath = FileDevicePath(NULL, (CHAR16 *)Path);
+	if (!LoadedImage.FilePath)
+		return EFI_OUT_OF_RESOURCES;
+
+	*ImageHandle = NULL;
+
+	return HostProtocolInstall(ImageHandle, &gEfiLoadedImageProtocolGuid,
+				   &LoadedImage);
+}
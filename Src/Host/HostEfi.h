@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+#ifndef HOST_EFI_H
+#define HOST_EFI_H
+
+#include <Efi.h>
+
+/*
+ * The simulated firmware running the SELoader library as a Linux process.
+ * The sources are built with the native compiler and EFIAPI defined as
+ * empty, so the firmware services are plain C functions.
+ */
+
+typedef enum {
+	HostLatencyFileOpen,
+	HostLatencyFileRead,
+	HostLatencyFileReadKiB,
+	HostLatencyFileWrite,
+	HostLatencyFileInfo,
+	HostLatencyVariableGet,
+	HostLatencyVariableSet,
+	HostLatencyPkcs7Verify,
+	HostLatencyMax
+} HOST_LATENCY;
+
+/* HostBootServices.c */
+EFI_STATUS
+HostBootServicesInitialize(EFI_SYSTEM_TABLE *SystemTable);
+
+EFI_STATUS
+HostProtocolInstall(EFI_HANDLE *Handle, EFI_GUID *Protocol, VOID *Interface);
+
+EFI_STATUS
+HostImageInstall(CONST CHAR16 *Path,
+		 EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem,
+		 EFI_HANDLE *ImageHandle);
+
+VOID
+HostExitBootServices(VOID);
+
+UINTN
+HostImageStartCount(VOID);
+
+/* HostImage.c */
+EFI_STATUS
+HostSecurity2Install(VOID);
+
+VOID
+HostSecurity2Restore(VOID);
+
+EFI_STATUS
+HostImageTrust(CONST VOID *Data, UINTN DataSize);
+
+EFI_STATUS
+HostUkiCreate(CONST VOID *Linux, UINTN LinuxSize, CONST CHAR8 *Cmdline,
+	      VOID **Data, UINTN *DataSize);
+
+/* HostRuntimeServices.c */
+EFI_STATUS
+HostRuntimeServicesInitialize(EFI_SYSTEM_TABLE *SystemTable);
+
+EFI_STATUS
+HostVariableSeed(CONST CHAR8 *KeyDirectory, BOOLEAN MokSecureBoot);
+
+/* HostFileSystem.c */
+EFI_STATUS
+HostFileSystemLoad(CONST CHAR8 *Directory);
+
+EFI_STATUS
+HostFileSystemAdd(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize);
+
+EFI_STATUS
+HostFileSystemFind(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize);
+
+EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *
+HostFileSystemGet(VOID);
+
+/* HostPkcs7.c */
+EFI_STATUS
+HostPkcs7Install(VOID);
+
+EFI_STATUS
+HostCertificateLoad(CONST CHAR8 *Path, UINT8 **Certificate,
+		    UINTN *CertificateSize);
+
+EFI_STATUS
+HostSignatureCreate(CONST CHAR8 *KeyPath, CONST CHAR8 *CertificatePath,
+		    CONST VOID *Data, UINTN DataSize, VOID **Signature,
+		    UINTN *SignatureSize);
+
+/* HostMpServices.c */
+EFI_STATUS
+HostMpServicesInstall(UINTN NumberOfApplicationProcessors);
+
+/* HostTcg2.c */
+BOOLEAN
+HostTcg2Parse(CONST CHAR8 *Specification);
+
+EFI_STATUS
+HostTcg2Install(VOID);
+
+VOID
+HostTcg2Report(VOID);
+
+/* HostLatency.c */
+BOOLEAN
+HostLatencyParse(CONST CHAR8 *Specification);
+
+VOID
+HostLatencyInject(HOST_LATENCY Point, UINTN Units);
+
+VOID
+HostLatencyReport(VOID);
+
+/* HostStub.c */
+VOID
+HostEfiInitialize(VOID);
+
+/* HostGnuEfi.c */
+CHAR16 *
+HostStrDup(CONST CHAR8 *String);
+
+#endif	/* HOST_EFI_H */
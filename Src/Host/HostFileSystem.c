@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The simulated ESP. The files are loaded from a host directory into
+ * memory up front so the file latency is determined by the injection
+ * only. The path is case-insensitive as FAT.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "HostEfi.h"
+
+#define NODE_NONE		((UINTN)-1)
+
+typedef struct {
+	/* The full path without the leading backslash, or NULL if deleted */
+	CHAR16 *Path;
+	BOOLEAN Directory;
+	UINT8 *Data;
+	UINTN DataSize;
+} HOST_FILE_NODE;
+
+typedef struct {
+	EFI_FILE_PROTOCOL File;
+	UINTN Node;
+	UINT64 Position;
+	UINT64 OpenMode;
+} HOST_FILE;
+
+STATIC HOST_FILE_NODE *Nodes;
+STATIC UINTN NumberOfNodes;
+
+STATIC CHAR16
+ToLower(CHAR16 Char)
+{
+	return (Char >= L'A' && Char <= L'Z') ? Char - L'A' + L'a' : Char;
+}
+
+STATIC BOOLEAN
+PathEqual(CONST CHAR16 *Path1, CONST CHAR16 *Path2)
+{
+	while (*Path1 && ToLower(*Path1) == ToLower(*Path2)) {
+		++Path1;
+		++Path2;
+	}
+
+	return *Path1 == *Path2;
+}
+
+/*
+ * Resolve the file name relative to the base directory, which is the
+ * full path of the opened directory, into a full path.
+ */
+STATIC CHAR16 *
+PathResolve(CONST CHAR16 *Base, CONST CHAR16 *Name)
+{
+	CHAR16 *Path = malloc((StrLen(Base) + StrLen(Name) + 2) *
+			      sizeof(CHAR16));
+	if (!Path)
+		return NULL;
+
+	UINTN Length = 0;
+
+	if (*Name != L'\\' && *Name != L'/') {
+		StrCpy(Path, Base);
+		Length = StrLen(Base);
+	}
+
+	while (*Name) {
+		CONST CHAR16 *End = Name;
+
+		while (*End && *End != L'\\' && *End != L'/')
+			++End;
+
+		UINTN ComponentLength = End - Name;
+
+		if (ComponentLength == 2 && Name[0] == L'.' &&
+		    Name[1] == L'.') {
+			while (Length && Path[Length - 1] != L'\\')
+				--Length;
+
+			if (Length)
+				--Length;
+		} else if (ComponentLength &&
+			   !(ComponentLength == 1 && Name[0] == L'.')) {
+			if (Length)
+				Path[Length++] = L'\\';
+
+			MemCpy(Path + Length, Name,
+			       ComponentLength * sizeof(CHAR16));
+			Length += ComponentLength;
+		}
+
+		Name = *End ? End + 1 : End;
+	}
+
+	Path[Length] = L'\0';
+
+	return Path;
+}
+
+STATIC UINTN
+NodeFind(CONST CHAR16 *Path)
+{
+	for (UINTN Index = 0; Index < NumberOfNodes; ++Index) {
+		if (Nodes[Index].Path &&
+		    PathEqual(Nodes[Index].Path, Path) == TRUE)
+			return Index;
+	}
+
+	return NODE_NONE;
+}
+
+STATIC EFI_STATUS
+NodeCreate(CONST CHAR16 *Path, BOOLEAN Directory, BOOLEAN Parents,
+	   UINTN *Node);
+
+STATIC EFI_STATUS
+ParentCreate(CONST CHAR16 *Path, BOOLEAN Parents)
+{
+	UINTN Length = StrLen(Path);
+
+	while (Length && Path[Length - 1] != L'\\')
+		--Length;
+
+	CHAR16 *Parent = malloc((Length + 1) * sizeof(CHAR16));
+	if (!Parent)
+		return EFI_OUT_OF_RESOURCES;
+
+	MemCpy(Parent, Path, Length * sizeof(CHAR16));
+	Parent[Length ? Length - 1 : 0] = L'\0';
+
+	UINTN ParentNode = NodeFind(Parent);
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	if (ParentNode == NODE_NONE) {
+		if (Parents == TRUE)
+			Status = NodeCreate(Parent, TRUE, TRUE, &ParentNode);
+		else
+			Status = EFI_NOT_FOUND;
+	} else if (Nodes[ParentNode].Directory == FALSE)
+		Status = EFI_NOT_FOUND;
+
+	free(Parent);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+NodeCreate(CONST CHAR16 *Path, BOOLEAN Directory, BOOLEAN Parents,
+	   UINTN *Node)
+{
+	/* The root directory has no parent */
+	if (*Path) {
+		EFI_STATUS Status;
+
+		Status = ParentCreate(Path, Parents);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	HOST_FILE_NODE *NewNodes = realloc(Nodes, (NumberOfNodes + 1) *
+						  sizeof(*Nodes));
+	if (!NewNodes)
+		return EFI_OUT_OF_RESOURCES;
+
+	Nodes = NewNodes;
+
+	HOST_FILE_NODE *NewNode = Nodes + NumberOfNodes;
+
+	NewNode->Path = malloc((StrLen(Path) + 1) * sizeof(CHAR16));
+	if (!NewNode->Path)
+		return EFI_OUT_OF_RESOURCES;
+
+	StrCpy(NewNode->Path, Path);
+	NewNode->Directory = Directory;
+	NewNode->Data = NULL;
+	NewNode->DataSize = 0;
+	*Node = NumberOfNodes++;
+
+	return EFI_SUCCESS;
+}
+
+STATIC CONST CHAR16 *
+NodeName(HOST_FILE_NODE *Node)
+{
+	CONST CHAR16 *Name = Node->Path + StrLen(Node->Path);
+
+	while (Name > Node->Path && Name[-1] != L'\\')
+		--Name;
+
+	return Name;
+}
+
+STATIC EFI_STATUS
+FileCreate(UINTN Node, UINT64 OpenMode, EFI_FILE_PROTOCOL **File);
+
+STATIC EFI_STATUS EFIAPI
+HostFileOpen(IN EFI_FILE_PROTOCOL *This, OUT EFI_FILE_PROTOCOL **NewHandle,
+	     IN CHAR16 *FileName, IN UINT64 OpenMode, IN UINT64 Attributes)
+{
+	if (!This || !NewHandle || !FileName)
+		return EFI_INVALID_PARAMETER;
+
+	if (OpenMode != EFI_FILE_MODE_READ &&
+	    OpenMode != (EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE) &&
+	    OpenMode != (EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE |
+			 EFI_FILE_MODE_CREATE))
+		return EFI_INVALID_PARAMETER;
+
+	HostLatencyInject(HostLatencyFileOpen, 1);
+
+	HOST_FILE *HostFile = (HOST_FILE *)This;
+	CHAR16 *Path = PathResolve(Nodes[HostFile->Node].Path, FileName);
+	if (!Path)
+		return EFI_OUT_OF_RESOURCES;
+
+	UINTN Node = NodeFind(Path);
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	if (Node == NODE_NONE) {
+		if (OpenMode & EFI_FILE_MODE_CREATE)
+			Status = NodeCreate(Path, (Attributes &
+						   EFI_FILE_DIRECTORY) ?
+						  TRUE : FALSE, FALSE, &Node);
+		else
+			Status = EFI_NOT_FOUND;
+	}
+
+	free(Path);
+
+	if (EFI_ERROR(Status))
+		return Status;
+
+	return FileCreate(Node, OpenMode, NewHandle);
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileClose(IN EFI_FILE_PROTOCOL *This)
+{
+	free(This);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileDelete(IN EFI_FILE_PROTOCOL *This)
+{
+	HOST_FILE_NODE *Node = Nodes + ((HOST_FILE *)This)->Node;
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	/* The directories are never deleted by the SELoader */
+	if (Node->Directory == TRUE)
+		Status = EFI_WARN_DELETE_FAILURE;
+	else {
+		free(Node->Path);
+		free(Node->Data);
+		Node->Path = NULL;
+		Node->Data = NULL;
+	}
+
+	HostFileClose(This);
+
+	return Status;
+}
+
+/*
+ * Reading a directory always hits the end of the directory entries as
+ * the SELoader never lists a directory.
+ */
+STATIC EFI_STATUS EFIAPI
+HostFileRead(IN EFI_FILE_PROTOCOL *This, IN OUT UINTN *BufferSize,
+	     OUT VOID *Buffer)
+{
+	if (!BufferSize || (*BufferSize && !Buffer))
+		return EFI_INVALID_PARAMETER;
+
+	HOST_FILE *HostFile = (HOST_FILE *)This;
+	HOST_FILE_NODE *Node = Nodes + HostFile->Node;
+
+	if (!Node->Path)
+		return EFI_DEVICE_ERROR;
+
+	if (Node->Directory == TRUE) {
+		*BufferSize = 0;
+		return EFI_SUCCESS;
+	}
+
+	if (HostFile->Position > Node->DataSize)
+		return EFI_DEVICE_ERROR;
+
+	UINTN Size = MIN(*BufferSize,
+			 Node->DataSize - (UINTN)HostFile->Position);
+
+	HostLatencyInject(HostLatencyFileRead, 1);
+	HostLatencyInject(HostLatencyFileReadKiB, Size / 1024);
+
+	MemCpy(Buffer, Node->Data + HostFile->Position, Size);
+	HostFile->Position += Size;
+	*BufferSize = Size;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileWrite(IN EFI_FILE_PROTOCOL *This, IN OUT UINTN *BufferSize,
+	      IN VOID *Buffer)
+{
+	if (!BufferSize || (*BufferSize && !Buffer))
+		return EFI_INVALID_PARAMETER;
+
+	HOST_FILE *HostFile = (HOST_FILE *)This;
+	HOST_FILE_NODE *Node = Nodes + HostFile->Node;
+
+	if (!Node->Path)
+		return EFI_DEVICE_ERROR;
+
+	if (Node->Directory == TRUE)
+		return EFI_UNSUPPORTED;
+
+	if (!(HostFile->OpenMode & EFI_FILE_MODE_WRITE))
+		return EFI_ACCESS_DENIED;
+
+	HostLatencyInject(HostLatencyFileWrite, 1);
+
+	UINTN End = (UINTN)HostFile->Position + *BufferSize;
+
+	if (End > Node->DataSize) {
+		UINT8 *Data = realloc(Node->Data, End);
+		if (!Data)
+			return EFI_VOLUME_FULL;
+
+		if (HostFile->Position > Node->DataSize)
+			MemSet(Data + Node->DataSize, 0,
+			       (UINTN)HostFile->Position - Node->DataSize);
+
+		Node->Data = Data;
+		Node->DataSize = End;
+	}
+
+	MemCpy(Node->Data + HostFile->Position, Buffer, *BufferSize);
+	HostFile->Position = End;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileSetPosition(IN EFI_FILE_PROTOCOL *This, IN UINT64 Position)
+{
+	HOST_FILE *HostFile = (HOST_FILE *)This;
+	HOST_FILE_NODE *Node = Nodes + HostFile->Node;
+
+	if (Node->Directory == TRUE) {
+		if (Position)
+			return EFI_UNSUPPORTED;
+	} else if (Position == (UINT64)-1)
+		Position = Node->DataSize;
+
+	HostFile->Position = Position;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileGetPosition(IN EFI_FILE_PROTOCOL *This, OUT UINT64 *Position)
+{
+	HOST_FILE *HostFile = (HOST_FILE *)This;
+
+	if (Nodes[HostFile->Node].Directory == TRUE)
+		return EFI_UNSUPPORTED;
+
+	*Position = HostFile->Position;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileGetInfo(IN EFI_FILE_PROTOCOL *This, IN EFI_GUID *InformationType,
+		IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+	if (!InformationType || !BufferSize)
+		return EFI_INVALID_PARAMETER;
+
+	if (MemCmp(InformationType, &gEfiFileInfoGuid, sizeof(EFI_GUID)))
+		return EFI_UNSUPPORTED;
+
+	HostLatencyInject(HostLatencyFileInfo, 1);
+
+	HOST_FILE_NODE *Node = Nodes + ((HOST_FILE *)This)->Node;
+	CONST CHAR16 *Name = NodeName(Node);
+	UINTN Size = SIZE_OF_EFI_FILE_INFO +
+		     (StrLen(Name) + 1) * sizeof(CHAR16);
+
+	if (*BufferSize < Size) {
+		*BufferSize = Size;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	if (!Buffer)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_FILE_INFO *FileInfo = Buffer;
+
+	MemSet(FileInfo, 0, SIZE_OF_EFI_FILE_INFO);
+	FileInfo->Size = Size;
+	FileInfo->FileSize = Node->DataSize;
+	FileInfo->PhysicalSize = ALIGN_VALUE(Node->DataSize, 512);
+	FileInfo->Attribute = Node->Directory == TRUE ? EFI_FILE_DIRECTORY :
+							EFI_FILE_ARCHIVE;
+	StrCpy(FileInfo->FileName, Name);
+	*BufferSize = Size;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileSetInfo(IN EFI_FILE_PROTOCOL *This, IN EFI_GUID *InformationType,
+		IN UINTN BufferSize, IN VOID *Buffer)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileFlush(IN EFI_FILE_PROTOCOL *This)
+{
+	return EFI_SUCCESS;
+}
+
+STATIC CONST EFI_FILE_PROTOCOL HostFileProtocol = {
+	.Revision = EFI_FILE_PROTOCOL_REVISION,
+	.Open = HostFileOpen,
+	.Close = HostFileClose,
+	.Delete = HostFileDelete,
+	.Read = HostFileRead,
+	.Write = HostFileWrite,
+	.GetPosition = HostFileGetPosition,
+	.SetPosition = HostFileSetPosition,
+	.GetInfo = HostFileGetInfo,
+	.SetInfo = HostFileSetInfo,
+	.Flush = HostFileFlush,
+};
+
+STATIC EFI_STATUS
+FileCreate(UINTN Node, UINT64 OpenMode, EFI_FILE_PROTOCOL **File)
+{
+	HOST_FILE *HostFile = malloc(sizeof(*HostFile));
+	if (!HostFile)
+		return EFI_OUT_OF_RESOURCES;
+
+	HostFile->File = HostFileProtocol;
+	HostFile->Node = Node;
+	HostFile->Position = 0;
+	HostFile->OpenMode = OpenMode;
+	*File = &HostFile->File;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostOpenVolume(IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *This,
+	       OUT EFI_FILE_PROTOCOL **Root)
+{
+	if (!Root)
+		return EFI_INVALID_PARAMETER;
+
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	if (!NumberOfNodes) {
+		UINTN Node;
+
+		Status = NodeCreate(L"", TRUE, FALSE, &Node);
+	}
+
+	if (EFI_ERROR(Status))
+		return Status;
+
+	return FileCreate(0, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, Root);
+}
+
+STATIC EFI_SIMPLE_FILE_SYSTEM_PROTOCOL HostFileSystem = {
+	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_REVISION,
+	HostOpenVolume
+};
+
+EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *
+HostFileSystemGet(VOID)
+{
+	return &HostFileSystem;
+}
+
+EFI_STATUS
+HostFileSystemAdd(CONST CHAR16 *Path, CONST VOID *Data, UINTN DataSize)
+{
+	CHAR16 *FullPath = PathResolve(L"", Path);
+	if (!FullPath)
+		return EFI_OUT_OF_RESOURCES;
+
+	UINTN Node = NodeFind(FullPath);
+	EFI_STATUS Status = EFI_SUCCESS;
+
+	if (Node == NODE_NONE)
+		Status = NodeCreate(FullPath, FALSE, TRUE, &Node);
+	else if (Nodes[Node].Directory == TRUE)
+		Status = EFI_ACCESS_DENIED;
+
+	free(FullPath);
+
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINT8 *Buffer = malloc(DataSize ? DataSize : 1);
+	if (!Buffer)
+		return EFI_OUT_OF_RESOURCES;
+
+	MemCpy(Buffer, Data, DataSize);
+	free(Nodes[Node].Data);
+	Nodes[Node].Data = Buffer;
+	Nodes[Node].DataSize = DataSize;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+HostFileSystemFind(CONST CHAR16 *Path, VOID **Data, UINTN *DataSize)
+{
+	CHAR16 *FullPath = PathResolve(L"", Path);
+	if (!FullPath)
+		return EFI_OUT_OF_RESOURCES;
+
+	UINTN Node = NodeFind(FullPath);
+
+	free(FullPath);
+
+	if (Node == NODE_NONE || Nodes[Node].Directory == TRUE)
+		return EFI_NOT_FOUND;
+
+	*Data = Nodes[Node].Data;
+	*DataSize = Nodes[Node].DataSize;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+LoadFile(CONST CHAR8 *HostPath, CONST CHAR16 *Path)
+{
+	FILE *File = fopen(HostPath, "rb");
+	if (!File)
+		return EFI_NOT_FOUND;
+
+	EFI_STATUS Status = EFI_OUT_OF_RESOURCES;
+	UINT8 *Data = NULL;
+	UINTN DataSize = 0;
+	UINTN BufferSize = 0;
+
+	while (!feof(File)) {
+		if (DataSize == BufferSize) {
+			BufferSize = BufferSize ? BufferSize * 2 : 65536;
+
+			UINT8 *Buffer = realloc(Data, BufferSize);
+			if (!Buffer)
+				goto out;
+
+			Data = Buffer;
+		}
+
+		DataSize += fread(Data + DataSize, 1, BufferSize - DataSize,
+				  File);
+		if (ferror(File)) {
+			Status = EFI_DEVICE_ERROR;
+			goto out;
+		}
+	}
+
+	Status = HostFileSystemAdd(Path, Data, DataSize);
+
+out:
+	free(Data);
+	fclose(File);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+LoadDirectory(CONST CHAR8 *HostPath, CONST CHAR8 *Path)
+{
+	DIR *Directory = opendir(HostPath);
+	if (!Directory)
+		return EFI_NOT_FOUND;
+
+	EFI_STATUS Status = EFI_SUCCESS;
+	struct dirent *Entry;
+
+	while (!EFI_ERROR(Status) && (Entry = readdir(Directory))) {
+		if (!strcmp(Entry->d_name, ".") ||
+		    !strcmp(Entry->d_name, ".."))
+			continue;
+
+		CHAR8 EntryHostPath[PATH_MAX];
+		CHAR8 EntryPath[PATH_MAX];
+		struct stat State;
+
+		snprintf(EntryHostPath, sizeof(EntryHostPath), "%s/%s",
+			 HostPath, Entry->d_name);
+		snprintf(EntryPath, sizeof(EntryPath), "%s\\%s", Path,
+			 Entry->d_name);
+
+		if (stat(EntryHostPath, &State))
+			continue;
+
+		if (S_ISDIR(State.st_mode))
+			Status = LoadDirectory(EntryHostPath, EntryPath);
+		else if (S_ISREG(State.st_mode)) {
+			CHAR16 *EntryPath16 = HostStrDup(EntryPath);
+			if (!EntryPath16) {
+				Status = EFI_OUT_OF_RESOURCES;
+				break;
+			}
+
+			Status = LoadFile(EntryHostPath, EntryPath16);
+			free(EntryPath16);
+		}
+	}
+
+	closedir(Directory);
+
+	return Status;
+}
+
+EFI_STATUS
+HostFileSystemLoad(CONST CHAR8 *Directory)
+{
+	EFI_FILE_PROTOCOL *Root;
+	EFI_STATUS Status;
+
+	Status = HostOpenVolume(&HostFileSystem, &Root);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	HostFileClose(Root);
+
+	return LoadDirectory(Directory, "");
+}
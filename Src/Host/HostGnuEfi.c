@@ -0,0 +1,449 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The subset of gnu-efi library used by the SELoader library. The pool
+ * of the simulated firmware is backed by malloc(), so the buffers returned
+ * to the caller are allocated with malloc() directly.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostEfi.h"
+
+/* Provided by gnu-efi */
+EFI_GUID gEfiDevicePathProtocolGuid = EFI_DEVICE_PATH_PROTOCOL_GUID;
+EFI_GUID gEfiGlobalVariableGuid = EFI_GLOBAL_VARIABLE;
+EFI_GUID gEfiHashProtocolGuid = EFI_HASH_PROTOCOL_GUID;
+EFI_GUID gEfiLoadedImageProtocolGuid = EFI_LOADED_IMAGE_PROTOCOL_GUID;
+EFI_GUID gEfiSimpleFileSystemProtocolGuid =
+	EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID;
+EFI_GUID gEfiFileInfoGuid = EFI_FILE_INFO_ID;
+
+/* The maximum number of characters formatted by VPrint() */
+#define PRINT_BUFFER_SIZE		1024
+
+VOID
+InitializeLib(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+}
+
+INTN
+StrCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2)
+{
+	while (*s1 && *s1 == *s2) {
+		++s1;
+		++s2;
+	}
+
+	return *s1 - *s2;
+}
+
+UINTN
+StrLen(IN CONST CHAR16 *s1)
+{
+	UINTN Length = 0;
+
+	while (s1[Length])
+		++Length;
+
+	return Length;
+}
+
+UINTN
+StrnLen(IN CONST CHAR16 *s1, IN UINTN Len)
+{
+	UINTN Length = 0;
+
+	while (Length < Len && s1[Length])
+		++Length;
+
+	return Length;
+}
+
+VOID
+StrCpy(IN CHAR16 *Dest, IN CONST CHAR16 *Src)
+{
+	while ((*Dest++ = *Src++))
+		;
+}
+
+VOID
+StrnCpy(IN CHAR16 *Dest, IN CONST CHAR16 *Src, IN UINTN Len)
+{
+	UINTN Length = StrnLen(Src, Len);
+
+	MemCpy(Dest, Src, Length * sizeof(CHAR16));
+
+	if (Length < Len)
+		Dest[Length] = L'\0';
+}
+
+CHAR16 *
+HostStrDup(CONST CHAR8 *String)
+{
+	UINTN Length = strlen(String);
+	CHAR16 *Result = malloc((Length + 1) * sizeof(CHAR16));
+	if (!Result)
+		return NULL;
+
+	for (UINTN Index = 0; Index <= Length; ++Index)
+		Result[Index] = (UINT8)String[Index];
+
+	return Result;
+}
+
+typedef struct {
+	CHAR16 *Buffer;
+	UINTN Size;
+	UINTN Length;
+} PRINT_STATE;
+
+STATIC VOID
+PutChar(PRINT_STATE *State, CHAR16 Char)
+{
+	/* Count the characters beyond the buffer as snprintf() */
+	if (State->Length + 1 < State->Size)
+		State->Buffer[State->Length] = Char;
+
+	++State->Length;
+}
+
+STATIC VOID
+PutField(PRINT_STATE *State, CONST CHAR16 *String, CONST CHAR8 *String8,
+	 UINTN Width, BOOLEAN LeftAligned, CHAR16 Pad)
+{
+	UINTN Length = String ? StrLen(String) : strlen(String8);
+
+	if (LeftAligned == FALSE) {
+		/* Keep the sign ahead of the zero padding */
+		if (Pad == L'0' && Length < Width && String &&
+		    *String == L'-') {
+			PutChar(State, *String++);
+			--Length;
+			--Width;
+		}
+
+		for (; Width > Length; --Width)
+			PutChar(State, Pad);
+	}
+
+	for (UINTN Index = 0; Index < Length; ++Index)
+		PutChar(State, String ? String[Index] : (UINT8)String8[Index]);
+
+	for (; LeftAligned == TRUE && Width > Length; --Width)
+		PutChar(State, L' ');
+}
+
+STATIC VOID
+FormatNumber(CHAR16 *Buffer, UINT64 Value, UINTN Base, BOOLEAN Negative,
+	     BOOLEAN UpperCase)
+{
+	CONST CHAR8 *Digits = UpperCase == TRUE ? "0123456789ABCDEF" :
+						  "0123456789abcdef";
+	CHAR16 Reversed[24];
+	UINTN Length = 0;
+
+	do {
+		Reversed[Length++] = Digits[Value % Base];
+		Value /= Base;
+	} while (Value);
+
+	if (Negative == TRUE)
+		*Buffer++ = L'-';
+
+	while (Length)
+		*Buffer++ = Reversed[--Length];
+
+	*Buffer = L'\0';
+}
+
+/*
+ * The subset of gnu-efi format: %s for CHAR16 string, %a for CHAR8
+ * string, %c, %d, %u, %x, %X, %p, %r for EFI_STATUS and %g for EFI_GUID,
+ * with the flags '-' and '0', the width and 'l' for 64-bit integer.
+ */
+STATIC UINTN
+Format(CHAR16 *Buffer, UINTN BufferSize, CONST CHAR16 *Fmt, VA_LIST Args)
+{
+	PRINT_STATE State = { Buffer, BufferSize, 0 };
+
+	for (; *Fmt; ++Fmt) {
+		if (*Fmt != L'%') {
+			PutChar(&State, *Fmt);
+			continue;
+		}
+
+		BOOLEAN LeftAligned = FALSE;
+		BOOLEAN Long = FALSE;
+		CHAR16 Pad = L' ';
+		UINTN Width = 0;
+
+		for (++Fmt; *Fmt == L'-' || *Fmt == L'0'; ++Fmt) {
+			if (*Fmt == L'-')
+				LeftAligned = TRUE;
+			else
+				Pad = L'0';
+		}
+
+		if (*Fmt == L'*') {
+			Width = VA_ARG(Args, UINTN);
+			++Fmt;
+		} else {
+			for (; *Fmt >= L'0' && *Fmt <= L'9'; ++Fmt)
+				Width = Width * 10 + *Fmt - L'0';
+		}
+
+		for (; *Fmt == L'l'; ++Fmt)
+			Long = TRUE;
+
+		CHAR16 Number[40];
+		UINT64 Value;
+
+		switch (*Fmt) {
+		case L's': {
+			CHAR16 *String = VA_ARG(Args, CHAR16 *);
+
+			PutField(&State, String ? String : L"(null)", NULL,
+				 Width, LeftAligned, L' ');
+			break;
+		}
+		case L'a': {
+			CHAR8 *String = VA_ARG(Args, CHAR8 *);
+
+			PutField(&State, NULL, String ? String : "(null)",
+				 Width, LeftAligned, L' ');
+			break;
+		}
+		case L'c':
+			Number[0] = (CHAR16)VA_ARG(Args, UINTN);
+			Number[1] = L'\0';
+			PutField(&State, Number, NULL, Width, LeftAligned,
+				 L' ');
+			break;
+		case L'd': {
+			INT64 Signed = Long == TRUE ? VA_ARG(Args, INT64) :
+						      VA_ARG(Args, INT32);
+
+			FormatNumber(Number, Signed < 0 ? -(UINT64)Signed :
+							  (UINT64)Signed,
+				     10, Signed < 0, FALSE);
+			PutField(&State, Number, NULL, Width, LeftAligned,
+				 Pad);
+			break;
+		}
+		case L'u':
+		case L'x':
+		case L'X':
+			Value = Long == TRUE ? VA_ARG(Args, UINT64) :
+					       VA_ARG(Args, UINT32);
+			FormatNumber(Number, Value, *Fmt == L'u' ? 10 : 16,
+				     FALSE, *Fmt == L'X');
+			PutField(&State, Number, NULL, Width, LeftAligned,
+				 Pad);
+			break;
+		case L'p':
+			FormatNumber(Number, (UINTN)VA_ARG(Args, VOID *), 16,
+				     FALSE, FALSE);
+			PutField(&State, Number, NULL, Width, LeftAligned,
+				 Pad);
+			break;
+		case L'r':
+			Value = VA_ARG(Args, UINTN);
+			if (!Value)
+				PutField(&State, L"Success", NULL, Width,
+					 LeftAligned, L' ');
+			else {
+				FormatNumber(Number, Value, 16, FALSE, FALSE);
+				PutField(&State, Number, NULL, Width,
+					 LeftAligned, L' ');
+			}
+			break;
+		case L'g': {
+			EFI_GUID *Guid = VA_ARG(Args, EFI_GUID *);
+			CHAR8 String[40];
+
+			snprintf(String, sizeof(String),
+				 "%08x-%04x-%04x-%02x%02x-"
+				 "%02x%02x%02x%02x%02x%02x",
+				 Guid->Data1, Guid->Data2, Guid->Data3,
+				 Guid->Data4[0], Guid->Data4[1],
+				 Guid->Data4[2], Guid->Data4[3],
+				 Guid->Data4[4], Guid->Data4[5],
+				 Guid->Data4[6], Guid->Data4[7]);
+			PutField(&State, NULL, String, Width, LeftAligned,
+				 L' ');
+			break;
+		}
+		case L'%':
+			PutChar(&State, L'%');
+			break;
+		case L'\0':
+			--Fmt;
+			break;
+		default:
+			PutChar(&State, L'%');
+			PutChar(&State, *Fmt);
+			break;
+		}
+	}
+
+	if (State.Size)
+		Buffer[MIN(State.Length, State.Size - 1)] = L'\0';
+
+	return MIN(State.Length, State.Size ? State.Size - 1 : 0);
+}
+
+UINTN
+VSPrint(OUT CHAR16 *Str, IN UINTN StrSize, IN CONST CHAR16 *fmt,
+	VA_LIST args)
+{
+	/* StrSize is in bytes, and 0 means unlimited as gnu-efi */
+	UINTN Size = StrSize ? StrSize / sizeof(CHAR16) : PRINT_BUFFER_SIZE;
+
+	return Format(Str, Size, fmt, args);
+}
+
+/* The console output goes to stderr to keep stdout for the results */
+UINTN
+VPrint(IN CONST CHAR16 *fmt, VA_LIST args)
+{
+	CHAR16 Buffer[PRINT_BUFFER_SIZE];
+	UINTN Length = Format(Buffer, ARRAY_SIZE(Buffer), fmt, args);
+
+	for (UINTN Index = 0; Index < Length; ++Index)
+		fputc(Buffer[Index] < 0x80 ? Buffer[Index] : '?', stderr);
+
+	return Length;
+}
+
+EFI_DEVICE_PATH *
+FileDevicePath(IN EFI_HANDLE Device OPTIONAL, IN CHAR16 *FileName)
+{
+	UINTN NameSize = (StrLen(FileName) + 1) * sizeof(CHAR16);
+	UINTN NodeSize = SIZE_OF_FILEPATH_DEVICE_PATH + NameSize;
+	UINT8 *DevicePath = malloc(NodeSize + sizeof(EFI_DEVICE_PATH));
+	if (!DevicePath)
+		return NULL;
+
+	FILEPATH_DEVICE_PATH *FilePath = (FILEPATH_DEVICE_PATH *)DevicePath;
+
+	FilePath->Header.Type = MEDIA_DEVICE_PATH;
+	FilePath->Header.SubType = MEDIA_FILEPATH_DP;
+	FilePath->Header.Length[0] = (UINT8)NodeSize;
+	FilePath->Header.Length[1] = (UINT8)(NodeSize >> 8);
+	MemCpy(FilePath->PathName, FileName, NameSize);
+
+	EFI_DEVICE_PATH *End = (EFI_DEVICE_PATH *)(DevicePath + NodeSize);
+
+	End->Type = END_DEVICE_PATH_TYPE;
+	End->SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE;
+	End->Length[0] = sizeof(EFI_DEVICE_PATH);
+	End->Length[1] = 0;
+
+	return (EFI_DEVICE_PATH *)DevicePath;
+}
+
+/*
+ * Only the file path nodes are rendered as the boot manager never passes
+ * the hardware nodes in the file path of the loaded image.
+ */
+CHAR16 *
+DevicePathToStr(EFI_DEVICE_PATH *DevPath)
+{
+	UINTN Length = 0;
+	CHAR16 *String = malloc(sizeof(CHAR16));
+	if (!String)
+		return NULL;
+
+	for (EFI_DEVICE_PATH *Node = DevPath;
+	     Node->Type != END_DEVICE_PATH_TYPE;
+	     Node = (EFI_DEVICE_PATH *)((UINT8 *)Node + (Node->Length[0] |
+							 Node->Length[1] << 8))) {
+		if (Node->Type != MEDIA_DEVICE_PATH ||
+		    Node->SubType != MEDIA_FILEPATH_DP)
+			continue;
+
+		CHAR16 *PathName = ((FILEPATH_DEVICE_PATH *)Node)->PathName;
+		UINTN PathLength = StrLen(PathName);
+		CHAR16 *NewString = realloc(String, (Length + PathLength + 2) *
+						    sizeof(CHAR16));
+		if (!NewString) {
+			free(String);
+			return NULL;
+		}
+
+		String = NewString;
+
+		if (Length && String[Length - 1] != L'\\' &&
+		    *PathName != L'\\')
+			String[Length++] = L'\\';
+
+		MemCpy(String + Length, PathName, PathLength * sizeof(CHAR16));
+		Length += PathLength;
+	}
+
+	String[Length] = L'\0';
+
+	return String;
+}
+
+EFI_FILE_INFO *
+LibFileInfo(IN EFI_FILE_HANDLE FHand)
+{
+	UINTN Size = 0;
+	EFI_STATUS Status;
+
+	Status = FHand->GetInfo(FHand, &gEfiFileInfoGuid, &Size, NULL);
+	if (Status != EFI_BUFFER_TOO_SMALL)
+		return NULL;
+
+	EFI_FILE_INFO *FileInfo = malloc(Size);
+	if (!FileInfo)
+		return NULL;
+
+	Status = FHand->GetInfo(FHand, &gEfiFileInfoGuid, &Size, FileInfo);
+	if (EFI_ERROR(Status)) {
+		free(FileInfo);
+		return NULL;
+	}
+
+	return FileInfo;
+}
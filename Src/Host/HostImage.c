@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The PE images on the simulated firmware. The stand-in of EFI Security2
+ * Architectural Protocol authenticates an image if its SHA-256 is trusted,
+ * as an EFI_CERT_SHA256 entry in db does for the Authenticode hash, and
+ * the synthetic Unified Kernel Image (UKI) carries the sections only.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "HostEfi.h"
+
+#define MAX_TRUSTED_IMAGES		8
+#define UKI_FILE_ALIGNMENT		0x200
+
+extern EFI_GUID gEfiSecurity2ArchProtocolGuid;
+
+STATIC UINT8 TrustedImages[MAX_TRUSTED_IMAGES][SHA256_DIGEST_SIZE];
+STATIC UINTN NumberOfTrustedImages;
+
+STATIC BOOLEAN
+ImageDigest(CONST VOID *Data, UINTN DataSize,
+	    UINT8 Digest[SHA256_DIGEST_SIZE])
+{
+	return EVP_Digest(Data, DataSize, Digest, NULL, EVP_sha256(),
+			  NULL) == 1;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostFileAuthentication(IN CONST EFI_SECURITY2_ARCH_PROTOCOL *This,
+		       IN CONST EFI_DEVICE_PATH_PROTOCOL *DevicePath,
+		       IN VOID *FileBuffer, IN UINTN FileSize,
+		       IN BOOLEAN BootPolicy)
+{
+	UINT8 Digest[SHA256_DIGEST_SIZE];
+
+	if (!FileBuffer || ImageDigest(FileBuffer, FileSize, Digest) == FALSE)
+		return EFI_ACCESS_DENIED;
+
+	for (UINTN Index = 0; Index < NumberOfTrustedImages; ++Index) {
+		if (!memcmp(TrustedImages[Index], Digest, sizeof(Digest)))
+			return EFI_SUCCESS;
+	}
+
+	return EFI_SECURITY_VIOLATION;
+}
+
+STATIC EFI_SECURITY2_ARCH_PROTOCOL HostSecurity2 = {
+	HostFileAuthentication
+};
+
+EFI_STATUS
+HostSecurity2Install(VOID)
+{
+	EFI_HANDLE Handle = NULL;
+
+	return HostProtocolInstall(&Handle, &gEfiSecurity2ArchProtocolGuid,
+				   &HostSecurity2);
+}
+
+/* Drop any hook as if the firmware re-installed the protocol */
+VOID
+HostSecurity2Restore(VOID)
+{
+	HostSecurity2.FileAuthentication = HostFileAuthentication;
+}
+
+/* Trust the image as if it were signed with a key in db */
+EFI_STATUS
+HostImageTrust(CONST VOID *Data, UINTN DataSize)
+{
+	if (NumberOfTrustedImages == MAX_TRUSTED_IMAGES)
+		return EFI_OUT_OF_RESOURCES;
+
+	if (ImageDigest(Data, DataSize,
+			TrustedImages[NumberOfTrustedImages]) == FALSE)
+		return EFI_DEVICE_ERROR;
+
+	++NumberOfTrustedImages;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Create a PE32+ image with the UKI sections .linux and .cmdline, which
+ * is only good for locating the sections.
+ */
+EFI_STATUS
+HostUkiCreate(CONST VOID *Linux, UINTN LinuxSize, CONST CHAR8 *Cmdline,
+	      VOID **Data, UINTN *DataSize)
+{
+	STATIC CONST CHAR8 *SectionNames[] = { ".linux", ".cmdline" };
+	CONST VOID *Sections[] = { Linux, Cmdline };
+	UINTN SectionSizes[] = { LinuxSize, strlen(Cmdline) };
+	UINTN HeaderSize = sizeof(EFI_IMAGE_DOS_HEADER) +
+			   sizeof(EFI_IMAGE_NT_HEADERS64) +
+			   ARRAY_SIZE(Sections) *
+			   sizeof(EFI_IMAGE_SECTION_HEADER);
+	UINTN Offset = ALIGN_VALUE(HeaderSize, UKI_FILE_ALIGNMENT);
+	UINTN Size = Offset;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Sections); ++Index)
+		Size += ALIGN_VALUE(SectionSizes[Index], UKI_FILE_ALIGNMENT);
+
+	UINT8 *Image = calloc(1, Size);
+	if (!Image)
+		return EFI_OUT_OF_RESOURCES;
+
+	EFI_IMAGE_DOS_HEADER *DosHeader = (EFI_IMAGE_DOS_HEADER *)Image;
+
+	DosHeader->e_magic = EFI_IMAGE_DOS_SIGNATURE;
+	DosHeader->e_lfanew = sizeof(*DosHeader);
+
+	EFI_IMAGE_NT_HEADERS64 *NtHeader;
+
+	NtHeader = (EFI_IMAGE_NT_HEADERS64 *)(DosHeader + 1);
+	NtHeader->Signature = EFI_IMAGE_NT_SIGNATURE;
+	NtHeader->FileHeader.Machine = IMAGE_FILE_MACHINE_X64;
+	NtHeader->FileHeader.NumberOfSections = ARRAY_SIZE(Sections);
+	NtHeader->FileHeader.SizeOfOptionalHeader =
+		sizeof(NtHeader->OptionalHeader);
+	NtHeader->OptionalHeader.Magic = EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+	NtHeader->OptionalHeader.FileAlignment = UKI_FILE_ALIGNMENT;
+	NtHeader->OptionalHeader.SizeOfHeaders = Offset;
+
+	EFI_IMAGE_SECTION_HEADER *SectionHeader;
+
+	SectionHeader = (EFI_IMAGE_SECTION_HEADER *)(NtHeader + 1);
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Sections); ++Index,
+	     ++SectionHeader) {
+		memcpy(SectionHeader->Name, SectionNames[Index],
+		       strlen(SectionNames[Index]));
+		SectionHeader->Misc.VirtualSize = SectionSizes[Index];
+		SectionHeader->VirtualAddress = Offset;
+		SectionHeader->SizeOfRawData =
+			ALIGN_VALUE(SectionSizes[Index], UKI_FILE_ALIGNMENT);
+		SectionHeader->PointerToRawData = Offset;
+
+		memcpy(Image + Offset, Sections[Index], SectionSizes[Index]);
+		Offset += SectionHeader->SizeOfRawData;
+	}
+
+	*Data = Image;
+	*DataSize = Size;
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The latency injected into the simulated firmware services so that the
+ * slow BIOS storage, variable and crypto services can be reproduced on
+ * Linux, e.g, "read=50,read_kib=8,pkcs7=2000" delays each file read by
+ * 50us plus 8us per KiB, and each PKCS#7 verification by 2ms.
+ */
+
+#include <Efi.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "HostEfi.h"
+
+typedef struct {
+	CONST CHAR8 *Name;
+	UINT64 Microseconds;
+	UINT64 Calls;
+	UINT64 Injected;
+} HOST_LATENCY_POINT;
+
+STATIC HOST_LATENCY_POINT LatencyPoints[HostLatencyMax] = {
+	[HostLatencyFileOpen] = { "open" },
+	[HostLatencyFileRead] = { "read" },
+	[HostLatencyFileReadKiB] = { "read_kib" },
+	[HostLatencyFileWrite] = { "write" },
+	[HostLatencyFileInfo] = { "info" },
+	[HostLatencyVariableGet] = { "get_variable" },
+	[HostLatencyVariableSet] = { "set_variable" },
+	[HostLatencyPkcs7Verify] = { "pkcs7" },
+};
+
+STATIC UINT64
+Now(VOID)
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+
+	return (UINT64)Time.tv_sec * 1000000000 + Time.tv_nsec;
+}
+
+BOOLEAN
+HostLatencyParse(CONST CHAR8 *Specification)
+{
+	CHAR8 *Buffer = strdup(Specification);
+	if (!Buffer)
+		return FALSE;
+
+	BOOLEAN Result = TRUE;
+	CHAR8 *Save;
+
+	for (CHAR8 *Item = strtok_r(Buffer, ",", &Save); Item;
+	     Item = strtok_r(NULL, ",", &Save)) {
+		CHAR8 *Value = strchr(Item, '=');
+		UINTN Index;
+
+		if (Value)
+			*Value++ = '\0';
+
+		for (Index = 0; Index < HostLatencyMax; ++Index) {
+			if (!strcmp(LatencyPoints[Index].Name, Item))
+				break;
+		}
+
+		CHAR8 *End;
+
+		if (Index == HostLatencyMax || !Value || !*Value) {
+			Result = FALSE;
+			break;
+		}
+
+		LatencyPoints[Index].Microseconds = strtoull(Value, &End, 0);
+		if (*End) {
+			Result = FALSE;
+			break;
+		}
+	}
+
+	free(Buffer);
+
+	return Result;
+}
+
+/*
+ * Busy wait rather than sleep, as BIOS does in the polled drivers, so that
+ * the delay is not rounded up by the scheduler.
+ */
+VOID
+HostLatencyInject(HOST_LATENCY Point, UINTN Units)
+{
+	HOST_LATENCY_POINT *LatencyPoint = LatencyPoints + Point;
+
+	++LatencyPoint->Calls;
+
+	UINT64 Delay = LatencyPoint->Microseconds * Units;
+	if (!Delay)
+		return;
+
+	LatencyPoint->Injected += Delay;
+
+	UINT64 Deadline = Now() + Delay * 1000;
+
+	while (Now() < Deadline)
+		;
+}
+
+VOID
+HostLatencyReport(VOID)
+{
+	fprintf(stderr, "point,latency_us,calls,injected_us\n");
+
+	for (UINTN Index = 0; Index < HostLatencyMax; ++Index) {
+		HOST_LATENCY_POINT *LatencyPoint = LatencyPoints + Index;
+
+		fprintf(stderr, "%s,%llu,%llu,%llu\n", LatencyPoint->Name,
+			(unsigned long long)LatencyPoint->Microseconds,
+			(unsigned long long)LatencyPoint->Calls,
+			(unsigned long long)LatencyPoint->Injected);
+	}
+}
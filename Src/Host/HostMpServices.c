@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The stand-in of EFI MP Services Protocol running each AP procedure on a
+ * host thread. The wait event of the non-blocking mode is never signalled
+ * because the simulated boot services are not thread-safe.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "HostEfi.h"
+
+#define MAX_HOST_APS		64
+
+typedef struct {
+	UINTN ProcessorNumber;
+	EFI_AP_PROCEDURE Procedure;
+	VOID *Argument;
+	pthread_t Thread;
+} HOST_AP;
+
+STATIC HOST_AP Aps[MAX_HOST_APS];
+STATIC UINTN NumberOfAps;
+STATIC UINTN NumberOfRunningAps;
+STATIC __thread UINTN CurrentProcessorNumber;
+
+STATIC VOID *
+ApThread(VOID *Argument)
+{
+	HOST_AP *Ap = Argument;
+
+	CurrentProcessorNumber = Ap->ProcessorNumber;
+	Ap->Procedure(Ap->Argument);
+	__atomic_sub_fetch(&NumberOfRunningAps, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetNumberOfProcessors(IN EFI_MP_SERVICES_PROTOCOL *This,
+			  OUT UINTN *NumberOfProcessors,
+			  OUT UINTN *NumberOfEnabledProcessors)
+{
+	if (!NumberOfProcessors || !NumberOfEnabledProcessors)
+		return EFI_INVALID_PARAMETER;
+
+	if (CurrentProcessorNumber)
+		return EFI_DEVICE_ERROR;
+
+	*NumberOfProcessors = NumberOfAps + 1;
+	*NumberOfEnabledProcessors = NumberOfAps + 1;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetProcessorInfo(IN EFI_MP_SERVICES_PROTOCOL *This,
+		     IN UINTN ProcessorNumber,
+		     OUT EFI_PROCESSOR_INFORMATION *ProcessorInfoBuffer)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostStartupAllAPs(IN EFI_MP_SERVICES_PROTOCOL *This,
+		  IN EFI_AP_PROCEDURE Procedure, IN BOOLEAN SingleThread,
+		  IN EFI_EVENT WaitEvent OPTIONAL,
+		  IN UINTN TimeoutInMicroSeconds,
+		  IN VOID *ProcedureArgument OPTIONAL,
+		  OUT UINTN **FailedCpuList OPTIONAL)
+{
+	if (!Procedure)
+		return EFI_INVALID_PARAMETER;
+
+	if (CurrentProcessorNumber)
+		return EFI_DEVICE_ERROR;
+
+	if (!NumberOfAps)
+		return EFI_NOT_STARTED;
+
+	/* Only the simultaneous execution is simulated */
+	if (SingleThread == TRUE || TimeoutInMicroSeconds)
+		return EFI_UNSUPPORTED;
+
+	if (__atomic_load_n(&NumberOfRunningAps, __ATOMIC_ACQUIRE))
+		return EFI_NOT_READY;
+
+	if (FailedCpuList)
+		*FailedCpuList = NULL;
+
+	for (UINTN Index = 0; Index < NumberOfAps; ++Index) {
+		HOST_AP *Ap = Aps + Index;
+
+		Ap->Procedure = Procedure;
+		Ap->Argument = ProcedureArgument;
+
+		__atomic_add_fetch(&NumberOfRunningAps, 1, __ATOMIC_RELEASE);
+		if (pthread_create(&Ap->Thread, NULL, ApThread, Ap)) {
+			__atomic_sub_fetch(&NumberOfRunningAps, 1,
+					   __ATOMIC_RELEASE);
+			return EFI_DEVICE_ERROR;
+		}
+
+		if (WaitEvent)
+			pthread_detach(Ap->Thread);
+	}
+
+	if (WaitEvent)
+		return EFI_SUCCESS;
+
+	for (UINTN Index = 0; Index < NumberOfAps; ++Index)
+		pthread_join(Aps[Index].Thread, NULL);
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostStartupThisAP(IN EFI_MP_SERVICES_PROTOCOL *This,
+		  IN EFI_AP_PROCEDURE Procedure, IN UINTN ProcessorNumber,
+		  IN EFI_EVENT WaitEvent OPTIONAL,
+		  IN UINTN TimeoutInMicroseconds,
+		  IN VOID *ProcedureArgument OPTIONAL,
+		  OUT BOOLEAN *Finished OPTIONAL)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostSwitchBSP(IN EFI_MP_SERVICES_PROTOCOL *This, IN UINTN ProcessorNumber,
+	      IN BOOLEAN EnableOldBSP)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostEnableDisableAP(IN EFI_MP_SERVICES_PROTOCOL *This,
+		    IN UINTN ProcessorNumber, IN BOOLEAN EnableAP,
+		    IN UINT32 *HealthFlag OPTIONAL)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostWhoAmI(IN EFI_MP_SERVICES_PROTOCOL *This, OUT UINTN *ProcessorNumber)
+{
+	if (!ProcessorNumber)
+		return EFI_INVALID_PARAMETER;
+
+	*ProcessorNumber = CurrentProcessorNumber;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_MP_SERVICES_PROTOCOL HostMpServices = {
+	HostGetNumberOfProcessors,
+	HostGetProcessorInfo,
+	HostStartupAllAPs,
+	HostStartupThisAP,
+	HostSwitchBSP,
+	HostEnableDisableAP,
+	HostWhoAmI
+};
+
+EFI_STATUS
+HostMpServicesInstall(UINTN NumberOfApplicationProcessors)
+{
+	if (NumberOfApplicationProcessors > MAX_HOST_APS)
+		return EFI_INVALID_PARAMETER;
+
+	NumberOfAps = NumberOfApplicationProcessors;
+	for (UINTN Index = 0; Index < NumberOfAps; ++Index)
+		Aps[Index].ProcessorNumber = Index + 1;
+
+	EFI_HANDLE Handle = NULL;
+
+	return HostProtocolInstall(&Handle, &gEfiMpServiceProtocolGuid,
+				   &HostMpServices);
+}
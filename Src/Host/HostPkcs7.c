@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The stand-in of EFI PKCS7 Verify Protocol backed by OpenSSL, and the
+ * signing counterpart to create the SELoader signature (.p7b) on the fly
+ * as libsign does.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+#include <stdlib.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/pkcs7.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "HostEfi.h"
+
+STATIC EFI_GUID CertX509Guid = EFI_CERT_X509_GUID;
+
+/*
+ * Walk the X.509 certificates in the signature database. As EDK2 does,
+ * each entry points to a single EFI_SIGNATURE_LIST.
+ */
+STATIC BOOLEAN
+DatabaseWalk(EFI_SIGNATURE_LIST **Database,
+	     BOOLEAN (*Callback)(X509 *Certificate, VOID *Context),
+	     VOID *Context)
+{
+	for (; Database && *Database; ++Database) {
+		EFI_SIGNATURE_LIST *List = *Database;
+
+		if (MemCmp(&List->SignatureType, &CertX509Guid,
+			   sizeof(EFI_GUID)) ||
+		    List->SignatureSize <= sizeof(EFI_GUID))
+			continue;
+
+		UINT8 *Entry = (UINT8 *)(List + 1) + List->SignatureHeaderSize;
+		UINT8 *End = (UINT8 *)List + List->SignatureListSize;
+
+		for (; Entry + List->SignatureSize <= End;
+		     Entry += List->SignatureSize) {
+			EFI_SIGNATURE_DATA *Data = (EFI_SIGNATURE_DATA *)Entry;
+			CONST UINT8 *Der = Data->SignatureData;
+			X509 *Certificate;
+
+			Certificate = d2i_X509(NULL, &Der,
+					       List->SignatureSize -
+					       sizeof(EFI_GUID));
+			if (!Certificate)
+				continue;
+
+			BOOLEAN Stop = Callback(Certificate, Context);
+
+			X509_free(Certificate);
+
+			if (Stop == TRUE)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+STATIC BOOLEAN
+StoreAdd(X509 *Certificate, VOID *Context)
+{
+	X509_STORE_add_cert((X509_STORE *)Context, Certificate);
+
+	return FALSE;
+}
+
+STATIC BOOLEAN
+SignerRevoked(X509 *Certificate, VOID *Context)
+{
+	STACK_OF(X509) *Signers = Context;
+
+	for (int Index = 0; Index < sk_X509_num(Signers); ++Index) {
+		if (!X509_cmp(sk_X509_value(Signers, Index), Certificate))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostPkcs7VerifyBuffer(IN EFI_PKCS7_VERIFY_PROTOCOL *This,
+		      IN VOID *SignedData, IN UINTN SignedDataSize,
+		      IN VOID *InData OPTIONAL, IN UINTN InDataSize,
+		      IN EFI_SIGNATURE_LIST **AllowedDb,
+		      IN EFI_SIGNATURE_LIST **RevokedDb OPTIONAL,
+		      IN EFI_SIGNATURE_LIST **TimeStampDb OPTIONAL,
+		      OUT VOID *Content OPTIONAL,
+		      IN OUT UINTN *ContentSize)
+{
+	if (!This || !SignedData || !SignedDataSize || !AllowedDb)
+		return EFI_INVALID_PARAMETER;
+
+	if (Content && !ContentSize)
+		return EFI_INVALID_PARAMETER;
+
+	HostLatencyInject(HostLatencyPkcs7Verify, 1);
+
+	CONST UINT8 *Der = SignedData;
+	PKCS7 *Pkcs7 = d2i_PKCS7(NULL, &Der, (long)SignedDataSize);
+	if (!Pkcs7 || !PKCS7_type_is_signed(Pkcs7)) {
+		PKCS7_free(Pkcs7);
+		return EFI_UNSUPPORTED;
+	}
+
+	EFI_STATUS Status = EFI_OUT_OF_RESOURCES;
+	X509_STORE *Store = X509_STORE_new();
+	BIO *Input = NULL;
+	BIO *Output = BIO_new(BIO_s_mem());
+
+	if (!Store || !Output)
+		goto out;
+
+	if (InData) {
+		Input = BIO_new_mem_buf(InData, (int)InDataSize);
+		if (!Input)
+			goto out;
+	}
+
+	/*
+	 * The certificate in db is trusted as is, regardless of the time
+	 * and the purpose, as the firmware does.
+	 */
+	X509_STORE_set_flags(Store, X509_V_FLAG_PARTIAL_CHAIN |
+				    X509_V_FLAG_NO_CHECK_TIME);
+	X509_STORE_set_purpose(Store, X509_PURPOSE_ANY);
+	DatabaseWalk(AllowedDb, StoreAdd, Store);
+
+	Status = EFI_SECURITY_VIOLATION;
+
+	if (PKCS7_verify(Pkcs7, NULL, Store, Input, Output,
+			 PKCS7_BINARY) != 1) {
+		ERR_clear_error();
+		goto out;
+	}
+
+	STACK_OF(X509) *Signers = PKCS7_get0_signers(Pkcs7, NULL, 0);
+	BOOLEAN Revoked = DatabaseWalk(RevokedDb, SignerRevoked, Signers);
+
+	sk_X509_free(Signers);
+
+	if (Revoked == TRUE)
+		goto out;
+
+	Status = EFI_SUCCESS;
+
+	/* The detached signature has no content to return */
+	if (InData || !ContentSize)
+		goto out;
+
+	CHAR8 *ExtractedContent;
+	UINTN ExtractedContentSize = BIO_get_mem_data(Output,
+						      &ExtractedContent);
+
+	if (!Content || *ContentSize < ExtractedContentSize)
+		Status = EFI_BUFFER_TOO_SMALL;
+	else
+		MemCpy(Content, ExtractedContent, ExtractedContentSize);
+
+	*ContentSize = ExtractedContentSize;
+
+out:
+	BIO_free(Output);
+	BIO_free(Input);
+	X509_STORE_free(Store);
+	PKCS7_free(Pkcs7);
+
+	return Status;
+}
+
+/* As EDK2 does, only the buffer verification is supported */
+STATIC EFI_STATUS EFIAPI
+HostPkcs7VerifySignature(IN EFI_PKCS7_VERIFY_PROTOCOL *This,
+			 IN VOID *Signature, IN UINTN SignatureSize,
+			 IN VOID *InHash, IN UINTN InHashSize,
+			 IN EFI_SIGNATURE_LIST **AllowedDb,
+			 IN EFI_SIGNATURE_LIST **RevokedDb OPTIONAL,
+			 IN EFI_SIGNATURE_LIST **TimeStampDb OPTIONAL)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_PKCS7_VERIFY_PROTOCOL HostPkcs7Verify = {
+	HostPkcs7VerifyBuffer,
+	HostPkcs7VerifySignature
+};
+
+EFI_STATUS
+HostPkcs7Install(VOID)
+{
+	EFI_HANDLE Handle = NULL;
+
+	return HostProtocolInstall(&Handle, &gEfiPkcs7VerifyProtocolGuid,
+				   &HostPkcs7Verify);
+}
+
+EFI_STATUS
+HostCertificateLoad(CONST CHAR8 *Path, UINT8 **Certificate,
+		    UINTN *CertificateSize)
+{
+	FILE *File = fopen(Path, "r");
+	if (!File)
+		return EFI_NOT_FOUND;
+
+	X509 *X509Certificate = PEM_read_X509(File, NULL, NULL, NULL);
+
+	fclose(File);
+
+	if (!X509Certificate)
+		return EFI_UNSUPPORTED;
+
+	UINT8 *Der = NULL;
+	int Size = i2d_X509(X509Certificate, &Der);
+
+	X509_free(X509Certificate);
+
+	if (Size <= 0)
+		return EFI_UNSUPPORTED;
+
+	/* Hand over the buffer to be released with free() */
+	*Certificate = malloc(Size);
+	if (*Certificate)
+		MemCpy(*Certificate, Der, Size);
+
+	OPENSSL_free(Der);
+
+	if (!*Certificate)
+		return EFI_OUT_OF_RESOURCES;
+
+	*CertificateSize = Size;
+
+	return EFI_SUCCESS;
+}
+
+/*
+ * Build the SELoader signature carrying the SHA-256 digest of the data
+ * and wrap it in the PKCS#7 attached signature.
+ */
+EFI_STATUS
+HostSignatureCreate(CONST CHAR8 *KeyPath, CONST CHAR8 *CertificatePath,
+		    CONST VOID *Data, UINTN DataSize, VOID **Signature,
+		    UINTN *SignatureSize)
+{
+	struct {
+		SEL_SIGNATURE_HEADER Header;
+		SEL_SIGNATURE_TAG Tags[2];
+		UINT32 HashAlgorithm;
+		UINT8 Digest[SHA256_DIGEST_LENGTH];
+	} __attribute__((packed)) SelSignature;
+
+	MemSet(&SelSignature, 0, sizeof(SelSignature));
+	MemCpy(&SelSignature.Header.Magic, SelSigantureMagic,
+	       sizeof(SelSignature.Header.Magic));
+	SelSignature.Header.Revision = SelSignatureRevision;
+	SelSignature.Header.HeaderSize = sizeof(SelSignature.Header);
+	SelSignature.Header.TagDirectorySize = sizeof(SelSignature.Tags);
+	SelSignature.Header.NumberOfTag = ARRAY_SIZE(SelSignature.Tags);
+	SelSignature.Header.PayloadSize = sizeof(SelSignature.HashAlgorithm) +
+					  sizeof(SelSignature.Digest);
+	SelSignature.Tags[0].Tag = SelSignatureTagHashAlgorithm;
+	SelSignature.Tags[0].DataOffset = 0;
+	SelSignature.Tags[0].DataSize = sizeof(SelSignature.HashAlgorithm);
+	SelSignature.Tags[1].Tag = SelSignatureTagContent;
+	SelSignature.Tags[1].DataOffset = sizeof(SelSignature.HashAlgorithm);
+	SelSignature.Tags[1].DataSize = sizeof(SelSignature.Digest);
+	SelSignature.HashAlgorithm = SelHashAlgorithmSha256;
+	SHA256(Data, DataSize, SelSignature.Digest);
+
+	EFI_STATUS Status = EFI_UNSUPPORTED;
+	FILE *File = fopen(KeyPath, "r");
+	EVP_PKEY *Key = NULL;
+	X509 *Certificate = NULL;
+	BIO *Content = NULL;
+	PKCS7 *Pkcs7 = NULL;
+
+	if (!File)
+		return EFI_NOT_FOUND;
+
+	Key = PEM_read_PrivateKey(File, NULL, NULL, NULL);
+	fclose(File);
+
+	File = fopen(CertificatePath, "r");
+	if (!File) {
+		Status = EFI_NOT_FOUND;
+		goto out;
+	}
+
+	Certificate = PEM_read_X509(File, NULL, NULL, NULL);
+	fclose(File);
+
+	if (!Key || !Certificate)
+		goto out;
+
+	Content = BIO_new_mem_buf(&SelSignature, sizeof(SelSignature));
+	if (!Content) {
+		Status = EFI_OUT_OF_RESOURCES;
+		goto out;
+	}
+
+	Pkcs7 = PKCS7_sign(Certificate, Key, NULL, Content, PKCS7_BINARY);
+	if (!Pkcs7)
+		goto out;
+
+	UINT8 *Der = NULL;
+	int Size = i2d_PKCS7(Pkcs7, &Der);
+
+	if (Size <= 0)
+		goto out;
+
+	*Signature = malloc(Size);
+	if (*Signature) {
+		MemCpy(*Signature, Der, Size);
+		*SignatureSize = Size;
+		Status = EFI_SUCCESS;
+	} else
+		Status = EFI_OUT_OF_RESOURCES;
+
+	OPENSSL_free(Der);
+
+out:
+	if (EFI_ERROR(Status))
+		ERR_print_errors_fp(stderr);
+
+	PKCS7_free(Pkcs7);
+	BIO_free(Content);
+	X509_free(Certificate);
+	EVP_PKEY_free(Key);
+
+	return Status;
+}
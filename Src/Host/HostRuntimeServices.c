@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The simulated EFI Runtime Services with the variable store in memory.
+ * The store is seeded as a platform in User mode with UEFI Secure Boot
+ * enabled, optionally booted via shim in MOK Secure Boot mode.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <MokVerify.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostEfi.h"
+
+#define MAX_VARIABLES			64
+
+typedef struct {
+	CHAR16 *Name;
+	EFI_GUID Guid;
+	UINT32 Attributes;
+	VOID *Data;
+	UINTN DataSize;
+	BOOLEAN ReadOnly;
+} HOST_VARIABLE;
+
+STATIC HOST_VARIABLE Variables[MAX_VARIABLES];
+
+STATIC EFI_GUID CertX509Guid = EFI_CERT_X509_GUID;
+
+STATIC HOST_VARIABLE *
+VariableGet(CONST CHAR16 *Name, CONST EFI_GUID *Guid)
+{
+	for (UINTN Index = 0; Index < MAX_VARIABLES; ++Index) {
+		HOST_VARIABLE *Variable = Variables + Index;
+
+		if (Variable->Name && !StrCmp(Variable->Name, Name) &&
+		    !MemCmp(&Variable->Guid, Guid, sizeof(*Guid)))
+			return Variable;
+	}
+
+	return NULL;
+}
+
+STATIC EFI_STATUS
+VariableSet(CONST CHAR16 *Name, CONST EFI_GUID *Guid, UINT32 Attributes,
+	    CONST VOID *Data, UINTN DataSize, BOOLEAN Append)
+{
+	HOST_VARIABLE *Variable = VariableGet(Name, Guid);
+	if (Variable && Variable->ReadOnly == TRUE)
+		return EFI_WRITE_PROTECTED;
+
+	if (!DataSize) {
+		if (!Variable)
+			return Append == TRUE ? EFI_SUCCESS : EFI_NOT_FOUND;
+
+		free(Variable->Name);
+		free(Variable->Data);
+		Variable->Name = NULL;
+
+		return EFI_SUCCESS;
+	}
+
+	if (!Variable) {
+		for (Variable = Variables; Variable < Variables + MAX_VARIABLES;
+		     ++Variable) {
+			if (!Variable->Name)
+				break;
+		}
+
+		if (Variable == Variables + MAX_VARIABLES)
+			return EFI_OUT_OF_RESOURCES;
+
+		Variable->Name = malloc((StrLen(Name) + 1) * sizeof(CHAR16));
+		if (!Variable->Name)
+			return EFI_OUT_OF_RESOURCES;
+
+		StrCpy(Variable->Name, Name);
+		Variable->Guid = *Guid;
+		Variable->Data = NULL;
+		Variable->DataSize = 0;
+		Variable->ReadOnly = FALSE;
+	} else if (Variable->Attributes != Attributes)
+		return EFI_INVALID_PARAMETER;
+
+	if (Append == FALSE)
+		Variable->DataSize = 0;
+
+	UINT8 *Buffer = realloc(Variable->Data, Variable->DataSize + DataSize);
+	if (!Buffer)
+		return EFI_OUT_OF_RESOURCES;
+
+	MemCpy(Buffer + Variable->DataSize, Data, DataSize);
+	Variable->Data = Buffer;
+	Variable->DataSize += DataSize;
+	Variable->Attributes = Attributes;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid,
+		OUT UINT32 *Attributes OPTIONAL, IN OUT UINTN *DataSize,
+		OUT VOID *Data OPTIONAL)
+{
+	if (!VariableName || !VendorGuid || !DataSize)
+		return EFI_INVALID_PARAMETER;
+
+	HostLatencyInject(HostLatencyVariableGet, 1);
+
+	HOST_VARIABLE *Variable = VariableGet(VariableName, VendorGuid);
+	if (!Variable)
+		return EFI_NOT_FOUND;
+
+	if (*DataSize < Variable->DataSize) {
+		*DataSize = Variable->DataSize;
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	if (!Data)
+		return EFI_INVALID_PARAMETER;
+
+	MemCpy(Data, Variable->Data, Variable->DataSize);
+	*DataSize = Variable->DataSize;
+
+	if (Attributes)
+		*Attributes = Variable->Attributes;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostSetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid,
+		IN UINT32 Attributes, IN UINTN DataSize, IN VOID *Data)
+{
+	if (!VariableName || !*VariableName || !VendorGuid)
+		return EFI_INVALID_PARAMETER;
+
+	if (DataSize && !Data)
+		return EFI_INVALID_PARAMETER;
+
+	HostLatencyInject(HostLatencyVariableSet, 1);
+
+	if (DataSize && !(Attributes & EFI_VARIABLE_BOOTSERVICE_ACCESS))
+		return EFI_INVALID_PARAMETER;
+
+	BOOLEAN Append = (Attributes & EFI_VARIABLE_APPEND_WRITE) ? TRUE :
+								      FALSE;
+
+	return VariableSet(VariableName, VendorGuid,
+			   Attributes & ~EFI_VARIABLE_APPEND_WRITE, Data,
+			   DataSize, Append);
+}
+
+STATIC EFI_STATUS
+VariableSeed(CONST CHAR16 *Name, CONST EFI_GUID *Guid, UINT32 Attributes,
+	     CONST VOID *Data, UINTN DataSize)
+{
+	HOST_VARIABLE *Variable = VariableGet(Name, Guid);
+	EFI_STATUS Status;
+
+	/* The seeded variable is extended with the next signature list */
+	if (Variable)
+		Variable->ReadOnly = FALSE;
+
+	Status = VariableSet(Name, Guid, Attributes, Data, DataSize, TRUE);
+	if (!EFI_ERROR(Status))
+		VariableGet(Name, Guid)->ReadOnly = TRUE;
+
+	return Status;
+}
+
+/*
+ * Append the certificate as an EFI_SIGNATURE_LIST of its own, as
+ * efi-updatevar does for each certificate.
+ */
+STATIC EFI_STATUS
+CertificateSeed(CONST CHAR8 *KeyDirectory, CONST CHAR8 *File,
+		CONST CHAR16 *Name, CONST EFI_GUID *Guid, UINT32 Attributes)
+{
+	CHAR8 Path[PATH_MAX];
+	UINT8 *Certificate;
+	UINTN CertificateSize;
+	EFI_STATUS Status;
+
+	snprintf(Path, sizeof(Path), "%s/%s", KeyDirectory, File);
+
+	Status = HostCertificateLoad(Path, &Certificate, &CertificateSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	UINTN ListSize = sizeof(EFI_SIGNATURE_LIST) + sizeof(EFI_GUID) +
+			 CertificateSize;
+	EFI_SIGNATURE_LIST *List = calloc(1, ListSize);
+	if (!List) {
+		free(Certificate);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	List->SignatureType = CertX509Guid;
+	List->SignatureListSize = (UINT32)ListSize;
+	List->SignatureSize = (UINT32)(sizeof(EFI_GUID) + CertificateSize);
+
+	EFI_SIGNATURE_DATA *Data = (EFI_SIGNATURE_DATA *)(List + 1);
+
+	MemCpy(Data->SignatureData, Certificate, CertificateSize);
+	free(Certificate);
+
+	Status = VariableSeed(Name, Guid, Attributes, List, ListSize);
+	free(List);
+
+	if (EFI_ERROR(Status))
+		fprintf(stderr, "Failed to seed the certificate %s "
+			"(err: 0x%llx)\n", Path, (unsigned long long)Status);
+
+	return Status;
+}
+
+EFI_STATUS
+HostVariableSeed(CONST CHAR8 *KeyDirectory, BOOLEAN MokSecureBoot)
+{
+	STATIC CONST UINT32 GlobalAttributes = EFI_VARIABLE_BOOTSERVICE_ACCESS |
+					       EFI_VARIABLE_RUNTIME_ACCESS;
+	STATIC CONST UINT32 SecureAttributes = EFI_VARIABLE_NON_VOLATILE |
+					       EFI_VARIABLE_BOOTSERVICE_ACCESS |
+					       EFI_VARIABLE_RUNTIME_ACCESS |
+					       EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS;
+	STATIC CONST struct {
+		CONST CHAR8 *File;
+		CONST CHAR16 *Name;
+		EFI_GUID *Guid;
+	} Certificates[] = {
+		{ "efi_sb_keys/PK.pem", L"PK", &gEfiGlobalVariableGuid },
+		{ "efi_sb_keys/KEK.pem", L"KEK", &gEfiGlobalVariableGuid },
+		{ "efi_sb_keys/ms-KEK.pem", L"KEK", &gEfiGlobalVariableGuid },
+		{ "efi_sb_keys/DB.pem", L"db", &gEfiImageSecurityDatabaseGuid },
+		{ "efi_sb_keys/ms-DB.pem", L"db",
+		  &gEfiImageSecurityDatabaseGuid },
+	};
+	UINT8 Enabled = 1, Disabled = 0;
+	EFI_STATUS Status;
+
+	Status = VariableSeed(L"SecureBoot", &gEfiGlobalVariableGuid,
+			      GlobalAttributes, &Enabled, sizeof(Enabled));
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = VariableSeed(L"SetupMode", &gEfiGlobalVariableGuid,
+			      GlobalAttributes, &Disabled, sizeof(Disabled));
+	if (EFI_ERROR(Status))
+		return Status;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Certificates); ++Index) {
+		Status = CertificateSeed(KeyDirectory,
+					 Certificates[Index].File,
+					 Certificates[Index].Name,
+					 Certificates[Index].Guid,
+					 SecureAttributes);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	if (MokSecureBoot == FALSE)
+		return EFI_SUCCESS;
+
+	/* Mirrored by shim from the MOK variables in NV storage */
+	Status = VariableSeed(L"MokSBState", &gEfiMokVerifyProtocolGuid,
+			      EFI_VARIABLE_BOOTSERVICE_ACCESS, &Disabled,
+			      sizeof(Disabled));
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = CertificateSeed(KeyDirectory, "mok_sb_keys/vendor_cert.pem",
+				 L"MokList", &gEfiMokVerifyProtocolGuid,
+				 EFI_VARIABLE_BOOTSERVICE_ACCESS);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	return CertificateSeed(KeyDirectory, "mok_sb_keys/shim_cert.pem",
+			       L"MokList", &gEfiMokVerifyProtocolGuid,
+			       EFI_VARIABLE_BOOTSERVICE_ACCESS);
+}
+
+STATIC VOID EFIAPI
+HostResetSystem(IN EFI_RESET_TYPE ResetType, IN EFI_STATUS ResetStatus,
+		IN UINTN DataSize, IN VOID *ResetData OPTIONAL)
+{
+	fprintf(stderr, "System reset requested (type: %d, status: 0x%llx)\n",
+		(int)ResetType, (unsigned long long)ResetStatus);
+
+	exit(EFI_ERROR(ResetStatus) ? 1 : 0);
+}
+
+STATIC EFI_RUNTIME_SERVICES HostRuntimeServices = {
+	.Hdr = {
+		.Signature = EFI_RUNTIME_SERVICES_SIGNATURE,
+		.Revision = EFI_RUNTIME_SERVICES_REVISION,
+		.HeaderSize = sizeof(EFI_RUNTIME_SERVICES),
+	},
+	.GetVariable = HostGetVariable,
+	.SetVariable = HostSetVariable,
+	.ResetSystem = HostResetSystem,
+};
+
+EFI_STATUS
+HostRuntimeServicesInitialize(EFI_SYSTEM_TABLE *SystemTable)
+{
+	SystemTable->RuntimeServices = &HostRuntimeServices;
+
+	return EFI_SUCCESS;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The SELoader library pieces which are not built for SelBench. Just
+ * enough to run the memory primitives, the SELoader signature parser and
+ * the hash service on the simulated firmware.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+
+#include "Internal.h"
+#include "HostEfi.h"
+
+EFI_BOOT_SERVICES *gBS;
+CHAR16 *gRootPath = L"\\";
+
+VOID
+HostEfiInitialize(VOID)
+{
+	STATIC EFI_SYSTEM_TABLE SystemTable;
+
+	HostBootServicesInitialize(&SystemTable);
+	gBS = SystemTable.BootServices;
+}
+
+/*
+ * Only the errors are printed, without formatting the arguments, so that
+ * the benchmark output is not interleaved with the expected messages.
+ */
+UINTN
+EfiConsolePrint(EfiConsolePrintLevel Level, CHAR16 *Format, ...)
+{
+	if (Level < CPL_ERROR)
+		return 0;
+
+	UINTN Length;
+
+	for (Length = 0; Format[Length]; ++Length)
+		fputc(Format[Length] < 0x80 ? Format[Length] : '?', stderr);
+
+	return Length;
+}
+
+UINTN
+EfiConsoleTrace(EfiConsolePrintLevel Level, CHAR16 *Format, ...)
+{
+	return 0;
+}
+
+VOID
+EfiLibraryHexDump(CONST CHAR16 *Prompt, UINT8 *Data, UINTN DataSize)
+{
+}
+
+EFI_STATUS
+EfiImageExecuteDriver(CONST CHAR16 *Path)
+{
+	return EFI_NOT_FOUND;
+}
+
+/*
+ * The benchmark feeds the SELoader signature without the PKCS#7 wrapper.
+ * Return a copy of it as the signed content, as EFI PKCS7 Verify Protocol
+ * does, to keep the allocation cost in the measurement.
+ */
+EFI_STATUS
+Pkcs7VerifyAttachedSignature(VOID **SignedContent, UINTN *SignedContentSize,
+			     VOID *Signature, UINTN SignatureSize)
+{
+	EFI_STATUS Status;
+
+	Status = EfiMemoryAllocate(SignatureSize, SignedContent);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	MemCpy(*SignedContent, Signature, SignatureSize);
+	*SignedContentSize = SignatureSize;
+
+	return EFI_SUCCESS;
+}
+
+EFI_STATUS
+Pkcs7VerifyDetachedSignature(VOID *Hash, UINTN HashSize,
+			     VOID *Signature, UINTN SignatureSize)
+{
+	return EFI_UNSUPPORTED;
+}
+
+UINT64
+ProfileStart(VOID)
+{
+	return 0;
+}
+
+VOID
+ProfileStop(SEL_PROFILE_PHASE Phase, UINT64 Start)
+{
+}
+
+VOID
+StatisticsHashed(UINTN Size)
+{
+}
+
+VOID
+StatisticsCacheHit(VOID)
+{
+}
+
+VOID
+StatisticsHashProviderSet(SEL_PROVIDER Provider)
+{
+}
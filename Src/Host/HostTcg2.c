@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The stand-in of EFI TCG2 Protocol backed by a software TPM which is only
+ * extended by HashLogExtendEvent(), as SubmitCommand() is not implemented.
+ * The PCRs are computed with OpenSSL and checked against the replay of the
+ * event log when reported.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "HostEfi.h"
+
+#define HOST_PCRS		24
+#define HOST_PCR_BANKS		4
+#define HOST_EVENTS		64
+#define HOST_EVENT_DATA_SIZE	128
+
+typedef struct {
+	UINT32 Bank;
+	TPM_ALG_ID Algorithm;
+	CONST CHAR8 *Name;
+	CONST EVP_MD *(*Md)(VOID);
+} HOST_PCR_BANK;
+
+STATIC CONST HOST_PCR_BANK PcrBanks[HOST_PCR_BANKS] = {
+	{ EFI_TCG2_BOOT_HASH_ALG_SHA1, TPM_ALG_SHA1, "sha1", EVP_sha1 },
+	{ EFI_TCG2_BOOT_HASH_ALG_SHA256, TPM_ALG_SHA256, "sha256",
+	  EVP_sha256 },
+	{ EFI_TCG2_BOOT_HASH_ALG_SHA384, TPM_ALG_SHA384, "sha384",
+	  EVP_sha384 },
+	{ EFI_TCG2_BOOT_HASH_ALG_SHA512, TPM_ALG_SHA512, "sha512",
+	  EVP_sha512 },
+};
+
+/* The firmware event log with the digests of all the active banks */
+typedef struct {
+	UINT32 PcrIndex;
+	UINT32 EventType;
+	UINT8 Digests[HOST_PCR_BANKS][SHA512_DIGEST_SIZE];
+	UINT32 EventSize;
+	UINT8 Event[HOST_EVENT_DATA_SIZE];
+} HOST_TCG2_EVENT;
+
+STATIC UINT32 ActivePcrBanks;
+STATIC UINT8 Pcrs[HOST_PCR_BANKS][HOST_PCRS][SHA512_DIGEST_SIZE];
+STATIC HOST_TCG2_EVENT Events[HOST_EVENTS];
+STATIC UINTN NumberOfEvents;
+STATIC BOOLEAN EventLogTruncated;
+
+/* PCR := H(PCR || Digest) */
+STATIC VOID
+Extend(UINT8 *Pcr, CONST HOST_PCR_BANK *Bank, CONST UINT8 *Digest)
+{
+	UINTN Size = EVP_MD_size(Bank->Md());
+	UINT8 Buffer[SHA512_DIGEST_SIZE * 2];
+
+	memcpy(Buffer, Pcr, Size);
+	memcpy(Buffer + Size, Digest, Size);
+	EVP_Digest(Buffer, Size * 2, Pcr, NULL, Bank->Md(), NULL);
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetCapability(IN EFI_TCG2_PROTOCOL *This,
+		  IN OUT EFI_TCG2_BOOT_SERVICE_CAPABILITY *Capability)
+{
+	if (!Capability)
+		return EFI_INVALID_PARAMETER;
+
+	if (Capability->Size < sizeof(*Capability)) {
+		Capability->Size = sizeof(*Capability);
+		return EFI_BUFFER_TOO_SMALL;
+	}
+
+	memset(Capability, 0, sizeof(*Capability));
+	Capability->Size = sizeof(*Capability);
+	Capability->StructureVersion.Major = 1;
+	Capability->StructureVersion.Minor = 1;
+	Capability->ProtocolVersion.Major = 1;
+	Capability->ProtocolVersion.Minor = 1;
+	Capability->HashAlgorithmBitmap = EFI_TCG2_BOOT_HASH_ALG_SHA1 |
+					  EFI_TCG2_BOOT_HASH_ALG_SHA256 |
+					  EFI_TCG2_BOOT_HASH_ALG_SHA384 |
+					  EFI_TCG2_BOOT_HASH_ALG_SHA512;
+	Capability->SupportedEventLogs = EFI_TCG2_EVENT_LOG_FORMAT_TCG_2;
+	Capability->TPMPresentFlag = TRUE;
+	Capability->MaxCommandSize = 4096;
+	Capability->MaxResponseSize = 4096;
+	Capability->NumberOfPCRBanks = HOST_PCR_BANKS;
+	Capability->ActivePcrBanks = ActivePcrBanks;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetEventLog(IN EFI_TCG2_PROTOCOL *This,
+		IN EFI_TCG2_EVENT_LOG_FORMAT EventLogFormat,
+		OUT EFI_PHYSICAL_ADDRESS *EventLogLocation,
+		OUT EFI_PHYSICAL_ADDRESS *EventLogLastEntry,
+		OUT BOOLEAN *EventLogTruncated)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostHashLogExtendEvent(IN EFI_TCG2_PROTOCOL *This, IN UINT64 Flags,
+		       IN EFI_PHYSICAL_ADDRESS DataToHash,
+		       IN UINT64 DataToHashLen, IN EFI_TCG2_EVENT *Event)
+{
+	if (!Event || Event->Header.PCRIndex >= HOST_PCRS ||
+	    Event->Size < OFFSET_OF(EFI_TCG2_EVENT, Event))
+		return EFI_INVALID_PARAMETER;
+
+	/* The PE/COFF image measurement is not implemented */
+	if (Flags & PE_COFF_IMAGE)
+		return EFI_UNSUPPORTED;
+
+	HOST_TCG2_EVENT Logged;
+	UINT32 EventSize = Event->Size - OFFSET_OF(EFI_TCG2_EVENT, Event);
+
+	memset(&Logged, 0, sizeof(Logged));
+	Logged.PcrIndex = Event->Header.PCRIndex;
+	Logged.EventType = Event->Header.EventType;
+	Logged.EventSize = EventSize;
+	memcpy(Logged.Event, Event->Event,
+	       EventSize < sizeof(Logged.Event) ? EventSize :
+						  sizeof(Logged.Event));
+
+	for (UINTN Index = 0; Index < HOST_PCR_BANKS; ++Index) {
+		CONST HOST_PCR_BANK *Bank = PcrBanks + Index;
+
+		if (!(ActivePcrBanks & Bank->Bank))
+			continue;
+
+		EVP_Digest((VOID *)(UINTN)DataToHash, DataToHashLen,
+			   Logged.Digests[Index], NULL, Bank->Md(), NULL);
+		Extend(Pcrs[Index][Logged.PcrIndex], Bank,
+		       Logged.Digests[Index]);
+	}
+
+	if (Flags & EFI_TCG2_EXTEND_ONLY)
+		return EFI_SUCCESS;
+
+	if (NumberOfEvents == HOST_EVENTS)
+		EventLogTruncated = TRUE;
+	else
+		Events[NumberOfEvents++] = Logged;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostSubmitCommand(IN EFI_TCG2_PROTOCOL *This,
+		  IN UINT32 InputParameterBlockSize,
+		  IN UINT8 *InputParameterBlock,
+		  IN UINT32 OutputParameterBlockSize,
+		  IN UINT8 *OutputParameterBlock)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetActivePcrBanks(IN EFI_TCG2_PROTOCOL *This,
+		      OUT UINT32 *ActivePcrBanksBitmap)
+{
+	if (!ActivePcrBanksBitmap)
+		return EFI_INVALID_PARAMETER;
+
+	*ActivePcrBanksBitmap = ActivePcrBanks;
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostSetActivePcrBanks(IN EFI_TCG2_PROTOCOL *This,
+		      IN UINT32 ActivePcrBanksBitmap)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostGetResultOfSetActivePcrBanks(IN EFI_TCG2_PROTOCOL *This,
+				 OUT UINT32 *OperationPresent,
+				 OUT UINT32 *Response)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_TCG2_PROTOCOL HostTcg2Protocol = {
+	HostGetCapability,
+	HostGetEventLog,
+	HostHashLogExtendEvent,
+	HostSubmitCommand,
+	HostGetActivePcrBanks,
+	HostSetActivePcrBanks,
+	HostGetResultOfSetActivePcrBanks
+};
+
+/* Parse the active banks, e.g, sha1,sha256 */
+BOOLEAN
+HostTcg2Parse(CONST CHAR8 *Specification)
+{
+	CHAR8 *Copy = strdup(Specification);
+	BOOLEAN Valid = TRUE;
+
+	if (!Copy)
+		return FALSE;
+
+	ActivePcrBanks = 0;
+
+	for (CHAR8 *Name = strtok(Copy, ","); Name;
+	     Name = strtok(NULL, ",")) {
+		UINTN Index;
+
+		for (Index = 0; Index < HOST_PCR_BANKS; ++Index) {
+			if (!strcmp(Name, PcrBanks[Index].Name))
+				break;
+		}
+
+		if (Index == HOST_PCR_BANKS) {
+			Valid = FALSE;
+			break;
+		}
+
+		ActivePcrBanks |= PcrBanks[Index].Bank;
+	}
+
+	free(Copy);
+
+	return Valid == TRUE && ActivePcrBanks;
+}
+
+EFI_STATUS
+HostTcg2Install(VOID)
+{
+	EFI_HANDLE Handle = NULL;
+
+	return HostProtocolInstall(&Handle, &gEfiTcg2ProtocolGuid,
+				   &HostTcg2Protocol);
+}
+
+/*
+ * Replay the firmware event log as a verifier does, returning FALSE if
+ * any PCR doesn't match.
+ */
+STATIC BOOLEAN
+ReplayEventLog(VOID)
+{
+	STATIC UINT8 Replayed[HOST_PCR_BANKS][HOST_PCRS][SHA512_DIGEST_SIZE];
+
+	memset(Replayed, 0, sizeof(Replayed));
+
+	for (UINTN Index = 0; Index < NumberOfEvents; ++Index) {
+		CONST HOST_TCG2_EVENT *Event = Events + Index;
+
+		for (UINTN Bank = 0; Bank < HOST_PCR_BANKS; ++Bank) {
+			if (ActivePcrBanks & PcrBanks[Bank].Bank)
+				Extend(Replayed[Bank][Event->PcrIndex],
+				       PcrBanks + Bank, Event->Digests[Bank]);
+		}
+
+		printf("# event %lu: pcr %u %.*s\n", (unsigned long)Index,
+		       Event->PcrIndex,
+		       (int)strnlen((CHAR8 *)Event->Event,
+				    Event->EventSize < sizeof(Event->Event) ?
+				    Event->EventSize : sizeof(Event->Event)),
+		       Event->Event);
+	}
+
+	return !memcmp(Replayed, Pcrs, sizeof(Replayed));
+}
+
+/* Print the PCRs extended and whether the event log reproduces them */
+VOID
+HostTcg2Report(VOID)
+{
+	printf("# %lu events logged by firmware%s\n",
+	       (unsigned long)NumberOfEvents,
+	       EventLogTruncated == TRUE ? " (truncated)" : "");
+
+	BOOLEAN Replayed = ReplayEventLog();
+	STATIC CONST UINT8 Zero[SHA512_DIGEST_SIZE];
+
+	for (UINTN Index = 0; Index < HOST_PCR_BANKS; ++Index) {
+		CONST HOST_PCR_BANK *Bank = PcrBanks + Index;
+		UINTN Size = EVP_MD_size(Bank->Md());
+
+		if (!(ActivePcrBanks & Bank->Bank))
+			continue;
+
+		for (UINTN Pcr = 0; Pcr < HOST_PCRS; ++Pcr) {
+			if (!memcmp(Pcrs[Index][Pcr], Zero, Size))
+				continue;
+
+			printf("# pcr %lu %s ", (unsigned long)Pcr,
+			       Bank->Name);
+			for (UINTN Byte = 0; Byte < Size; ++Byte)
+				printf("%02x", Pcrs[Index][Pcr][Byte]);
+			printf("\n");
+		}
+	}
+
+	printf("# event log replay %s\n", Replayed == TRUE ? "matches" :
+							       "MISMATCHES");
+}
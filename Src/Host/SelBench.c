@@ -0,0 +1,719 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * The host microbenchmark of the memory primitives, the SELoader signature
+ * parser and the hash service. The results are written to stdout in CSV.
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <SELoader.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "HostEfi.h"
+
+/* The bytes processed in each run, bounded by the iteration limits */
+#define BENCH_BYTES_PER_RUN		(16 * 1024 * 1024)
+#define BENCH_MIN_ITERATIONS		16
+#define BENCH_MAX_ITERATIONS		(1024 * 1024)
+/* The fastest run is reported */
+#define BENCH_RUNS			3
+
+#define MEMORY_MAX_SIZE			(4 * 1024 * 1024)
+#define MEMORY_MOVE_DISTANCE		64
+#define SIGNATURE_MESSAGE_SIZE		4096
+
+typedef enum {
+	MemoryOpMemCpy,
+	MemoryOpMemcpy,
+	MemoryOpMemMove,
+	MemoryOpMemmove,
+	MemoryOpMemSet,
+	MemoryOpMemset,
+	MemoryOpMemCmp,
+	MemoryOpMemcmp,
+	MemoryOpMemCmpConstantTime,
+	MemoryOpMax
+} MEMORY_OP;
+
+STATIC CONST CHAR8 *MemoryOpNames[MemoryOpMax] = {
+	[MemoryOpMemCpy] = "MemCpy",
+	[MemoryOpMemcpy] = "memcpy",
+	[MemoryOpMemMove] = "MemMove",
+	[MemoryOpMemmove] = "memmove",
+	[MemoryOpMemSet] = "MemSet",
+	[MemoryOpMemset] = "memset",
+	[MemoryOpMemCmp] = "MemCmp",
+	[MemoryOpMemcmp] = "memcmp",
+	[MemoryOpMemCmpConstantTime] = "MemCmpConstantTime",
+};
+
+STATIC CONST UINTN MemorySizes[] = {
+	8, 16, 32, 64, 128, 256, 512, 1024, 4096, 16 * 1024, 64 * 1024,
+	256 * 1024, 1024 * 1024, MEMORY_MAX_SIZE
+};
+
+/* The byte offset of the destination from a page boundary */
+STATIC CONST UINTN MemoryAlignments[] = {
+	0, 1, 7, 32
+};
+
+STATIC CONST UINTN SignatureTags[] = {
+	2, 16, 256, 4096, 65536
+};
+
+STATIC CONST UINTN HashSizes[] = {
+	64, 1024, 16 * 1024, 1024 * 1024, 16 * 1024 * 1024
+};
+
+STATIC struct {
+	CONST CHAR8 *Name;
+	EFI_GUID *Guid;
+} HashAlgorithms[] = {
+	{ "SHA-256", &gEfiHashAlgorithmSha256Guid },
+	{ "SHA-384", &gEfiHashAlgorithmSha384Guid },
+	{ "SHA-512", &gEfiHashAlgorithmSha512Guid },
+};
+
+/* Keep the comparison results alive */
+STATIC volatile INTN Sink;
+
+/*
+ * libc declares memcmp() pure. Prevent the compiler from hoisting it out
+ * of the loop.
+ */
+#define Barrier()	asm volatile("" : : : "memory")
+
+STATIC UINT64
+Now(VOID)
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+
+	return (UINT64)Time.tv_sec * 1000000000 + Time.tv_nsec;
+}
+
+STATIC UINTN
+Iterations(UINTN Size)
+{
+	UINTN Count = BENCH_BYTES_PER_RUN / (Size ? Size : 1);
+
+	return MIN(MAX(Count, BENCH_MIN_ITERATIONS), BENCH_MAX_ITERATIONS);
+}
+
+STATIC VOID
+Report(CONST CHAR8 *Group, CONST CHAR8 *Name, UINTN Size, UINTN Alignment,
+       UINTN Bytes, UINTN Iterations, UINT64 Nanoseconds)
+{
+	if (!Nanoseconds)
+		Nanoseconds = 1;
+
+	printf("%s,%s,%lu,%lu,%lu,%.2f,%.2f\n", Group, Name,
+	       (unsigned long)Size, (unsigned long)Alignment,
+	       (unsigned long)Iterations, (double)Nanoseconds / Iterations,
+	       (double)Bytes * Iterations * 1000 / Nanoseconds);
+}
+
+STATIC VOID
+RunMemoryOp(MEMORY_OP Op, UINT8 *Destination, UINT8 *Source, UINTN Size,
+	    UINTN Iterations)
+{
+	INTN Result = 0;
+
+	switch (Op) {
+	case MemoryOpMemCpy:
+		while (Iterations--)
+			MemCpy(Destination, Source, Size);
+		break;
+	case MemoryOpMemcpy:
+		while (Iterations--)
+			memcpy(Destination, Source, Size);
+		break;
+	case MemoryOpMemMove:
+		while (Iterations--)
+			MemMove(Destination, Source, Size);
+		break;
+	case MemoryOpMemmove:
+		while (Iterations--)
+			memmove(Destination, Source, Size);
+		break;
+	case MemoryOpMemSet:
+		while (Iterations--)
+			MemSet(Destination, 0x5a, Size);
+		break;
+	case MemoryOpMemset:
+		while (Iterations--)
+			memset(Destination, 0x5a, Size);
+		break;
+	case MemoryOpMemCmp:
+		while (Iterations--) {
+			Result |= MemCmp(Destination, Source, Size);
+			Barrier();
+		}
+		break;
+	case MemoryOpMemcmp:
+		while (Iterations--) {
+			Result |= memcmp(Destination, Source, Size);
+			Barrier();
+		}
+		break;
+	case MemoryOpMemCmpConstantTime:
+		while (Iterations--) {
+			Result |= MemCmpConstantTime(Destination, Source,
+						     Size);
+			Barrier();
+		}
+		break;
+	default:
+		break;
+	}
+
+	Sink = Result;
+}
+
+/*
+ * A wrong result invalidates the numbers, e.g, a fast path skipping the
+ * tail. Run the primitive once more on the prepared buffers and check.
+ */
+STATIC BOOLEAN
+CheckMemoryOp(MEMORY_OP Op, UINT8 *Destination, UINT8 *Source, UINTN Size)
+{
+	UINT8 *Expected = malloc(Size);
+	BOOLEAN Passed = FALSE;
+
+	if (!Expected)
+		return FALSE;
+
+	for (UINTN Index = 0; Index < Size; ++Index)
+		Source[Index] = (UINT8)(Index * 131 + 7);
+
+	switch (Op) {
+	case MemoryOpMemCpy:
+	case MemoryOpMemcpy:
+	case MemoryOpMemMove:
+	case MemoryOpMemmove:
+		memcpy(Expected, Source, Size);
+		RunMemoryOp(Op, Destination, Source, Size, 1);
+		Passed = !memcmp(Destination, Expected, Size);
+		break;
+	case MemoryOpMemSet:
+	case MemoryOpMemset:
+		memset(Expected, 0x5a, Size);
+		RunMemoryOp(Op, Destination, Source, Size, 1);
+		Passed = !memcmp(Destination, Expected, Size);
+		break;
+	case MemoryOpMemCmp:
+	case MemoryOpMemcmp:
+	case MemoryOpMemCmpConstantTime:
+		MemCpy(Destination, Source, Size);
+		Destination[Size - 1] ^= 1;
+		RunMemoryOp(Op, Destination, Source, Size, 1);
+		Passed = Sink != 0;
+		Destination[Size - 1] ^= 1;
+		RunMemoryOp(Op, Destination, Source, Size, 1);
+		Passed = Passed == TRUE && !Sink;
+		break;
+	default:
+		break;
+	}
+
+	free(Expected);
+
+	return Passed;
+}
+
+STATIC BOOLEAN
+BenchMemory(VOID)
+{
+	UINTN BufferSize = MEMORY_MAX_SIZE + 2 * EFI_PAGE_SIZE;
+	UINT8 *Destination = aligned_alloc(EFI_PAGE_SIZE, BufferSize);
+	UINT8 *Source = aligned_alloc(EFI_PAGE_SIZE, BufferSize);
+	BOOLEAN Passed = FALSE;
+
+	if (!Destination || !Source)
+		goto out;
+
+	MemSet(Destination, 0, BufferSize);
+	MemSet(Source, 0, BufferSize);
+
+	for (MEMORY_OP Op = 0; Op < MemoryOpMax; ++Op) {
+		for (UINTN SizeIndex = 0; SizeIndex < ARRAY_SIZE(MemorySizes);
+		     ++SizeIndex) {
+			for (UINTN AlignmentIndex = 0;
+			     AlignmentIndex < ARRAY_SIZE(MemoryAlignments);
+			     ++AlignmentIndex) {
+				UINTN Size = MemorySizes[SizeIndex];
+				UINTN Alignment =
+					MemoryAlignments[AlignmentIndex];
+				UINT8 *Target = Destination + Alignment;
+				UINT8 *Origin = Source;
+
+				/* Move backward within an overlapped buffer */
+				if (Op == MemoryOpMemMove ||
+				    Op == MemoryOpMemmove) {
+					Origin = Target;
+					Target += MEMORY_MOVE_DISTANCE;
+				}
+
+				if (CheckMemoryOp(Op, Target, Origin,
+						  Size) == FALSE) {
+					fprintf(stderr, "%s failed with size %lu "
+						"and alignment %lu\n",
+						MemoryOpNames[Op],
+						(unsigned long)Size,
+						(unsigned long)Alignment);
+					goto out;
+				}
+
+				UINTN Count = Iterations(Size);
+				UINT64 Best = ~0ULL;
+
+				for (UINTN Run = 0; Run < BENCH_RUNS; ++Run) {
+					UINT64 Start = Now();
+
+					RunMemoryOp(Op, Target, Origin, Size,
+						    Count);
+					Best = MIN(Best, Now() - Start);
+				}
+
+				Report("memory", MemoryOpNames[Op], Size,
+				       Alignment, Size, Count, Best);
+			}
+		}
+	}
+
+	Passed = TRUE;
+
+out:
+	free(Source);
+	free(Destination);
+
+	return Passed;
+}
+
+/*
+ * Build a SELoader signature with the content tag, optionally the hash
+ * algorithm tag, and the file size tags filling up the tag directory.
+ */
+STATIC UINT8 *
+BuildSignature(UINTN NumberOfTag, UINT8 *Content, UINTN ContentSize,
+	       BOOLEAN Hashed, UINTN *SignatureSize)
+{
+	UINT32 HashAlgorithm = SelHashAlgorithmSha256;
+	UINT64 FileSize = SIGNATURE_MESSAGE_SIZE;
+	UINTN TagDirectorySize = NumberOfTag * sizeof(SEL_SIGNATURE_TAG);
+	UINTN PayloadSize = sizeof(HashAlgorithm) + ContentSize +
+			    sizeof(FileSize);
+	UINTN Size = sizeof(SEL_SIGNATURE_HEADER) + TagDirectorySize +
+		     PayloadSize;
+	UINT8 *Signature = calloc(1, Size);
+
+	if (!Signature)
+		return NULL;
+
+	SEL_SIGNATURE_HEADER *Header = (SEL_SIGNATURE_HEADER *)Signature;
+
+	MemCpy(&Header->Magic, SelSigantureMagic, sizeof(Header->Magic));
+	Header->Revision = SelSignatureRevision;
+	Header->HeaderSize = sizeof(*Header);
+	Header->TagDirectorySize = TagDirectorySize;
+	Header->NumberOfTag = NumberOfTag;
+	Header->PayloadSize = PayloadSize;
+
+	SEL_SIGNATURE_TAG *Tag = (SEL_SIGNATURE_TAG *)(Header + 1);
+	UINT8 *Payload = (UINT8 *)(Tag + NumberOfTag);
+
+	MemCpy(Payload, &HashAlgorithm, sizeof(HashAlgorithm));
+	MemCpy(Payload + sizeof(HashAlgorithm), Content, ContentSize);
+	MemCpy(Payload + sizeof(HashAlgorithm) + ContentSize, &FileSize,
+	       sizeof(FileSize));
+
+	for (UINTN Index = 0; Index < NumberOfTag; ++Index) {
+		Tag[Index].Tag = SelSignatureTagFileSize;
+		Tag[Index].DataOffset = sizeof(HashAlgorithm) + ContentSize;
+		Tag[Index].DataSize = sizeof(FileSize);
+	}
+
+	Tag[0].Tag = SelSignatureTagContent;
+	Tag[0].DataOffset = sizeof(HashAlgorithm);
+	Tag[0].DataSize = ContentSize;
+
+	if (Hashed == TRUE) {
+		Tag[1].Tag = SelSignatureTagHashAlgorithm;
+		Tag[1].DataOffset = 0;
+		Tag[1].DataSize = sizeof(HashAlgorithm);
+	}
+
+	*SignatureSize = Size;
+
+	return Signature;
+}
+
+STATIC BOOLEAN
+BenchSignatureCase(CONST CHAR8 *Name, UINTN NumberOfTag, UINT8 *Content,
+		   UINTN ContentSize, UINT8 *Message)
+{
+	BOOLEAN Hashed = Message ? TRUE : FALSE;
+	UINTN SignatureSize;
+	UINT8 *Signature;
+
+	Signature = BuildSignature(NumberOfTag, Content, ContentSize, Hashed,
+				   &SignatureSize);
+	if (!Signature)
+		return FALSE;
+
+	UINTN Count = Iterations(SignatureSize);
+	UINT64 Best = ~0ULL;
+	BOOLEAN Passed = FALSE;
+
+	for (UINTN Run = 0; Run < BENCH_RUNS; ++Run) {
+		UINT64 Start = Now();
+
+		for (UINTN Iteration = 0; Iteration < Count; ++Iteration) {
+			VOID *Data = Message;
+			UINTN DataSize = Message ? SIGNATURE_MESSAGE_SIZE : 0;
+			EFI_STATUS Status;
+
+			Status = EfiSignatureVerifyAttached(Signature,
+							    SignatureSize,
+							    Message ?
+								&Data : NULL,
+							    &DataSize);
+			if (EFI_ERROR(Status) ||
+			    (!Message && DataSize != ContentSize)) {
+				fprintf(stderr, "%s failed with %lu tags "
+					"(err: 0x%lx)\n", Name,
+					(unsigned long)NumberOfTag,
+					(unsigned long)Status);
+				goto out;
+			}
+		}
+
+		Best = MIN(Best, Now() - Start);
+	}
+
+	Report("signature", Name, NumberOfTag, 0, SignatureSize, Count, Best);
+	Passed = TRUE;
+
+out:
+	free(Signature);
+
+	return Passed;
+}
+
+STATIC BOOLEAN
+BenchSignature(VOID)
+{
+	UINT8 Message[SIGNATURE_MESSAGE_SIZE];
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_STATUS Status;
+
+	for (UINTN Index = 0; Index < sizeof(Message); ++Index)
+		Message[Index] = (UINT8)Index;
+
+	Status = EfiHashData(&gEfiHashAlgorithmSha256Guid, Message,
+			     sizeof(Message), &Hash, &HashSize);
+	if (EFI_ERROR(Status))
+		return FALSE;
+
+	BOOLEAN Passed = TRUE;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(SignatureTags) &&
+			      Passed == TRUE; ++Index) {
+		/* The attached content is returned without hashing */
+		Passed = BenchSignatureCase("parse", SignatureTags[Index],
+					    Message, 64, NULL);
+		if (Passed == FALSE)
+			break;
+
+		Passed = BenchSignatureCase("verify", SignatureTags[Index],
+					    Hash, HashSize, Message);
+	}
+
+	EfiMemoryFree(Hash);
+
+	return Passed;
+}
+
+STATIC BOOLEAN
+BenchHash(VOID)
+{
+	STATIC CONST UINT8 Sha256Abc[] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	UINT8 *Hash;
+	UINTN HashSize;
+	EFI_STATUS Status;
+
+	Status = EfiHashData(&gEfiHashAlgorithmSha256Guid, (UINT8 *)"abc", 3,
+			     &Hash, &HashSize);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "Unable to hash (err: 0x%lx)\n",
+			(unsigned long)Status);
+		return FALSE;
+	}
+
+	BOOLEAN Passed = HashSize == sizeof(Sha256Abc) &&
+			 !memcmp(Hash, Sha256Abc, HashSize);
+
+	EfiMemoryFree(Hash);
+
+	if (Passed == FALSE) {
+		fprintf(stderr, "Wrong SHA-256 digest\n");
+		return FALSE;
+	}
+
+	UINTN MaxSize = HashSizes[ARRAY_SIZE(HashSizes) - 1];
+	UINT8 *Message = malloc(MaxSize);
+
+	if (!Message)
+		return FALSE;
+
+	for (UINTN Index = 0; Index < MaxSize; ++Index)
+		Message[Index] = (UINT8)(Index * 13);
+
+	for (UINTN AlgorithmIndex = 0;
+	     AlgorithmIndex < ARRAY_SIZE(HashAlgorithms) && Passed == TRUE;
+	     ++AlgorithmIndex) {
+		for (UINTN SizeIndex = 0; SizeIndex < ARRAY_SIZE(HashSizes);
+		     ++SizeIndex) {
+			UINTN Size = HashSizes[SizeIndex];
+			UINTN Count = Iterations(Size);
+			UINT64 Best = ~0ULL;
+
+			for (UINTN Run = 0; Run < BENCH_RUNS; ++Run) {
+				UINT64 Start = Now();
+
+				for (UINTN Iteration = 0; Iteration < Count;
+				     ++Iteration) {
+					Status = EfiHashData(HashAlgorithms[AlgorithmIndex].Guid,
+							     Message, Size,
+							     &Hash, &HashSize);
+					if (EFI_ERROR(Status))
+						break;
+
+					EfiMemoryFree(Hash);
+				}
+
+				Best = MIN(Best, Now() - Start);
+			}
+
+			if (EFI_ERROR(Status)) {
+				Passed = FALSE;
+				break;
+			}
+
+			Report("hash", HashAlgorithms[AlgorithmIndex].Name,
+			       Size, 0, Size, Count, Best);
+		}
+	}
+
+	free(Message);
+
+	return Passed;
+}
+
+STATIC EFI_STATUS
+HashSeparate(EFI_GUID **Guids, UINT8 *Message, UINTN Size, UINT8 **Hashes,
+	     UINTN *DigestSizes)
+{
+	for (UINTN Index = 0; Index < ARRAY_SIZE(HashAlgorithms); ++Index) {
+		EFI_STATUS Status;
+
+		Status = EfiHashData(Guids[Index], Message, Size,
+				     &Hashes[Index], &DigestSizes[Index]);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_STATUS
+HashMulti(EFI_GUID **Guids, UINT8 *Message, UINTN Size, UINT8 **Hashes,
+	  UINTN *DigestSizes)
+{
+	return EfiMultiHashData(Guids, ARRAY_SIZE(HashAlgorithms), Message,
+				Size, Hashes, DigestSizes);
+}
+
+/*
+ * All the algorithms over the same message, one pass per algorithm
+ * versus a single pass with the multi-digest context.
+ */
+STATIC BOOLEAN
+BenchMultiHash(VOID)
+{
+	STATIC CONST struct {
+		CONST CHAR8 *Name;
+		EFI_STATUS (*Run)(EFI_GUID **Guids, UINT8 *Message,
+				  UINTN Size, UINT8 **Hashes,
+				  UINTN *DigestSizes);
+	} Modes[] = {
+		{ "separate", HashSeparate },
+		{ "multi", HashMulti },
+	};
+	EFI_GUID *Guids[ARRAY_SIZE(HashAlgorithms)];
+	UINT8 *Expected[ARRAY_SIZE(HashAlgorithms)];
+	UINT8 *Hashes[ARRAY_SIZE(HashAlgorithms)];
+	UINTN DigestSizes[ARRAY_SIZE(HashAlgorithms)];
+	EFI_STATUS Status;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(HashAlgorithms); ++Index)
+		Guids[Index] = HashAlgorithms[Index].Guid;
+
+	UINTN MaxSize = HashSizes[ARRAY_SIZE(HashSizes) - 1];
+	UINT8 *Message = malloc(MaxSize);
+
+	if (!Message)
+		return FALSE;
+
+	for (UINTN Index = 0; Index < MaxSize; ++Index)
+		Message[Index] = (UINT8)(Index * 13);
+
+	/* Cross the stride boundary with an odd size */
+	Status = HashSeparate(Guids, Message, 100003, Expected, DigestSizes);
+	if (!EFI_ERROR(Status))
+		Status = HashMulti(Guids, Message, 100003, Hashes, DigestSizes);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "Unable to hash (err: 0x%lx)\n",
+			(unsigned long)Status);
+		free(Message);
+		return FALSE;
+	}
+
+	BOOLEAN Passed = TRUE;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(HashAlgorithms); ++Index) {
+		if (memcmp(Expected[Index], Hashes[Index],
+			   DigestSizes[Index])) {
+			fprintf(stderr, "Wrong %s digest in the multi-digest "
+				"context\n", HashAlgorithms[Index].Name);
+			Passed = FALSE;
+		}
+
+		EfiMemoryFree(Expected[Index]);
+		EfiMemoryFree(Hashes[Index]);
+	}
+
+	for (UINTN SizeIndex = 0; SizeIndex < ARRAY_SIZE(HashSizes) &&
+				  Passed == TRUE; ++SizeIndex) {
+		UINTN Size = HashSizes[SizeIndex];
+		UINTN Count = Iterations(Size);
+
+		for (UINTN Mode = 0; Mode < ARRAY_SIZE(Modes); ++Mode) {
+			UINT64 Best = ~0ULL;
+
+			for (UINTN Run = 0; Run < BENCH_RUNS; ++Run) {
+				UINT64 Start = Now();
+
+				for (UINTN Iteration = 0; Iteration < Count;
+				     ++Iteration) {
+					Status = Modes[Mode].Run(Guids, Message,
+								 Size, Hashes,
+								 DigestSizes);
+					if (EFI_ERROR(Status))
+						break;
+
+					for (UINTN Index = 0;
+					     Index < ARRAY_SIZE(HashAlgorithms);
+					     ++Index)
+						EfiMemoryFree(Hashes[Index]);
+				}
+
+				Best = MIN(Best, Now() - Start);
+			}
+
+			if (EFI_ERROR(Status)) {
+				Passed = FALSE;
+				break;
+			}
+
+			Report("multihash", Modes[Mode].Name, Size, 0, Size,
+			       Count, Best);
+		}
+	}
+
+	free(Message);
+
+	return Passed;
+}
+
+STATIC struct {
+	CONST CHAR8 *Name;
+	BOOLEAN (*Run)(VOID);
+} Groups[] = {
+	{ "memory", BenchMemory },
+	{ "signature", BenchSignature },
+	{ "hash", BenchHash },
+	{ "multihash", BenchMultiHash },
+};
+
+int
+main(int argc, char **argv)
+{
+	HostEfiInitialize();
+
+	fprintf(stderr, "CPU features: 0x%x\n", CpuFeatures());
+
+	printf("group,name,size,alignment,iterations,ns_per_op,mb_per_s\n");
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Groups); ++Index) {
+		BOOLEAN Selected = argc < 2;
+
+		for (int Arg = 1; Arg < argc; ++Arg) {
+			if (!strcmp(argv[Arg], Groups[Index].Name))
+				Selected = TRUE;
+		}
+
+		if (Selected == FALSE)
+			continue;
+
+		if (Groups[Index].Run() == FALSE)
+			return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
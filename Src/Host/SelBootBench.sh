@@ -0,0 +1,378 @@
+#!/bin/bash
+#
+# Copyright (c) 2017, Wind River Systems, Inc.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# 1) Redistributions of source code must retain the above copyright notice,
+# this list of conditions and the following disclaimer.
+#
+# 2) Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# 3) Neither the name of Wind River Systems nor the names of its contributors
+# may be used to endorse or promote products derived from this software
+# without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# Author:
+#       Jia Zhang <zhang.jia@linux.alibaba.com>
+
+# Boot the synthetic ESP images under QEMU with UEFI Secure Boot enrolled
+# and record the boot markers emitted by SELoader built with
+# BOOT_MARKER_BUILD=1. The results are written to stdout in CSV.
+
+set -e
+
+TOPDIR="${TOPDIR:-$(cd "$(dirname "$0")/../.." && pwd)}"
+
+OPENSSL="${OPENSSL:-openssl}"
+SBSIGN="${SBSIGN:-sbsign}"
+QEMU="${QEMU:-qemu-system-x86_64}"
+
+OVMF="$TOPDIR/Bin/OVMF.fd"
+FLASH="$TOPDIR/Bin/flash"
+SELOADER="$TOPDIR/Src/Efi/SELoader.efi"
+KEY_DIR="$TOPDIR/Key/efi_sb_keys"
+GRUB=
+KERNEL=
+MODE=grub
+MODULES=
+MODULE_KIB=64
+KERNEL_KIB=8192
+INITRD_KIB=16384
+RUNS=3
+TIMEOUT=120
+WORK_DIR=
+
+# MAX_INITRD_SEGMENTS in Src/Efi/Lib/Initrd.c
+MAX_INITRDS=8
+
+# The stand-in of grub and kernel if not specified. It is a valid PE image
+# so that it can be loaded and started.
+STAND_IN="$TOPDIR/Bin/Hash2DxeCrypto.efi"
+
+usage() {
+	cat <<USAGE
+Usage: $0 [options]
+
+Options:
+  -b OVMF        OVMF image (default: Bin/OVMF.fd)
+  -f FLASH       variable store with the keys enrolled (default: Bin/flash)
+  -e SELOADER    SELoader built with BOOT_MARKER_BUILD=1
+                 (default: Src/Efi/SELoader.efi)
+  -g GRUB        grub EFI image (default: a stand-in)
+  -K KERNEL      EFI-stub kernel (default: a stand-in)
+  -m MODE        grub: chainload grub
+                 kernel: start the kernel via SELoader.conf
+                 (default: $MODE)
+  -n MODULES     number of grub modules (default: 16 with -m grub, or
+                 $((MAX_INITRDS - 1)) with -m kernel, the most SELoader serves
+                 along with the initrd)
+  -s KIB         size of each grub module (default: $MODULE_KIB)
+  -k KIB         size of the kernel (default: $KERNEL_KIB)
+  -i KIB         size of the initrd (default: $INITRD_KIB)
+  -r RUNS        number of boots (default: $RUNS)
+  -t SECONDS     timeout of each boot (default: $TIMEOUT)
+  -w DIRECTORY   work directory kept after the run (default: temporary)
+  -h             show this help
+USAGE
+}
+
+while getopts "b:f:e:g:K:m:n:s:k:i:r:t:w:h" Option; do
+	case "$Option" in
+	b) OVMF="$OPTARG" ;;
+	f) FLASH="$OPTARG" ;;
+	e) SELOADER="$OPTARG" ;;
+	g) GRUB="$OPTARG" ;;
+	K) KERNEL="$OPTARG" ;;
+	m) MODE="$OPTARG" ;;
+	n) MODULES="$OPTARG" ;;
+	s) MODULE_KIB="$OPTARG" ;;
+	k) KERNEL_KIB="$OPTARG" ;;
+	i) INITRD_KIB="$OPTARG" ;;
+	r) RUNS="$OPTARG" ;;
+	t) TIMEOUT="$OPTARG" ;;
+	w) WORK_DIR="$OPTARG" ;;
+	h) usage; exit 0 ;;
+	*) usage >&2; exit 1 ;;
+	esac
+done
+
+if [ "$MODE" != grub -a "$MODE" != kernel ]; then
+	echo "Invalid mode $MODE specified" >&2
+	exit 1
+fi
+
+# The path in the start marker of the expected boot target
+if [ "$MODE" = kernel ]; then
+	TARGET='\images\bzImage'
+	MODULES="${MODULES:-$((MAX_INITRDS - 1))}"
+
+	# The modules are served as the initrds along with the initrd
+	if [ "$MODULES" -ge "$MAX_INITRDS" ]; then
+		echo "At most $((MAX_INITRDS - 1)) modules are supported" \
+		     "with -m kernel" >&2
+		exit 1
+	fi
+else
+	TARGET=grubx64.efi
+	MODULES="${MODULES:-16}"
+
+	echo "The modules are never read with -m grub, so the number of" \
+	     "modules only changes the ESP size" >&2
+fi
+
+for File in "$OVMF" "$FLASH" "$SELOADER" "$STAND_IN"; do
+	if [ ! -f "$File" ]; then
+		echo "$File not found" >&2
+		exit 1
+	fi
+done
+
+if ! grep -q -a "SELoader: marker" "$SELOADER"; then
+	echo "$SELOADER is not built with BOOT_MARKER_BUILD=1" >&2
+	exit 1
+fi
+
+if [ -z "$WORK_DIR" ]; then
+	WORK_DIR="$(mktemp -d)"
+	trap 'rm -rf "$WORK_DIR"' EXIT
+else
+	mkdir -p "$WORK_DIR"
+fi
+
+ESP_DIR="$WORK_DIR/esp"
+BOOT_DIR="$ESP_DIR/EFI/BOOT"
+MODULE_DIR="$BOOT_DIR/x86_64-efi"
+
+le32() {
+	printf "$(printf '\\x%02x\\x%02x\\x%02x\\x%02x' \
+		$(($1 & 255)) $(($1 >> 8 & 255)) \
+		$(($1 >> 16 & 255)) $(($1 >> 24 & 255)))"
+}
+
+# The SELoader signature with the SHA-256 digest of the file, as defined
+# by the packed SEL_SIGNATURE_HEADER and SEL_SIGNATURE_TAG in
+# Src/Efi/Include/SELoader.h
+sel_signature() {
+	printf 'SELS\x01'
+	# HeaderSize, TagDirectorySize, NumberOfTag, PayloadSize, Flags
+	le32 25; le32 32; le32 2; le32 36; le32 0
+	# SelSignatureTagHashAlgorithm
+	le32 1; le32 0; le32 0; le32 4
+	# SelSignatureTagContent
+	le32 9; le32 0; le32 4; le32 32
+	# SelHashAlgorithmSha256
+	le32 3
+	"$OPENSSL" dgst -sha256 -binary "$1"
+}
+
+sign_file() {
+	sel_signature "$1" > "$WORK_DIR/signature"
+	"$OPENSSL" smime -sign -binary -nodetach -outform DER \
+	    -in "$WORK_DIR/signature" -signer "$KEY_DIR/DB.pem" \
+	    -inkey "$KEY_DIR/DB.key" -out "$1.p7b"
+}
+
+sign_image() {
+	"$SBSIGN" --key "$KEY_DIR/DB.key" --cert "$KEY_DIR/DB.pem" \
+	    --output "$2" "$1" 2>/dev/null
+}
+
+# Pad the image with zeros to the size in KiB. The trailing data is covered
+# by the PE signature.
+pad_image() {
+	cp "$1" "$2"
+	if [ "$3" -gt $(($(stat -c %s "$1") / 1024)) ]; then
+		truncate -s "$3K" "$2"
+	fi
+}
+
+synthetic_file() {
+	head -c "$(($2 * 1024))" /dev/urandom > "$1"
+	sign_file "$1"
+}
+
+build_esp() {
+	rm -rf "$ESP_DIR"
+	mkdir -p "$MODULE_DIR" "$ESP_DIR/images"
+
+	# Launched without shim, so SELoader is the removable media loader
+	sign_image "$SELOADER" "$BOOT_DIR/bootx64.efi"
+	cp "$BOOT_DIR/bootx64.efi" "$BOOT_DIR/SELoaderx64.efi"
+
+	sign_image "$TOPDIR/Bin/Pkcs7VerifyDxe.efi" \
+	    "$BOOT_DIR/Pkcs7VerifyDxe.efi"
+	sign_image "$TOPDIR/Bin/Hash2DxeCrypto.efi" \
+	    "$BOOT_DIR/Hash2DxeCrypto.efi"
+
+	if [ -n "$GRUB" ]; then
+		sign_image "$GRUB" "$BOOT_DIR/grubx64.efi"
+	else
+		sign_image "$STAND_IN" "$BOOT_DIR/grubx64.efi"
+	fi
+
+	local Initrds="\\images\\initrd"
+
+	for Index in $(seq 1 "$MODULES"); do
+		synthetic_file "$MODULE_DIR/module$Index.mod" "$MODULE_KIB"
+		Initrds="$Initrds \\EFI\\BOOT\\x86_64-efi\\module$Index.mod"
+	done
+
+	if [ -n "$KERNEL" ]; then
+		sign_image "$KERNEL" "$ESP_DIR/images/bzImage"
+	else
+		pad_image "$STAND_IN" "$WORK_DIR/bzImage" "$KERNEL_KIB"
+		sign_image "$WORK_DIR/bzImage" "$ESP_DIR/images/bzImage"
+	fi
+	sign_file "$ESP_DIR/images/bzImage"
+
+	synthetic_file "$ESP_DIR/images/initrd" "$INITRD_KIB"
+
+	cat > "$BOOT_DIR/grub.cfg" <<GRUB_CFG
+set timeout=0
+menuentry "bench" {
+	linux /images/bzImage console=ttyS0
+	initrd /images/initrd
+}
+GRUB_CFG
+	sign_file "$BOOT_DIR/grub.cfg"
+
+	# The modules are served as the additional initrds to be verified
+	if [ "$MODE" = kernel ]; then
+		cat > "$BOOT_DIR/SELoader.conf" <<SELOADER_CONF
+[global]
+default_boot=bench
+
+[bench]
+kernel=\\images\\bzImage
+initrd=$Initrds
+option=console=ttyS0
+SELOADER_CONF
+		sign_file "$BOOT_DIR/SELoader.conf"
+	fi
+
+	echo 'fs0:\EFI\BOOT\bootx64.efi' > "$ESP_DIR/startup.nsh"
+}
+
+build_image() {
+	local Kib=$(du -s -k "$ESP_DIR" | cut -f1)
+
+	# Leave the room for the file system metadata
+	Kib=$((Kib + Kib / 8 + 8192))
+
+	rm -f "$WORK_DIR/esp.img"
+	mkfs.vfat -C -n ESP "$WORK_DIR/esp.img" "$Kib" >/dev/null
+	MTOOLS_SKIP_CHECK=1 mcopy -s -i "$WORK_DIR/esp.img" \
+	    "$ESP_DIR"/* ::/
+
+	echo "$Kib"
+}
+
+now_us() {
+	local Now="${EPOCHREALTIME/[.,]/}"
+
+	echo "$Now"
+}
+
+# Boot once and print a CSV record per marker. The boot stops at the first
+# start marker, i.e, the boot target is about to be started.
+boot() {
+	local Run="$1"
+	local Fifo="$WORK_DIR/debugcon"
+	local Accel=
+
+	[ -w /dev/kvm ] && Accel="-enable-kvm"
+
+	# The variable store is modified during the boot
+	cp "$FLASH" "$WORK_DIR/flash"
+	rm -f "$Fifo"
+	mkfifo "$Fifo"
+
+	local Start=$(now_us)
+
+	"$QEMU" $Accel -m 1024 -display none -net none \
+	    -bios "$OVMF" \
+	    -drive format=raw,if=pflash,file="$WORK_DIR/flash" \
+	    -drive format=raw,if=virtio,file="$WORK_DIR/esp.img" \
+	    -serial file:"$WORK_DIR/serial$Run.log" \
+	    -debugcon file:"$Fifo" -global isa-debugcon.iobase=0x402 &
+	local Pid=$!
+	local Deadline=$((Start + TIMEOUT * 1000000))
+	local Line Partial= Reached= Mismatched=
+
+	# Opened for write as well so it doesn't block if QEMU fails
+	exec 3<>"$Fifo"
+
+	while [ -z "$Reached" ] && [ "$(now_us)" -lt "$Deadline" ] &&
+	      kill -0 "$Pid" 2>/dev/null; do
+		# The partial line is kept on timeout
+		if ! IFS= read -r -t 1 -u 3 Line; then
+			Partial="$Partial$Line"
+			continue
+		fi
+
+		Line="$Partial$Line"
+		Partial=
+
+		case "$Line" in
+		"SELoader: marker "*) ;;
+		*) continue ;;
+		esac
+
+		local Elapsed=$(($(now_us) - Start))
+		local Fields=(${Line#SELoader: marker })
+
+		# SELoader may fall back to another target, e.g, grub
+		if [ "${Fields[0]}" = start ] &&
+		   [ "${Fields[2]}" != "$TARGET" ]; then
+			echo "Run $Run started ${Fields[2]} instead of" \
+			     "$TARGET. See $WORK_DIR/serial$Run.log" >&2
+			Mismatched=1
+			break
+		fi
+
+		echo "$MODE,$MODULES,$EspKib,$Run,${Fields[0]},${Fields[2]},$((Elapsed / 1000)),${Fields[1]}"
+
+		[ "${Fields[0]}" = start ] && Reached=1
+	done
+
+	exec 3<&-
+
+	kill "$Pid" 2>/dev/null || true
+	wait "$Pid" 2>/dev/null || true
+
+	[ -n "$Mismatched" ] && return 1
+
+	if [ -z "$Reached" ]; then
+		echo "Run $Run didn't reach the boot target. See" \
+		     "$WORK_DIR/serial$Run.log" >&2
+		return 1
+	fi
+}
+
+build_esp
+EspKib=$(build_image)
+
+echo "mode,modules,esp_kib,run,marker,path,host_ms,seloader_us"
+
+Failures=0
+for Run in $(seq 1 "$RUNS"); do
+	boot "$Run" || Failures=$((Failures + 1))
+done
+
+[ "$Failures" = 0 ]
@@ -0,0 +1,843 @@
+/*
+ * Copyright (c) 2017, Wind River Systems, Inc.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1) Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2) Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * 3) Neither the name of Wind River Systems nor the names of its contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Author:
+ *       Jia Zhang <zhang.jia@linux.alibaba.com>
+ */
+
+/*
+ * Run the SELoader library on the simulated firmware as a Linux process.
+ * The library is initialized as SELoader.efi launched from the ESP loaded
+ * from a host directory, and the files are verified through MOK2 Verify
+ * Protocol as grub does, e.g,
+ *
+ * SelFirmware -s -l read_kib=8,pkcs7=2000 esp \EFI\BOOT\grub.cfg
+ */
+
+#include <Efi.h>
+#include <EfiLibrary.h>
+#include <BaseLibrary.h>
+#include <MokVerify.h>
+#include <Mok2Verify.h>
+#include <SELoader.h>
+
+/* Included after EDK2 headers which don't tolerate the NULL definition */
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+#include "HostEfi.h"
+
+#define LOADER_PATH		L"\\EFI\\BOOT\\SELoader" EFI_ARCH ".efi"
+#define UKI_PATH		L"\\EFI\\BOOT\\linux.efi"
+#define UKI_TAMPERED_PATH	L"\\EFI\\BOOT\\linux-tampered.efi"
+
+STATIC CONST CHAR8 *KeyDirectory = HOST_KEY_DIR;
+
+STATIC UINT64
+Now(VOID)
+{
+	struct timespec Time;
+
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+
+	return (UINT64)Time.tv_sec * 1000000000 + Time.tv_nsec;
+}
+
+/*
+ * The PE images are not modeled, so the stand-in of MOK Verify Protocol
+ * installed by shim rejects anything.
+ */
+STATIC EFI_STATUS
+HostMokVerify(IN VOID *Buffer, IN UINT32 BufferSize)
+{
+	return EFI_SECURITY_VIOLATION;
+}
+
+STATIC EFI_STATUS
+HostMokHash(IN UINT8 *Data, IN UINTN DataSize,
+	    PE_COFF_LOADER_IMAGE_CONTEXT *Context, UINT8 *Sha256Hash,
+	    UINT8 *Sha1Hash)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS
+HostMokContext(IN VOID *Data, IN UINTN DataSize,
+	       IN PE_COFF_LOADER_IMAGE_CONTEXT *Context)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_MOK_VERIFY_PROTOCOL HostMokVerifyProtocol = {
+	HostMokVerify,
+	HostMokHash,
+	HostMokContext
+};
+
+/* The stand-in of EFI RNG Protocol backed by the host entropy */
+STATIC EFI_STATUS EFIAPI
+HostRngGetInfo(IN EFI_RNG_PROTOCOL *This,
+	       IN OUT UINTN *RNGAlgorithmListSize,
+	       OUT EFI_RNG_ALGORITHM *RNGAlgorithmList)
+{
+	return EFI_UNSUPPORTED;
+}
+
+STATIC EFI_STATUS EFIAPI
+HostRngGetRng(IN EFI_RNG_PROTOCOL *This, IN EFI_RNG_ALGORITHM *RNGAlgorithm,
+	      IN UINTN RNGValueLength, OUT UINT8 *RNGValue)
+{
+	if (RNGAlgorithm)
+		return EFI_UNSUPPORTED;
+
+	while (RNGValueLength) {
+		ssize_t Size = getrandom(RNGValue, RNGValueLength, 0);
+		if (Size < 0)
+			return EFI_DEVICE_ERROR;
+
+		RNGValue += Size;
+		RNGValueLength -= Size;
+	}
+
+	return EFI_SUCCESS;
+}
+
+STATIC EFI_RNG_PROTOCOL HostRngProtocol = {
+	HostRngGetInfo,
+	HostRngGetRng
+};
+
+/* Sign the file on the ESP with DB.key into the .p7b along with it */
+STATIC EFI_STATUS
+SignFile(CONST CHAR16 *Path)
+{
+	CHAR8 KeyPath[PATH_MAX], CertificatePath[PATH_MAX];
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	Status = HostFileSystemFind(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	snprintf(KeyPath, sizeof(KeyPath), "%s/efi_sb_keys/DB.key",
+		 KeyDirectory);
+	snprintf(CertificatePath, sizeof(CertificatePath),
+		 "%s/efi_sb_keys/DB.pem", KeyDirectory);
+
+	VOID *Signature;
+	UINTN SignatureSize;
+
+	Status = HostSignatureCreate(KeyPath, CertificatePath, Data, DataSize,
+				     &Signature, &SignatureSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	CHAR16 *SignaturePath = malloc((StrLen(Path) + 5) * sizeof(CHAR16));
+	if (!SignaturePath) {
+		free(Signature);
+		return EFI_OUT_OF_RESOURCES;
+	}
+
+	StrCpy(SignaturePath, Path);
+	StrCpy(SignaturePath + StrLen(Path), L".p7b");
+
+	Status = HostFileSystemAdd(SignaturePath, Signature, SignatureSize);
+	free(SignaturePath);
+	free(Signature);
+
+	return Status;
+}
+
+STATIC EFI_STATUS
+FirmwareInitialize(EFI_SYSTEM_TABLE *SystemTable, CONST CHAR8 *EspDirectory,
+		   BOOLEAN MokSecureBoot, UINTN NumberOfAps, BOOLEAN Tpm,
+		   EFI_HANDLE *ImageHandle)
+{
+	EFI_STATUS Status;
+
+	Status = HostBootServicesInitialize(SystemTable);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = HostRuntimeServicesInitialize(SystemTable);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = HostVariableSeed(KeyDirectory, MokSecureBoot);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = HostFileSystemLoad(EspDirectory);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "Failed to load ESP from %s (err: 0x%llx)\n",
+			EspDirectory, (unsigned long long)Status);
+		return Status;
+	}
+
+	Status = HostPkcs7Install();
+	if (EFI_ERROR(Status))
+		return Status;
+
+	/* SELoader hooks it at initialization with UEFI Secure Boot */
+	Status = HostSecurity2Install();
+	if (EFI_ERROR(Status))
+		return Status;
+
+	EFI_HANDLE RngHandle = NULL;
+
+	Status = HostProtocolInstall(&RngHandle, &gEfiRngProtocolGuid,
+				     &HostRngProtocol);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	if (MokSecureBoot == TRUE) {
+		EFI_HANDLE Handle = NULL;
+
+		Status = HostProtocolInstall(&Handle,
+					     &gEfiMokVerifyProtocolGuid,
+					     &HostMokVerifyProtocol);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	if (NumberOfAps) {
+		Status = HostMpServicesInstall(NumberOfAps);
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	if (Tpm == TRUE) {
+		Status = HostTcg2Install();
+		if (EFI_ERROR(Status))
+			return Status;
+	}
+
+	return HostImageInstall(LOADER_PATH, HostFileSystemGet(), ImageHandle);
+}
+
+/*
+ * Mimic grub which reads the file itself and then asks SELoader to verify
+ * the buffer.
+ */
+STATIC EFI_STATUS
+VerifyFileBuffer(EFI_MOK2_VERIFY_PROTOCOL *Mok2Verify, CONST CHAR16 *Path)
+{
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	Status = EfiFileRead(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	Status = Mok2Verify->VerifyFileBuffer(Mok2Verify, &Data, &DataSize,
+					      Path);
+	EfiMemoryFree(Data);
+
+	return Status;
+}
+
+/*
+ * Mimic grub which reads the file in pieces of ChunkSize and hashes them
+ * via MOK2 Verify Protocol revision 2 while reading.
+ */
+STATIC EFI_STATUS
+VerifyFileStream(EFI_MOK2_VERIFY_PROTOCOL *Mok2Verify, CONST CHAR16 *Path,
+		 UINTN ChunkSize)
+{
+	VOID *Data;
+	UINTN DataSize;
+	EFI_STATUS Status;
+
+	if (Mok2Verify->Revision < 2)
+		return EFI_UNSUPPORTED;
+
+	Status = EfiFileRead(Path, &Data, &DataSize);
+	if (EFI_ERROR(Status))
+		return Status;
+
+	VOID *Context;
+
+	Status = Mok2Verify->VerifyBegin(Mok2Verify, Path, &Context);
+	if (EFI_ERROR(Status)) {
+		EfiMemoryFree(Data);
+		return Status;
+	}
+
+	for (UINTN Offset = 0; Offset < DataSize; Offset += ChunkSize) {
+		Status = Mok2Verify->VerifyUpdate(Mok2Verify, Context,
+						  (UINT8 *)Data + Offset,
+						  MIN(ChunkSize,
+						      DataSize - Offset));
+		if (EFI_ERROR(Status))
+			break;
+	}
+
+	Status = Mok2Verify->VerifyFinal(Mok2Verify, Context);
+	EfiMemoryFree(Data);
+
+	return Status;
+}
+
+/*
+ * Verify all the files with VerifyBatch() of MOK2 Verify Protocol revision
+ * 3, read first as grub does if Buffer is TRUE. Event is passed to check
+ * the completion is signalled. The status of each file is left in Items.
+ */
+STATIC VOID
+VerifyBatch(EFI_MOK2_VERIFY_PROTOCOL *Mok2Verify, CHAR16 **Paths,
+	    UINTN NumberOfPaths, BOOLEAN Buffer, EFI_MOK2_VERIFY_ITEM *Items)
+{
+	EFI_STATUS Status = EFI_UNSUPPORTED;
+
+	if (Mok2Verify->Revision < 3)
+		goto out;
+
+	for (UINTN Index = 0; Index < NumberOfPaths; ++Index) {
+		Items[Index].Path = Paths[Index];
+		Items[Index].Data = NULL;
+		Items[Index].DataSize = 0;
+
+		if (Buffer == FALSE)
+			continue;
+
+		Status = EfiFileRead(Paths[Index], &Items[Index].Data,
+				     &Items[Index].DataSize);
+		if (EFI_ERROR(Status))
+			Items[Index].Data = NULL;
+	}
+
+	EFI_EVENT Event;
+
+	Status = gBS->CreateEvent(0, 0, NULL, NULL, &Event);
+	if (!EFI_ERROR(Status)) {
+		Mok2Verify->VerifyBatch(Mok2Verify, Items, NumberOfPaths,
+					Event);
+		Status = gBS->CheckEvent(Event);
+		if (EFI_ERROR(Status))
+			fprintf(stderr, "The batch completion not "
+				"signalled\n");
+
+		gBS->CloseEvent(Event);
+	}
+
+	for (UINTN Index = 0; Index < NumberOfPaths; ++Index) {
+		if (Items[Index].Data)
+			EfiMemoryFree(Items[Index].Data);
+	}
+
+out:
+	if (EFI_ERROR(Status)) {
+		for (UINTN Index = 0; Index < NumberOfPaths; ++Index)
+			Items[Index].Status = Status;
+	}
+}
+
+/*
+ * Boot a synthetic UKI trusted by db, a tampered copy of it, and the
+ * trusted one again after the firmware dropped the hook of EFI Security2
+ * Architectural Protocol. The last one must fail closed unless shim is
+ * present for SELoader to hook it again.
+ */
+STATIC UINTN
+TestUki(BOOLEAN MokSecureBoot)
+{
+	STATIC CONST UINT8 Linux[4096];
+	VOID *Uki;
+	UINTN UkiSize;
+	EFI_STATUS Status;
+
+	Status = HostUkiCreate(Linux, sizeof(Linux), "console=ttyS0", &Uki,
+			       &UkiSize);
+	if (EFI_ERROR(Status))
+		return 1;
+
+	Status = HostImageTrust(Uki, UkiSize);
+	if (!EFI_ERROR(Status))
+		Status = HostFileSystemAdd(UKI_PATH, Uki, UkiSize);
+
+	/* The command line is covered by the signature of UKI */
+	((UINT8 *)Uki)[UkiSize - 1] ^= 1;
+	if (!EFI_ERROR(Status))
+		Status = HostFileSystemAdd(UKI_TAMPERED_PATH, Uki, UkiSize);
+	free(Uki);
+	if (EFI_ERROR(Status))
+		return 1;
+
+	STATIC CONST struct {
+		CONST CHAR8 *Name;
+		CONST CHAR16 *Path;
+		BOOLEAN Unhook;
+	} Tests[] = {
+		{ "trusted", UKI_PATH, FALSE },
+		{ "tampered", UKI_TAMPERED_PATH, FALSE },
+		{ "unhooked", UKI_PATH, TRUE },
+	};
+	BOOLEAN Expected[] = { TRUE, FALSE, MokSecureBoot };
+	UINTN Failures = 0;
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Tests); ++Index) {
+		UINTN StartCount = HostImageStartCount();
+
+		if (Tests[Index].Unhook == TRUE)
+			HostSecurity2Restore();
+
+		Status = EfiUkiExecute(Tests[Index].Path, NULL);
+
+		BOOLEAN Booted = !EFI_ERROR(Status) &&
+				 HostImageStartCount() > StartCount;
+
+		printf("# uki %s: 0x%llx %s\n", Tests[Index].Name,
+		       (unsigned long long)Status,
+		       Booted == Expected[Index] ? "ok" : "FAILED");
+
+		if (Booted != Expected[Index])
+			++Failures;
+	}
+
+	return Failures;
+}
+
+STATIC CONST CHAR8 *
+HashAlgorithmName(CONST EFI_GUID *HashAlgorithm)
+{
+	STATIC CONST struct {
+		EFI_GUID *HashAlgorithm;
+		CONST CHAR8 *Name;
+	} Names[] = {
+		{ &gEfiHashAlgorithmSha1Guid, "sha1" },
+		{ &gEfiHashAlgorithmSha256Guid, "sha256" },
+		{ &gEfiHashAlgorithmSha384Guid, "sha384" },
+		{ &gEfiHashAlgorithmSha512Guid, "sha512" },
+	};
+
+	for (UINTN Index = 0; Index < ARRAY_SIZE(Names); ++Index) {
+		if (!memcmp(Names[Index].HashAlgorithm, HashAlgorithm,
+			    sizeof(EFI_GUID)))
+			return Names[Index].Name;
+	}
+
+	return "unknown";
+}
+
+STATIC VOID
+PrintHex(CONST UINT8 *Data, UINTN DataSize)
+{
+	for (UINTN Index = 0; Index < DataSize; ++Index)
+		printf("%02x", Data[Index]);
+}
+
+/* Print the records of the verified table handed to the OS */
+STATIC VOID
+ReportVerifiedTable(EFI_SYSTEM_TABLE *SystemTable)
+{
+	SEL_VERIFIED_TABLE *Table = NULL;
+
+	for (UINTN Index = 0; Index < SystemTable->NumberOfTableEntries;
+	     ++Index) {
+		EFI_CONFIGURATION_TABLE *ConfigurationTable;
+
+		ConfigurationTable = SystemTable->ConfigurationTable + Index;
+		if (!memcmp(&ConfigurationTable->VendorGuid,
+			    &gSelVerifiedTableGuid, sizeof(EFI_GUID)))
+			Table = ConfigurationTable->VendorTable;
+	}
+
+	if (!Table) {
+		printf("# verified table not installed\n");
+		return;
+	}
+
+	printf("# %u files in verified table%s\n", Table->NumberOfRecords,
+	       Table->Flags & SelVerifiedTableFlagsTruncated ?
+	       " (truncated)" : "");
+
+	CONST UINT8 *Pointer = (CONST UINT8 *)Table + Table->HeaderSize;
+
+	for (UINT32 Index = 0; Index < Table->NumberOfRecords; ++Index) {
+		CONST SEL_VERIFIED_FILE_RECORD *Record;
+
+		Record = (CONST SEL_VERIFIED_FILE_RECORD *)Pointer;
+		Pointer += Table->RecordSize;
+
+		printf("# verified ");
+		for (CONST CHAR16 *Char = Record->Path; *Char; ++Char)
+			putchar(*Char < 0x80 ? (int)*Char : '?');
+		printf("%s %llu %s ",
+		       Record->Flags & SelVerifiedFileFlagsPathTruncated ?
+		       "..." : "", (unsigned long long)Record->Size,
+		       HashAlgorithmName(&Record->HashAlgorithm));
+		PrintHex(Record->Hash, Record->HashSize);
+		printf(" signer ");
+		if (Record->Flags & SelVerifiedFileFlagsSignerUnknown)
+			printf("unknown");
+		else
+			PrintHex(Record->SignerHash,
+				 sizeof(Record->SignerHash));
+		printf(" at %lluus in %lluus\n",
+		       (unsigned long long)Record->Timestamp,
+		       (unsigned long long)Record->Microseconds);
+	}
+}
+
+STATIC VOID
+Usage(CONST CHAR8 *Name)
+{
+	fprintf(stderr,
+		"Usage: %s [options] ESP_DIR [PATH...]\n"
+		"\n"
+		"Verify the files on the ESP loaded from ESP_DIR with MOK2 "
+		"Verify Protocol.\n"
+		"PATH is relative to \\EFI\\BOOT unless starting with "
+		"\\.\n"
+		"\n"
+		"Options:\n"
+		"  -a       verify the files at once with VerifyBatch()\n"
+		"  -b       read the files first as grub and verify them with "
+		"VerifyFileBuffer()\n"
+		"  -c KIB   read the files in KIB pieces and verify them with "
+		"VerifyBegin(),\n"
+		"           VerifyUpdate() and VerifyFinal()\n"
+		"  -e       enable the persistent verification cache, hit "
+		"from the 2nd iteration\n"
+		"  -l SPEC  inject latency, e.g, read=50,read_kib=8,pkcs7=2000"
+		"\n"
+		"           points: open read read_kib write info "
+		"get_variable set_variable pkcs7\n"
+		"  -j N     simulate N APs with MP Services Protocol\n"
+		"  -n N     verify the files N times\n"
+		"  -o       publish the verified table and print it at exit"
+		"\n"
+		"  -p CFG   pre-verify the default entry of grub.cfg CFG "
+		"first\n"
+		"  -k DIR   key directory (default: %s)\n"
+		"  -m       boot via shim in MOK Secure Boot mode\n"
+		"  -s       sign the files with DB.key into .p7b first\n"
+		"  -t BANKS measure the files into PCR 9 of the TPM with the "
+		"active banks,\n"
+		"           e.g, sha256 or sha1,sha256, and replay the log "
+		"at exit\n"
+		"  -u       boot the synthetic UKI trusted by db, tampered "
+		"and unhooked\n"
+		"  -v       print the debug messages after initialization\n",
+		Name, HOST_KEY_DIR);
+}
+
+int
+main(int argc, char **argv)
+{
+	BOOLEAN MokSecureBoot = FALSE;
+	BOOLEAN Sign = FALSE;
+	BOOLEAN Verbose = FALSE;
+	BOOLEAN Latency = FALSE;
+	BOOLEAN Buffer = FALSE;
+	BOOLEAN Batch = FALSE;
+	BOOLEAN VerifyCache = FALSE;
+	BOOLEAN Tpm = FALSE;
+	BOOLEAN VerifiedTable = FALSE;
+	BOOLEAN Uki = FALSE;
+	UINTN ChunkSize = 0;
+	UINTN Repeat = 1;
+	UINTN NumberOfAps = 0;
+	CONST CHAR8 *GrubConfig = NULL;
+	int Option;
+
+	while ((Option = getopt(argc, argv, "abc:ej:l:n:op:k:mst:uvh")) != -1) {
+		switch (Option) {
+		case 'a':
+			Batch = TRUE;
+			break;
+		case 'b':
+			Buffer = TRUE;
+			break;
+		case 'c':
+			ChunkSize = strtoul(optarg, NULL, 0) * 1024;
+			if (!ChunkSize) {
+				Usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'e':
+			VerifyCache = TRUE;
+			break;
+		case 'j':
+			NumberOfAps = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			if (HostLatencyParse(optarg) == FALSE) {
+				fprintf(stderr, "Invalid latency %s\n",
+					optarg);
+				return 1;
+			}
+			Latency = TRUE;
+			break;
+		case 'n':
+			Repeat = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			VerifiedTable = TRUE;
+			break;
+		case 'p':
+			GrubConfig = optarg;
+			break;
+		case 'k':
+			KeyDirectory = optarg;
+			break;
+		case 'm':
+			MokSecureBoot = TRUE;
+			break;
+		case 's':
+			Sign = TRUE;
+			break;
+		case 't':
+			if (HostTcg2Parse(optarg) == FALSE) {
+				fprintf(stderr, "Invalid PCR banks %s\n",
+					optarg);
+				return 1;
+			}
+			Tpm = TRUE;
+			break;
+		case 'u':
+			Uki = TRUE;
+			break;
+		case 'v':
+			Verbose = TRUE;
+			break;
+		default:
+			Usage(argv[0]);
+			return Option == 'h' ? 0 : 1;
+		}
+	}
+
+	/* The files to verify are optional with the UKI boot */
+	if (argc - optind < (Uki == TRUE ? 1 : 2) || !Repeat) {
+		Usage(argv[0]);
+		return 1;
+	}
+
+	STATIC EFI_SYSTEM_TABLE SystemTable;
+	EFI_HANDLE ImageHandle;
+	EFI_STATUS Status;
+
+	Status = FirmwareInitialize(&SystemTable, argv[optind], MokSecureBoot,
+				    NumberOfAps, Tpm, &ImageHandle);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "Failed to initialize the firmware "
+			"(err: 0x%llx)\n", (unsigned long long)Status);
+		return 1;
+	}
+
+	UINTN NumberOfPaths = argc - optind - 1;
+	CHAR16 **Paths = calloc(NumberOfPaths, sizeof(*Paths));
+	if (!Paths)
+		return 1;
+
+	for (UINTN Index = 0; Index < NumberOfPaths; ++Index) {
+		Paths[Index] = HostStrDup(argv[optind + 1 + Index]);
+		if (!Paths[Index])
+			return 1;
+
+		if (Sign == FALSE)
+			continue;
+
+		/* The relative path is resolved as the SELoader does */
+		CHAR16 *Path = Paths[Index];
+
+		if (*Path != L'\\') {
+			Path = malloc((StrLen(Paths[Index]) + 11) *
+				      sizeof(CHAR16));
+			if (!Path)
+				return 1;
+
+			StrCpy(Path, L"\\EFI\\BOOT\\");
+			StrCpy(Path + 10, Paths[Index]);
+		}
+
+		Status = SignFile(Path);
+		if (Path != Paths[Index])
+			free(Path);
+
+		/* The missing file is left to the SELoader to report */
+		if (EFI_ERROR(Status) && Status != EFI_NOT_FOUND) {
+			fprintf(stderr, "Failed to sign %s (err: 0x%llx)\n",
+				argv[optind + 1 + Index],
+				(unsigned long long)Status);
+			return 1;
+		}
+	}
+
+	Status = EfiLibraryInitialize(ImageHandle, &SystemTable);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "Failed to initialize the SELoader library "
+			"(err: 0x%llx)\n", (unsigned long long)Status);
+		return 1;
+	}
+
+	if (Verbose == TRUE)
+		EfiConsoleSetVerbosity(CPL_DEBUG);
+
+	if (VerifyCache == TRUE) {
+		Status = EfiVerifyCacheEnable();
+		if (EFI_ERROR(Status)) {
+			fprintf(stderr, "Failed to enable the verification "
+				"cache (err: 0x%llx)\n",
+				(unsigned long long)Status);
+			return 1;
+		}
+	}
+
+	if (Tpm == TRUE) {
+		Status = EfiMeasureEnable(9);
+		if (EFI_ERROR(Status)) {
+			fprintf(stderr, "Failed to enable the measurement "
+				"(err: 0x%llx)\n", (unsigned long long)Status);
+			return 1;
+		}
+	}
+
+	if (VerifiedTable == TRUE) {
+		Status = EfiVerifiedTableEnable();
+		if (EFI_ERROR(Status)) {
+			fprintf(stderr, "Failed to enable the verified table "
+				"(err: 0x%llx)\n", (unsigned long long)Status);
+			return 1;
+		}
+	}
+
+	EFI_MOK2_VERIFY_PROTOCOL *Mok2Verify;
+
+	Status = EfiProtocolLocate(&gEfiMok2VerifyProtocolGuid,
+				   (VOID **)&Mok2Verify);
+	if (EFI_ERROR(Status)) {
+		fprintf(stderr, "MOK2 Verify Protocol not installed "
+			"(err: 0x%llx)\n", (unsigned long long)Status);
+		return 1;
+	}
+
+	if (GrubConfig) {
+		CHAR16 *Path = HostStrDup(GrubConfig);
+		if (!Path)
+			return 1;
+
+		/* Only the first iteration is served from the cache */
+		Status = EfiPreverifyGrubConfig(Path);
+		free(Path);
+		if (EFI_ERROR(Status)) {
+			fprintf(stderr, "Failed to pre-verify %s (err: "
+				"0x%llx)\n", GrubConfig,
+				(unsigned long long)Status);
+			return 1;
+		}
+	}
+
+	EFI_MOK2_VERIFY_ITEM *Items = calloc(NumberOfPaths, sizeof(*Items));
+	if (!Items)
+		return 1;
+
+	UINTN Failures = 0;
+
+	printf("iteration,path,status,microseconds\n");
+
+	for (UINTN Iteration = 0; Iteration < Repeat; ++Iteration) {
+		if (Batch == TRUE) {
+			UINT64 Start = Now();
+
+			VerifyBatch(Mok2Verify, Paths, NumberOfPaths, Buffer,
+				    Items);
+
+			UINT64 Elapsed = Now() - Start;
+
+			/* The time is of the whole batch */
+			for (UINTN Index = 0; Index < NumberOfPaths; ++Index) {
+				printf("%lu,%s,0x%llx,%.1f\n",
+				       (unsigned long)Iteration,
+				       argv[optind + 1 + Index],
+				       (unsigned long long)Items[Index].Status,
+				       Elapsed / 1000.0);
+
+				if (EFI_ERROR(Items[Index].Status))
+					++Failures;
+			}
+
+			continue;
+		}
+
+		for (UINTN Index = 0; Index < NumberOfPaths; ++Index) {
+			UINT64 Start = Now();
+
+			if (ChunkSize)
+				Status = VerifyFileStream(Mok2Verify,
+							  Paths[Index],
+							  ChunkSize);
+			else if (Buffer == TRUE)
+				Status = VerifyFileBuffer(Mok2Verify,
+							  Paths[Index]);
+			else
+				Status = Mok2Verify->VerifyFile(Mok2Verify,
+								Paths[Index]);
+
+			UINT64 Elapsed = Now() - Start;
+
+			printf("%lu,%s,0x%llx,%.1f\n",
+			       (unsigned long)Iteration,
+			       argv[optind + 1 + Index],
+			       (unsigned long long)Status, Elapsed / 1000.0);
+
+			if (EFI_ERROR(Status))
+				++Failures;
+		}
+	}
+
+	if (Uki == TRUE)
+		Failures += TestUki(MokSecureBoot);
+
+	HostExitBootServices();
+
+	if (Latency == TRUE)
+		HostLatencyReport();
+
+	if (Tpm == TRUE)
+		HostTcg2Report();
+
+	if (VerifiedTable == TRUE)
+		ReportVerifiedTable(&SystemTable);
+
+	for (UINTN Index = 0; Index < NumberOfPaths; ++Index)
+		free(Paths[Index]);
+	free(Paths);
+	free(Items);
+
+	return Failures ? 2 : 0;
+}